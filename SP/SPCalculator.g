@@ -13,11 +13,21 @@ grammar SPCalculator;
 	//We define a new method in our praser. This method will return a string
 	//Representing our tree in LISP-Style
 	public String getLisp(){
+		SPTree tree = getTree();
+		if(tree==null){
+			return new String("Invalid Expression!");		
+		}else{
+			return tree.getLisp();
+		}
+	}
+	
+	//Parse a statement into a tree (null if the statement is invalid)
+	public SPTree getTree(){
 		StatContext ctx = (StatContext)stat();
 		if(ctx.exception!=null){
-			return new String("Invalid Expression!");		
+			return null;
 		}else{
-			return ctx.tree.getLisp();
+			return ctx.tree;
 		}
 	}
 	
@@ -29,8 +39,10 @@ grammar SPCalculator;
 }
 
 
-//Valid statement is either a termination command || an arithmetical expression followed by a semicolon
+//Valid statement is either a command (termination, checkpoint or rollback) || an arithmetical expression followed by a semicolon
 stat returns [SPTree tree] : e1=TERMINATION SEMICOLON {$tree = new SPTree($e1.text);}
+			   | c=CHECKPOINT SEMICOLON {$tree = new SPTree($c.text);}
+			   | r=ROLLBACK n=NUMBER SEMICOLON {$tree = new SPTree($r.text); $tree.insertChild(new SPTree($n.text));}
 			   | a=assign  SEMICOLON {$tree = $a.tree;}
 			   | e2=exp    SEMICOLON {$tree = $e2.tree;}
  ; 
@@ -51,7 +63,7 @@ exp returns [SPTree tree] :
 			  ;
 
 assign returns [SPTree tree] :
-			  v=VAR_NAME c=EQUALS e=exp {$tree = new SPTree($c.text); $tree.insertChild(new SPTree($v.text)); $tree.insertChild($e.tree);}
+			  v=VAR_NAME c=(EQUALS|BIND) e=exp {$tree = new SPTree($c.text); $tree.insertChild(new SPTree($v.text)); $tree.insertChild($e.tree);}
 			  ;
 			  
 expList returns [ ArrayList<SPTree> children ]
@@ -64,6 +76,8 @@ expList returns [ ArrayList<SPTree> children ]
 
 // parser rules start with lowercase letters, lexer rules with uppercase
 TERMINATION: '<>';
+CHECKPOINT: '<checkpoint>';
+ROLLBACK: '<rollback>';
 SEMICOLON: ';';
 
 // Numbers
@@ -80,6 +94,7 @@ MULPTIPLY: '*';
 DIVIDE: '/';
 SUM_RANGE: '$';
 EQUALS: '=';
+BIND: ':=';
 MIN: 'min';
 MAX: 'max';
 MEDIAN: 'median';
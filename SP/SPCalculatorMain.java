@@ -9,17 +9,28 @@ public class SPCalculatorMain {
 	private final static HashSet<String> inputFlag =  new HashSet<String>(Arrays.asList("-i","-I"));
 	private final static HashSet<String> outputFlag = new HashSet<String>(Arrays.asList("-o","-O"));
 	private final static HashSet<String> errorFlag =  new HashSet<String>(Arrays.asList("-e","-E"));
+	private final static HashSet<String> binaryFlag = new HashSet<String>(Arrays.asList("-b","-B"));
+	private final static HashSet<String> batchFlag =  new HashSet<String>(Arrays.asList("-m","-M"));
+	//Whether to emit trees in the binary format instead of LISP-style text
+	private static boolean isBinaryOutput = false;
+	//Whether to emit LISP-style trees in length-prefixed batches instead of lines
+	private static boolean isBatchOutput = false;
+	//Maximal amount of expressions in a batch
+	private final static int MAX_BATCH_SIZE = 1024;
 	//Print a usage message to stderr	
 	private static void usage(){
-		System.err.println("Usage: -i [filename] -o [filename] -e [filename]");
+		System.err.println("Usage: -i [filename] -o [filename] -e [filename] [-b | -m]");
 	}
 	//Checks if str is valid flag
 	private static boolean isFlag(String str){
-		return inputFlag.contains(str) || outputFlag.contains(str) || errorFlag.contains(str);
+		return inputFlag.contains(str) || outputFlag.contains(str) || errorFlag.contains(str) || binaryFlag.contains(str) || batchFlag.contains(str);
 	}
 	//Checks if all options are in a valid form
 	private static void checkOptions(String[] args){
 		for(int i =0;i<args.length;i++){
+			if(binaryFlag.contains(args[i]) || batchFlag.contains(args[i])){ //These flags have no filename
+				continue;
+			}
 			if(isFlag(args[i])){
 				if(++i>=args.length || isFlag(args[i])){
 					usage();
@@ -35,7 +46,11 @@ public class SPCalculatorMain {
 	private static void setStandardIOE(String[] args){
 		checkOptions(args);
 		for(int i =0;i<args.length;i++){
-			if(outputFlag.contains(args[i])){
+			if(binaryFlag.contains(args[i])){
+				isBinaryOutput = true;
+			}else if(batchFlag.contains(args[i])){
+				isBatchOutput = true;
+			}else if(outputFlag.contains(args[i])){
 				try{
 				    System.setOut( new PrintStream(new FileOutputStream(args[++i])));
 				 }catch(Exception e){
@@ -73,6 +88,12 @@ public class SPCalculatorMain {
 		setStandardIOE(args);
 		//Start reading from stdin
 		BufferedReader br = new BufferedReader(new InputStreamReader(System.in));
+		//Binary output stream, and the ids of the variables written to it
+		DataOutputStream binaryOut = new DataOutputStream(new BufferedOutputStream(System.out));
+		Map<String, Integer> variableIds = new HashMap<String, Integer>();
+		//Pending expressions of the current batch
+		List<byte[]> batch = new ArrayList<byte[]>();
+		boolean isTerminated = false;
 		String s;
 		while((s = br.readLine())!=null){
 			try{
@@ -85,16 +106,60 @@ public class SPCalculatorMain {
 				// create a parser that feeds off the tokens buffer
 				SPCalculatorParser parser = new SPCalculatorParser(tokens);
 				parser.setErrorHandler(new BailErrorStrategy());
+				if(isBinaryOutput){
+					// Start parsing + write the tree as a frame: 32 bit length, then the payload
+					SPTree tree = parser.getTree();
+					if(tree==null){
+						throw new Exception("Invalid Expression");
+					}
+					ByteArrayOutputStream payload = new ByteArrayOutputStream();
+					tree.writeBinary(new DataOutputStream(payload), variableIds);
+					binaryOut.writeInt(payload.size());
+					payload.writeTo(binaryOut);
+					binaryOut.flush();
+					if(!tree.hasChildren() && tree.getValue().equals("<>")){ //Termination command
+						break;
+					}
+					continue;
+				}
 				// Start parsing + return the tree in LispStyle -				
 				String lispTree = parser.getLisp();
+				if(isBatchOutput){
+					batch.add(lispTree.getBytes("US-ASCII"));
+					isTerminated = isTermination(lispTree);
+					continue;
+				}
 				System.out.println(lispTree); // print LISP-style tree
 				if(isTermination(lispTree)){ //If we had termination command we need to terminate the java prog as well.
 					break;
 				}
 			}catch(Exception e){ // Exception May occur during parsing!
 				System.err.println("Invalid Expression : " + s);
+			}finally{
+				//A batch is sent once no more input is waiting (or it's full)
+				if(isBatchOutput && !batch.isEmpty() && (isTerminated || !br.ready() || batch.size() >= MAX_BATCH_SIZE)){
+					writeBatch(binaryOut, batch);
+				}
+			}
+			if(isTerminated){
+				break;
 			}
 		}
+		if(isBatchOutput && !batch.isEmpty()){
+			writeBatch(binaryOut, batch);
+		}
 		
 	}
+	//Write a batch: the amount of expressions and their lengths (32 bit each), then the expressions
+	private static void writeBatch(DataOutputStream out, List<byte[]> batch) throws IOException{
+		out.writeInt(batch.size());
+		for(byte[] expression : batch){
+			out.writeInt(expression.length);
+		}
+		for(byte[] expression : batch){
+			out.write(expression);
+		}
+		out.flush();
+		batch.clear();
+	}
 }	
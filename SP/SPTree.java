@@ -1,10 +1,22 @@
 package SP;
 
 import java.util.*;
+import java.io.*;
 import java.lang.StringBuffer;
 
 //A simple tree data structure which supports LispStyle conversion method
 public class SPTree{
+	//Node kinds of the binary format (see codec.h)
+	private final static int NODE_OPERATION = 0;
+	private final static int NODE_NUMBER = 1;
+	private final static int NODE_NUMBER_TEXT = 2;
+	private final static int NODE_VARIABLE = 3;
+	private final static int NODE_NEW_VARIABLE = 4;
+	private final static int NODE_END_COMMAND = 5;
+	private final static int NODE_CHECKPOINT_COMMAND = 6;
+	//Operations of the binary format, by opcode
+	private final static List<String> OPERATIONS = Arrays.asList(
+			"+", "-", "*", "/", "$", "=", ":=", "min", "max", "average", "median", "<rollback>");
 	//Each node has a string value
 	private String value;
 	//A list of node's children
@@ -22,6 +34,71 @@ public class SPTree{
 	public SPTree getChildAtIndex(int index){
 		return childList.get(index);
 	}
+	//Get the string value of the node
+	public String getValue(){
+		return value;
+	}
+	//Check if the node has children
+	public boolean hasChildren(){
+		return !childList.isEmpty();
+	}
+	//Write the tree in the binary format (pre-order).
+	//variableIds maps the names of the variables already written to the stream to their ids
+	public void writeBinary(DataOutputStream out, Map<String, Integer> variableIds) throws IOException{
+		if(!childList.isEmpty()){
+			out.writeByte(NODE_OPERATION);
+			out.writeByte(OPERATIONS.indexOf(value));
+			writeVarint(out, childList.size());
+			for(SPTree child : childList){
+				child.writeBinary(out, variableIds);
+			}
+		}else if(value.equals("<>")){
+			out.writeByte(NODE_END_COMMAND);
+		}else if(value.equals("<checkpoint>")){
+			out.writeByte(NODE_CHECKPOINT_COMMAND);
+		}else if(Character.isDigit(value.charAt(0))){
+			if(isCanonicalNumber(value)){
+				out.writeByte(NODE_NUMBER);
+				writeVarint(out, Long.parseLong(value));
+			}else{
+				out.writeByte(NODE_NUMBER_TEXT);
+				writeString(out, value);
+			}
+		}else if(variableIds.containsKey(value)){
+			out.writeByte(NODE_VARIABLE);
+			writeVarint(out, variableIds.get(value));
+		}else{
+			out.writeByte(NODE_NEW_VARIABLE);
+			writeString(out, value);
+			variableIds.put(value, variableIds.size());
+		}
+	}
+	//Check if a number literal is the decimal text of a 64 bit value (no leading zeros)
+	private static boolean isCanonicalNumber(String str){
+		if(str.length() > 1 && str.charAt(0) == '0'){
+			return false;
+		}
+		try{
+			Long.parseLong(str);
+			return true;
+		}catch(NumberFormatException e){
+			return false;
+		}
+	}
+	//Write an unsigned LEB128 varint
+	private static void writeVarint(DataOutputStream out, long value) throws IOException{
+		while(value >= 0x80){
+			out.writeByte((int)(value & 0x7f) | 0x80);
+			value >>>= 7;
+		}
+		out.writeByte((int)value);
+	}
+	//Write a string prefixed by it's length
+	private static void writeString(DataOutputStream out, String str) throws IOException{
+		byte[] bytes = str.getBytes("US-ASCII");
+		writeVarint(out, bytes.length);
+		out.write(bytes);
+	}
 	//Get a string representing the tree in LISP Style
 	public String getLisp(){
 		StringBuffer sBuf = new StringBuffer();
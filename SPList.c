@@ -1,5 +1,9 @@
 #include "SPList.h"
 #include <stdlib.h>
+#include "alloc.h"
+
+/* Amount of nodes which the node pool allocates at once */
+#define NODE_POOL_CHUNK_SIZE 64
 
 typedef struct Node_t {
 	SPListElement data;
@@ -7,17 +11,40 @@ typedef struct Node_t {
 	struct Node_t* previous;
 }*Node;
 
-Node createNode(Node previous, Node next, SPListElement element) {
-	SPListElement newElement = copyElement(element);
-	if (newElement == NULL ) {
-		return NULL ;
+/* Nodes which were released, linked by their next pointers. Nodes are taken from it
+ * before new ones are allocated, so inserting into a list rarely allocates a node */
+Node freeNodes = NULL;
+
+/* Takes a node from the pool, and allocates a chunk of nodes if the pool is empty */
+Node allocateNode() {
+	if (freeNodes == NULL ) {
+		Node chunk = (Node) ALLOCATE(ALLOC_VARIABLES, NODE_POOL_CHUNK_SIZE * sizeof(*chunk));
+		if (chunk == NULL ) {
+			return NULL ;
+		}
+		for (int i = 0; i < NODE_POOL_CHUNK_SIZE; i++) {
+			chunk[i].next = (i + 1 < NODE_POOL_CHUNK_SIZE) ? &chunk[i + 1] : NULL;
+		}
+		freeNodes = chunk;
 	}
-	Node newNode = (Node) malloc(sizeof(*newNode));
+	Node node = freeNodes;
+	freeNodes = node->next;
+	return node;
+}
+
+/* Returns a node to the pool (the chunks of the pool are never released) */
+void releaseNode(Node node) {
+	node->next = freeNodes;
+	freeNodes = node;
+}
+
+/* Creates a node which owns the given element (which isn't copied) */
+Node createNode(Node previous, Node next, SPListElement element) {
+	Node newNode = allocateNode();
 	if (newNode == NULL ) {
-		destroyElement(newElement);
 		return NULL ;
 	}
-	newNode->data = newElement;
+	newNode->data = element;
 	newNode->previous = previous;
 	newNode->next = next;
 	return newNode;
@@ -30,10 +57,13 @@ void destroyNode(Node node){
 	if(node->data!=NULL){
 		destroyElement(node->data);
 	}
-	free(node);
+	releaseNode(node);
 }
 
+/* The sentinel nodes are stored inside the list, so creating a list is a single allocation */
 struct List_t {
+	struct Node_t headSentinel;
+	struct Node_t tailSentinel;
 	Node head;
 	Node tail;
 	Node current;
@@ -41,21 +71,12 @@ struct List_t {
 };
 
 SPList listCreate() {
-	SPList list = (SPList) malloc(sizeof(*list));
+	SPList list = (SPList) ALLOCATE(ALLOC_VARIABLES, sizeof(*list));
 	if (list == NULL ) {
 		return NULL ;
 	} else {
-		list->head = (Node) malloc(sizeof(*list->head));
-		if (list->head == NULL ) {
-			free(list);
-			return NULL ;
-		}
-		list->tail = (Node) malloc(sizeof(*list->tail));
-		if (list->tail == NULL ) {
-			free(list->head);
-			free(list);
-			return NULL ;
-		}
+		list->head = &list->headSentinel;
+		list->tail = &list->tailSentinel;
 		list->head->data = NULL;
 		list->head->next = list->tail;
 		list->head->previous = NULL;
@@ -126,7 +147,7 @@ SPListElement listGetCurrent(SPList list) {
 	}
 }
 
-ListResult listInsertFirst(SPList list, SPListElement element) {
+ListResult listInsertFirstOwned(SPList list, SPListElement element) {
 	if (list == NULL || element == NULL ) {
 		return SP_LIST_NULL_ARGUMENT;
 	}
@@ -140,7 +161,7 @@ ListResult listInsertFirst(SPList list, SPListElement element) {
 	return SP_LIST_SUCCESS;
 }
 
-ListResult listInsertLast(SPList list, SPListElement element) {
+ListResult listInsertLastOwned(SPList list, SPListElement element) {
 	if (list == NULL || element == NULL ) {
 		return SP_LIST_NULL_ARGUMENT;
 	}
@@ -154,6 +175,36 @@ ListResult listInsertLast(SPList list, SPListElement element) {
 	return SP_LIST_SUCCESS;
 }
 
+ListResult listInsertFirst(SPList list, SPListElement element) {
+	if (list == NULL || element == NULL ) {
+		return SP_LIST_NULL_ARGUMENT;
+	}
+	SPListElement newElement = copyElement(element);
+	if (newElement == NULL ) {
+		return SP_LIST_OUT_OF_MEMORY;
+	}
+	ListResult res = listInsertFirstOwned(list, newElement);
+	if (res != SP_LIST_SUCCESS) {
+		destroyElement(newElement);
+	}
+	return res;
+}
+
+ListResult listInsertLast(SPList list, SPListElement element) {
+	if (list == NULL || element == NULL ) {
+		return SP_LIST_NULL_ARGUMENT;
+	}
+	SPListElement newElement = copyElement(element);
+	if (newElement == NULL ) {
+		return SP_LIST_OUT_OF_MEMORY;
+	}
+	ListResult res = listInsertLastOwned(list, newElement);
+	if (res != SP_LIST_SUCCESS) {
+		destroyElement(newElement);
+	}
+	return res;
+}
+
 ListResult listInsertBeforeCurrent(SPList list, SPListElement element) {
 	if (list == NULL || element == NULL ) {
 		return SP_LIST_NULL_ARGUMENT;
@@ -161,8 +212,13 @@ ListResult listInsertBeforeCurrent(SPList list, SPListElement element) {
 	if (list->current == NULL ) {
 		return SP_LIST_INVALID_CURRENT;
 	}
-	Node newNode = createNode(list->current->previous, list->current, element);
+	SPListElement newElement = copyElement(element);
+	if (newElement == NULL ) {
+		return SP_LIST_OUT_OF_MEMORY;
+	}
+	Node newNode = createNode(list->current->previous, list->current, newElement);
 	if (newNode == NULL ) {
+		destroyElement(newElement);
 		return SP_LIST_OUT_OF_MEMORY;
 	}
 	list->current->previous->next = newNode;
@@ -218,7 +274,5 @@ void listDestroy(SPList list){
 		return;
 	}
 	listClear(list);
-	destroyNode(list->head);
-	destroyNode(list->tail);
-	free(list);
+	deallocate(list);
 }
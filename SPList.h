@@ -23,6 +23,10 @@
  *                              element and returns it.
  *   listInsertFirst          - Inserts an element in the beginning of the list
  *   listInsertLast           - Inserts an element in the end of the list
+ *   listInsertFirstOwned     - Inserts an element in the beginning of the list,
+ *                              without copying it
+ *   listInsertLastOwned      - Inserts an element in the end of the list,
+ *                              without copying it
  *   listInsertBeforeCurrent  - Inserts an element right before the place of
  *                              internal iterator
  *   listInsertAfterCurrent   - Inserts an element right after the place of the
@@ -159,6 +163,39 @@ ListResult listInsertFirst(SPList list, SPListElement element);
  */
 ListResult listInsertLast(SPList list, SPListElement element);
 
+/**
+ * Adds an element to the list, the element will be the first element. The state
+ * of the iterator will not be changed.
+ * Unlike listInsertFirst, the element isn't copied: the list takes ownership of it,
+ * and destroys it when it's removed. Nodes are taken from a pool of released nodes,
+ * so the insert usually doesn't allocate at all.
+ *
+ * @param list The list for which to add an element in its start
+ * @param element The element to insert. On success it's owned by the list,
+ * and otherwise it's left to the caller
+ * @return
+ * SP_LIST_NULL_ARGUMENT if a NULL was sent as list or element
+ * SP_LIST_OUT_OF_MEMORY if an allocation failed
+ * SP_LIST_SUCCESS the element has been inserted successfully
+ */
+ListResult listInsertFirstOwned(SPList list, SPListElement element);
+
+/**
+ * Adds an element to the list, the element will be the last element. The state
+ * of the iterator will not be changed.
+ * Unlike listInsertLast, the element isn't copied: the list takes ownership of it
+ * (see listInsertFirstOwned).
+ *
+ * @param list The list for which to add an element in its end
+ * @param element The element to insert. On success it's owned by the list,
+ * and otherwise it's left to the caller
+ * @return
+ * SP_LIST_NULL_ARGUMENT if a NULL was sent as list or element
+ * SP_LIST_OUT_OF_MEMORY if an allocation failed
+ * SP_LIST_SUCCESS the element has been inserted successfully
+ */
+ListResult listInsertLastOwned(SPList list, SPListElement element);
+
 /**
  * Adds a new element to the list, the new element will be placed right before
  * the current element (As pointed by the inner iterator of the list). The state
@@ -239,7 +276,7 @@ void listDestroy(SPList list);
  *     char* eStr = getElementStr(e)
  *     assert(eStr != NULL);
  *     printf("%s\\n", eStr);
- *     free(eStr);
+ *     deallocate(eStr);
  *   }
  * }
  * @endcode
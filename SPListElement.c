@@ -1,11 +1,19 @@
 #include "SPListElement.h"
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include "alloc.h"
 
 
+/* Strings shorter than this (like most variable names) are stored inside the element */
+#define ELEMENT_INLINE_STR_SIZE 24
+
+/* The value and short strings are stored inline, so creating an element is a single allocation */
 struct SPListElement_t {
-	char* elementStr;
-	double* elementValue;
+	char* elementStr; //Points to elementInlineStr if the string fits in it
+	double elementValue;
+	unsigned long elementVersion;
+	char elementInlineStr[ELEMENT_INLINE_STR_SIZE];
 };
 
 char* copyStr(char* str){
@@ -13,7 +21,7 @@ char* copyStr(char* str){
 		return NULL;
 	}else{
 		int sizeOfStr = strlen(str);
-		char* tempStr = (char*)calloc((sizeOfStr+1),sizeof(char));
+		char* tempStr = (char*)ALLOCATE_ZEROED(ALLOC_VARIABLES, (sizeOfStr+1),sizeof(char));
 		strcpy(tempStr,str);
 		tempStr[sizeOfStr] = '\0';
 		return tempStr;
@@ -21,7 +29,7 @@ char* copyStr(char* str){
 }
 
 double* copyDouble(double value){
-	double* newValue = (double*)malloc(sizeof(*newValue));
+	double* newValue = (double*)ALLOCATE(ALLOC_VARIABLES, sizeof(*newValue));
 	if(newValue==NULL){
 		return NULL;
 	}else{
@@ -30,63 +38,64 @@ double* copyDouble(double value){
 	}
 }
 
+/* Stores a copy of str in the element (inline if it fits), releasing the previous string.
+ * Returns false if allocation fails (and then the element is left as it was) */
+bool storeElementStr(SPListElement data, char* str){
+	char* oldStr = data->elementStr;
+	size_t sizeOfStr = strlen(str);
+	if(sizeOfStr < ELEMENT_INLINE_STR_SIZE){
+		memmove(data->elementInlineStr,str,sizeOfStr+1);
+		data->elementStr = data->elementInlineStr;
+	}else{
+		char* strCopy = copyStr(str);
+		if(strCopy == NULL){//Allocation fails
+			return false;
+		}
+		data->elementStr = strCopy;
+	}
+	if(oldStr != NULL && oldStr != data->elementInlineStr){
+		deallocate(oldStr);
+	}
+	return true;
+}
+
 SPListElement createElement(char* str, double value){
 	if(str==NULL){
 		return NULL;
 	}
-	SPListElement temp = (SPListElement) malloc(sizeof(*temp));
+	SPListElement temp = (SPListElement) ALLOCATE(ALLOC_VARIABLES, sizeof(*temp));
 	if(temp == NULL){//Allocation Fails
 		return NULL;
-	}else{
-		temp->elementStr = copyStr(str);
-		if(temp->elementStr == NULL){//Allocation fails
-			free(temp);
-			return NULL;
-		}else{
-			temp->elementValue = copyDouble(value);
-			if(temp->elementValue == NULL){
-				free(temp->elementStr);
-				free(temp);
-				return NULL;
-			}
-			return temp;
-		}
 	}
+	temp->elementStr = NULL;
+	if(!storeElementStr(temp,str)){//Allocation fails
+		deallocate(temp);
+		return NULL;
+	}
+	temp->elementValue = value;
+	temp->elementVersion = 0;
+	return temp;
 }
 SPListElement copyElement(SPListElement data){
 	if(data==NULL){
 		return NULL;
 	}
-    SPListElement copyElement = (SPListElement) malloc(sizeof(*copyElement));
-    if(copyElement==NULL){
-    	return NULL;
-    }
-    char* str = data->elementStr;
-    if(str==NULL){
-    	return NULL;
-    }else{
-    	copyElement->elementStr = copyStr(data->elementStr);
-    	if(copyElement->elementStr == NULL){
-    		free(copyElement);
-    		return NULL;
-    	}
-    	copyElement->elementValue = copyDouble(*data->elementValue);
-    	if(copyElement->elementValue == NULL){
-    		free(copyElement->elementStr);
-    		free(copyElement);
-    		return NULL;
-    	}
-    	return copyElement;
-    }
+	SPListElement copyElement = createElement(data->elementStr,data->elementValue);
+	if(copyElement==NULL){
+		return NULL;
+	}
+	copyElement->elementVersion = data->elementVersion;
+	return copyElement;
 }
 
 void destroyElement(SPListElement data){
 	if(data==NULL){
 		return;
 	}else{
-		free(data->elementStr);
-		free(data->elementValue);
-		free(data);
+		if(data->elementStr != data->elementInlineStr){
+			deallocate(data->elementStr);
+		}
+		deallocate(data);
 		return;
 	}
 }
@@ -95,14 +104,7 @@ SPElementResult setElementStr(SPListElement data, char* str){
 	if(data == NULL || str == NULL){//str value cannot be NULL
 		return SP_ELEMENT_INVALID_ARGUMENT;
 	}else{
-		char* strCopy = copyStr(str);
-		if(strCopy == NULL){//Allocation fails
-			return SP_ELEMENT_OUT_OF_MEMORY;
-		}else{
-			free(data->elementStr);
-			data->elementStr=strCopy;
-			return SP_ELEMENT_SUCCESS;
-		}
+		return storeElementStr(data,str) ? SP_ELEMENT_SUCCESS : SP_ELEMENT_OUT_OF_MEMORY;
 	}
 }
 
@@ -114,19 +116,17 @@ SPElementResult setELementValue(SPListElement data, double newValue){
 	if(data==NULL){
 		return SP_ELEMENT_INVALID_ARGUMENT;
 	}else{
-		double* valueCopy = copyDouble(newValue);
-		if(valueCopy==NULL){
-			return SP_ELEMENT_OUT_OF_MEMORY;
-		}else{
-			free(data->elementValue);
-			data->elementValue = valueCopy;
-			return SP_ELEMENT_SUCCESS;
-		}
+		data->elementValue = newValue;
+		return SP_ELEMENT_SUCCESS;
 	}
 }
 
 double* getElementValue(SPListElement data){
-	return (data==NULL ? NULL : copyDouble(*data->elementValue));
+	return (data==NULL ? NULL : copyDouble(data->elementValue));
+}
+
+double readElementValue(SPListElement data){
+	return (data==NULL ? NAN : data->elementValue);
 }
 
 bool areElementsEqual(SPListElement data1,SPListElement data2){
@@ -134,7 +134,7 @@ bool areElementsEqual(SPListElement data1,SPListElement data2){
 		return false;
 	}else{
 		return (strcmp(data1->elementStr,data2->elementStr) == 0 ) &&
-			   (*data1->elementValue == *data2->elementValue);
+			   (data1->elementValue == data2->elementValue);
 	}
 }
 
@@ -150,6 +150,19 @@ bool isElementValueEquals(SPListElement data1,double value){
 	if(data1==NULL){
 		return false;
 	}else{
-		return *data1->elementValue == value ? true : false;
+		return data1->elementValue == value ? true : false;
 	}
-}
\ No newline at end of file
+}
+
+SPElementResult setElementVersion(SPListElement data, unsigned long version){
+	if(data==NULL){
+		return SP_ELEMENT_INVALID_ARGUMENT;
+	}else{
+		data->elementVersion = version;
+		return SP_ELEMENT_SUCCESS;
+	}
+}
+
+unsigned long getElementVersion(SPListElement data){
+	return (data==NULL ? 0 : data->elementVersion);
+}
@@ -11,6 +11,8 @@
  * 		double Value
  * Two elements e1 and e2 are said to be equal iff:
  * 		(e1.str == e2.str) AND (e1.Value == e2.Value)
+ * The value and short strings are stored inside the element, so creating
+ * an element usually takes a single allocation.
  *
  * The following functions are available
  *	createElement   - Creates a new element with a copy of a specific string and double value
@@ -22,6 +24,9 @@
  *  getElementStr   - Gets a copy of the string of the target element
  *  setElementValue - Sets a new value to the target element.
  *  getElementValue - Gets a copy of the value of the target element
+ *  readElementValue - Gets the value of the target element (without copying it)
+ *  setElementVersion - Sets the version of the target element.
+ *  getElementVersion - Gets the version of the target element
  */
 
 /** Type used for returning error codes from element functions */
@@ -134,8 +139,36 @@ SPElementResult setELementValue(SPListElement data, double newValue);
  * @param data the target element
  * @return
  * NULL in case data==NULL or memory allocation fails.
- * A copy of the element value otherwise.
+ * A copy of the element value otherwise (which has to be released by deallocate).
  */
 double* getElementValue(SPListElement data);
 
+/* A getter of the value of the target element, which doesn't copy it
+ * @param data the target element
+ * @return
+ * NAN in case data==NULL.
+ * The element value otherwise.
+ */
+double readElementValue(SPListElement data);
+
+/* A setter of the version of the target element.
+ * The version is an opaque counter which isn't part of the element equality,
+ * and is copied along with the element. New elements have version 0.
+ *
+ * @param data the target element
+ * @param version The new version of the target element
+ * @return
+ * SP_ELEMENT_INVALID_ARGUMENT in case data==NULL
+ * SP_ELEMENT_SUCCESS otherwise
+ */
+SPElementResult setElementVersion(SPListElement data, unsigned long version);
+
+/* A getter of the version of the target element
+ * @param data the target element
+ * @return
+ * 0 in case data==NULL.
+ * The version of the element otherwise.
+ */
+unsigned long getElementVersion(SPListElement data);
+
 #endif /* LISTELEMENT_H_ */
@@ -0,0 +1,330 @@
+/*
+ * Allocation Module
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+#include "common.h"
+
+/*
+ * Constants
+ */
+
+/* Maximal amount of call sites which allocate memory (there are fewer than 100).
+ * The table is kept small, since the first allocation at each site touches it's slot,
+ * and each page of the table touched at startup costs a page fault. */
+#define ALLOCATION_SITES_BITS 8
+#define MAX_ALLOCATION_SITES (1 << ALLOCATION_SITES_BITS)
+
+/* Site of allocations which were made while call sites weren't tracked */
+#define NO_ALLOCATION_SITE MAX_ALLOCATION_SITES
+
+/* Multiplier of the (Fibonacci) hash of call sites */
+#define ALLOCATION_SITE_HASH_MULTIPLIER (2654435761u)
+
+/* Names of the categories (by their enum values) */
+const char* ALLOC_TAG_NAMES[ALLOC_TAGS_COUNT] = {
+    "trees", "strings", "parsing", "variables", "checkpoints", "plans", "formulas", "evaluation", "io"
+};
+
+/*
+ * Types
+ */
+
+/*
+ * Header which precedes each allocated memory, so it's size and call site are known when it's released.
+ * The union keeps the memory after it aligned like memory returned by malloc.
+ */
+typedef union AllocationHeader_
+{
+    struct
+    {
+        size_t size;
+        unsigned int site;
+    } fields;
+    long double alignment;
+} AllocationHeader;
+
+/* Call site which allocates memory */
+typedef struct AllocationSite_
+{
+    const char* file;               /* NULL if the slot is empty */
+    int line;
+    AllocTag tag;
+    unsigned long long allocations;
+    unsigned long long bytes;
+    size_t live_bytes;
+} AllocationSite;
+
+/*
+ * Globals
+ */
+
+/* Hash table of the call sites (with linear probing) */
+AllocationSite allocationSites[MAX_ALLOCATION_SITES];
+
+size_t liveBytes = 0;
+size_t peakBytes = 0;
+
+/* Whether allocations are accounted to their call sites (see enableAllocationSites) */
+bool areSitesEnabled = false;
+
+/* Allocations of the current line, and their budget (0 if there's none).
+ * Allocations before the first line (e.g. of the variables table) aren't counted. */
+bool isLineStarted = false;
+unsigned long long lineAllocations = 0;
+unsigned long long allocationBudget = 0;
+
+/*
+ * Internal Function Declarations
+ */
+
+unsigned int findAllocationSite(AllocTag tag, const char* file, int line);
+void* recordAllocation(AllocationHeader* header, size_t size, AllocTag tag, const char* file, int line);
+int compareAllocationSites(const void* first, const void* second);
+
+/*
+ * Module Functions
+ */
+
+void* allocate(AllocTag tag, size_t size, const char* file, int line)
+{
+    AllocationHeader* header = malloc(sizeof(*header) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    return recordAllocation(header, size, tag, file, line);
+}
+
+void* allocateZeroed(AllocTag tag, size_t count, size_t size, const char* file, int line)
+{
+    if (size != 0 && count > ((size_t)-1 - sizeof(AllocationHeader)) / size) {
+        return NULL;
+    }
+    AllocationHeader* header = calloc(1, sizeof(*header) + count * size);
+    if (header == NULL) {
+        return NULL;
+    }
+    return recordAllocation(header, count * size, tag, file, line);
+}
+
+void* reallocate(AllocTag tag, void* pointer, size_t size, const char* file, int line)
+{
+    if (pointer == NULL) {
+        return allocate(tag, size, file, line);
+    }
+    AllocationHeader* header = (AllocationHeader*)pointer - 1;
+    size_t old_size = header->fields.size;
+    unsigned int old_site = header->fields.site;
+    header = realloc(header, sizeof(*header) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    liveBytes -= old_size;
+    if (old_site != NO_ALLOCATION_SITE) {
+        allocationSites[old_site].live_bytes -= old_size;
+    }
+    return recordAllocation(header, size, tag, file, line);
+}
+
+void deallocate(void* pointer)
+{
+    if (pointer == NULL) {
+        return;
+    }
+    AllocationHeader* header = (AllocationHeader*)pointer - 1;
+    liveBytes -= header->fields.size;
+    if (header->fields.site != NO_ALLOCATION_SITE) {
+        allocationSites[header->fields.site].live_bytes -= header->fields.size;
+    }
+    free(header);
+}
+
+void enableAllocationSites()
+{
+    areSitesEnabled = true;
+}
+
+void setAllocationBudget(unsigned long long budget)
+{
+    allocationBudget = budget;
+    if (budget != 0) {
+        /* The site which exceeds the budget is reported */
+        enableAllocationSites();
+    }
+}
+
+void startLineAllocations()
+{
+    isLineStarted = true;
+    lineAllocations = 0;
+}
+
+size_t getLiveBytes()
+{
+    return liveBytes;
+}
+
+size_t getPeakBytes()
+{
+    return peakBytes;
+}
+
+void printAllocationStats(FILE* file, StatsFormat format)
+{
+    VERIFY(file != NULL);
+
+    /* Sum the categories, and order the call sites */
+    AllocationSite totals[ALLOC_TAGS_COUNT];
+    memset(totals, 0, sizeof(totals));
+    AllocationSite* sites[MAX_ALLOCATION_SITES];
+    unsigned int sites_count = 0;
+    for (unsigned int i = 0; i < MAX_ALLOCATION_SITES; ++i)
+    {
+        AllocationSite* site = &allocationSites[i];
+        if (site->file == NULL) {
+            continue;
+        }
+        totals[site->tag].allocations += site->allocations;
+        totals[site->tag].bytes += site->bytes;
+        totals[site->tag].live_bytes += site->live_bytes;
+        sites[sites_count] = site;
+        sites_count += 1;
+    }
+    qsort(sites, sites_count, sizeof(*sites), compareAllocationSites);
+
+    if (format == STATS_JSON) {
+        fprintf(file, "{\"live_bytes\": %zu, \"peak_bytes\": %zu, \"categories\": {", liveBytes, peakBytes);
+        for (unsigned int tag = 0; tag < ALLOC_TAGS_COUNT; ++tag)
+        {
+            fprintf(file, "%s\"%s\": {\"allocations\": %llu, \"bytes\": %llu, \"live_bytes\": %zu}",
+                    (tag > 0) ? ", " : "", ALLOC_TAG_NAMES[tag],
+                    totals[tag].allocations, totals[tag].bytes, totals[tag].live_bytes);
+        }
+        fprintf(file, "}, \"sites\": [");
+        for (unsigned int i = 0; i < sites_count; ++i)
+        {
+            fprintf(file, "%s{\"site\": \"%s:%d\", \"category\": \"%s\", "
+                          "\"allocations\": %llu, \"bytes\": %llu, \"live_bytes\": %zu}",
+                    (i > 0) ? ", " : "", sites[i]->file, sites[i]->line, ALLOC_TAG_NAMES[sites[i]->tag],
+                    sites[i]->allocations, sites[i]->bytes, sites[i]->live_bytes);
+        }
+        fprintf(file, "]}");
+        return;
+    }
+
+    fprintf(file, "live bytes %zu, peak bytes %zu\n", liveBytes, peakBytes);
+    fprintf(file, "%-20s %12s %12s %12s\n", "category", "allocations", "bytes", "live bytes");
+    for (unsigned int tag = 0; tag < ALLOC_TAGS_COUNT; ++tag)
+    {
+        fprintf(file, "%-20s %12llu %12llu %12zu\n", ALLOC_TAG_NAMES[tag],
+                totals[tag].allocations, totals[tag].bytes, totals[tag].live_bytes);
+    }
+    fprintf(file, "%-20s %12s %12s %12s\n", "site", "allocations", "bytes", "live bytes");
+    for (unsigned int i = 0; i < sites_count; ++i)
+    {
+        char site_name[64];
+        snprintf(site_name, sizeof(site_name), "%s:%d", sites[i]->file, sites[i]->line);
+        fprintf(file, "%-20s %12llu %12llu %12zu\n", site_name,
+                sites[i]->allocations, sites[i]->bytes, sites[i]->live_bytes);
+    }
+}
+
+/*
+ * Internal Functions
+ */
+
+/**
+ * Find the slot of a call site, and add it to the sites table if it isn't there yet.
+ *
+ * @param
+ *      AllocTag tag - Category of the call site's allocations.
+ *      const char* file - File of the call site.
+ *      int line - Line of the call site.
+ *
+ * @return
+ *      Index of the call site's slot.
+ */
+unsigned int findAllocationSite(AllocTag tag, const char* file, int line)
+{
+    /* This is called by every allocation, so only the line is hashed (by a single multiplication),
+     * and the file names are compared by pointer before they're compared by content */
+    unsigned int index = ((unsigned int)line * ALLOCATION_SITE_HASH_MULTIPLIER) >> (32 - ALLOCATION_SITES_BITS);
+    for (unsigned int probes = 0; probes < MAX_ALLOCATION_SITES; ++probes)
+    {
+        AllocationSite* site = &allocationSites[index];
+        if (site->file == NULL) {
+            VERIFY(tag < ALLOC_TAGS_COUNT && file != NULL);
+            site->file = file;
+            site->line = line;
+            site->tag = tag;
+            return index;
+        }
+        if (site->line == line && (site->file == file || strcmp(site->file, file) == 0)) {
+            return index;
+        }
+        index = (index + 1) % MAX_ALLOCATION_SITES;
+    }
+    panic();
+}
+
+/**
+ * Account for allocated memory (to it's call site, if sites are tracked), and check the allocation budget.
+ *
+ * @param
+ *      AllocationHeader* header - The allocated memory (which starts with the header).
+ *      size_t size - Amount of bytes after the header.
+ *      AllocTag tag - Category of the allocation.
+ *      const char* file - File of the call site.
+ *      int line - Line of the call site.
+ *
+ * @return
+ *      The memory after the header.
+ */
+void* recordAllocation(AllocationHeader* header, size_t size, AllocTag tag, const char* file, int line)
+{
+    header->fields.size = size;
+    header->fields.site = NO_ALLOCATION_SITE;
+    liveBytes += size;
+    if (liveBytes > peakBytes) {
+        peakBytes = liveBytes;
+    }
+    if (!areSitesEnabled) {
+        return header + 1;
+    }
+
+    unsigned int site = findAllocationSite(tag, file, line);
+    header->fields.site = site;
+    allocationSites[site].allocations += 1;
+    allocationSites[site].bytes += size;
+    allocationSites[site].live_bytes += size;
+
+    lineAllocations += 1;
+    if (allocationBudget != 0 && isLineStarted && lineAllocations > allocationBudget) {
+        fprintf(stderr, "Allocation budget of %llu per line exceeded at %s:%d\n",
+                allocationBudget, allocationSites[site].file, allocationSites[site].line);
+        exit(EXIT_FAILURE);
+    }
+    return header + 1;
+}
+
+/**
+ * Compare call sites by their allocated bytes (for qsort, in descending order).
+ *
+ * @param
+ *      const void* first - First site (AllocationSite* given by reference).
+ *      const void* second - Second site (AllocationSite* given by reference).
+ *
+ * @return
+ *      Negative if the first site allocated more bytes, positive if it allocated fewer, 0 otherwise.
+ */
+int compareAllocationSites(const void* first, const void* second)
+{
+    const AllocationSite* first_site = *(AllocationSite* const*)first;
+    const AllocationSite* second_site = *(AllocationSite* const*)second;
+    if (first_site->bytes != second_site->bytes) {
+        return (first_site->bytes > second_site->bytes) ? -1 : 1;
+    }
+    return (first_site->line < second_site->line) ? -1 : (first_site->line > second_site->line);
+}
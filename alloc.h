@@ -0,0 +1,165 @@
+/*
+ * Allocation Module
+ */
+
+#ifndef ALLOC_H_
+#define ALLOC_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include "stats.h"
+
+/*
+ * Allocation Accounting
+ *
+ * All the memory of the calculator is allocated through this module, which tags each allocation
+ * with a category and the call site (file and line) that made it.
+ * The live and peak bytes of the whole program are tracked, and once call sites are enabled
+ * (by enableAllocationSites, or an allocation budget), the allocations and bytes of each category
+ * and call site are counted. Sites are off by default, since finding the site is a hash lookup
+ * on every allocation; memory allocated before they're enabled isn't accounted to any site.
+ * Memory is always released by deallocate (and never by free).
+ */
+
+/*
+ * Types
+ */
+
+/* Categories of allocations */
+typedef enum AllocTag_
+{
+    ALLOC_TREES,            /* Tree nodes and their values */
+    ALLOC_STRINGS,          /* Copied strings */
+    ALLOC_PARSING,          /* Parsers and decoders of input */
+    ALLOC_VARIABLES,        /* The variables table */
+    ALLOC_CHECKPOINTS,      /* Persistent maps of checkpoints */
+    ALLOC_PLANS,            /* Compiled lines and the plan cache */
+    ALLOC_FORMULAS,         /* The formulas dependency graph */
+    ALLOC_EVALUATION,       /* Scratch memory of evaluations */
+    ALLOC_IO,               /* Input and output buffers */
+    ALLOC_TAGS_COUNT
+} AllocTag;
+
+/*
+ * Macros
+ */
+
+/* Allocate memory (like malloc), accounted to the calling line */
+#define ALLOCATE(tag, size) allocate(tag, size, __FILE__, __LINE__)
+
+/* Allocate zeroed memory (like calloc), accounted to the calling line */
+#define ALLOCATE_ZEROED(tag, count, size) allocateZeroed(tag, count, size, __FILE__, __LINE__)
+
+/* Resize memory (like realloc), accounted to the calling line */
+#define REALLOCATE(tag, pointer, size) reallocate(tag, pointer, size, __FILE__, __LINE__)
+
+/*
+ * Functions
+ */
+
+/**
+ * Allocate memory. Use the ALLOCATE macro, which passes the call site.
+ *
+ * @param
+ *      AllocTag tag - Category of the allocation.
+ *      size_t size - Amount of bytes to allocate.
+ *      const char* file - File of the call site (a string literal).
+ *      int line - Line of the call site.
+ *
+ * @return
+ *      The allocated memory (which has to be released by deallocate), or NULL if the allocation failed.
+ */
+void* allocate(AllocTag tag, size_t size, const char* file, int line);
+
+/**
+ * Allocate zeroed memory. Use the ALLOCATE_ZEROED macro, which passes the call site.
+ *
+ * @param
+ *      AllocTag tag - Category of the allocation.
+ *      size_t count - Amount of elements to allocate.
+ *      size_t size - Size of each element.
+ *      const char* file - File of the call site (a string literal).
+ *      int line - Line of the call site.
+ *
+ * @return
+ *      The allocated memory (which has to be released by deallocate), or NULL if the allocation failed.
+ */
+void* allocateZeroed(AllocTag tag, size_t count, size_t size, const char* file, int line);
+
+/**
+ * Resize memory. Use the REALLOCATE macro, which passes the call site.
+ * The resized memory is accounted to the call site of the resize.
+ *
+ * @param
+ *      AllocTag tag - Category of the allocation.
+ *      void* pointer - Memory to resize (returned by this module), or NULL to allocate new memory.
+ *      size_t size - New amount of bytes.
+ *      const char* file - File of the call site (a string literal).
+ *      int line - Line of the call site.
+ *
+ * @return
+ *      The resized memory (which has to be released by deallocate),
+ *      or NULL if the allocation failed (and then the given memory is left as it was).
+ */
+void* reallocate(AllocTag tag, void* pointer, size_t size, const char* file, int line);
+
+/**
+ * Release memory returned by this module.
+ * If the given pointer is NULL, then nothing is done.
+ *
+ * @param
+ *      void* pointer - Memory to release.
+ */
+void deallocate(void* pointer);
+
+/**
+ * Start accounting allocations to their call sites and categories (see printAllocationStats).
+ */
+void enableAllocationSites();
+
+/**
+ * Set the maximal amount of allocations of each input line (see startLineAllocations).
+ * When a line exceeds it, the program exits with an error (so allocation regressions fail runs).
+ * A budget enables the call sites (see enableAllocationSites), so the site which exceeds it is reported.
+ *
+ * @param
+ *      unsigned long long budget - Amount of allocations, or 0 for no budget.
+ */
+void setAllocationBudget(unsigned long long budget);
+
+/**
+ * Start counting the allocations of a new input line (against the allocation budget).
+ */
+void startLineAllocations();
+
+/**
+ * Get the amount of bytes which are currently allocated.
+ *
+ * @return
+ *      Amount of bytes.
+ */
+size_t getLiveBytes();
+
+/**
+ * Get the maximal amount of bytes which were allocated at once.
+ *
+ * @return
+ *      Amount of bytes.
+ */
+size_t getPeakBytes();
+
+/**
+ * Print the live and peak bytes, and the allocations and bytes of each category and call site
+ * (call sites are ordered by their allocated bytes).
+ * The JSON format is a single object (which printStats nests in it's own object).
+ *
+ * @param
+ *      FILE* file - File to print into.
+ *      StatsFormat format - Format to print in.
+ *
+ * @preconditions
+ *      file != NULL
+ */
+void printAllocationStats(FILE* file, StatsFormat format);
+
+#endif /* ALLOC_H_ */
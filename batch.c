@@ -0,0 +1,217 @@
+/*
+ * Batch Framing Module
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "batch.h"
+#include "stats.h"
+#include "alloc.h"
+#include "common.h"
+
+/*
+ * Constants
+ */
+
+/* Initial size of the input buffer of a reader (it's grown to fit larger batches) */
+#define INITIAL_BATCH_BUFFER_SIZE (64 * 1024)
+
+/*
+ * Types
+ */
+
+struct BatchReader_t
+{
+    int input_fd;
+
+    char* buffer;                   /* Received input, from the start of the current batch */
+    size_t buffer_capacity;
+    size_t buffer_start;            /* Offset of the current batch */
+    size_t buffer_end;              /* End of the received input */
+    size_t batch_length;            /* Length of the current batch (header included) */
+
+    size_t* offsets;                /* Offsets of the expressions of the current batch (in the batch) */
+    size_t* lengths;                /* Lengths of the expressions of the current batch */
+    unsigned int count;
+    unsigned int capacity;
+};
+
+/*
+ * Internal Function Declarations
+ */
+
+bool receiveBatchInput(BatchReader reader, size_t size);
+size_t decodeBatchField(const char* field);
+
+/*
+ * Module Functions
+ */
+
+BatchReader createBatchReader(int input_fd)
+{
+    BatchReader reader = ALLOCATE_ZEROED(ALLOC_IO, 1, sizeof(*reader));
+    VERIFY(reader != NULL);
+    reader->input_fd = input_fd;
+    reader->buffer_capacity = INITIAL_BATCH_BUFFER_SIZE;
+    reader->buffer = ALLOCATE(ALLOC_IO, reader->buffer_capacity);
+    VERIFY(reader->buffer != NULL);
+    return reader;
+}
+
+void destroyBatchReader(BatchReader reader)
+{
+    if (reader == NULL) {
+        return;
+    }
+    deallocate(reader->buffer);
+    deallocate(reader->offsets);
+    deallocate(reader->lengths);
+    deallocate(reader);
+}
+
+bool readBatch(BatchReader reader)
+{
+    VERIFY(reader != NULL);
+
+    /* Drop the current batch */
+    reader->buffer_start += reader->batch_length;
+    reader->batch_length = 0;
+    reader->count = 0;
+
+    /* Read the header */
+    if (!receiveBatchInput(reader, BATCH_FIELD_SIZE)) {
+        return false;
+    }
+    size_t count = decodeBatchField(reader->buffer + reader->buffer_start);
+    size_t header_length = BATCH_FIELD_SIZE * (count + 1);
+    VERIFY(receiveBatchInput(reader, header_length));
+
+    if (count > reader->capacity) {
+        deallocate(reader->offsets);
+        deallocate(reader->lengths);
+        reader->offsets = ALLOCATE(ALLOC_IO, count * sizeof(*reader->offsets));
+        reader->lengths = ALLOCATE(ALLOC_IO, count * sizeof(*reader->lengths));
+        VERIFY(reader->offsets != NULL && reader->lengths != NULL);
+        reader->capacity = count;
+    }
+    size_t offset = header_length;
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t length = decodeBatchField(reader->buffer + reader->buffer_start + BATCH_FIELD_SIZE * (i + 1));
+        reader->offsets[i] = offset;
+        reader->lengths[i] = length;
+        offset += length;
+    }
+
+    /* Read the expressions */
+    VERIFY(receiveBatchInput(reader, offset));
+    reader->batch_length = offset;
+    reader->count = count;
+    return true;
+}
+
+unsigned int batchSize(BatchReader reader)
+{
+    VERIFY(reader != NULL);
+    return reader->count;
+}
+
+const char* batchExpression(BatchReader reader, unsigned int index, size_t* length)
+{
+    VERIFY(reader != NULL && length != NULL);
+    VERIFY(index < reader->count);
+    *length = reader->lengths[index];
+    return reader->buffer + reader->buffer_start + reader->offsets[index];
+}
+
+void writeBatchResults(int output_fd, const char* results, size_t length)
+{
+    VERIFY(results != NULL);
+    while (length > 0)
+    {
+        ssize_t written = write(output_fd, results, length);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        VERIFY(written > 0);
+        results += written;
+        length -= written;
+    }
+}
+
+/*
+ * Internal Functions
+ */
+
+/**
+ * Make sure that the input buffer holds a given amount of bytes from the start of the current batch,
+ * by reading as much input as fits into the buffer (so later batches are usually already received).
+ *
+ * @param
+ *      BatchReader reader - Reader to read by.
+ *      size_t size - Required amount of bytes.
+ *
+ * @return
+ *      true iff the bytes were received, false if the input ended before any of them.
+ */
+bool receiveBatchInput(BatchReader reader, size_t size)
+{
+    while (reader->buffer_end - reader->buffer_start < size)
+    {
+        /* Move the current batch to the start of the buffer, and grow it if the batch doesn't fit */
+        if (reader->buffer_capacity - reader->buffer_start < size) {
+            memmove(reader->buffer,
+                    reader->buffer + reader->buffer_start,
+                    reader->buffer_end - reader->buffer_start);
+            reader->buffer_end -= reader->buffer_start;
+            reader->buffer_start = 0;
+            if (reader->buffer_capacity < size) {
+                while (reader->buffer_capacity < size)
+                {
+                    reader->buffer_capacity *= 2;
+                }
+                reader->buffer = REALLOCATE(ALLOC_IO, reader->buffer, reader->buffer_capacity);
+                VERIFY(reader->buffer != NULL);
+            }
+        }
+
+        ssize_t received = read(reader->input_fd,
+                                reader->buffer + reader->buffer_end,
+                                reader->buffer_capacity - reader->buffer_end);
+        if (received < 0 && errno == EINTR) {
+            /* Interrupted by a statistics request (see allowStatsRequests) */
+            handleStatsRequest(stderr);
+            continue;
+        }
+        VERIFY(received >= 0);
+        if (received == 0) {
+            /* The input may only end between batches */
+            VERIFY(reader->buffer_end == reader->buffer_start);
+            return false;
+        }
+        reader->buffer_end += received;
+    }
+    return true;
+}
+
+/**
+ * Decode a field of a batch header.
+ *
+ * @param
+ *      const char* field - Field to decode (BATCH_FIELD_SIZE bytes).
+ *
+ * @return
+ *      The field's value.
+ */
+size_t decodeBatchField(const char* field)
+{
+    const unsigned char* bytes = (const unsigned char*)field;
+    return ((size_t)bytes[0] << 24) | ((size_t)bytes[1] << 16) | ((size_t)bytes[2] << 8) | (size_t)bytes[3];
+}
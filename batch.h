@@ -0,0 +1,124 @@
+/*
+ * Batch Framing Module
+ */
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Batch Framing
+ *
+ * An alternative to newline-terminated lines, for passing many small expressions at once.
+ * Each batch starts with a header: the amount of expressions in the batch, followed by
+ * the length of each expression (all 32 bit big-endian). The header is followed by
+ * the expressions themselves (Lisp text, without new-lines or terminators), back to back.
+ *
+ * Input is read in large blocks, so a whole batch (usually more than one) is received
+ * by a single read, and it's expressions are used in place, without copying.
+ */
+
+/*
+ * Constants
+ */
+
+/* Size of the fields of a batch header (in bytes) */
+#define BATCH_FIELD_SIZE 4
+
+/*
+ * Types
+ */
+
+/* Reader of a stream of batches */
+typedef struct BatchReader_t* BatchReader;
+
+/*
+ * Functions
+ */
+
+/**
+ * Create a reader of the batches sent to a file descriptor.
+ * The created reader has to be destroyed by destroyBatchReader.
+ *
+ * @param
+ *      int input_fd - File descriptor to read from.
+ *
+ * @return
+ *      The created reader.
+ */
+BatchReader createBatchReader(int input_fd);
+
+/**
+ * Destroy a reader (the file descriptor isn't closed).
+ * If the given reader is NULL, then nothing is done.
+ *
+ * @param
+ *      BatchReader reader - Reader to destroy.
+ */
+void destroyBatchReader(BatchReader reader);
+
+/**
+ * Read the next batch, which replaces the current one.
+ * Blocks until the whole batch was received.
+ *
+ * @param
+ *      BatchReader reader - Reader to read by.
+ *
+ * @preconditions
+ *      - reader != NULL
+ *      - The input ends between batches.
+ *
+ * @return
+ *      true iff a batch was read (false at the end of the input).
+ */
+bool readBatch(BatchReader reader);
+
+/**
+ * Get the amount of expressions in the current batch.
+ *
+ * @param
+ *      BatchReader reader - Reader of the batch.
+ *
+ * @preconditions
+ *      reader != NULL
+ *
+ * @return
+ *      Amount of expressions.
+ */
+unsigned int batchSize(BatchReader reader);
+
+/**
+ * Get an expression of the current batch.
+ * The expression is valid until the next batch is read.
+ *
+ * @param
+ *      BatchReader reader - Reader of the batch.
+ *      unsigned int index - Index of the expression in the batch.
+ *      size_t* length - Expression length (output parameter).
+ *
+ * @preconditions
+ *      - reader != NULL, length != NULL
+ *      - index < batchSize(reader)
+ *
+ * @return
+ *      The expression (not null-terminated).
+ */
+const char* batchExpression(BatchReader reader, unsigned int index, size_t* length);
+
+/**
+ * Write the results of a batch to a file descriptor by a single write
+ * (more are made only if the descriptor accepts part of the results).
+ *
+ * @param
+ *      int output_fd - File descriptor to write to.
+ *      const char* results - Results to write.
+ *      size_t length - Length of the results.
+ *
+ * @preconditions
+ *      results != NULL
+ */
+void writeBatchResults(int output_fd, const char* results, size_t length);
+
+#endif /* BATCH_H_ */
@@ -7,21 +7,52 @@
 #include <string.h>
 #include <math.h>
 #include "calculate.h"
+#include "reduce.h"
+#include "alloc.h"
+#include "trace.h"
+#include "container.h"
 #include "common.h"
 
 /*
  * Types
  */
 
+/* Value of an evaluated sub-expression.
+   Integer values are kept as exact 64 bit integers (as long as doubles represent them exactly),
+   so integer arithmetic doesn't go through floating point conversions.
+   A value is an integer iff it's number is an exact integer (see realValue). */
+typedef struct Value_
+{
+    bool is_integer;
+    union
+    {
+        long long int integer;  /* Valid iff is_integer */
+        double real;            /* Valid iff !is_integer */
+    } number;
+} Value;
+
+/* Integer which is wide enough for the intermediate results of rangeSum */
+#ifdef __SIZEOF_INT128__
+__extension__ typedef __int128 WideInteger;
+#else
+typedef long long int WideInteger;
+#endif
+
+/* Stack of the values of evaluated operands, which are waiting for their operation to be evaluated.
+   The stack starts in a pre-allocated buffer, and is moved to the heap if it outgrows it. */
+DEFINE_VECTOR(ValueStack, valueStack, Value, ALLOC_EVALUATION)
+
 /* This defines the interface we need to use for all functions that are used
-   for evaluating different parts of the calculator */
-typedef double (*EvaluatorFunc)(Tree*, HashTable);
+   for evaluating different parts of the calculator
+   (given the operation sub-tree, and the values of it's operands) */
+typedef Value (*EvaluatorFunc)(Tree*, Value*, unsigned int, HashTable);
 
 /* An internal structure that maps between a string representing a calculation in
    the calculator, and the function that implements it internally */
 typedef struct OperationAndEvaluator_
 {
     char* operation_string;
+    Operation operation;
     EvaluatorFunc evaluator;
 } OperationAndEvaluator;
 
@@ -29,19 +60,31 @@ typedef struct OperationAndEvaluator_
  * Internal Function Declarations
  */
 
-EvaluatorFunc getEvaluator(char* operation_string);
-double evaluateTerminalExpression(Tree* tree, HashTable variables);
-double evaluatePlusExpression(Tree* tree, HashTable variables);
-double evaluateMinusExpression(Tree* tree, HashTable variables);
-double evaluateMultiplyExpression(Tree* tree, HashTable variables);
-double evaluateDivideExpression(Tree* tree, HashTable variables);
-double evaluateSumRangeExpression(Tree* tree, HashTable variables);
-double evaluateAssignmentExpression(Tree* tree, HashTable variables);
-double evaluateMinExpression(Tree* tree, HashTable variables);
-double evaluateMaxExpression(Tree* tree, HashTable variables);
-double evaluateAverageExpression(Tree* tree, HashTable variables);
-double evaluateMedianExpression(Tree* tree, HashTable variables);
-long long int  rangeSum(long long int  a, long long int  b);
+Value evaluateValue(Tree* tree, HashTable variables);
+bool isAssignmentOperation(Tree* tree);
+bool isListOperation(Operation operation);
+Value evaluateTerminalExpression(Tree* tree, HashTable variables);
+Value evaluatePlusExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables);
+Value evaluateMinusExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables);
+Value evaluateMultiplyExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables);
+Value evaluateDivideExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables);
+Value evaluateSumRangeExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables);
+Value evaluateAssignmentExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables);
+Value evaluateMinExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables);
+Value evaluateMaxExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables);
+Value evaluateAverageExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables);
+Value evaluateMedianExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables);
+double* gatherOperands(Value* operands, unsigned int operands_count, double* buffer, unsigned int buffer_size,
+                       OUT bool* are_integers);
+void releaseOperands(double* operands, double* buffer);
+Value integerValue(long long int integer);
+Value realValue(double real);
+Value nonIntegerValue(double real);
+double toDouble(Value value);
+double calculateDivide(double a, double b);
+double calculateSumRange(double a_, double b_);
+double calculateMedian(double* operands, unsigned int operands_count);
+WideInteger rangeSum(long long int a, long long int b);
 bool isNumber(const char* string);
 bool isDigit(char c);
 int compareDouble(const void* a, const void* b);
@@ -54,19 +97,34 @@ int compareDouble(const void* a, const void* b);
    an integer (and not a floating point number) for the sum-range function */
 #define EQUALITY_THRESHOLD 0.000001
 
+/* Largest integer magnitude up to which all integers are exactly representable as doubles (2^53).
+   Integer results beyond it are converted to doubles, so they are rounded like a double calculation. */
+#define MAX_EXACT_INTEGER 9007199254740992LL
+
+/* Bound (exclusive) of the magnitude of the sum-range operands, which have to fit in 64 bits (2^63) */
+#define SUM_RANGE_LIMIT 9223372036854775808.0
+
+/* Amount of operands of a function expression that are gathered on the stack
+   (larger operand lists are gathered into a heap buffer) */
+#define OPERANDS_BUFFER_SIZE 64
+
+/* Amount of pending operand values that are kept on the call stack during evaluation
+   (deeper or wider expressions move them into a heap buffer) */
+#define VALUE_STACK_BUFFER_SIZE 64
+
 /* This struct maps between the string representation of the operations
    and the functions that implement their calculation */
 const OperationAndEvaluator OPERATIONS[] = {
-        {"+",       evaluatePlusExpression      },
-        {"-",       evaluateMinusExpression     },
-        {"*",       evaluateMultiplyExpression  },
-        {"/",       evaluateDivideExpression    },
-        {"$",       evaluateSumRangeExpression  },
-        {"=",       evaluateAssignmentExpression},
-        {"min",     evaluateMinExpression       },
-        {"max",     evaluateMaxExpression       },
-        {"average", evaluateAverageExpression   },
-        {"median",  evaluateMedianExpression    },
+        {"+",       OPERATION_PLUS,       evaluatePlusExpression      },
+        {"-",       OPERATION_MINUS,      evaluateMinusExpression     },
+        {"*",       OPERATION_MULTIPLY,   evaluateMultiplyExpression  },
+        {"/",       OPERATION_DIVIDE,     evaluateDivideExpression    },
+        {"$",       OPERATION_SUM_RANGE,  evaluateSumRangeExpression  },
+        {"=",       OPERATION_ASSIGNMENT, evaluateAssignmentExpression},
+        {"min",     OPERATION_MIN,        evaluateMinExpression       },
+        {"max",     OPERATION_MAX,        evaluateMaxExpression       },
+        {"average", OPERATION_AVERAGE,    evaluateAverageExpression   },
+        {"median",  OPERATION_MEDIAN,     evaluateMedianExpression    },
 };
 
 /*
@@ -78,16 +136,71 @@ double evaluateExpressionTree(Tree* tree, HashTable variables)
     VERIFY(tree != NULL);
     VERIFY(variables != NULL);
 
-    if (!hasChildren(tree)) {
-        return evaluateTerminalExpression(tree, variables);
+    return toDouble(evaluateValue(tree, variables));
+}
+
+Operation getOperation(const char* operation_string)
+{
+    VERIFY(operation_string != NULL);
+    for (int i = 0; i < ARRAY_LENGTH(OPERATIONS); ++i)
+    {
+        if (strcmp(operation_string, OPERATIONS[i].operation_string) == 0) {
+            return OPERATIONS[i].operation;
+        }
     }
+    return OPERATION_INVALID;
+}
 
-    char* operation_string = getValue(tree);
-    EvaluatorFunc evaluator = getEvaluator(operation_string);
-    VERIFY(evaluator != NULL);
+double calculateOperation(Operation operation, double* operands, unsigned int operands_count)
+{
+    VERIFY(operands != NULL);
 
-    /* Evaluate operation */
-    return evaluator(tree, variables);
+    switch (operation)
+    {
+        case OPERATION_PLUS:
+            VERIFY(operands_count == 1 || operands_count == 2);
+            return (operands_count == 1) ? operands[0] : operands[0] + operands[1];
+        case OPERATION_MINUS:
+            VERIFY(operands_count == 1 || operands_count == 2);
+            return (operands_count == 1) ? -operands[0] : operands[0] - operands[1];
+        case OPERATION_MULTIPLY:
+            VERIFY(operands_count == 2);
+            return operands[0] * operands[1];
+        case OPERATION_DIVIDE:
+            VERIFY(operands_count == 2);
+            return calculateDivide(operands[0], operands[1]);
+        case OPERATION_SUM_RANGE: {
+            VERIFY(operands_count == 2);
+            uint64_t start = startTraceSpan();
+            double result = calculateSumRange(operands[0], operands[1]);
+            stopTraceSpan("$", start);
+            return result;
+        }
+        case OPERATION_MIN:
+            VERIFY(operands_count > 0);
+            return reduceMin(operands, operands_count);
+        case OPERATION_MAX:
+            VERIFY(operands_count > 0);
+            return reduceMax(operands, operands_count);
+        case OPERATION_AVERAGE:
+            VERIFY(operands_count > 0);
+            return reduceSum(operands, operands_count) / (double)operands_count;
+        case OPERATION_MEDIAN: {
+            VERIFY(operands_count > 0);
+            for (unsigned int i = 0; i < operands_count; ++i)
+            {
+                if (isnan(operands[i])) {
+                    return NAN;
+                }
+            }
+            uint64_t start = startTraceSpan();
+            double result = calculateMedian(operands, operands_count);
+            stopTraceSpan("median", start);
+            return result;
+        }
+        default:
+            panic();
+    }
 }
 
 /*
@@ -95,7 +208,7 @@ double evaluateExpressionTree(Tree* tree, HashTable variables)
  */
 
 /**
- * Returns the relevant evaluating function for a given evaluation literal
+ * Returns the operation entry for a given evaluation literal
  *
  * @param
  * 		char* operation_string - The name of the operation to evaluate.
@@ -104,99 +217,144 @@ double evaluateExpressionTree(Tree* tree, HashTable variables)
  *      - operation_string != NULL
  *
  * @return
- *		The function that evaluates the given type of calculation,
+ *		The entry of the operation (with the function that evaluates it),
  *    or NULL if the given operation is not supported.
  */
-EvaluatorFunc getEvaluator(char* operation_string)
+const OperationAndEvaluator* getOperationAndEvaluator(char* operation_string)
 {
     VERIFY(operation_string != NULL);
-    OperationAndEvaluator operation_pair;
-    bool found = false;
     for (int i = 0; i < ARRAY_LENGTH(OPERATIONS); ++i)
     {
-        operation_pair = OPERATIONS[i];
-        if (strcmp(operation_string, operation_pair.operation_string) == 0) {
-            found = true;
-            break;
+        if (strcmp(operation_string, OPERATIONS[i].operation_string) == 0) {
+            return &OPERATIONS[i];
         }
     }
-    if (found) {
-        return operation_pair.evaluator;
-    } else {
-        return NULL;
-    }
+    return NULL;
 }
 
 /**
- * Evaluate a terminal (number or variable) expression sub-tree (tree leaf).
+ * Evaluate an expression sub-tree, keeping integer results exact.
+ * The tree is walked iteratively (by the parent and brother links of the nodes),
+ * so the depth of the tree isn't limited by the call stack.
+ * The values of the operands that were evaluated are kept on an explicit stack,
+ * until the operation they belong to is evaluated.
+ *
+ * The operands are evaluated in order. Operands of list operations (min, max, etc.)
+ * are not evaluated after the first invalid one, so assignments in them are not performed.
+ * The first operand (variable name) of an assignment is not evaluated.
  *
  * @param
  * 		Tree* tree - Expression sub-tree to evaluate.
- * 		HashTable variables - variables to use for evaluation.
+ * 		HashTable variables - variables to use for evaluation,
+ * 		                      and to update after assignment.
  *
  * @preconditions
  *      - tree != NULL
- *      - tree is a leaf node.
- *      - The value of tree is a valid number string
  *      - variables != NULL
  *
  * @return
  *		Evaluation result.
  */
-double evaluateTerminalExpression(Tree* tree, HashTable variables)
+Value evaluateValue(Tree* tree, HashTable variables)
 {
     VERIFY(tree != NULL);
-    VERIFY(!hasChildren(tree));
     VERIFY(variables != NULL);
-    char* terminal = getValue(tree);
-    if (isName(terminal)) {
-        if (hashContains(variables, terminal)) {
-            return hashGetValue(variables, terminal);
-        } else {
-            return NAN;
+
+    Value buffer[VALUE_STACK_BUFFER_SIZE];
+    ValueStack stack;
+    valueStackInit(&stack, buffer, ARRAY_LENGTH(buffer));
+
+    Tree* node = tree;
+    while (true)
+    {
+        /* Descend to the first operand that has to be evaluated */
+        while (hasChildren(node))
+        {
+            node = isAssignmentOperation(node) ? lastChild(node) : firstChild(node);
         }
-    } else if (isNumber(terminal)) {
-        return (double)atoi(terminal);
-    } else {
-        panic();
+        valueStackPush(&stack, evaluateTerminalExpression(node, variables));
+
+        /* Evaluate the operations whose operands are done */
+        while (node != tree)
+        {
+            Tree* parent = getParent(node);
+            const OperationAndEvaluator* entry = getOperationAndEvaluator(getValue(parent));
+            VERIFY(entry != NULL);
+
+            Value* top = &stack.items[stack.count - 1];
+            bool is_aborted = isListOperation(entry->operation) && !top->is_integer && isnan(top->number.real);
+            if (!is_aborted && nextBrother(node) != NULL) {
+                break;
+            }
+
+            Value result;
+            unsigned int operands_count;
+            if (is_aborted) {
+                /* Pop the operands evaluated so far */
+                operands_count = 1;
+                for (Tree* brother = previousBrother(node); brother != NULL; brother = previousBrother(brother))
+                {
+                    operands_count += 1;
+                }
+                result = nonIntegerValue(NAN);
+            } else {
+                operands_count = (entry->operation == OPERATION_ASSIGNMENT) ? 1 : childrenCount(parent);
+                result = entry->evaluator(parent,
+                                          &stack.items[stack.count - operands_count],
+                                          operands_count,
+                                          variables);
+            }
+            stack.count -= operands_count;
+            valueStackPush(&stack, result);
+            node = parent;
+        }
+        if (node == tree) {
+            break;
+        }
+
+        node = nextBrother(node);
     }
+
+    VERIFY(stack.count == 1);
+    Value result = stack.items[0];
+    valueStackDestroy(&stack);
+    return result;
 }
 
 /**
- * Evaluate a plus expression sub-tree.
+ * Check if a tree node is an assignment operation.
  *
  * @param
- * 		Tree* tree - Expression sub-tree to evaluate.
- * 		HashTable variables - variables to use for evaluation.
+ * 		Tree* tree - Tree node to examine.
  *
- * @preconditions
- *      - tree != NULL
- *      - tree has 1 or 2 children.
- *      - variables != NULL
+ * @return
+ *		true iff the node is an assignment with operands.
+ */
+bool isAssignmentOperation(Tree* tree)
+{
+    return (hasChildren(tree) && strcmp(getValue(tree), "=") == 0);
+}
+
+/**
+ * Check if an operation is a list operation, i.e. an operation on any amount of operands,
+ * which is invalid as soon as one of them is invalid.
+ *
+ * @param
+ * 		Operation operation - Operation to check.
  *
  * @return
- *		Evaluation result.
+ *		true iff the operation is a list operation.
  */
-double evaluatePlusExpression(Tree* tree, HashTable variables)
+bool isListOperation(Operation operation)
 {
-    VERIFY(tree != NULL);
-    VERIFY(variables != NULL);
-    switch (childrenCount(tree)) {
-        case 1:
-            return evaluateExpressionTree(firstChild(tree), variables);
-        case 2:
-        {
-            double a = evaluateExpressionTree(firstChild(tree), variables);
-            double b = evaluateExpressionTree(lastChild(tree), variables);
-            return a + b;
-        }
-        default:
-            panic();
-    }
+    return (   operation == OPERATION_MIN
+            || operation == OPERATION_MAX
+            || operation == OPERATION_AVERAGE
+            || operation == OPERATION_MEDIAN);
 }
 
 /**
- * Evaluate a minus expression sub-tree.
+ * Evaluate a terminal (number or variable) expression sub-tree (tree leaf).
  *
  * @param
  * 		Tree* tree - Expression sub-tree to evaluate.
@@ -204,336 +362,436 @@ double evaluatePlusExpression(Tree* tree, HashTable variables)
  *
  * @preconditions
  *      - tree != NULL
- *      - tree has 1 or 2 children.
+ *      - tree is a leaf node.
+ *      - tree has a number (a parsed literal), or it's value is a valid variable name.
  *      - variables != NULL
  *
  * @return
  *		Evaluation result.
  */
-double evaluateMinusExpression(Tree* tree, HashTable variables)
+Value evaluateTerminalExpression(Tree* tree, HashTable variables)
 {
     VERIFY(tree != NULL);
+    VERIFY(!hasChildren(tree));
     VERIFY(variables != NULL);
-    switch (childrenCount(tree))
+    if (hasNumber(tree)) {
+        return isNumberInRange(tree) ? integerValue(getIntegerNumber(tree)) : nonIntegerValue(NAN);
+    }
+    NameId name_id = getNameId(tree);
+    if (name_id != NO_NAME_ID) {
+        double value;
+        return hashGetValueById(variables, name_id, &value) ? realValue(value) : nonIntegerValue(NAN);
+    } else {
+        panic();
+    }
+}
+
+/*
+ * Operation Evaluators
+ * Each evaluator gets the operation node, and the values of it's evaluated operands.
+ *
+ * @param
+ * 		Tree* tree - Operation sub-tree.
+ * 		Value* operands - Values of the operands. Note: the array may be modified.
+ * 		unsigned int operands_count - Amount of operands.
+ * 		HashTable variables - variables to update after assignment.
+ *
+ * @return
+ *		Evaluation result.
+ */
+
+/* Unary or binary plus */
+Value evaluatePlusExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables)
+{
+    switch (operands_count) {
+        case 1:
+            return operands[0];
+        case 2:
+        {
+            Value a = operands[0];
+            Value b = operands[1];
+            long long int result;
+            if (a.is_integer && b.is_integer && !__builtin_add_overflow(a.number.integer, b.number.integer, &result)) {
+                return integerValue(result);
+            }
+            return realValue(toDouble(a) + toDouble(b));
+        }
+        default:
+            panic();
+    }
+}
+
+/* Unary or binary minus */
+Value evaluateMinusExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables)
+{
+    switch (operands_count)
     {
         case 1:
-            return -evaluateExpressionTree(firstChild(tree), variables);
+        {
+            /* Negating an integer 0 gives -0, which isn't an integer */
+            Value a = operands[0];
+            if (a.is_integer && a.number.integer != 0) {
+                return integerValue(-a.number.integer);
+            }
+            return realValue(-toDouble(a));
+        }
         case 2:
         {
-            double a = evaluateExpressionTree(firstChild(tree), variables);
-            double b = evaluateExpressionTree(lastChild(tree), variables);
-            return a - b;
+            Value a = operands[0];
+            Value b = operands[1];
+            long long int result;
+            if (a.is_integer && b.is_integer && !__builtin_sub_overflow(a.number.integer, b.number.integer, &result)) {
+                return integerValue(result);
+            }
+            return realValue(toDouble(a) - toDouble(b));
         }
         default:
             panic();
     }
 }
 
+/* Multiplication */
+Value evaluateMultiplyExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables)
+{
+    VERIFY(operands_count == 2);
+    Value a = operands[0];
+    Value b = operands[1];
+    long long int result;
+    /* A zero product of operands with different signs is -0, which isn't an integer */
+    if (   a.is_integer && b.is_integer
+        && !__builtin_mul_overflow(a.number.integer, b.number.integer, &result)
+        && (result != 0 || (a.number.integer < 0) == (b.number.integer < 0))) {
+        return integerValue(result);
+    }
+    return realValue(toDouble(a) * toDouble(b));
+}
+
+/* Division. If the value of the divisor is 0, then NAN is returned. */
+Value evaluateDivideExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables)
+{
+    VERIFY(operands_count == 2);
+    return realValue(calculateDivide(toDouble(operands[0]), toDouble(operands[1])));
+}
+
+/* Sum range. If the value of the first operand is greater the second operand, then NAN is returned. */
+Value evaluateSumRangeExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables)
+{
+    VERIFY(operands_count == 2);
+    Value a = operands[0];
+    Value b = operands[1];
+    uint64_t start = startTraceSpan();
+    Value result;
+    if (!a.is_integer || !b.is_integer) {
+        result = realValue(calculateSumRange(toDouble(a), toDouble(b)));
+    } else if (a.number.integer > b.number.integer) {
+        result = nonIntegerValue(NAN);
+    } else {
+        WideInteger sum = rangeSum(a.number.integer, b.number.integer);
+        if (sum >= -MAX_EXACT_INTEGER && sum <= MAX_EXACT_INTEGER) {
+            result = integerValue((long long int)sum);
+        } else {
+            result = realValue((double)sum);
+        }
+    }
+    stopTraceSpan("$", start);
+    return result;
+}
+
+/* Assignment of the value of the second operand (the only evaluated operand) to the variable.
+   If the value to assign is invalid, then NAN is returned. */
+Value evaluateAssignmentExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables)
+{
+    VERIFY(childrenCount(tree) == 2);
+    VERIFY(operands_count == 1);
+    VERIFY(variables != NULL);
+
+    Value value = operands[0];
+    if (isnan((float)toDouble(value))) {
+        return nonIntegerValue(NAN);
+    }
+
+    Tree* var_expression = firstChild(tree);
+    VERIFY(!hasChildren(var_expression));
+    NameId name_id = getNameId(var_expression);
+    VERIFY(name_id != NO_NAME_ID);
+    hashInsertById(variables, name_id, toDouble(value));
+
+    return value;
+}
+
+/* Minimum of the operands */
+Value evaluateMinExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables)
+{
+    double buffer[OPERANDS_BUFFER_SIZE];
+    bool are_integers;
+    double* values = gatherOperands(operands, operands_count, buffer, ARRAY_LENGTH(buffer), &are_integers);
+
+    /* The operands are exact, so the result of the kernel is exact as well */
+    double result = reduceMin(values, operands_count);
+    releaseOperands(values, buffer);
+    return are_integers ? integerValue((long long int)result) : realValue(result);
+}
+
+/* Maximum of the operands */
+Value evaluateMaxExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables)
+{
+    double buffer[OPERANDS_BUFFER_SIZE];
+    bool are_integers;
+    double* values = gatherOperands(operands, operands_count, buffer, ARRAY_LENGTH(buffer), &are_integers);
+
+    double result = reduceMax(values, operands_count);
+    releaseOperands(values, buffer);
+    return are_integers ? integerValue((long long int)result) : realValue(result);
+}
+
+/* Average of the operands */
+Value evaluateAverageExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables)
+{
+    double buffer[OPERANDS_BUFFER_SIZE];
+    bool are_integers;
+    double* values = gatherOperands(operands, operands_count, buffer, ARRAY_LENGTH(buffer), &are_integers);
+
+    double sum = reduceSum(values, operands_count);
+    releaseOperands(values, buffer);
+    return realValue(sum / (double)operands_count);
+}
+
+/* Median of the operands */
+Value evaluateMedianExpression(Tree* tree, Value* operands, unsigned int operands_count, HashTable variables)
+{
+    double buffer[OPERANDS_BUFFER_SIZE];
+    bool are_integers;
+    uint64_t start = startTraceSpan();
+    double* values = gatherOperands(operands, operands_count, buffer, ARRAY_LENGTH(buffer), &are_integers);
+
+    double result = calculateMedian(values, operands_count);
+    releaseOperands(values, buffer);
+    stopTraceSpan("median", start);
+    return realValue(result);
+}
+
 /**
- * Evaluate a multiply expression sub-tree.
+ * Gather the values of the operands of a list operation into a contiguous array of doubles,
+ * so they can be reduced by the vector kernels.
  *
  * @param
- * 		Tree* tree - Expression sub-tree to evaluate.
- * 		HashTable variables - variables to use for evaluation.
+ * 		Value* operands - Operand values (none of them is invalid).
+ * 		unsigned int operands_count - Amount of operands.
+ * 		double* buffer - Pre-allocated buffer that is used if it's large enough.
+ * 		unsigned int buffer_size - Amount of values that fit in the buffer.
+ * 		bool* are_integers - Out parameter that receives whether all the operands are exact integers.
  *
  * @preconditions
- *      - tree != NULL
- *      - tree has 2 children.
- *      - variables != NULL
+ *      - operands != NULL, buffer != NULL, are_integers != NULL, operands_count > 0
  *
  * @return
- *		Evaluation result.
+ *		Array of the operands (has to be released by releaseOperands).
  */
-double evaluateMultiplyExpression(Tree* tree, HashTable variables)
+double* gatherOperands(Value* operands, unsigned int operands_count, double* buffer, unsigned int buffer_size,
+                       OUT bool* are_integers)
 {
-    VERIFY(tree != NULL);
-    VERIFY(childrenCount(tree) == 2);
-    VERIFY(variables != NULL);
-    double a = evaluateExpressionTree(firstChild(tree), variables);
-    double b = evaluateExpressionTree(lastChild(tree), variables);
-    return a * b;
+    VERIFY(operands != NULL);
+    VERIFY(buffer != NULL);
+    VERIFY(are_integers != NULL);
+    VERIFY(operands_count > 0);
+
+    double* values = buffer;
+    if (operands_count > buffer_size) {
+        values = ALLOCATE(ALLOC_EVALUATION, operands_count * sizeof(double));
+        VERIFY(values != NULL);
+    }
+
+    *are_integers = true;
+    for (unsigned int i = 0; i < operands_count; ++i)
+    {
+        *are_integers = *are_integers && operands[i].is_integer;
+        values[i] = toDouble(operands[i]);
+    }
+    return values;
 }
 
 /**
- * Evaluate a divide expression sub-tree.
- * If the value of the divisor is 0, then NAN is returned.
+ * Release an operands array returned by gatherOperands.
  *
  * @param
- * 		Tree* tree - Expression sub-tree to evaluate.
- * 		HashTable variables - variables to use for evaluation.
+ * 		double* operands - Operands array to release.
+ * 		double* buffer - The pre-allocated buffer that was given to gatherOperands.
+ */
+void releaseOperands(double* operands, double* buffer)
+{
+    if (operands != buffer) {
+        deallocate(operands);
+    }
+}
+
+/**
+ * Create an exact integer value.
+ * Integers which aren't exactly representable as doubles are converted to doubles
+ * (rounded like the result of the matching double calculation).
  *
- * @preconditions
- *      - tree != NULL
- *      - tree has 2 children.
- *      - variables != NULL
+ * @param
+ *      long long int integer - Integer to represent.
  *
  * @return
- *		Evaluation result.
+ *      The value.
  */
-double evaluateDivideExpression(Tree* tree, HashTable variables)
+Value integerValue(long long int integer)
 {
-    VERIFY(tree != NULL);
-    VERIFY(childrenCount(tree) == 2);
-    VERIFY(variables != NULL);
-    double a = evaluateExpressionTree(firstChild(tree), variables);
-    double b = evaluateExpressionTree(lastChild(tree), variables);
-    if (b == 0) {
-        return NAN;
+    Value value;
+    if (integer >= -MAX_EXACT_INTEGER && integer <= MAX_EXACT_INTEGER) {
+        value.is_integer = true;
+        value.number.integer = integer;
     } else {
-        return a / b;
+        value.is_integer = false;
+        value.number.real = (double)integer;
     }
+    return value;
 }
 
 /**
- * Evaluate a sum-range expression sub-tree.
- * If the value of the first operand is greater the second operand, then NAN is returned.
+ * Create a value from a double. The value is an exact integer if the double
+ * is an integer in the exact range (-0 is not considered an integer, since the sign has to be kept).
  *
  * @param
- * 		Tree* tree - Expression sub-tree to evaluate.
- * 		HashTable variables - variables to use for evaluation.
- *
- * @preconditions
- *      - tree != NULL
- *      - tree has 2 children.
- *      - variables != NULL
+ *      double real - Double to represent.
  *
  * @return
- *		Evaluation result.
+ *      The value.
  */
-double evaluateSumRangeExpression(Tree* tree, HashTable variables)
+Value realValue(double real)
 {
-    VERIFY(tree != NULL);
-    VERIFY(childrenCount(tree) == 2);
-    VERIFY(variables != NULL);
-
-    double a_ = evaluateExpressionTree(firstChild(tree), variables);
-    double b_ = evaluateExpressionTree(lastChild(tree), variables);
-
-    long long int a = llround(a_);
-    long long int b = llround(b_);
-
-    if (   fabs(a_ - (double)a) > EQUALITY_THRESHOLD
-        || fabs(b_ - (double)b) > EQUALITY_THRESHOLD
-        || a > b) {
-        return NAN;
+    Value value;
+    if (   fabs(real) <= (double)MAX_EXACT_INTEGER
+        && real == trunc(real)
+        && !(real == 0 && signbit(real))) {
+        value.is_integer = true;
+        value.number.integer = (long long int)real;
     } else {
-        return (double)rangeSum(a, b);
+        value.is_integer = false;
+        value.number.real = real;
     }
+    return value;
 }
 
 /**
- * Evaluate an assignment expression.
- * If the value of the expression to assign is invalid, then NAN is returned.
+ * Create a value from a double which isn't an exact integer (such as NAN), without examining it.
  *
  * @param
- * 		Tree* tree - Assignment sub-tree to evaluate.
- *    HashTable variables - variables to use for evaluation,
- * 		                      and to update after assignment.
+ *      double real - Double to represent.
  *
  * @preconditions
- *      - tree != NULL
- *      - tree has 2 children.
- *      - First child of the tree is a valid variable sub-expression,
- *        i.e. it has no children, and it's value is a valid variable name.
- *      - variables != NULL
+ *      realValue(real) isn't an integer.
  *
  * @return
- *		Evaluation result (the value assigned to the variable).
+ *      The value.
  */
-double evaluateAssignmentExpression(Tree* tree, HashTable variables)
+Value nonIntegerValue(double real)
 {
-    VERIFY(tree != NULL);
-    VERIFY(childrenCount(tree) == 2);
-    VERIFY(variables != NULL);
-
-    double value = evaluateExpressionTree(lastChild(tree), variables);
-    if (isnan((float)value)) {
-        return NAN;
-    }
-
-    Tree* var_expression = firstChild(tree);
-    VERIFY(!hasChildren(var_expression));
-    char* name = getValue(var_expression);
-    VERIFY(isName(name));
-    hashInsert(variables, name, value);
-
+    Value value;
+    value.is_integer = false;
+    value.number.real = real;
     return value;
 }
 
 /**
- * Evaluate a min expression sub-tree.
- * Returns the minimum value from the given children.
- * If any of the sub-expressions is invalid, then NAN is returned.
+ * Get the double of a value.
  *
  * @param
- * 		Tree* tree - Expression sub-tree to evaluate.
- *    HashTable variables - variables to use for evaluation.
- *
- * @preconditions
- *      - tree != NULL
- *      - tree has children.
- *      - variables != NULL
+ *      Value value - Value to convert.
  *
  * @return
- *		Evaluation result.
+ *      The double, which is exact if the value is an integer.
  */
-double evaluateMinExpression(Tree* tree, HashTable variables)
+double toDouble(Value value)
 {
-    VERIFY(NULL != tree);
-    VERIFY(hasChildren(tree));
-    VERIFY(variables != NULL);
-
-    double minValue = NAN;
-    for (Tree* child = firstChild(tree);
-         child != NULL;
-         child = nextBrother(child))
-    {
-        double current = evaluateExpressionTree(child, variables);
-        if (isnan((float)current)) {
-            return NAN;
-        }
-        minValue = fmin(minValue, current);
-    }
-    
-    return minValue;
+    return value.is_integer ? (double)value.number.integer : value.number.real;
 }
 
 /**
- * Evaluate a max expression sub-tree.
- * Returns the maximum value from the given children.
- * If any of the sub-expressions is invalid, then NAN is returned.
+ * Divide two values.
+ * If the value of the divisor is 0, then NAN is returned.
  *
  * @param
- * 		Tree* tree - Expression sub-tree to evaluate.
- * 		HashTable variables - variables to use for evaluation.
- *
- * @preconditions
- *      - tree != NULL
- *      - tree has children.
- *      - variables != NULL
+ *      double a - Dividend.
+ *      double b - Divisor.
  *
  * @return
- *		Evaluation result.
+ *      Calculation result.
  */
-double evaluateMaxExpression(Tree* tree, HashTable variables)
+double calculateDivide(double a, double b)
 {
-    VERIFY(NULL != tree);
-    VERIFY(hasChildren(tree));
-    VERIFY(variables != NULL);
-
-    double maxValue = NAN;
-    for (Tree* child = firstChild(tree);
-         child != NULL;
-         child = nextBrother(child))
-    {
-        double current = evaluateExpressionTree(child, variables);
-        if (isnan((float)current)) {
-            return NAN;
-        }
-        maxValue = fmax(maxValue, current);
+    if (b == 0) {
+        return NAN;
+    } else {
+        return a / b;
     }
-    
-    return maxValue;
 }
 
 /**
- * Evaluate an average expression sub-tree.
- * Returns the average value from the given children.
- * If any of the sub-expressions is invalid, then NAN is returned.
+ * Calculate the sum of all integers in range [a_, b_].
+ * If one of the values isn't an integer (or doesn't fit in 64 bits), or a_ is greater than b_,
+ * then NAN is returned.
  *
  * @param
- * 		Tree* tree - Expression sub-tree to evaluate.
- * 		HashTable variables - variables to use for evaluation.
- *
- * @preconditions
- *      - tree != NULL
- *      - tree has children.
- *      - variables != NULL
+ *      double a_ - Range start
+ *      double b_ - Range end
  *
  * @return
- *		Evaluation result.
+ *      Calculation result.
  */
-double evaluateAverageExpression(Tree* tree, HashTable variables)
+double calculateSumRange(double a_, double b_)
 {
-    VERIFY(NULL != tree);
-    VERIFY(hasChildren(tree));
-    VERIFY(variables != NULL);
-
-    double sum = 0;
-    for (Tree* child = firstChild(tree);
-         child != NULL;
-         child = nextBrother(child))
-    {
-        double current = evaluateExpressionTree(child, variables);
-        if (isnan((float)current)) {
-            return NAN;
-        }
-        sum += current;
+    /* Note: this also rejects NAN operands */
+    if (!(fabs(a_) < SUM_RANGE_LIMIT && fabs(b_) < SUM_RANGE_LIMIT)) {
+        return NAN;
     }
 
-    return sum / (double)childrenCount(tree);
+    long long int a = llround(a_);
+    long long int b = llround(b_);
+
+    if (   fabs(a_ - (double)a) > EQUALITY_THRESHOLD
+        || fabs(b_ - (double)b) > EQUALITY_THRESHOLD
+        || a > b) {
+        return NAN;
+    } else {
+        return (double)rangeSum(a, b);
+    }
 }
 
 /**
- * Evaluate a median expression sub-tree.
- * Returns the median value from the given children.
- * If any of the sub-expressions is invalid, then NAN is returned.
+ * Calculate the median of the given values.
  *
  * @param
- * 		Tree* tree - Expression sub-tree to evaluate.
- * 		HashTable variables - variables to use for evaluation.
+ *      double* operands - Values to calculate their median. The array is sorted in place.
+ *      unsigned int operands_count - Amount of values.
  *
  * @preconditions
- *      - tree != NULL
- *      - tree has children.
- *      - variables != NULL
+ *      operands != NULL, operands_count > 0, none of the values is NAN.
  *
  * @return
- *		Evaluation result.
+ *      Calculation result.
  */
-double evaluateMedianExpression(Tree* tree, HashTable variables)
+double calculateMedian(double* operands, unsigned int operands_count)
 {
-    VERIFY(NULL != tree);
-    VERIFY(hasChildren(tree));
-    VERIFY(variables != NULL);
-
-    unsigned int operands_count = childrenCount(tree);
-    double* operands = malloc(operands_count * sizeof(double));
     VERIFY(operands != NULL);
-
-    int i = 0;
-    for (Tree* child = firstChild(tree);
-         child != NULL;
-         child = nextBrother(child))
-    {
-        double current = evaluateExpressionTree(child, variables);
-        if (isnan((float)current)) {
-            free(operands);
-            return NAN;
-        }
-        operands[i] = current;
-        i += 1;
-    }
+    VERIFY(operands_count > 0);
 
     /* Note: using quickselect would be better,
      * but because it's promised that the number of operands is not greater than 10,
      * it doesn't really matter. */
     qsort(operands, operands_count, sizeof(*operands), compareDouble);
 
-    double result;
     if (operands_count % 2 == 1) {
-        result = operands[(operands_count - 1)/2];
+        return operands[(operands_count - 1)/2];
     } else {
-        result = (operands[operands_count/2] + operands[operands_count/2 - 1]) / 2;
+        return (operands[operands_count/2] + operands[operands_count/2 - 1]) / 2;
     }
-
-    free(operands);
-
-    return result;
 }
 
 /**
  * Calculate the sum of all integers in range [a, b].
+ * The calculation is done in 128 bits (where supported), so it doesn't overflow
+ * for any range of 64 bit integers.
  *
  * @param
  *      long a - Range start
@@ -545,10 +803,17 @@ double evaluateMedianExpression(Tree* tree, HashTable variables)
  * @return
  *      Calculation result.
  */
-long long int rangeSum(long long int  a, long long int  b)
+WideInteger rangeSum(long long int a, long long int b)
 {
     VERIFY(a <= b);
-    return (a + b) * (b - a + 1) / 2;
+    WideInteger count = (WideInteger)b - a + 1;
+    WideInteger ends = (WideInteger)a + b;
+    /* One of the factors is even, and it's halved before multiplying */
+    if (count % 2 == 0) {
+        return (count / 2) * ends;
+    } else {
+        return count * (ends / 2);
+    }
 }
 
 /**
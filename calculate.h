@@ -8,6 +8,30 @@
 #include "tree.h"
 #include "hashtable.h"
 
+/*
+ * Types
+ */
+
+/* Operations supported by the calculator */
+typedef enum Operation_e
+{
+    OPERATION_PLUS,
+    OPERATION_MINUS,
+    OPERATION_MULTIPLY,
+    OPERATION_DIVIDE,
+    OPERATION_SUM_RANGE,
+    OPERATION_ASSIGNMENT,
+    OPERATION_MIN,
+    OPERATION_MAX,
+    OPERATION_AVERAGE,
+    OPERATION_MEDIAN,
+    OPERATION_INVALID,
+} Operation;
+
+/*
+ * Functions
+ */
+
 /**
  * Evaluate (calculate) an arithmetic or assignment expression tree and variables.
  * If the result of the evaluation is invalid, then NAN is returned.
@@ -28,4 +52,38 @@
  */
 double evaluateExpressionTree(Tree* tree, HashTable variables);
 
+/**
+ * Get the operation represented by an operation string (e.g. "+" or "median").
+ *
+ * @param
+ * 		const char* operation_string - The operation string.
+ *
+ * @preconditions
+ *      operation_string != NULL
+ *
+ * @return
+ *		The matching operation, or OPERATION_INVALID if the operation is not supported.
+ */
+Operation getOperation(const char* operation_string);
+
+/**
+ * Calculate the result of an operation on already evaluated operands.
+ * The result is exactly the same as the result of evaluating the matching expression tree
+ * whose operands evaluate to the given values.
+ * If the result is invalid (e.g. division by zero, or one of the operands is NAN), then NAN is returned.
+ *
+ * @param
+ * 		Operation operation - Operation to calculate (can't be OPERATION_ASSIGNMENT).
+ * 		double* operands - Operand values. Note: the array may be reordered.
+ * 		unsigned int operands_count - Amount of operands.
+ *
+ * @preconditions
+ *      - operands != NULL
+ *      - operands_count is valid for the operation.
+ *
+ * @return
+ *		Calculation result.
+ */
+double calculateOperation(Operation operation, double* operands, unsigned int operands_count);
+
 #endif /* CALCULATE_H_ */
@@ -0,0 +1,165 @@
+/*
+ * Checkpoint Benchmark
+ *
+ * Measures a round of checkpoint, a few assignments and rollback of the variables table (see hashCheckpoint),
+ * for tables of growing sizes, and compares it with checkpoints which are full copies of the table.
+ * Usage: ./checkpointbench [rounds per measurement]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include "hashtable.h"
+#include "stats.h"
+#include "common.h"
+
+/*
+ * Constants
+ */
+
+/* Amount of variables in the smallest and largest tables */
+#define BENCH_MIN_VARIABLES 1000
+#define BENCH_MAX_VARIABLES 100000
+
+/* Amount of variables which are assigned between a checkpoint and it's rollback */
+#define BENCH_CHANGES 16
+
+/* Default amount of rounds of each measurement */
+#define BENCH_DEFAULT_ROUNDS 200
+
+/*
+ * Function Declarations
+ */
+
+double measureCheckpoints(NameId* ids, unsigned int variables_count, unsigned int rounds);
+double measureFullCopies(NameId* ids, unsigned int variables_count, unsigned int rounds);
+HashTable copyBenchTable(HashTable table);
+void copyBenchVariable(void* context, const char* name, double value);
+
+/*
+ * Function Implementations
+ */
+
+int main(int argc, char** argv)
+{
+    unsigned int rounds = (argc > 1) ? (unsigned int)atoi(argv[1]) : BENCH_DEFAULT_ROUNDS;
+    VERIFY(rounds > 0);
+
+    NameId* ids = malloc(BENCH_MAX_VARIABLES * sizeof(NameId));
+    VERIFY(ids != NULL);
+    for (unsigned int i = 0; i < BENCH_MAX_VARIABLES; ++i)
+    {
+        /* Names of letters only, like the calculator's variables */
+        char name[5] = {(char)('a' + i / 17576), (char)('a' + i / 676 % 26),
+                        (char)('a' + i / 26 % 26), (char)('a' + i % 26), '\0'};
+        ids[i] = internName(name, 4);
+    }
+
+    printf("%10s %20s %20s\n", "variables", "checkpoint (us)", "full copy (us)");
+    for (unsigned int count = BENCH_MIN_VARIABLES; count <= BENCH_MAX_VARIABLES; count *= 10)
+    {
+        double checkpoint_time = measureCheckpoints(ids, count, rounds);
+        double copy_time = measureFullCopies(ids, count, rounds);
+        printf("%10u %20.2f %20.2f\n", count, checkpoint_time, copy_time);
+    }
+
+    free(ids);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Run rounds of checkpoint, assignments and rollback on a table.
+ *
+ * @param
+ *      NameId* ids - Names of the variables.
+ *      unsigned int variables_count - Amount of variables in the table.
+ *      unsigned int rounds - Amount of rounds.
+ *
+ * @return
+ *      Average time of a round (in microseconds).
+ */
+double measureCheckpoints(NameId* ids, unsigned int variables_count, unsigned int rounds)
+{
+    HashTable table = createHashTable();
+    for (unsigned int i = 0; i < variables_count; ++i)
+    {
+        hashInsertById(table, ids[i], i);
+    }
+    /* The first checkpoint copies the table (later ones share it), it isn't part of the rounds */
+    hashCheckpoint(table);
+
+    uint64_t start = readClock();
+    for (unsigned int round = 0; round < rounds; ++round)
+    {
+        unsigned int checkpoint = hashCheckpoint(table);
+        for (unsigned int i = 0; i < BENCH_CHANGES; ++i)
+        {
+            hashInsertById(table, ids[(round * BENCH_CHANGES + i) % variables_count], -1);
+        }
+        VERIFY(hashRollback(table, checkpoint));
+    }
+    double round_time = (readClock() - start) / 1e3 / rounds;
+
+    destroyHashTable(table);
+    return round_time;
+}
+
+/**
+ * Run the same rounds with a full copy of the table as the checkpoint,
+ * which replaces the table on rollback.
+ *
+ * @param
+ *      NameId* ids - Names of the variables.
+ *      unsigned int variables_count - Amount of variables in the table.
+ *      unsigned int rounds - Amount of rounds.
+ *
+ * @return
+ *      Average time of a round (in microseconds).
+ */
+double measureFullCopies(NameId* ids, unsigned int variables_count, unsigned int rounds)
+{
+    HashTable table = createHashTable();
+    for (unsigned int i = 0; i < variables_count; ++i)
+    {
+        hashInsertById(table, ids[i], i);
+    }
+
+    uint64_t start = readClock();
+    for (unsigned int round = 0; round < rounds; ++round)
+    {
+        HashTable checkpoint = copyBenchTable(table);
+        for (unsigned int i = 0; i < BENCH_CHANGES; ++i)
+        {
+            hashInsertById(table, ids[(round * BENCH_CHANGES + i) % variables_count], -1);
+        }
+        destroyHashTable(table);
+        table = checkpoint;
+    }
+    double round_time = (readClock() - start) / 1e3 / rounds;
+
+    destroyHashTable(table);
+    return round_time;
+}
+
+/**
+ * Copy all the variables of a table into a new table.
+ *
+ * @param
+ *      HashTable table - Table to copy.
+ *
+ * @return
+ *      The copy.
+ */
+HashTable copyBenchTable(HashTable table)
+{
+    HashTable copy = createHashTable();
+    hashForEach(table, copyBenchVariable, copy);
+    return copy;
+}
+
+/**
+ * Visitor of copyBenchTable: inserts a variable into the copy.
+ */
+void copyBenchVariable(void* context, const char* name, double value)
+{
+    hashInsert(context, (char*)name, value);
+}
@@ -0,0 +1,343 @@
+/*
+ * Binary Tree Format Module
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include "codec.h"
+#include "parse.h"
+#include "stats.h"
+#include "alloc.h"
+#include "common.h"
+
+/*
+ * Constants
+ */
+
+/* Operations by their opcodes (must match the frontend) */
+const char* OPERATION_CODES[] = {"+", "-", "*", "/", "$", "=", ":=", "min", "max", "average", "median", "<rollback>"};
+
+/* Initial capacity of the growable arrays of a decoder */
+#define INITIAL_DECODER_CAPACITY 16
+
+/* Maximal amount of bytes of a 64 bit varint */
+#define MAX_VARINT_SIZE 10
+
+/*
+ * Types
+ */
+
+struct TreeDecoder_t
+{
+    NameId* variable_ids;           /* Interned names of the variables of the stream, by stream id */
+    unsigned int variables_count;
+    unsigned int variables_capacity;
+
+    unsigned long long* remaining;  /* Amount of children left to decode, of each open operation */
+    unsigned int remaining_capacity;
+
+    unsigned char* frame;           /* Buffer of the last read frame */
+    size_t frame_capacity;
+};
+
+/*
+ * Internal Function Declarations
+ */
+
+Tree* decodeNode(TreeDecoder decoder, const unsigned char** payload_pointer, const unsigned char* payload_end,
+                 OUT unsigned long long* children_count);
+unsigned long long decodeVarint(const unsigned char** payload_pointer, const unsigned char* payload_end);
+char* decodeString(const unsigned char** payload_pointer, const unsigned char* payload_end);
+void* growArray(void* array, unsigned int* capacity, size_t element_size);
+void readFrameBytes(FILE* input_file, unsigned char* buffer, size_t length);
+
+/*
+ * Module Functions
+ */
+
+TreeDecoder createTreeDecoder()
+{
+    TreeDecoder decoder = ALLOCATE_ZEROED(ALLOC_PARSING, 1, sizeof(*decoder));
+    VERIFY(decoder != NULL);
+    return decoder;
+}
+
+void destroyTreeDecoder(TreeDecoder decoder)
+{
+    if (decoder == NULL) {
+        return;
+    }
+    deallocate(decoder->variable_ids);
+    deallocate(decoder->remaining);
+    deallocate(decoder->frame);
+    deallocate(decoder);
+}
+
+Tree* decodeTree(TreeDecoder decoder, const unsigned char* payload, size_t length)
+{
+    VERIFY(decoder != NULL);
+    VERIFY(payload != NULL);
+
+    const unsigned char* payload_end = payload + length;
+    Tree* tree = NULL;
+    Tree* node = NULL;          /* The innermost operation whose children are being decoded */
+    unsigned int depth = 0;     /* Amount of open operations */
+    while (true)
+    {
+        if (depth + 1 > getMaxExpressionDepth()) {
+            destroyTree(tree);
+            return NULL;
+        }
+
+        unsigned long long children_count;
+        Tree* child = decodeNode(decoder, &payload, payload_end, &children_count);
+        if (node == NULL) {
+            tree = child;
+        } else {
+            addChild(node, child);
+        }
+
+        if (children_count > 0) {
+            if (depth == decoder->remaining_capacity) {
+                decoder->remaining = growArray(decoder->remaining,
+                                               &decoder->remaining_capacity,
+                                               sizeof(*decoder->remaining));
+            }
+            decoder->remaining[depth] = children_count;
+            depth += 1;
+            node = child;
+            continue;
+        }
+
+        /* The child is complete, and so are the operations whose last child it completes */
+        while (depth > 0)
+        {
+            decoder->remaining[depth - 1] -= 1;
+            if (decoder->remaining[depth - 1] > 0) {
+                break;
+            }
+            depth -= 1;
+            node = getParent(node);
+        }
+        if (depth == 0) {
+            break;
+        }
+    }
+
+    /* Check that the entire payload was processed */
+    VERIFY(payload == payload_end);
+    return tree;
+}
+
+Tree* readTreeFrame(TreeDecoder decoder, FILE* input_file)
+{
+    VERIFY(decoder != NULL);
+    VERIFY(input_file != NULL);
+
+    unsigned char header[FRAME_HEADER_SIZE];
+    readFrameBytes(input_file, header, sizeof(header));
+    size_t length = 0;
+    for (unsigned int i = 0; i < sizeof(header); ++i)
+    {
+        length = (length << 8) | header[i];
+    }
+
+    if (length > decoder->frame_capacity) {
+        deallocate(decoder->frame);
+        decoder->frame = ALLOCATE(ALLOC_PARSING, length);
+        VERIFY(decoder->frame != NULL);
+        decoder->frame_capacity = length;
+    }
+    readFrameBytes(input_file, decoder->frame, length);
+
+    return decodeTree(decoder, decoder->frame, length);
+}
+
+/*
+ * Internal Functions
+ */
+
+/**
+ * Decode a single node, and advance the payload pointer past it.
+ *
+ * @param
+ *      TreeDecoder decoder - Decoder of the stream.
+ *      const unsigned char** payload_pointer - Payload given by reference.
+ *      const unsigned char* payload_end - End of the payload.
+ *      unsigned long long* children_count - Out parameter that receives the amount of children of the node,
+ *                                           which follow it.
+ *
+ * @return
+ *      The decoded node (without children).
+ */
+Tree* decodeNode(TreeDecoder decoder, const unsigned char** payload_pointer, const unsigned char* payload_end,
+                 OUT unsigned long long* children_count)
+{
+    VERIFY(*payload_pointer < payload_end);
+    unsigned char kind = **payload_pointer;
+    *payload_pointer += 1;
+    *children_count = 0;
+
+    Tree* node = NULL;
+    switch (kind)
+    {
+        case NODE_OPERATION:
+        {
+            VERIFY(*payload_pointer < payload_end);
+            unsigned char opcode = **payload_pointer;
+            *payload_pointer += 1;
+            VERIFY(opcode < ARRAY_LENGTH(OPERATION_CODES));
+            *children_count = decodeVarint(payload_pointer, payload_end);
+            VERIFY(*children_count > 0);
+            node = createTree(copyString(OPERATION_CODES[opcode]));
+            break;
+        }
+        case NODE_NUMBER:
+        {
+            unsigned long long value = decodeVarint(payload_pointer, payload_end);
+            VERIFY(value <= (unsigned long long)LLONG_MAX);
+            char text[MAX_VARINT_SIZE * 2 + 1];
+            sprintf(text, "%llu", value);
+            node = createTree(copyString(text));
+            setNumber(node, (long long int)value);
+            break;
+        }
+        case NODE_NUMBER_TEXT:
+        {
+            char* text = decodeString(payload_pointer, payload_end);
+            VERIFY(isNumber(text));
+            node = createTree(text);
+            parseNumberLiteral(node);
+            break;
+        }
+        case NODE_VARIABLE:
+        {
+            unsigned long long id = decodeVarint(payload_pointer, payload_end);
+            VERIFY(id < decoder->variables_count);
+            node = createNameTree(decoder->variable_ids[id]);
+            break;
+        }
+        case NODE_NEW_VARIABLE:
+        {
+            char* name = decodeString(payload_pointer, payload_end);
+            VERIFY(isName(name));
+            if (decoder->variables_count == decoder->variables_capacity) {
+                decoder->variable_ids = growArray(decoder->variable_ids,
+                                                  &decoder->variables_capacity,
+                                                  sizeof(*decoder->variable_ids));
+            }
+            NameId name_id = internName(name, strlen(name));
+            deallocate(name);
+            decoder->variable_ids[decoder->variables_count] = name_id;
+            decoder->variables_count += 1;
+            node = createNameTree(name_id);
+            break;
+        }
+        case NODE_END_COMMAND:
+            node = createTree(copyString("<>"));
+            break;
+        case NODE_CHECKPOINT_COMMAND:
+            node = createTree(copyString("<checkpoint>"));
+            break;
+        default:
+            panic();
+    }
+    COUNT_STAT(COUNTER_NODES_PARSED);
+    return node;
+}
+
+/**
+ * Decode a varint, and advance the payload pointer past it.
+ *
+ * @param
+ *      const unsigned char** payload_pointer - Payload given by reference.
+ *      const unsigned char* payload_end - End of the payload.
+ *
+ * @return
+ *      Decoded value.
+ */
+unsigned long long decodeVarint(const unsigned char** payload_pointer, const unsigned char* payload_end)
+{
+    const unsigned char* p = *payload_pointer;
+    unsigned long long value = 0;
+    for (unsigned int i = 0; ; ++i)
+    {
+        VERIFY(i < MAX_VARINT_SIZE);
+        VERIFY(p < payload_end);
+        unsigned char byte = *p;
+        p += 1;
+        value |= (unsigned long long)(byte & 0x7f) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    *payload_pointer = p;
+    return value;
+}
+
+/**
+ * Decode a length-prefixed string, and advance the payload pointer past it.
+ *
+ * @param
+ *      const unsigned char** payload_pointer - Payload given by reference.
+ *      const unsigned char* payload_end - End of the payload.
+ *
+ * @return
+ *      Decoded (null-terminated) string, which has to be released by deallocate.
+ */
+char* decodeString(const unsigned char** payload_pointer, const unsigned char* payload_end)
+{
+    unsigned long long length = decodeVarint(payload_pointer, payload_end);
+    VERIFY(length <= (unsigned long long)(payload_end - *payload_pointer));
+    char* string = ALLOCATE(ALLOC_STRINGS, length + 1);
+    VERIFY(string != NULL);
+    memcpy(string, *payload_pointer, length);
+    string[length] = '\0';
+    *payload_pointer += length;
+    return string;
+}
+
+/**
+ * Double the capacity of a growable array.
+ *
+ * @param
+ *      void* array - Array to grow (may be NULL if it's capacity is 0).
+ *      unsigned int* capacity - Capacity of the array (in elements), given by reference.
+ *      size_t element_size - Size of an element.
+ *
+ * @return
+ *      The grown array.
+ */
+void* growArray(void* array, unsigned int* capacity, size_t element_size)
+{
+    unsigned int new_capacity = (*capacity == 0) ? INITIAL_DECODER_CAPACITY : 2 * *capacity;
+    void* new_array = REALLOCATE(ALLOC_PARSING, array, new_capacity * element_size);
+    VERIFY(new_array != NULL);
+    *capacity = new_capacity;
+    return new_array;
+}
+
+/**
+ * Read bytes of a frame, which must all be available (the input may only end after an end command).
+ * A read which is interrupted by a statistics request (see allowStatsRequests) is resumed after it's printed.
+ *
+ * @param
+ *      FILE* input_file - File to read from.
+ *      unsigned char* buffer - Buffer to read into.
+ *      size_t length - Amount of bytes to read.
+ */
+void readFrameBytes(FILE* input_file, unsigned char* buffer, size_t length)
+{
+    size_t read_length = fread(buffer, 1, length, input_file);
+    while (read_length < length && ferror(input_file) && errno == EINTR)
+    {
+        clearerr(input_file);
+        handleStatsRequest(stderr);
+        read_length += fread(buffer + read_length, 1, length - read_length, input_file);
+    }
+    VERIFY(read_length == length);
+}
@@ -0,0 +1,112 @@
+/*
+ * Binary Tree Format Module
+ */
+
+#ifndef CODEC_H_
+#define CODEC_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include "tree.h"
+
+/*
+ * Binary Tree Format
+ *
+ * An alternative to Lisp text for passing expression trees from the frontend.
+ * Each tree is sent as a frame: a 32 bit big-endian payload length, followed by the payload,
+ * which holds the nodes of the tree in pre-order. Each node starts with a kind byte:
+ *
+ *      NODE_OPERATION      opcode byte (index in OPERATION_CODES), children count (varint)
+ *      NODE_NUMBER         value (varint) of a literal, whose text is the decimal value
+ *      NODE_NUMBER_TEXT    text length (varint) and text of any other literal
+ *                          (leading zeros, or too large for 64 bits)
+ *      NODE_VARIABLE       id (varint) of a variable that already appeared in the stream
+ *      NODE_NEW_VARIABLE   name length (varint) and name of a variable, which gets the next id
+ *      NODE_END_COMMAND    the quit command
+ *      NODE_CHECKPOINT_COMMAND the checkpoint command (the rollback command is an operation)
+ *
+ * Varints are unsigned LEB128 (7 bits per byte, least significant group first).
+ * Variable ids are shared by all the frames of a stream.
+ */
+
+/*
+ * Constants
+ */
+
+#define NODE_OPERATION 0
+#define NODE_NUMBER 1
+#define NODE_NUMBER_TEXT 2
+#define NODE_VARIABLE 3
+#define NODE_NEW_VARIABLE 4
+#define NODE_END_COMMAND 5
+#define NODE_CHECKPOINT_COMMAND 6
+
+/* Size of the length prefix of a frame (in bytes) */
+#define FRAME_HEADER_SIZE 4
+
+/*
+ * Types
+ */
+
+/* Decoder of a stream of binary trees (keeps the variable ids of the stream) */
+typedef struct TreeDecoder_t* TreeDecoder;
+
+/*
+ * Functions
+ */
+
+/**
+ * Create a decoder for a new stream of binary trees.
+ * The created decoder has to be destroyed by destroyTreeDecoder.
+ *
+ * @return
+ *      The created decoder.
+ */
+TreeDecoder createTreeDecoder();
+
+/**
+ * Destroy a decoder.
+ * If the given decoder is NULL, then nothing is done.
+ *
+ * @param
+ *      TreeDecoder decoder - Decoder to destroy.
+ */
+void destroyTreeDecoder(TreeDecoder decoder);
+
+/**
+ * Decode the payload of a frame into a tree,
+ * which is identical to the tree parsed from the equivalent Lisp expression.
+ * Trees nested deeper than the maximal expression depth (see setMaxExpressionDepth) are rejected.
+ * The created tree has to be destroyed by destroyTree.
+ *
+ * @param
+ *      TreeDecoder decoder - Decoder of the stream.
+ *      const unsigned char* payload - Payload to decode.
+ *      size_t length - Payload length.
+ *
+ * @preconditions
+ *      - decoder != NULL, payload != NULL
+ *      - The payload holds a single valid tree.
+ *
+ * @return
+ *      Decoded tree, or NULL if the tree is nested too deep.
+ */
+Tree* decodeTree(TreeDecoder decoder, const unsigned char* payload, size_t length);
+
+/**
+ * Read the next frame from an input file, and decode it's tree (see decodeTree).
+ *
+ * @param
+ *      TreeDecoder decoder - Decoder of the stream.
+ *      FILE* input_file - File to read from.
+ *
+ * @preconditions
+ *      - decoder != NULL, input_file != NULL
+ *      - The file holds a complete frame.
+ *
+ * @return
+ *      Decoded tree, or NULL if the tree is nested too deep.
+ */
+Tree* readTreeFrame(TreeDecoder decoder, FILE* input_file);
+
+#endif /* CODEC_H_ */
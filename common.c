@@ -5,8 +5,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "alloc.h"
 #include "common.h"
 
+/*
+ * Constants
+ */
+
+/* FNV-1a prime */
+#define HASH_PRIME (16777619u)
+
 void panic()
 {
     printf("Unexpected error occurred!\n");
@@ -65,3 +73,42 @@ bool isLetter(char c)
 {
     return (c >= 'A') && (c <= 'z');
 }
+
+char* copyString(const char* string)
+{
+    VERIFY(string != NULL);
+    size_t length = strlen(string);
+    char* copy = ALLOCATE(ALLOC_STRINGS, length + 1);
+    VERIFY(copy != NULL);
+    memcpy(copy, string, length + 1);
+    return copy;
+}
+
+unsigned int hashCombine(unsigned int hash, unsigned int value)
+{
+    for (int i = 0; i < sizeof(value); ++i)
+    {
+        hash = (hash ^ ((value >> (8 * i)) & 0xff)) * HASH_PRIME;
+    }
+    return hash;
+}
+
+unsigned int hashString(unsigned int hash, const char* string)
+{
+    VERIFY(string != NULL);
+    for (const char* c = string; *c != '\0'; c++)
+    {
+        hash = (hash ^ (unsigned char)*c) * HASH_PRIME;
+    }
+    return hash;
+}
+
+unsigned int hashBytes(unsigned int hash, const char* bytes, size_t length)
+{
+    VERIFY(bytes != NULL || length == 0);
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash = (hash ^ (unsigned char)bytes[i]) * HASH_PRIME;
+    }
+    return hash;
+}
@@ -6,6 +6,7 @@
 #define COMMON_H_
 
 #include <stdbool.h>
+#include <stddef.h>
 
 /*
  * Macros
@@ -23,6 +24,9 @@
     } while (0)
 
 
+/* Initial value of hashes calculated by hashCombine and hashString (FNV-1a offset basis) */
+#define HASH_SEED (2166136261u)
+
 /* Function Arguments Markers */
 #define IN
 #define OUT
@@ -110,4 +114,62 @@ bool isName(char* string);
  */
 bool isLetter(char c);
 
+/**
+ * Create a copy of the given string.
+ * The created string has to be released by deallocate.
+ *
+ * @param
+ *      const char* string - String to copy.
+ *
+ * @preconditions
+ *      string != NULL
+ *
+ * @return
+ *      A new string (allocated by malloc) equal to the given string.
+ */
+char* copyString(const char* string);
+
+/**
+ * Mix a value into a hash (FNV-1a).
+ *
+ * @param
+ *      unsigned int hash - Hash so far (HASH_SEED for a new hash).
+ *      unsigned int value - Value to mix in.
+ *
+ * @return
+ *      The combined hash.
+ */
+unsigned int hashCombine(unsigned int hash, unsigned int value);
+
+/**
+ * Mix a string into a hash (FNV-1a).
+ *
+ * @param
+ *      unsigned int hash - Hash so far (HASH_SEED for a new hash).
+ *      const char* string - String to mix in (up to the null-terminator).
+ *
+ * @preconditions
+ *      string != NULL
+ *
+ * @return
+ *      The combined hash.
+ */
+unsigned int hashString(unsigned int hash, const char* string);
+
+/**
+ * Mix bytes into a hash (FNV-1a), like hashString for a string of a known length.
+ *
+ * @param
+ *      unsigned int hash - Hash so far (HASH_SEED for a new hash).
+ *      const char* bytes - Bytes to mix in.
+ *      size_t length - Amount of bytes.
+ *
+ * @preconditions
+ *      bytes != NULL, unless length == 0
+ *
+ * @return
+ *      The combined hash.
+ */
+unsigned int hashBytes(unsigned int hash, const char* bytes, size_t length);
+
 #endif /* COMMON_H_ */
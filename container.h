@@ -0,0 +1,358 @@
+/*
+ * Container Templates
+ */
+
+#ifndef CONTAINER_H_
+#define CONTAINER_H_
+
+#include <stdbool.h>
+#include <string.h>
+#include "alloc.h"
+#include "common.h"
+
+/*
+ * Generic Containers
+ *
+ * Header-only containers which are instantiated for each element type by a macro, so their
+ * elements are stored by value (rather than behind opaque pointers), and their functions
+ * (including the hashing and comparing of keys) are inlined at their call sites:
+ *
+ *   DEFINE_VECTOR - Growable array, which may start in a caller provided buffer.
+ *   DEFINE_MAP    - Hash map with open addressing (linear probing, and deletion by backward shifting),
+ *                   which doesn't allocate anything until the first insertion.
+ *   DEFINE_LIST   - Doubly linked list of elements which embed their links (LIST_LINK),
+ *                   so linking an element never allocates.
+ *
+ * Each macro defines a container type, and functions whose names start with the given prefix
+ * (e.g. DEFINE_VECTOR(ValueStack, valueStack, Value, ALLOC_EVALUATION) defines valueStackPush).
+ * Memory is allocated with the given tag, and accounted to the line of the macro's instantiation.
+ * A failed allocation panics.
+ */
+
+/*
+ * Constants
+ */
+
+/* Capacity of a vector's first heap buffer */
+#define VECTOR_INITIAL_CAPACITY 8
+
+/* Amount of slots of a map's first table (a power of 2) */
+#define MAP_INITIAL_CAPACITY 16
+
+/*
+ * Vector
+ *
+ * Type name - {Type* items; unsigned int count; unsigned int capacity; Type* buffer;}
+ *
+ * prefix##Init(Name* vector, Type* buffer, unsigned int buffer_capacity)
+ *      Initialize an empty vector, which uses the given buffer (which may be NULL, with a capacity of 0)
+ *      until it outgrows it.
+ * prefix##Reserve(Name* vector, unsigned int capacity)
+ *      Make room for at least the given amount of items.
+ * prefix##Push(Name* vector, Type item)
+ *      Append an item.
+ * prefix##Destroy(Name* vector)
+ *      Release the vector's memory (but not the caller provided buffer).
+ */
+#define DEFINE_VECTOR(Name, prefix, Type, tag)                                          \
+    typedef struct Name##_                                                              \
+    {                                                                                   \
+        Type* items;                                                                    \
+        unsigned int count;                                                             \
+        unsigned int capacity;                                                          \
+        Type* buffer;                                                                   \
+    } Name;                                                                             \
+                                                                                        \
+    static inline void prefix##Init(Name* vector, Type* buffer, unsigned int buffer_capacity) \
+    {                                                                                   \
+        vector->items = buffer;                                                         \
+        vector->count = 0;                                                              \
+        vector->capacity = buffer_capacity;                                             \
+        vector->buffer = buffer;                                                        \
+    }                                                                                   \
+                                                                                        \
+    static inline void prefix##Reserve(Name* vector, unsigned int capacity)             \
+    {                                                                                   \
+        if (capacity <= vector->capacity) {                                             \
+            return;                                                                     \
+        }                                                                               \
+        unsigned int new_capacity = (vector->capacity < VECTOR_INITIAL_CAPACITY) ?      \
+                                    VECTOR_INITIAL_CAPACITY : 2 * vector->capacity;     \
+        if (new_capacity < capacity) {                                                  \
+            new_capacity = capacity;                                                    \
+        }                                                                               \
+        Type* items;                                                                    \
+        if (vector->items == vector->buffer) {                                          \
+            items = ALLOCATE(tag, new_capacity * sizeof(*items));                       \
+            VERIFY(items != NULL);                                                      \
+            if (vector->count > 0) {                                                    \
+                memcpy(items, vector->items, vector->count * sizeof(*items));           \
+            }                                                                           \
+        } else {                                                                        \
+            items = REALLOCATE(tag, vector->items, new_capacity * sizeof(*items));      \
+            VERIFY(items != NULL);                                                      \
+        }                                                                               \
+        vector->items = items;                                                          \
+        vector->capacity = new_capacity;                                                \
+    }                                                                                   \
+                                                                                        \
+    static inline void prefix##Push(Name* vector, Type item)                            \
+    {                                                                                   \
+        if (vector->count == vector->capacity) {                                        \
+            prefix##Reserve(vector, vector->count + 1);                                 \
+        }                                                                               \
+        vector->items[vector->count] = item;                                            \
+        vector->count += 1;                                                             \
+    }                                                                                   \
+                                                                                        \
+    static inline void prefix##Destroy(Name* vector)                                    \
+    {                                                                                   \
+        if (vector->items != vector->buffer) {                                          \
+            deallocate(vector->items);                                                  \
+        }                                                                               \
+        vector->items = vector->buffer;                                                 \
+        vector->count = 0;                                                              \
+    }
+
+/*
+ * Map
+ *
+ * Type name - {Name##Slot* slots; unsigned int count; unsigned int mask;}
+ * Type Name##Slot - {Key key; bool is_used; Value value;}
+ * Keys are hashed by hash_function(Key) (returning an unsigned int),
+ * and compared by equals_function(Key, Key) (both may be macros).
+ *
+ * prefix##Init(Name* map)
+ *      Initialize an empty map (without allocating).
+ * prefix##Find(Name* map, Key key)
+ *      Get the value of a key by reference, or NULL if the key isn't in the map.
+ * prefix##Insert(Name* map, Key key, OUT bool* is_new)
+ *      Get the value of a key by reference, and add the key if it isn't in the map
+ *      (then the value is uninitialized, and is_new is set).
+ *      References to values are valid until the next insertion or removal.
+ * prefix##Remove(Name* map, Key key, OUT Value* value)
+ *      Remove a key (and get it's value, if value isn't NULL). Returns false if the key isn't in the map.
+ * prefix##Next(Name* map, unsigned int* index)
+ *      Iterate over the used slots: returns the first used slot from *index on (and advances *index
+ *      past it), or NULL at the end. Start with *index = 0.
+ * prefix##Destroy(Name* map)
+ *      Release the map's memory.
+ */
+#define DEFINE_MAP(Name, prefix, Key, Value, hash_function, equals_function, tag)      \
+    /* The flag follows the key, so it usually fits in padding */                       \
+    typedef struct Name##Slot_                                                          \
+    {                                                                                   \
+        Key key;                                                                        \
+        bool is_used;                                                                   \
+        Value value;                                                                    \
+    } Name##Slot;                                                                       \
+                                                                                        \
+    typedef struct Name##_                                                              \
+    {                                                                                   \
+        Name##Slot* slots;                                                              \
+        unsigned int count;                                                             \
+        unsigned int mask;                                                              \
+    } Name;                                                                             \
+                                                                                        \
+    static inline void prefix##Init(Name* map)                                          \
+    {                                                                                   \
+        map->slots = NULL;                                                              \
+        map->count = 0;                                                                 \
+        map->mask = 0;                                                                  \
+    }                                                                                   \
+                                                                                        \
+    static inline Name##Slot* prefix##FindSlot(Name* map, Key key)                      \
+    {                                                                                   \
+        if (map->slots == NULL) {                                                       \
+            return NULL;                                                                \
+        }                                                                               \
+        unsigned int index = (hash_function(key)) & map->mask;                          \
+        while (map->slots[index].is_used)                                               \
+        {                                                                               \
+            if (equals_function(map->slots[index].key, key)) {                          \
+                return &map->slots[index];                                              \
+            }                                                                           \
+            index = (index + 1) & map->mask;                                            \
+        }                                                                               \
+        return NULL;                                                                    \
+    }                                                                                   \
+                                                                                        \
+    static inline Value* prefix##Find(Name* map, Key key)                               \
+    {                                                                                   \
+        Name##Slot* slot = prefix##FindSlot(map, key);                                  \
+        return (slot != NULL) ? &slot->value : NULL;                                    \
+    }                                                                                   \
+                                                                                        \
+    static inline void prefix##Grow(Name* map)                                          \
+    {                                                                                   \
+        unsigned int capacity = (map->slots == NULL) ? MAP_INITIAL_CAPACITY : 2 * (map->mask + 1); \
+        Name##Slot* slots = ALLOCATE_ZEROED(tag, capacity, sizeof(*slots));             \
+        VERIFY(slots != NULL);                                                          \
+        for (unsigned int i = 0; map->slots != NULL && i <= map->mask; ++i)             \
+        {                                                                               \
+            if (!map->slots[i].is_used) {                                               \
+                continue;                                                               \
+            }                                                                           \
+            unsigned int index = (hash_function(map->slots[i].key)) & (capacity - 1);  \
+            while (slots[index].is_used)                                                \
+            {                                                                           \
+                index = (index + 1) & (capacity - 1);                                   \
+            }                                                                           \
+            slots[index] = map->slots[i];                                               \
+        }                                                                               \
+        deallocate(map->slots);                                                         \
+        map->slots = slots;                                                             \
+        map->mask = capacity - 1;                                                       \
+    }                                                                                   \
+                                                                                        \
+    static inline Value* prefix##Insert(Name* map, Key key, OUT bool* is_new)           \
+    {                                                                                   \
+        Name##Slot* slot = prefix##FindSlot(map, key);                                  \
+        if (slot != NULL) {                                                             \
+            *is_new = false;                                                            \
+            return &slot->value;                                                        \
+        }                                                                               \
+        /* The load factor is kept at most 3/4 */                                       \
+        if (map->slots == NULL || 4 * (map->count + 1) > 3 * (map->mask + 1)) {        \
+            prefix##Grow(map);                                                          \
+        }                                                                               \
+        unsigned int index = (hash_function(key)) & map->mask;                          \
+        while (map->slots[index].is_used)                                               \
+        {                                                                               \
+            index = (index + 1) & map->mask;                                            \
+        }                                                                               \
+        map->slots[index].key = key;                                                    \
+        map->slots[index].is_used = true;                                               \
+        map->count += 1;                                                                \
+        *is_new = true;                                                                 \
+        return &map->slots[index].value;                                                \
+    }                                                                                   \
+                                                                                        \
+    static inline bool prefix##Remove(Name* map, Key key, OUT Value* value)             \
+    {                                                                                   \
+        Name##Slot* slot = prefix##FindSlot(map, key);                                  \
+        if (slot == NULL) {                                                             \
+            return false;                                                               \
+        }                                                                               \
+        if (value != NULL) {                                                            \
+            *value = slot->value;                                                       \
+        }                                                                               \
+        /* Shift back the following slots of the probe sequence into the hole, so no tombstones are needed */ \
+        unsigned int hole = (unsigned int)(slot - map->slots);                          \
+        unsigned int index = hole;                                                      \
+        while (true)                                                                    \
+        {                                                                               \
+            index = (index + 1) & map->mask;                                            \
+            if (!map->slots[index].is_used) {                                           \
+                break;                                                                  \
+            }                                                                           \
+            unsigned int home = (hash_function(map->slots[index].key)) & map->mask;     \
+            /* The slot can move iff it's home isn't (cyclically) between the hole and it */ \
+            if (((index - home) & map->mask) >= ((index - hole) & map->mask)) {         \
+                map->slots[hole] = map->slots[index];                                   \
+                hole = index;                                                           \
+            }                                                                           \
+        }                                                                               \
+        map->slots[hole].is_used = false;                                               \
+        map->count -= 1;                                                                \
+        return true;                                                                    \
+    }                                                                                   \
+                                                                                        \
+    static inline Name##Slot* prefix##Next(Name* map, unsigned int* index)              \
+    {                                                                                   \
+        for (; map->slots != NULL && *index <= map->mask; *index += 1)                  \
+        {                                                                               \
+            if (map->slots[*index].is_used) {                                           \
+                *index += 1;                                                            \
+                return &map->slots[*index - 1];                                         \
+            }                                                                           \
+        }                                                                               \
+        return NULL;                                                                    \
+    }                                                                                   \
+                                                                                        \
+    static inline void prefix##Destroy(Name* map)                                       \
+    {                                                                                   \
+        deallocate(map->slots);                                                         \
+        prefix##Init(map);                                                              \
+    }
+
+/*
+ * Intrusive List
+ *
+ * Elements embed their links as a member declared by LIST_LINK(Type), whose name is given to DEFINE_LIST.
+ * Type name - {Type* first; Type* last; unsigned int count;}
+ * Iterate by: for (Type* element = list.first; element != NULL; element = element->link.next)
+ *
+ * prefix##Init(Name* list)
+ *      Initialize an empty list.
+ * prefix##InsertFirst(Name* list, Type* element), prefix##InsertLast(Name* list, Type* element)
+ *      Link an element (which isn't in any list of the same link) at the start or the end of the list.
+ * prefix##Remove(Name* list, Type* element)
+ *      Unlink an element of the list (the element itself isn't released).
+ */
+#define LIST_LINK(Type)                                                                 \
+    struct                                                                              \
+    {                                                                                   \
+        Type* next;                                                                     \
+        Type* previous;                                                                 \
+    }
+
+#define DEFINE_LIST(Name, prefix, Type, link)                                           \
+    typedef struct Name##_                                                              \
+    {                                                                                   \
+        Type* first;                                                                    \
+        Type* last;                                                                     \
+        unsigned int count;                                                             \
+    } Name;                                                                             \
+                                                                                        \
+    static inline void prefix##Init(Name* list)                                         \
+    {                                                                                   \
+        list->first = NULL;                                                             \
+        list->last = NULL;                                                              \
+        list->count = 0;                                                                \
+    }                                                                                   \
+                                                                                        \
+    static inline void prefix##InsertFirst(Name* list, Type* element)                   \
+    {                                                                                   \
+        element->link.previous = NULL;                                                  \
+        element->link.next = list->first;                                               \
+        if (list->first != NULL) {                                                      \
+            list->first->link.previous = element;                                       \
+        } else {                                                                        \
+            list->last = element;                                                       \
+        }                                                                               \
+        list->first = element;                                                          \
+        list->count += 1;                                                               \
+    }                                                                                   \
+                                                                                        \
+    static inline void prefix##InsertLast(Name* list, Type* element)                    \
+    {                                                                                   \
+        element->link.next = NULL;                                                      \
+        element->link.previous = list->last;                                            \
+        if (list->last != NULL) {                                                       \
+            list->last->link.next = element;                                            \
+        } else {                                                                        \
+            list->first = element;                                                      \
+        }                                                                               \
+        list->last = element;                                                           \
+        list->count += 1;                                                               \
+    }                                                                                   \
+                                                                                        \
+    static inline void prefix##Remove(Name* list, Type* element)                        \
+    {                                                                                   \
+        if (element->link.previous != NULL) {                                           \
+            element->link.previous->link.next = element->link.next;                     \
+        } else {                                                                        \
+            list->first = element->link.next;                                           \
+        }                                                                               \
+        if (element->link.next != NULL) {                                               \
+            element->link.next->link.previous = element->link.previous;                 \
+        } else {                                                                        \
+            list->last = element->link.previous;                                        \
+        }                                                                               \
+        element->link.next = NULL;                                                      \
+        element->link.previous = NULL;                                                  \
+        list->count -= 1;                                                               \
+    }
+
+#endif /* CONTAINER_H_ */
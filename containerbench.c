@@ -0,0 +1,171 @@
+/*
+ * Container Benchmark
+ *
+ * Measures lookups of variables by name in a table of SPList buckets (like the original variables table),
+ * and in a map instantiated from container.h with string keys.
+ * Usage: ./containerbench [lookups]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "SPList.h"
+#include "SPListElement.h"
+#include "container.h"
+#include "stats.h"
+#include "alloc.h"
+#include "common.h"
+
+/*
+ * Constants
+ */
+
+/* Amount of variables in the tables */
+#define BENCH_VARIABLES 2000
+
+/* Default amount of lookups of each measurement */
+#define BENCH_DEFAULT_LOOKUPS 1000000
+
+/* Buckets and hash of the SPList table (as in the original variables table) */
+#define LIST_BUCKETS_COUNT 100
+#define LIST_FIRST_PRIME 571
+#define LIST_COEFFICIENT_PRIME 31
+
+/*
+ * Types
+ */
+
+#define HASH_BENCH_NAME(name) hashString(HASH_SEED, (name))
+#define ARE_BENCH_NAMES_EQUAL(first, second) (strcmp((first), (second)) == 0)
+DEFINE_MAP(BenchMap, benchMap, const char*, double, HASH_BENCH_NAME, ARE_BENCH_NAMES_EQUAL, ALLOC_VARIABLES)
+
+/*
+ * Function Declarations
+ */
+
+double measureListTable(char** names, unsigned int lookups);
+double measureMap(char** names, unsigned int lookups);
+unsigned int hashListName(const char* name);
+
+/*
+ * Function Implementations
+ */
+
+int main(int argc, char** argv)
+{
+    unsigned int lookups = (argc > 1) ? (unsigned int)atoi(argv[1]) : BENCH_DEFAULT_LOOKUPS;
+    VERIFY(lookups > 0);
+
+    char* names[BENCH_VARIABLES];
+    for (unsigned int i = 0; i < BENCH_VARIABLES; ++i)
+    {
+        /* Names of letters only, like the calculator's variables */
+        char name[4] = {(char)('a' + i / 676), (char)('a' + i / 26 % 26), (char)('a' + i % 26), '\0'};
+        names[i] = copyString(name);
+    }
+
+    printf("%20s %20s\n", "SPList table (ns)", "map (ns)");
+    printf("%20.1f %20.1f\n", measureListTable(names, lookups), measureMap(names, lookups));
+
+    for (unsigned int i = 0; i < BENCH_VARIABLES; ++i)
+    {
+        deallocate(names[i]);
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Look the variables up in turn in a table of SPList buckets.
+ *
+ * @param
+ *      char** names - Names of the variables.
+ *      unsigned int lookups - Amount of lookups.
+ *
+ * @return
+ *      Average time of a lookup (in nanoseconds).
+ */
+double measureListTable(char** names, unsigned int lookups)
+{
+    SPList buckets[LIST_BUCKETS_COUNT];
+    for (unsigned int i = 0; i < LIST_BUCKETS_COUNT; ++i)
+    {
+        buckets[i] = listCreate();
+        VERIFY(buckets[i] != NULL);
+    }
+    for (unsigned int i = 0; i < BENCH_VARIABLES; ++i)
+    {
+        SPListElement element = createElement(names[i], i);
+        VERIFY(element != NULL);
+        VERIFY(listInsertLastOwned(buckets[hashListName(names[i])], element) == SP_LIST_SUCCESS);
+    }
+
+    double sum = 0;
+    uint64_t start = readClock();
+    for (unsigned int i = 0; i < lookups; ++i)
+    {
+        char* name = names[i % BENCH_VARIABLES];
+        SPList bucket = buckets[hashListName(name)];
+        LIST_FOREACH(SPListElement, element, bucket) {
+            if (isElementStrEquals(element, name)) {
+                sum += readElementValue(element);
+                break;
+            }
+        }
+    }
+    double lookup_time = (double)(readClock() - start) / lookups;
+    VERIFY(sum >= 0);
+
+    for (unsigned int i = 0; i < LIST_BUCKETS_COUNT; ++i)
+    {
+        listDestroy(buckets[i]);
+    }
+    return lookup_time;
+}
+
+/**
+ * Look the variables up in turn in a map.
+ *
+ * @param
+ *      char** names - Names of the variables.
+ *      unsigned int lookups - Amount of lookups.
+ *
+ * @return
+ *      Average time of a lookup (in nanoseconds).
+ */
+double measureMap(char** names, unsigned int lookups)
+{
+    BenchMap map;
+    benchMapInit(&map);
+    for (unsigned int i = 0; i < BENCH_VARIABLES; ++i)
+    {
+        bool is_new;
+        *benchMapInsert(&map, names[i], &is_new) = i;
+    }
+
+    double sum = 0;
+    uint64_t start = readClock();
+    for (unsigned int i = 0; i < lookups; ++i)
+    {
+        double* value = benchMapFind(&map, names[i % BENCH_VARIABLES]);
+        sum += *value;
+    }
+    double lookup_time = (double)(readClock() - start) / lookups;
+    VERIFY(sum >= 0);
+
+    benchMapDestroy(&map);
+    return lookup_time;
+}
+
+/**
+ * Hash a name into a bucket of the SPList table (the hash of the original variables table).
+ */
+unsigned int hashListName(const char* name)
+{
+    int hash = LIST_FIRST_PRIME;
+    for (; *name != '\0'; ++name)
+    {
+        hash = (LIST_COEFFICIENT_PRIME * hash) + (int)*name;
+        hash %= LIST_BUCKETS_COUNT;
+    }
+    return (unsigned int)hash;
+}
@@ -0,0 +1,372 @@
+/*
+ * Expression DAG Module
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "dag.h"
+#include "calculate.h"
+#include "alloc.h"
+#include "common.h"
+
+/*
+ * Types
+ */
+
+/* Kinds of DAG nodes */
+typedef enum DagNodeKind_e
+{
+    DAG_NUMBER,
+    DAG_VARIABLE,
+    DAG_OPERATION,
+    DAG_ASSIGNMENT,
+} DagNodeKind;
+
+/*
+ * DAG node.
+ * The operands of a node are stored as node indices in the operands array of the DAG,
+ * and always precede the node itself (so the nodes array is topologically sorted).
+ */
+typedef struct DagNode_
+{
+    DagNodeKind kind;
+    Operation operation;
+    double number;
+    NameId name_id;
+    unsigned int first_operand;
+    unsigned int operands_count;
+    unsigned int hash;
+} DagNode;
+
+struct ExpressionDag_t
+{
+    DagNode* nodes;
+    unsigned int nodes_count;
+    unsigned int* operands;
+    unsigned int operands_count;
+    unsigned int max_operands_count;
+
+    /* Hash-consing table: open addressing of node indices + 1 (0 marks an empty bucket) */
+    unsigned int* buckets;
+    unsigned int buckets_mask;
+
+    /* Stack of operand indices of the nodes that are being built */
+    unsigned int* pending;
+    unsigned int pending_count;
+
+    unsigned int tree_nodes_count;
+    double* values;
+    double* arguments;
+};
+
+/*
+ * Internal Function Declarations
+ */
+
+bool buildDagNodes(ExpressionDag dag, Tree* tree, OUT unsigned int* root_index);
+unsigned int internDagNode(ExpressionDag dag, DagNode* node, unsigned int pending_base);
+bool areDagNodesEqual(ExpressionDag dag, DagNode* node, DagNode* candidate, unsigned int pending_base);
+
+/*
+ * Module Functions
+ */
+
+ExpressionDag createExpressionDag(Tree* tree)
+{
+    VERIFY(tree != NULL);
+
+    ExpressionDag dag = ALLOCATE_ZEROED(ALLOC_PLANS, 1, sizeof(*dag));
+    VERIFY(dag != NULL);
+
+    /* The tree size bounds the amount of nodes and operands */
+    unsigned int tree_nodes_count = treeSize(tree);
+    unsigned int buckets_count = 1;
+    while (buckets_count < 2 * tree_nodes_count)
+    {
+        buckets_count *= 2;
+    }
+    dag->nodes = ALLOCATE(ALLOC_PLANS, tree_nodes_count * sizeof(*dag->nodes));
+    dag->operands = ALLOCATE(ALLOC_PLANS, tree_nodes_count * sizeof(*dag->operands));
+    dag->pending = ALLOCATE(ALLOC_PLANS, tree_nodes_count * sizeof(*dag->pending));
+    dag->buckets = ALLOCATE_ZEROED(ALLOC_PLANS, buckets_count, sizeof(*dag->buckets));
+    VERIFY(dag->nodes != NULL && dag->operands != NULL);
+    VERIFY(dag->pending != NULL && dag->buckets != NULL);
+    dag->buckets_mask = buckets_count - 1;
+    dag->tree_nodes_count = tree_nodes_count;
+
+    unsigned int root_index;
+    if (!buildDagNodes(dag, tree, &root_index)) {
+        destroyExpressionDag(dag);
+        return NULL;
+    }
+
+    /* The building buffers are no longer needed */
+    deallocate(dag->pending);
+    dag->pending = NULL;
+    deallocate(dag->buckets);
+    dag->buckets = NULL;
+
+    dag->values = ALLOCATE(ALLOC_PLANS, dag->nodes_count * sizeof(*dag->values));
+    dag->arguments = ALLOCATE(ALLOC_PLANS, (dag->max_operands_count + 1) * sizeof(*dag->arguments));
+    VERIFY(dag->values != NULL && dag->arguments != NULL);
+
+    return dag;
+}
+
+void destroyExpressionDag(ExpressionDag dag)
+{
+    if (dag == NULL) {
+        return;
+    }
+
+    deallocate(dag->nodes);
+    deallocate(dag->operands);
+    deallocate(dag->buckets);
+    deallocate(dag->pending);
+    deallocate(dag->values);
+    deallocate(dag->arguments);
+    deallocate(dag);
+}
+
+double evaluateExpressionDag(ExpressionDag dag, HashTable variables)
+{
+    VERIFY(dag != NULL);
+    VERIFY(variables != NULL);
+
+    /* Operands precede the nodes that use them, so a single pass evaluates every node once */
+    for (unsigned int i = 0; i < dag->nodes_count; ++i)
+    {
+        DagNode* node = &dag->nodes[i];
+        double value;
+        switch (node->kind)
+        {
+            case DAG_NUMBER:
+                value = node->number;
+                break;
+            case DAG_VARIABLE:
+                if (!hashGetValueById(variables, node->name_id, &value)) {
+                    value = NAN;
+                }
+                break;
+            case DAG_OPERATION:
+                for (unsigned int j = 0; j < node->operands_count; ++j)
+                {
+                    dag->arguments[j] = dag->values[dag->operands[node->first_operand + j]];
+                }
+                value = calculateOperation(node->operation, dag->arguments, node->operands_count);
+                break;
+            case DAG_ASSIGNMENT:
+                value = dag->values[dag->operands[node->first_operand]];
+                if (isnan(value)) {
+                    value = NAN;
+                } else {
+                    hashInsertById(variables, node->name_id, value);
+                }
+                break;
+            default:
+                panic();
+        }
+        dag->values[i] = value;
+    }
+
+    return dag->values[dag->nodes_count - 1];
+}
+
+unsigned int getDagNodeCount(ExpressionDag dag)
+{
+    VERIFY(dag != NULL);
+    return dag->nodes_count;
+}
+
+size_t getDagMemorySize(ExpressionDag dag)
+{
+    VERIFY(dag != NULL);
+    size_t size = sizeof(*dag)
+                + dag->nodes_count * (sizeof(*dag->nodes) + sizeof(*dag->values))
+                + dag->operands_count * sizeof(*dag->operands)
+                + (dag->max_operands_count + 1) * sizeof(*dag->arguments);
+    return size;
+}
+
+unsigned int getDagRemovedNodeCount(ExpressionDag dag)
+{
+    VERIFY(dag != NULL);
+    unsigned int tree_nodes_count = dag->tree_nodes_count;
+    if (dag->nodes[dag->nodes_count - 1].kind == DAG_ASSIGNMENT) {
+        /* The assigned variable is stored in the assignment node itself */
+        tree_nodes_count -= 1;
+    }
+    return tree_nodes_count - dag->nodes_count;
+}
+
+/*
+ * Internal Functions
+ */
+
+/**
+ * Build the DAG nodes of an expression tree, in post-order (the nodes of the operands before their operation),
+ * without recursion, so trees of any depth are built.
+ * The indices of the built nodes which are waiting for their operation are kept in the pending stack.
+ *
+ * @param
+ *      ExpressionDag dag - DAG being built.
+ *      Tree* tree - Expression tree.
+ *      unsigned int* root_index - Out parameter that receives the index of the root's node.
+ *
+ * @preconditions
+ *      dag != NULL, tree != NULL, root_index != NULL
+ *
+ * @return
+ *      false iff the tree contains a nested assignment.
+ */
+bool buildDagNodes(ExpressionDag dag, Tree* tree, OUT unsigned int* root_index)
+{
+    VERIFY(dag != NULL && tree != NULL && root_index != NULL);
+
+    for (Tree* tree_node = firstPostOrderNode(tree);
+         tree_node != NULL;
+         tree_node = nextPostOrderNode(tree, tree_node))
+    {
+        /* The assigned variable is stored in the assignment node itself, it isn't an operand */
+        Tree* parent = (tree_node != tree) ? getParent(tree_node) : NULL;
+        if (   parent != NULL
+            && tree_node == firstChild(parent)
+            && getOperation(getValue(parent)) == OPERATION_ASSIGNMENT) {
+            continue;
+        }
+
+        DagNode node;
+        memset(&node, 0, sizeof(node));
+        node.hash = HASH_SEED;
+        unsigned int pending_base = dag->pending_count;
+
+        if (!hasChildren(tree_node)) {
+            if (getNameId(tree_node) != NO_NAME_ID) {
+                node.kind = DAG_VARIABLE;
+                node.name_id = getNameId(tree_node);
+                node.hash = hashCombine(hashCombine(node.hash, DAG_VARIABLE), node.name_id);
+            } else {
+                VERIFY(hasNumber(tree_node));
+                node.kind = DAG_NUMBER;
+                node.number = getNumber(tree_node);
+                uint64_t bits;
+                memcpy(&bits, &node.number, sizeof(bits));
+                node.hash = hashCombine(hashCombine(hashCombine(node.hash, DAG_NUMBER),
+                                                    (unsigned int)bits),
+                                        (unsigned int)(bits >> 32));
+            }
+        } else {
+            Operation operation = getOperation(getValue(tree_node));
+            VERIFY(operation != OPERATION_INVALID);
+
+            unsigned int operands_count = childrenCount(tree_node);
+            if (operation == OPERATION_ASSIGNMENT) {
+                if (tree_node != tree) {
+                    return false;
+                }
+                Tree* variable = firstChild(tree_node);
+                VERIFY(operands_count == 2);
+                VERIFY(!hasChildren(variable) && getNameId(variable) != NO_NAME_ID);
+                node.kind = DAG_ASSIGNMENT;
+                node.name_id = getNameId(variable);
+                operands_count -= 1;
+            } else {
+                node.kind = DAG_OPERATION;
+            }
+            node.operation = operation;
+            node.hash = hashCombine(hashCombine(node.hash, node.kind), operation);
+
+            /* The operands are the last pending nodes */
+            VERIFY(dag->pending_count >= operands_count);
+            pending_base = dag->pending_count - operands_count;
+            for (unsigned int i = pending_base; i < dag->pending_count; ++i)
+            {
+                node.hash = hashCombine(node.hash, dag->pending[i]);
+            }
+            node.operands_count = operands_count;
+            if (node.operands_count > dag->max_operands_count) {
+                dag->max_operands_count = node.operands_count;
+            }
+        }
+
+        unsigned int index = internDagNode(dag, &node, pending_base);
+        dag->pending[pending_base] = index;
+        dag->pending_count = pending_base + 1;
+    }
+
+    VERIFY(dag->pending_count == 1);
+    *root_index = dag->pending[0];
+    return true;
+}
+
+/**
+ * Find a node which is identical to the given node, or add the node to the DAG if there isn't one.
+ *
+ * @param
+ *      ExpressionDag dag - DAG being built.
+ *      DagNode* node - Node to find. It's operands are on the pending stack, from pending_base.
+ *      unsigned int pending_base - Index of the first operand of the node in the pending stack.
+ *
+ * @preconditions
+ *      dag != NULL, node != NULL
+ *
+ * @return
+ *      Index of the node in the DAG.
+ */
+unsigned int internDagNode(ExpressionDag dag, DagNode* node, unsigned int pending_base)
+{
+    VERIFY(dag != NULL && node != NULL);
+
+    unsigned int bucket = node->hash & dag->buckets_mask;
+    while (dag->buckets[bucket] != 0)
+    {
+        unsigned int candidate_index = dag->buckets[bucket] - 1;
+        if (areDagNodesEqual(dag, node, &dag->nodes[candidate_index], pending_base)) {
+            return candidate_index;
+        }
+        bucket = (bucket + 1) & dag->buckets_mask;
+    }
+
+    /* New node */
+    node->first_operand = dag->operands_count;
+    memcpy(&dag->operands[dag->operands_count],
+           &dag->pending[pending_base],
+           node->operands_count * sizeof(*dag->operands));
+    dag->operands_count += node->operands_count;
+
+    unsigned int index = dag->nodes_count;
+    dag->nodes[index] = *node;
+    dag->nodes_count += 1;
+    dag->buckets[bucket] = index + 1;
+    return index;
+}
+
+/**
+ * Check if a node that is being built is structurally identical to an existing DAG node.
+ *
+ * @param
+ *      ExpressionDag dag - DAG being built.
+ *      DagNode* node - Node being built. It's operands are on the pending stack, from pending_base.
+ *      DagNode* candidate - Existing DAG node.
+ *      unsigned int pending_base - Index of the first operand of the node in the pending stack.
+ *
+ * @return
+ *      true iff the nodes are identical.
+ */
+bool areDagNodesEqual(ExpressionDag dag, DagNode* node, DagNode* candidate, unsigned int pending_base)
+{
+    if (   node->hash != candidate->hash
+        || node->kind != candidate->kind
+        || node->operation != candidate->operation
+        || node->number != candidate->number
+        || node->name_id != candidate->name_id
+        || node->operands_count != candidate->operands_count) {
+        return false;
+    }
+    return (memcmp(&dag->pending[pending_base],
+                   &dag->operands[candidate->first_operand],
+                   node->operands_count * sizeof(*dag->operands)) == 0);
+}
@@ -0,0 +1,114 @@
+/*
+ * Expression DAG Module
+ */
+
+#ifndef DAG_H_
+#define DAG_H_
+
+#include <stddef.h>
+#include "tree.h"
+#include "hashtable.h"
+
+/*
+ * Types
+ */
+
+/* Expression tree in which structurally identical sub-trees share a single node */
+typedef struct ExpressionDag_t* ExpressionDag;
+
+/*
+ * Functions
+ */
+
+/**
+ * Create an expression DAG from an expression tree (hash-consing).
+ * Structurally identical sub-trees (same operation or terminal, and identical operands)
+ * are represented by a single node, so each of them is evaluated once.
+ * The created DAG doesn't reference the tree, and has to be destroyed by destroyExpressionDag.
+ *
+ * Variables are treated as read-only during the evaluation,
+ * so only an assignment at the root of the tree is supported.
+ *
+ * @param
+ *      Tree* tree - Expression tree to convert.
+ *
+ * @preconditions
+ *      - tree != NULL
+ *      - tree is a valid arithmetic expression tree.
+ *
+ * @return
+ *      The created DAG, or NULL if the tree contains a nested assignment.
+ */
+ExpressionDag createExpressionDag(Tree* tree);
+
+/**
+ * Destroy a previously created expression DAG.
+ * If the given DAG is NULL, then nothing is done.
+ *
+ * @param
+ *      ExpressionDag dag - DAG to destroy.
+ */
+void destroyExpressionDag(ExpressionDag dag);
+
+/**
+ * Evaluate an expression DAG.
+ * The result is exactly the same as the result of evaluateExpressionTree on the original tree.
+ * If the expression is an assignment, the given variables table is updated.
+ *
+ * @param
+ *      ExpressionDag dag - DAG to evaluate.
+ *      HashTable variables - variables to use for evaluation,
+ *                            and to update after assignment.
+ *
+ * @preconditions
+ *      dag != NULL, variables != NULL
+ *
+ * @return
+ *      Evaluation result.
+ */
+double evaluateExpressionDag(ExpressionDag dag, HashTable variables);
+
+/**
+ * Get the amount of unique nodes in the DAG.
+ *
+ * @param
+ *      ExpressionDag dag - DAG to examine.
+ *
+ * @preconditions
+ *      dag != NULL
+ *
+ * @return
+ *      Amount of nodes.
+ */
+unsigned int getDagNodeCount(ExpressionDag dag);
+
+/**
+ * Get the amount of memory used by the DAG (in bytes).
+ *
+ * @param
+ *      ExpressionDag dag - DAG to examine.
+ *
+ * @preconditions
+ *      dag != NULL
+ *
+ * @return
+ *      Memory size of the DAG.
+ */
+size_t getDagMemorySize(ExpressionDag dag);
+
+/**
+ * Get the amount of tree nodes that were removed by sharing identical sub-trees,
+ * i.e. the difference between the original tree size and the DAG size.
+ *
+ * @param
+ *      ExpressionDag dag - DAG to examine.
+ *
+ * @preconditions
+ *      dag != NULL
+ *
+ * @return
+ *      Amount of removed nodes.
+ */
+unsigned int getDagRemovedNodeCount(ExpressionDag dag);
+
+#endif /* DAG_H_ */
@@ -0,0 +1,548 @@
+/*
+ * Formula Variables Module
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "formula.h"
+#include "calculate.h"
+#include "parse.h"
+#include "alloc.h"
+#include "common.h"
+
+/*
+ * Types
+ */
+
+/*
+ * Node of the dependency graph.
+ * There is a node for every formula variable, and for every variable that a formula reads.
+ * Edges are kept in both directions: a formula lists it's inputs,
+ * and every variable lists the formulas that read it (dependents).
+ */
+typedef struct VariableNode_
+{
+    char* name;
+    unsigned int hash;
+    Tree* formula;                          /* NULL if the variable isn't bound to a formula */
+    struct VariableNode_** inputs;
+    unsigned int inputs_count;
+    struct VariableNode_** dependents;
+    unsigned int dependents_count;
+    unsigned int dependents_capacity;
+    bool is_dirty;
+    bool is_marked;                         /* Used by graph traversals */
+    struct VariableNode_* next_in_bucket;
+} VariableNode;
+
+struct FormulaEngine_t
+{
+    HashTable variables;
+    VariableNode** buckets;
+    unsigned int buckets_count;
+    unsigned int nodes_count;
+    /* Formula whose value is being stored (so the change isn't treated as an overwrite) */
+    VariableNode* recomputing;
+};
+
+/* Growable stack of nodes, used by the graph traversals */
+typedef struct NodeStack_
+{
+    VariableNode** nodes;
+    unsigned int count;
+    unsigned int capacity;
+} NodeStack;
+
+/*
+ * Constants
+ */
+
+/* Amount of hash buckets allocated by the first node (doubled whenever the amount of nodes exceeds it) */
+#define INITIAL_NODE_BUCKETS_COUNT 64
+
+/*
+ * Internal Function Declarations
+ */
+
+void onVariableChanged(void* context, char* name, bool is_restored);
+VariableNode* findVariableNode(FormulaEngine engine, char* name);
+VariableNode* getVariableNode(FormulaEngine engine, char* name);
+void growVariableBuckets(FormulaEngine engine);
+void unbindFormula(VariableNode* node);
+void markDependentsDirty(VariableNode* node);
+bool dependsOn(VariableNode* node, VariableNode* target);
+void refreshVariableNode(FormulaEngine engine, VariableNode* node);
+void recomputeFormula(FormulaEngine engine, VariableNode* node);
+unsigned int collectFormulaInputs(FormulaEngine engine, Tree* tree, VariableNode** inputs, unsigned int inputs_count);
+bool containsAssignment(Tree* tree);
+void addDependent(VariableNode* node, VariableNode* dependent);
+void pushNode(NodeStack* stack, VariableNode* node);
+
+/*
+ * Module Functions
+ */
+
+FormulaEngine createFormulaEngine(HashTable variables)
+{
+    VERIFY(variables != NULL);
+
+    FormulaEngine engine = ALLOCATE_ZEROED(ALLOC_FORMULAS, 1, sizeof(*engine));
+    VERIFY(engine != NULL);
+    /* The buckets are allocated with the first node (most sessions bind no formulas) */
+    engine->variables = variables;
+    hashSetChangeListener(variables, onVariableChanged, engine);
+    return engine;
+}
+
+void destroyFormulaEngine(FormulaEngine engine)
+{
+    if (engine == NULL) {
+        return;
+    }
+
+    hashSetChangeListener(engine->variables, NULL, NULL);
+    for (unsigned int i = 0; i < engine->buckets_count; ++i)
+    {
+        VariableNode* node = engine->buckets[i];
+        while (node != NULL)
+        {
+            VariableNode* next = node->next_in_bucket;
+            destroyTree(node->formula);
+            deallocate(node->inputs);
+            deallocate(node->dependents);
+            deallocate(node->name);
+            deallocate(node);
+            node = next;
+        }
+    }
+    deallocate(engine->buckets);
+    deallocate(engine);
+}
+
+double bindFormula(FormulaEngine engine, char* name, Tree* expression)
+{
+    VERIFY(engine != NULL);
+    VERIFY(name != NULL);
+    VERIFY(expression != NULL);
+
+    if (containsAssignment(expression)) {
+        return NAN;
+    }
+
+    /* Find the inputs of the formula, and make sure they don't depend on the variable */
+    VariableNode* node = getVariableNode(engine, name);
+    VariableNode** inputs = ALLOCATE(ALLOC_FORMULAS, treeSize(expression) * sizeof(*inputs));
+    VERIFY(inputs != NULL);
+    unsigned int inputs_count = collectFormulaInputs(engine, expression, inputs, 0);
+    for (unsigned int i = 0; i < inputs_count; ++i)
+    {
+        inputs[i]->is_marked = false;
+    }
+    for (unsigned int i = 0; i < inputs_count; ++i)
+    {
+        if (dependsOn(inputs[i], node)) {
+            deallocate(inputs);
+            return NAN;
+        }
+    }
+
+    /* Replace the binding */
+    unbindFormula(node);
+    node->formula = copyTree(expression);
+    node->inputs = inputs;
+    node->inputs_count = inputs_count;
+    for (unsigned int i = 0; i < inputs_count; ++i)
+    {
+        addDependent(inputs[i], node);
+    }
+
+    node->is_dirty = true;
+    refreshVariableNode(engine, node);
+    if (!hashContains(engine->variables, name)) {
+        return NAN;
+    }
+    return hashGetValue(engine->variables, name);
+}
+
+void refreshFormulas(FormulaEngine engine, NameId* ids, unsigned int ids_count)
+{
+    VERIFY(engine != NULL);
+    VERIFY(ids != NULL || ids_count == 0);
+
+    for (unsigned int i = 0; i < ids_count; ++i)
+    {
+        VariableNode* node = findVariableNode(engine, (char*)getInternedName(ids[i]));
+        if (node != NULL) {
+            refreshVariableNode(engine, node);
+        }
+    }
+}
+
+bool isFormula(FormulaEngine engine, char* name)
+{
+    VERIFY(engine != NULL);
+    VariableNode* node = findVariableNode(engine, name);
+    return (node != NULL && node->formula != NULL);
+}
+
+/*
+ * Internal Functions
+ */
+
+/**
+ * Change listener of the variables table.
+ * A variable that changed makes all of it's dependents dirty.
+ * If the variable is a formula which was overwritten (not recomputed), then it's unbound.
+ * Bindings aren't part of checkpoints, so a formula whose value was restored by a rollback stays bound,
+ * and it's marked dirty (it's restored value may not match it's restored inputs).
+ *
+ * @param
+ *      void* context - The formula engine.
+ *      char* name - Variable that changed.
+ *      bool is_restored - Whether the value was restored by a rollback.
+ */
+void onVariableChanged(void* context, char* name, bool is_restored)
+{
+    FormulaEngine engine = context;
+    VariableNode* node = findVariableNode(engine, name);
+    if (node == NULL) {
+        return;
+    }
+    if (is_restored && node->formula != NULL) {
+        node->is_dirty = true;
+    } else if (node != engine->recomputing) {
+        unbindFormula(node);
+    }
+    markDependentsDirty(node);
+}
+
+/**
+ * Find the dependency graph node of a variable.
+ *
+ * @param
+ *      FormulaEngine engine - Engine to use.
+ *      char* name - Variable name.
+ *
+ * @return
+ *      The node of the variable, or NULL if there isn't one.
+ */
+VariableNode* findVariableNode(FormulaEngine engine, char* name)
+{
+    VERIFY(name != NULL);
+    if (engine->nodes_count == 0) {
+        return NULL;
+    }
+    unsigned int hash = hashString(HASH_SEED, name);
+    for (VariableNode* node = engine->buckets[hash % engine->buckets_count];
+         node != NULL;
+         node = node->next_in_bucket)
+    {
+        if (node->hash == hash && strcmp(node->name, name) == 0) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Get the dependency graph node of a variable, creating it if there isn't one.
+ *
+ * @param
+ *      FormulaEngine engine - Engine to use.
+ *      char* name - Variable name.
+ *
+ * @return
+ *      The node of the variable.
+ */
+VariableNode* getVariableNode(FormulaEngine engine, char* name)
+{
+    VariableNode* node = findVariableNode(engine, name);
+    if (node != NULL) {
+        return node;
+    }
+
+    if (engine->nodes_count >= engine->buckets_count) {
+        growVariableBuckets(engine);
+    }
+    node = ALLOCATE_ZEROED(ALLOC_FORMULAS, 1, sizeof(*node));
+    VERIFY(node != NULL);
+    node->name = copyString(name);
+    node->hash = hashString(HASH_SEED, name);
+    unsigned int bucket = node->hash % engine->buckets_count;
+    node->next_in_bucket = engine->buckets[bucket];
+    engine->buckets[bucket] = node;
+    engine->nodes_count += 1;
+    return node;
+}
+
+/**
+ * Double the amount of hash buckets (or allocate the first ones), and redistribute the nodes.
+ *
+ * @param
+ *      FormulaEngine engine - Engine to modify.
+ */
+void growVariableBuckets(FormulaEngine engine)
+{
+    unsigned int buckets_count = (engine->buckets_count > 0) ? engine->buckets_count * 2 : INITIAL_NODE_BUCKETS_COUNT;
+    VariableNode** buckets = ALLOCATE_ZEROED(ALLOC_FORMULAS, buckets_count, sizeof(*buckets));
+    VERIFY(buckets != NULL);
+
+    for (unsigned int i = 0; i < engine->buckets_count; ++i)
+    {
+        VariableNode* node = engine->buckets[i];
+        while (node != NULL)
+        {
+            VariableNode* next = node->next_in_bucket;
+            unsigned int bucket = node->hash % buckets_count;
+            node->next_in_bucket = buckets[bucket];
+            buckets[bucket] = node;
+            node = next;
+        }
+    }
+
+    deallocate(engine->buckets);
+    engine->buckets = buckets;
+    engine->buckets_count = buckets_count;
+}
+
+/**
+ * Remove the formula of a variable (if it has one), and it's input edges.
+ *
+ * @param
+ *      VariableNode* node - Variable node to unbind.
+ */
+void unbindFormula(VariableNode* node)
+{
+    for (unsigned int i = 0; i < node->inputs_count; ++i)
+    {
+        VariableNode* input = node->inputs[i];
+        for (unsigned int j = 0; j < input->dependents_count; ++j)
+        {
+            if (input->dependents[j] == node) {
+                input->dependents_count -= 1;
+                input->dependents[j] = input->dependents[input->dependents_count];
+                break;
+            }
+        }
+    }
+    deallocate(node->inputs);
+    node->inputs = NULL;
+    node->inputs_count = 0;
+    destroyTree(node->formula);
+    node->formula = NULL;
+    node->is_dirty = false;
+}
+
+/**
+ * Mark all the formulas that depend on a variable (directly or indirectly) as dirty.
+ * Formulas that are already dirty aren't traversed again,
+ * so the cost is proportional to the amount of newly dirty formulas.
+ *
+ * @param
+ *      VariableNode* node - Variable that changed.
+ */
+void markDependentsDirty(VariableNode* node)
+{
+    NodeStack stack = {NULL, 0, 0};
+    pushNode(&stack, node);
+    while (stack.count > 0)
+    {
+        stack.count -= 1;
+        VariableNode* current = stack.nodes[stack.count];
+        for (unsigned int i = 0; i < current->dependents_count; ++i)
+        {
+            VariableNode* dependent = current->dependents[i];
+            if (!dependent->is_dirty) {
+                dependent->is_dirty = true;
+                pushNode(&stack, dependent);
+            }
+        }
+    }
+    deallocate(stack.nodes);
+}
+
+/**
+ * Check if a variable depends on another variable through formulas (or is the same variable).
+ *
+ * @param
+ *      VariableNode* node - Variable to check.
+ *      VariableNode* target - Variable which may be depended on.
+ *
+ * @return
+ *      true iff target is reachable from node through formula inputs.
+ */
+bool dependsOn(VariableNode* node, VariableNode* target)
+{
+    NodeStack stack = {NULL, 0, 0};
+    NodeStack visited = {NULL, 0, 0};
+    bool found = false;
+
+    pushNode(&stack, node);
+    while (stack.count > 0 && !found)
+    {
+        stack.count -= 1;
+        VariableNode* current = stack.nodes[stack.count];
+        if (current == target) {
+            found = true;
+        } else if (!current->is_marked) {
+            current->is_marked = true;
+            pushNode(&visited, current);
+            for (unsigned int i = 0; i < current->inputs_count; ++i)
+            {
+                pushNode(&stack, current->inputs[i]);
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < visited.count; ++i)
+    {
+        visited.nodes[i]->is_marked = false;
+    }
+    deallocate(stack.nodes);
+    deallocate(visited.nodes);
+    return found;
+}
+
+/**
+ * Recompute a dirty formula, after recomputing the dirty formulas it reads (post-order).
+ * Only dirty paths are traversed.
+ *
+ * @param
+ *      FormulaEngine engine - Engine to use.
+ *      VariableNode* node - Variable to refresh.
+ */
+void refreshVariableNode(FormulaEngine engine, VariableNode* node)
+{
+    if (node->formula == NULL || !node->is_dirty) {
+        return;
+    }
+
+    NodeStack stack = {NULL, 0, 0};
+    pushNode(&stack, node);
+    while (stack.count > 0)
+    {
+        VariableNode* current = stack.nodes[stack.count - 1];
+        bool has_dirty_input = false;
+        for (unsigned int i = 0; i < current->inputs_count && !has_dirty_input; ++i)
+        {
+            VariableNode* input = current->inputs[i];
+            if (input->formula != NULL && input->is_dirty) {
+                pushNode(&stack, input);
+                has_dirty_input = true;
+            }
+        }
+        if (!has_dirty_input) {
+            stack.count -= 1;
+            recomputeFormula(engine, current);
+        }
+    }
+    deallocate(stack.nodes);
+}
+
+/**
+ * Evaluate the formula of a variable (whose inputs are up to date), and store it's value.
+ *
+ * @param
+ *      FormulaEngine engine - Engine to use.
+ *      VariableNode* node - Formula variable.
+ */
+void recomputeFormula(FormulaEngine engine, VariableNode* node)
+{
+    double value = evaluateExpressionTree(node->formula, engine->variables);
+
+    engine->recomputing = node;
+    if (!isnan(value)) {
+        hashInsert(engine->variables, node->name, value);
+    } else if (hashContains(engine->variables, node->name)) {
+        hashDelete(engine->variables, node->name);
+    }
+    engine->recomputing = NULL;
+    node->is_dirty = false;
+}
+
+/**
+ * Collect the (unique) variable nodes read by an expression tree.
+ * The collected nodes are marked, and the caller has to clear their marks.
+ *
+ * @param
+ *      FormulaEngine engine - Engine to use.
+ *      Tree* tree - Expression tree.
+ *      VariableNode** inputs - Array which the nodes are added to (large enough for all the tree nodes).
+ *      unsigned int inputs_count - Amount of nodes already in the array.
+ *
+ * @return
+ *      Amount of nodes in the array.
+ */
+unsigned int collectFormulaInputs(FormulaEngine engine, Tree* tree, VariableNode** inputs, unsigned int inputs_count)
+{
+    for (Tree* node = tree; node != NULL; node = nextPreOrderNode(tree, node))
+    {
+        if (!hasChildren(node) && isName(getValue(node))) {
+            VariableNode* input = getVariableNode(engine, getValue(node));
+            if (!input->is_marked) {
+                input->is_marked = true;
+                inputs[inputs_count] = input;
+                inputs_count += 1;
+            }
+        }
+    }
+    return inputs_count;
+}
+
+/**
+ * Check if an expression tree contains an assignment or a formula binding.
+ *
+ * @param
+ *      Tree* tree - Expression tree to examine.
+ *
+ * @return
+ *      true iff the tree contains an assignment.
+ */
+bool containsAssignment(Tree* tree)
+{
+    for (Tree* node = tree; node != NULL; node = nextPreOrderNode(tree, node))
+    {
+        if (hasChildren(node) && (isAssignmentExpression(node) || isBindingExpression(node))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Add a formula to the dependents of a variable.
+ *
+ * @param
+ *      VariableNode* node - Input variable.
+ *      VariableNode* dependent - Formula variable that reads it.
+ */
+void addDependent(VariableNode* node, VariableNode* dependent)
+{
+    if (node->dependents_count == node->dependents_capacity) {
+        node->dependents_capacity = (node->dependents_capacity == 0) ? 4 : 2 * node->dependents_capacity;
+        node->dependents = REALLOCATE(ALLOC_FORMULAS, node->dependents, node->dependents_capacity * sizeof(*node->dependents));
+        VERIFY(node->dependents != NULL);
+    }
+    node->dependents[node->dependents_count] = dependent;
+    node->dependents_count += 1;
+}
+
+/**
+ * Push a node onto a node stack (growing it if needed).
+ *
+ * @param
+ *      NodeStack* stack - Stack to push onto.
+ *      VariableNode* node - Node to push.
+ */
+void pushNode(NodeStack* stack, VariableNode* node)
+{
+    if (stack->count == stack->capacity) {
+        stack->capacity = (stack->capacity == 0) ? 16 : 2 * stack->capacity;
+        stack->nodes = REALLOCATE(ALLOC_FORMULAS, stack->nodes, stack->capacity * sizeof(*stack->nodes));
+        VERIFY(stack->nodes != NULL);
+    }
+    stack->nodes[stack->count] = node;
+    stack->count += 1;
+}
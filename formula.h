@@ -0,0 +1,106 @@
+/*
+ * Formula Variables Module
+ */
+
+#ifndef FORMULA_H_
+#define FORMULA_H_
+
+#include "tree.h"
+#include "hashtable.h"
+
+/*
+ * Types
+ */
+
+/*
+ * Engine of formula variables, i.e. variables that are bound to an expression (:=)
+ * rather than to a value (=).
+ * The engine keeps a dependency graph between variables. When a variable changes,
+ * all the formulas that depend on it (directly or indirectly) are marked dirty,
+ * and a dirty formula is recomputed only when it's read.
+ */
+typedef struct FormulaEngine_t* FormulaEngine;
+
+/*
+ * Functions
+ */
+
+/**
+ * Create a formula engine for a variables table.
+ * The engine listens to the changes of the table (so the table can't have another listener),
+ * and stores the values of the formula variables in it.
+ * The created engine has to be destroyed by destroyFormulaEngine.
+ *
+ * @param
+ *      HashTable variables - variables table.
+ *
+ * @preconditions
+ *      variables != NULL
+ *
+ * @return
+ *      The created engine.
+ */
+FormulaEngine createFormulaEngine(HashTable variables);
+
+/**
+ * Destroy a formula engine, and stop listening to it's variables table.
+ * The current values of the formula variables remain in the table.
+ * If the given engine is NULL, then nothing is done.
+ *
+ * @param
+ *      FormulaEngine engine - Engine to destroy.
+ */
+void destroyFormulaEngine(FormulaEngine engine);
+
+/**
+ * Bind a variable to an expression, and calculate it's current value.
+ * Any previous binding of the variable is replaced.
+ * If the value of the expression is invalid, the variable is removed from the table
+ * (until the expression becomes valid), and NAN is returned.
+ * If the expression contains an assignment, or depends on the variable itself
+ * (directly or through other formulas), then the variable isn't bound and NAN is returned.
+ *
+ * @param
+ *      FormulaEngine engine - Engine to use.
+ *      char* name - Variable to bind.
+ *      Tree* expression - Expression to bind to (the engine keeps a copy of it).
+ *
+ * @preconditions
+ *      engine != NULL, name != NULL, expression != NULL
+ *
+ * @return
+ *      The current value of the variable.
+ */
+double bindFormula(FormulaEngine engine, char* name, Tree* expression);
+
+/**
+ * Recompute the dirty formulas among the given variables (and the dirty formulas they depend on),
+ * so the table holds their up to date values.
+ * This has to be called before evaluating an expression which reads these variables.
+ *
+ * @param
+ *      FormulaEngine engine - Engine to use.
+ *      NameId* ids - Variables that are about to be read (interned names).
+ *      unsigned int ids_count - Amount of variables.
+ *
+ * @preconditions
+ *      engine != NULL, ids != NULL (unless ids_count is 0)
+ */
+void refreshFormulas(FormulaEngine engine, NameId* ids, unsigned int ids_count);
+
+/**
+ * Check if a variable is bound to a formula.
+ *
+ * @param
+ *      FormulaEngine engine - Engine to use.
+ *      char* name - Variable to check.
+ *
+ * @preconditions
+ *      engine != NULL, name != NULL
+ *
+ * @return
+ *      true iff the variable is bound to a formula.
+ */
+bool isFormula(FormulaEngine engine, char* name);
+
+#endif /* FORMULA_H_ */
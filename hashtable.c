@@ -3,57 +3,78 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "hashtable.h"
+#include "shmtable.h"
+#include "container.h"
+#include "stats.h"
+#include "alloc.h"
 #include "common.h"
 
 /*
- * Constants
+ * Types
  */
 
-#define NUMBER_OF_ENTRIES (100)
-#define FIRST_PRIME (571)
-#define COEFFICIENT_PRIME (31)
+typedef struct Variable_t {
+    double value;
+    unsigned long version;
+} Variable;
 
-/*
- * Types
- */
+/* Ids are given in order, so they're used as their own hashes (consecutive ids never collide) */
+#define HASH_NAME_ID(id) (id)
+#define ARE_NAME_IDS_EQUAL(first, second) ((first) == (second))
+
+DEFINE_MAP(VariableMap, variableMap, NameId, Variable, HASH_NAME_ID, ARE_NAME_IDS_EQUAL, ALLOC_VARIABLES)
 
 struct HashTable_t {
-    SPList buckets[NUMBER_OF_ENTRIES];
-    int numberOfValues;
+    VariableMap variables;      /* Values by the interned ids of their names */
+    HashChangeListener changeListener;
+    void* changeListenerContext;
+    struct ShmTable_t* shared;  /* Read-only values beneath the table's own values (or NULL) */
+    VarMap snapshot;            /* Persistent copy of the table, kept once a checkpoint is taken (or NULL) */
+    VarMap* checkpoints;
+    unsigned int checkpointsCount;
+    bool isRollingBack;         /* Whether the changes are made by a rollback */
+    unsigned int checkpointsCapacity;
 };
 
-typedef enum LookupOperation_e {
-    INSERT,
-    DELETE,
-    GET,
-} LookupOperation;
+/*
+ * Globals
+ */
+
+/* Last version given to an inserted value (shared by all tables, so versions are unique) */
+unsigned long lastVersion = 0;
 
 /*
  * Internal Functions
  */
 
 /**
- * lookupElementByName: Finds an element in the table by it's name, creates a new one, or deletes
- * an exiting one (based on the action).
+ * findVariable: Finds the variable of a name in the table
  *
  * @param table Target hash table to work on
- * @param name The name of the element to work on
- * @param operation Says wheather to create, get or delete the element
- * @param element Out parameter that receives the element for the GET operation
- * @return Says wheather the operation succeeded or not
+ * @param id The interned name of the variable (or NO_NAME_ID, which is never found)
+ * @return The variable, or NULL if the name isn't in the table
  */
-bool lookupElementByName(HashTable table,
-                         char* name,
-                         LookupOperation operation,
-                         OUT SPListElement* element);
+Variable* findVariable(HashTable table, NameId id);
+
 /**
- * lookupElementByName: Hashes the given string (for the hash table)
+ * createSnapshot: Copies the table into a persistent map
  *
- * @param str The string to hash (untill the '\0' character is found)
- * @return The resulting hash value
+ * @param table The hash table to copy
+ * @return The created map
  */
-int hash(const char* str);
+VarMap createSnapshot(HashTable table);
+
+/**
+ * rollbackChange: Applies a difference between the table and a checkpoint (see varMapDiff)
+ *
+ * @param context The hash table to work on
+ * @param name The name whose value differs
+ * @param isSet Says wheather the name has a value in the checkpoint
+ * @param value The value of the name in the checkpoint
+ */
+void rollbackChange(void* context, const char* name, bool isSet, double value);
 
 /*
  * Functions
@@ -61,62 +82,189 @@ int hash(const char* str);
 
 HashTable createHashTable()
 {
-    struct HashTable_t* table = malloc(sizeof(*table));
+    struct HashTable_t* table = ALLOCATE(ALLOC_VARIABLES, sizeof(*table));
     VERIFY(NULL != table);
-    
-    for (int i = 0; i < NUMBER_OF_ENTRIES; i++) {
-        table->buckets[i] = listCreate();
-        VERIFY(NULL != table->buckets[i]);
-    }
-    table->numberOfValues = 0;
-    
+
+    variableMapInit(&table->variables);
+    table->changeListener = NULL;
+    table->changeListenerContext = NULL;
+    table->shared = NULL;
+    table->snapshot = NULL;
+    table->checkpoints = NULL;
+    table->checkpointsCount = 0;
+    table->checkpointsCapacity = 0;
+    table->isRollingBack = false;
+
     return table;
 }
 
 void hashInsert(HashTable table, char* name, double value)
 {
-    SPListElement newElement;
-    bool found = lookupElementByName(table, name, INSERT, &newElement);
-    VERIFY(found);
-    
-    setELementValue(newElement, value);
+    VERIFY(NULL != name);
+    hashInsertById(table, internName(name, strlen(name)), value);
+}
+
+void hashInsertById(HashTable table, NameId id, double value)
+{
+    VERIFY(NULL != table);
+    VERIFY(NO_NAME_ID != id);
+
+    bool isNew = false;
+    Variable* variable = variableMapInsert(&table->variables, id, &isNew);
+    variable->value = value;
+    lastVersion++;
+    variable->version = lastVersion;
+
+    if (NULL != table->snapshot) {
+        VarMap snapshot = varMapInsert(table->snapshot, getInternedName(id), value);
+        releaseVarMap(table->snapshot);
+        table->snapshot = snapshot;
+    }
+    if (NULL != table->changeListener) {
+        table->changeListener(table->changeListenerContext, (char*)getInternedName(id), table->isRollingBack);
+    }
 }
 
 double hashGetValue(HashTable table, char* name)
 {
-    SPListElement foundElement;
-    bool found = lookupElementByName(table, name, GET, &foundElement);
-    VERIFY(found);
-    
-    double* foundValue = getElementValue(foundElement);
-    VERIFY(NULL != foundValue);
-    return *foundValue;
+    VERIFY(NULL != name);
+    COUNT_STAT(COUNTER_VARIABLE_LOOKUPS);
+    Variable* variable = findVariable(table, findInternedName(name));
+    if (NULL != variable) {
+        return variable->value;
+    }
+
+    double value = 0;
+    VERIFY(NULL != table->shared && shmTableGetValue(table->shared, name, &value));
+    return value;
+}
+
+bool hashGetValueById(HashTable table, NameId id, OUT double* value)
+{
+    COUNT_STAT(COUNTER_VARIABLE_LOOKUPS);
+    Variable* variable = findVariable(table, id);
+    if (NULL == variable) {
+        return (NULL != table->shared && NO_NAME_ID != id
+                && shmTableGetValue(table->shared, getInternedName(id), value));
+    }
+    *value = variable->value;
+    return true;
+}
+
+unsigned long hashGetVersion(HashTable table, char* name)
+{
+    VERIFY(NULL != name);
+    return hashGetVersionById(table, findInternedName(name));
+}
+
+unsigned long hashGetVersionById(HashTable table, NameId id)
+{
+    Variable* variable = findVariable(table, id);
+    return (NULL != variable) ? variable->version : 0;
 }
 
 void hashDelete(HashTable table, char* name)
 {
-    SPListElement foundElement;
-    bool found = lookupElementByName(table, name, DELETE, &foundElement);
-    VERIFY(found);
+    VERIFY(NULL != table);
+    VERIFY(NULL != name);
+    NameId id = findInternedName(name);
+    bool found = (NO_NAME_ID != id) && variableMapRemove(&table->variables, id, NULL);
+    if (!found) {
+        /* Shared values can't be deleted (so deleting the table's own value uncovers the shared one) */
+        VERIFY(hashContains(table, name));
+        return;
+    }
+
+    if (NULL != table->snapshot) {
+        VarMap snapshot = varMapDelete(table->snapshot, name);
+        releaseVarMap(table->snapshot);
+        table->snapshot = snapshot;
+    }
+    if (NULL != table->changeListener) {
+        table->changeListener(table->changeListenerContext, name, table->isRollingBack);
+    }
 }
 
 bool hashContains(HashTable table, char* name)
 {
-    SPListElement foundElement;
-    bool found = lookupElementByName(table, name, GET, &foundElement);
-    return (found);
+    VERIFY(NULL != name);
+    double value = 0;
+    return (NULL != findVariable(table, findInternedName(name))
+            || (NULL != table->shared && shmTableGetValue(table->shared, name, &value)));
 }
 
 int hashGetSize(HashTable table)
 {
     VERIFY(NULL != table);
-    return table->numberOfValues;
+    return (int)table->variables.count;
 }
 
 bool hashIsEmpty(HashTable table)
 {
     VERIFY(NULL != table);
-    return (table->numberOfValues == 0);
+    return (table->variables.count == 0);
+}
+
+void hashSetSharedVariables(HashTable table, struct ShmTable_t* shared)
+{
+    VERIFY(NULL != table);
+    table->shared = shared;
+}
+
+void hashForEach(HashTable table, HashVisitor visitor, void* context)
+{
+    VERIFY(NULL != table);
+    VERIFY(NULL != visitor);
+
+    unsigned int index = 0;
+    for (VariableMapSlot* slot = variableMapNext(&table->variables, &index);
+         NULL != slot;
+         slot = variableMapNext(&table->variables, &index)) {
+        visitor(context, getInternedName(slot->key), slot->value.value);
+    }
+}
+
+void hashSetChangeListener(HashTable table, HashChangeListener listener, void* context)
+{
+    VERIFY(NULL != table);
+    table->changeListener = listener;
+    table->changeListenerContext = context;
+}
+
+unsigned int hashCheckpoint(HashTable table)
+{
+    VERIFY(NULL != table);
+
+    if (NULL == table->snapshot) {
+        table->snapshot = createSnapshot(table);
+    }
+    if (table->checkpointsCount == table->checkpointsCapacity) {
+        table->checkpointsCapacity = (0 == table->checkpointsCapacity) ? 4 : 2 * table->checkpointsCapacity;
+        table->checkpoints = REALLOCATE(ALLOC_VARIABLES, table->checkpoints,
+                                     table->checkpointsCapacity * sizeof(*table->checkpoints));
+        VERIFY(NULL != table->checkpoints);
+    }
+    table->checkpoints[table->checkpointsCount] = retainVarMap(table->snapshot);
+    table->checkpointsCount++;
+    return table->checkpointsCount;
+}
+
+bool hashRollback(HashTable table, unsigned int checkpoint)
+{
+    VERIFY(NULL != table);
+    if (0 == checkpoint || checkpoint > table->checkpointsCount) {
+        return false;
+    }
+
+    /* The persistent copy isn't updated by the changes, it's replaced by the checkpoint after them */
+    VarMap current = table->snapshot;
+    table->snapshot = NULL;
+    table->isRollingBack = true;
+    varMapDiff(current, table->checkpoints[checkpoint - 1], rollbackChange, table);
+    table->isRollingBack = false;
+    releaseVarMap(current);
+    table->snapshot = retainVarMap(table->checkpoints[checkpoint - 1]);
+    return true;
 }
 
 void destroyHashTable(HashTable table)
@@ -124,69 +272,49 @@ void destroyHashTable(HashTable table)
     if (NULL == table) {
         return;
     }
-    
-    for (int i = 0; i < NUMBER_OF_ENTRIES; i++) {
-        if (NULL != table->buckets[i]) {
-            listDestroy(table->buckets[i]);
-        }
+
+    for (unsigned int i = 0; i < table->checkpointsCount; i++) {
+        releaseVarMap(table->checkpoints[i]);
     }
-    
-    free(table);
+    deallocate(table->checkpoints);
+    releaseVarMap(table->snapshot);
+
+    variableMapDestroy(&table->variables);
+    deallocate(table);
 }
 
 
-int hash(const char* str)
+Variable* findVariable(HashTable table, NameId id)
 {
-    if (NULL == str) {
-        return -1;
+    VERIFY(NULL != table);
+
+    if (NO_NAME_ID == id) {
+        return NULL;
     }
-    
-    int hashValue = FIRST_PRIME;
-    while ('\0' != *str) {
-        hashValue = (COEFFICIENT_PRIME * hashValue) + (int)(*str);
-        hashValue %= NUMBER_OF_ENTRIES;
-        str++;
+    COUNT_STAT(COUNTER_HASH_PROBES);
+    return variableMapFind(&table->variables, id);
+}
+
+VarMap createSnapshot(HashTable table)
+{
+    VarMap snapshot = createVarMap();
+    unsigned int index = 0;
+    for (VariableMapSlot* slot = variableMapNext(&table->variables, &index);
+         NULL != slot;
+         slot = variableMapNext(&table->variables, &index)) {
+        VarMap newSnapshot = varMapInsert(snapshot, getInternedName(slot->key), slot->value.value);
+        releaseVarMap(snapshot);
+        snapshot = newSnapshot;
     }
-    
-    return hashValue;
+    return snapshot;
 }
 
-bool lookupElementByName(HashTable table,
-                         char* name,
-                         LookupOperation operation,
-                         OUT SPListElement* element)
+void rollbackChange(void* context, const char* name, bool isSet, double value)
 {
-    VERIFY(NULL != table);
-    
-    int nameHash = hash(name);
-    SPList bucket = table->buckets[nameHash];
-    *element = NULL;
-    
-    LIST_FOREACH(SPListElement, i, bucket) {
-        if (isElementStrEquals(i, name)) {
-            if (DELETE == operation) {
-                table->numberOfValues--;
-                listRemoveCurrent(bucket);
-                return true;
-            } else if (INSERT == operation || GET == operation) {
-                *element = listGetCurrent(bucket);
-                return true;
-            }
-        }
-    }
-    
-    if (INSERT != operation) {
-        return false;
+    HashTable table = context;
+    if (isSet) {
+        hashInsert(table, (char*)name, value);
+    } else {
+        hashDelete(table, (char*)name);
     }
-    
-    *element = createElement(name, 0);
-    VERIFY(NULL != element);
-    
-    ListResult listResult = listInsertFirst(bucket, *element);
-    VERIFY(SP_LIST_SUCCESS == listResult);
-    listGetFirst(bucket);
-    *element = listGetCurrent(bucket);
-    table->numberOfValues++;
-    
-    return true;
-}
\ No newline at end of file
+}
@@ -5,16 +5,36 @@
 #define HASHTABLE_H_
 
 
-#include "SPList.h"
-#include "SPListElement.h"
+#include <stdbool.h>
+#include "intern.h"
+#include "varmap.h"
+#include "common.h"
+
+/*
+ * The table maps the interned ids of names (see intern.h) to values, so a lookup compares ids
+ * rather than strings. Every function has a variant which takes the id of the name,
+ * for callers which keep ids (e.g. trees, see getNameId) rather than names.
+ */
 
 
 typedef struct HashTable_t * HashTable;
 
+/* Function that is called whenever the value of a name is inserted, modified or deleted.
+ * isRestored says whether the change restores the value of a checkpoint (see hashRollback),
+ * rather than assigns it. */
+typedef void (*HashChangeListener)(void* context, char* name, bool isRestored);
+
+/* Function that is called for each name and value of a table (see hashForEach) */
+typedef void (*HashVisitor)(void* context, const char* name, double value);
+
+/* Read-only table of values shared between processes (see shmtable.h) */
+struct ShmTable_t;
+
  /**
  * Allocates a new HashTable structure
  *
- * This function creates a new empty hash table.
+ * This function creates a new empty hash table, in O(1): only the table itself is allocated,
+ * and the storage of the values is allocated by the first insertion.
  * @return
  * 	NULL - If allocations failed.
  * 	A new HashTable in case of success.
@@ -33,6 +53,15 @@ HashTable createHashTable();
  */
 void hashInsert(HashTable table, char* name, double value);
 
+/**
+ * Inserts (or modifies) a value in the hash table, like hashInsert
+ * 
+ * @param table The hash table to work on
+ * @param id The interned name of the value to set
+ * @param value The value to set for the given name
+ */
+void hashInsertById(HashTable table, NameId id, double value);
+
 /**
  * Get the value that was previously set for a specific name
  * 
@@ -43,8 +72,43 @@ void hashInsert(HashTable table, char* name, double value);
  */
 double hashGetValue(HashTable table, char* name);
 
+/**
+ * Get the value that was previously set for a specific name, if there is one
+ * 
+ * @param table The hash table to work on
+ * @param id The interned name of the value to get (or NO_NAME_ID, which is never in the table)
+ * @param value Out parameter that receives the value
+ * @return
+ *   Weather there is a value for the given name or not
+ */
+bool hashGetValueById(HashTable table, NameId id, OUT double* value);
+
+/**
+ * Get the version of a specific name.
+ * Every insert (or modification) gives the name a new version, which is unique across
+ * all hash tables, so a name whose version didn't change still has the same value.
+ * 
+ * @param table The hash table to work on
+ * @param name The key of the version to get
+ * @return
+ *   The version of the given key, or 0 if the key is not in the table
+ */
+unsigned long hashGetVersion(HashTable table, char* name);
+
+/**
+ * Get the version of a specific name, like hashGetVersion
+ * 
+ * @param table The hash table to work on
+ * @param id The interned name of the version to get
+ * @return
+ *   The version of the given name, or 0 if the name is not in the table
+ */
+unsigned long hashGetVersionById(HashTable table, NameId id);
+
 /**
  * Deletes a value in the hash table based on a key.
+ * A shared value (see hashSetSharedVariables) isn't deleted, so deleting a name which only has
+ * a shared value does nothing, and deleting the table's own value of a name uncovers it's shared value.
  * 
  * @param table The hash table to work on
  * @param name The key of the value to delete
@@ -65,7 +129,7 @@ void hashDelete(HashTable table, char* name);
 bool hashContains(HashTable table, char* name);
 
 /**
- * Returns the number of values in the hash table
+ * Returns the number of values in the hash table (not including the shared values)
  * 
  * @param table The hash table to check
  * @return
@@ -83,8 +147,61 @@ int hashGetSize(HashTable table);
 bool hashIsEmpty(HashTable table);
 
 /**
- * destroyHashTable: Deallocates an existing hash table. Clears all elements by using the
- * stored free function.
+ * Set read-only shared values beneath the table's own values: names which aren't in the table
+ * are looked up in the shared table (by hashGetValue, hashGetValueById and hashContains).
+ * The shared values never change, so their version (see hashGetVersion) is 0.
+ *
+ * @param table The hash table to work on
+ * @param shared The shared values (or NULL, to stop using them), which have to be kept while they're used
+ */
+void hashSetSharedVariables(HashTable table, struct ShmTable_t* shared);
+
+/**
+ * Call a function for each name and value of the table (not including the shared values),
+ * in no particular order.
+ *
+ * @param table The hash table to visit
+ * @param visitor Function to call (which mustn't change the table)
+ * @param context Context passed to the visitor
+ */
+void hashForEach(HashTable table, HashVisitor visitor, void* context);
+
+/**
+ * Set a listener which is called after every change of the table (hashInsert and hashDelete).
+ * There can be a single listener for each table.
+ * 
+ * @param table The hash table to work on
+ * @param listener The function to call, or NULL to remove the current listener
+ * @param context Opaque pointer that is passed to the listener
+ */
+void hashSetChangeListener(HashTable table, HashChangeListener listener, void* context);
+
+/**
+ * Take a checkpoint of the names and values of the table, which it can be rolled back to.
+ * The first checkpoint copies the table into a persistent map (see varmap.h), which is then
+ * kept up to date by every change, so later checkpoints are taken in O(1).
+ * 
+ * @param table The hash table to work on
+ * @return
+ *   Id of the checkpoint (the first checkpoint is 1)
+ */
+unsigned int hashCheckpoint(HashTable table);
+
+/**
+ * Roll the table back to a checkpoint (which is kept, as well as the checkpoints taken after it).
+ * Only the names whose values changed since the checkpoint are touched,
+ * by hashInsert and hashDelete (so the change listener is called for them, as restored changes).
+ * 
+ * @param table The hash table to work on
+ * @param checkpoint Id of the checkpoint (given by hashCheckpoint)
+ * @return
+ *   If there is such a checkpoint or not
+ */
+bool hashRollback(HashTable table, unsigned int checkpoint);
+
+/**
+ * destroyHashTable: Deallocates an existing hash table and all of it's values.
+ * The values are stored in a single array, so they're deallocated at once (without walking them).
  *
  * @param table Target hash table to be deallocated. If table is NULL nothing will be
  * done
@@ -0,0 +1,134 @@
+/*
+ * Name Interning Module
+ */
+
+#include <string.h>
+#include <limits.h>
+#include "intern.h"
+#include "container.h"
+#include "alloc.h"
+#include "common.h"
+
+/*
+ * Constants
+ */
+
+/* Size of the chunks which the interned names are stored in (longer names get their own chunk) */
+#define NAMES_CHUNK_SIZE 4096
+
+/*
+ * Types
+ */
+
+/* Name being looked up, with it's hash (so the pool is rehashed without hashing the names again) */
+typedef struct InternKey_
+{
+    const char* name;
+    unsigned int length;
+    unsigned int hash;
+} InternKey;
+
+#define HASH_INTERN_KEY(key) ((key).hash)
+#define ARE_INTERN_KEYS_EQUAL(first, second) \
+    ((first).hash == (second).hash && (first).length == (second).length \
+     && memcmp((first).name, (second).name, (first).length) == 0)
+
+DEFINE_MAP(NameIdMap, nameIdMap, InternKey, NameId, HASH_INTERN_KEY, ARE_INTERN_KEYS_EQUAL, ALLOC_STRINGS)
+DEFINE_VECTOR(NameVector, nameVector, const char*, ALLOC_STRINGS)
+
+/*
+ * Globals
+ */
+
+/* Ids of the interned names (whose keys point to the canonical strings) */
+NameIdMap internedIds;
+
+/* Canonical strings of the interned names, by their ids - 1 */
+NameVector internedNames;
+
+/* Free part of the current chunk of names */
+char* namesChunk = NULL;
+size_t namesChunkFreeBytes = 0;
+
+/*
+ * Internal Function Declarations
+ */
+
+const char* storeInternedName(const char* name, size_t length);
+
+/*
+ * Module Functions
+ */
+
+NameId internName(const char* name, size_t length)
+{
+    VERIFY(name != NULL);
+    VERIFY(length <= UINT_MAX);
+    InternKey key = {name, (unsigned int)length, hashBytes(HASH_SEED, name, length)};
+    NameId* id = nameIdMapFind(&internedIds, key);
+    if (id != NULL) {
+        return *id;
+    }
+
+    /* New name, which is keyed by it's canonical string */
+    key.name = storeInternedName(name, length);
+    nameVectorPush(&internedNames, key.name);
+    bool is_new = false;
+    id = nameIdMapInsert(&internedIds, key, &is_new);
+    *id = internedNames.count;
+    return *id;
+}
+
+NameId findInternedName(const char* name)
+{
+    VERIFY(name != NULL);
+
+    size_t length = strlen(name);
+    if (length > UINT_MAX) {
+        return NO_NAME_ID;
+    }
+    InternKey key = {name, (unsigned int)length, hashBytes(HASH_SEED, name, length)};
+    NameId* id = nameIdMapFind(&internedIds, key);
+    return (id != NULL) ? *id : NO_NAME_ID;
+}
+
+const char* getInternedName(NameId id)
+{
+    VERIFY(id != NO_NAME_ID && id <= internedNames.count);
+    return internedNames.items[id - 1];
+}
+
+unsigned int getInternedNamesCount()
+{
+    return internedNames.count;
+}
+
+/*
+ * Internal Functions
+ */
+
+/**
+ * Store a copy of a new name in the chunks of names.
+ *
+ * @param
+ *      const char* name - The name (which doesn't have to be null-terminated).
+ *      size_t length - Length of the name.
+ *
+ * @return
+ *      The stored copy (null-terminated).
+ */
+const char* storeInternedName(const char* name, size_t length)
+{
+    if (length + 1 > namesChunkFreeBytes) {
+        size_t chunk_size = (length + 1 > NAMES_CHUNK_SIZE) ? length + 1 : NAMES_CHUNK_SIZE;
+        namesChunk = ALLOCATE(ALLOC_STRINGS, chunk_size);
+        VERIFY(namesChunk != NULL);
+        namesChunkFreeBytes = chunk_size;
+    }
+    char* stored_name = namesChunk;
+    memcpy(stored_name, name, length);
+    stored_name[length] = '\0';
+    namesChunk += length + 1;
+    namesChunkFreeBytes -= length + 1;
+    return stored_name;
+}
@@ -0,0 +1,89 @@
+/*
+ * Name Interning Module
+ */
+
+#ifndef INTERN_H_
+#define INTERN_H_
+
+#include <stddef.h>
+
+/*
+ * Name Interning
+ *
+ * Each distinct variable name is stored once, in a global pool, and is identified by a unique id.
+ * The parser interns the names as it reads them, so trees, the variables table and the caches
+ * keep ids (and a shared canonical string, for printing) instead of copies of the names,
+ * and compare names by comparing their ids.
+ * Interned names are kept until the program exits.
+ */
+
+/*
+ * Types
+ */
+
+/* Id of an interned name (ids are given in order, starting from 1) */
+typedef unsigned int NameId;
+
+/*
+ * Constants
+ */
+
+/* Id which isn't given to any name */
+#define NO_NAME_ID ((NameId)0)
+
+/*
+ * Functions
+ */
+
+/**
+ * Intern a name: get it's id, and add it to the pool if it isn't there yet.
+ *
+ * @param
+ *      const char* name - The name (which doesn't have to be null-terminated).
+ *      size_t length - Length of the name.
+ *
+ * @preconditions
+ *      name != NULL
+ *
+ * @return
+ *      Id of the name.
+ */
+NameId internName(const char* name, size_t length);
+
+/**
+ * Find the id of a name, without adding it to the pool.
+ *
+ * @param
+ *      const char* name - The name (null-terminated).
+ *
+ * @preconditions
+ *      name != NULL
+ *
+ * @return
+ *      Id of the name, or NO_NAME_ID if it was never interned.
+ */
+NameId findInternedName(const char* name);
+
+/**
+ * Get the canonical string of an interned name.
+ *
+ * @param
+ *      NameId id - Id of the name.
+ *
+ * @preconditions
+ *      id was given by internName.
+ *
+ * @return
+ *      The name (null-terminated). It's kept until the program exits, and mustn't be modified.
+ */
+const char* getInternedName(NameId id);
+
+/**
+ * Get the amount of interned names.
+ *
+ * @return
+ *      Amount of names (which is also the largest id).
+ */
+unsigned int getInternedNamesCount();
+
+#endif /* INTERN_H_ */
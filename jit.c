@@ -0,0 +1,525 @@
+/*
+ * Native Code Compilation Module
+ */
+
+/* Needed for mmap's MAP_ANONYMOUS and for sysconf in strict C99 mode */
+#define _DEFAULT_SOURCE
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "jit.h"
+#include "calculate.h"
+#include "alloc.h"
+#include "common.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_X86_64
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Types
+ */
+
+/*
+ * Signature of the generated code.
+ * slots holds the values of the variables, and scratch holds the intermediate values
+ * (the value of a node at depth d of the evaluation stack is stored in scratch[d]).
+ */
+typedef double (*JitFunction)(const double* slots, double* scratch);
+
+struct JitCode_t
+{
+    JitFunction function;
+    void* mapping;
+    size_t mapping_size;
+    NameId* variable_ids;
+    unsigned int variables_count;
+    double* slots;
+    double* scratch;
+    size_t memory_size;
+    NameId assigned_id;         /* Variable assigned by the expression, or NO_NAME_ID */
+};
+
+/* Buffer which the machine code is emitted into */
+typedef struct CodeBuffer_
+{
+    unsigned char* bytes;
+    size_t size;
+    size_t capacity;
+    unsigned int max_depth;
+    NameId* variable_ids;
+    unsigned int variables_count;
+} CodeBuffer;
+
+/*
+ * Constants
+ */
+
+/* x86-64 registers used by the generated code */
+#define REGISTER_RBX 3          /* Base of the variable slots */
+#define REGISTER_RBP 5          /* Base of the scratch values */
+#define REGISTER_XMM0 0
+#define REGISTER_XMM1 1
+
+/* Opcodes of the scalar double SSE2 instructions (prefixed by F2 0F) */
+#define SSE_MOVSD_LOAD 0x10
+#define SSE_MOVSD_STORE 0x11
+#define SSE_ADDSD 0x58
+#define SSE_MULSD 0x59
+#define SSE_SUBSD 0x5C
+#define SSE_DIVSD 0x5E
+
+/* Maximal nesting of compiled expressions (compilation is recursive), deeper ones are interpreted */
+#define JIT_MAX_NESTING 1000
+
+/*
+ * Internal Function Declarations
+ */
+
+#ifdef JIT_X86_64
+bool compileJitNode(CodeBuffer* buffer, Tree* tree, unsigned int depth, unsigned int nesting);
+void compileJitArithmetic(CodeBuffer* buffer, unsigned char opcode, unsigned int depth);
+void compileJitDivide(CodeBuffer* buffer, unsigned int depth);
+void compileJitCall(CodeBuffer* buffer, Operation operation, unsigned int operands_count, unsigned int depth);
+unsigned int findVariableSlot(CodeBuffer* buffer, NameId id);
+bool mapJitCode(JitCode code, CodeBuffer* buffer);
+void emitByte(CodeBuffer* buffer, unsigned char byte);
+void emitInt32(CodeBuffer* buffer, uint32_t value);
+void emitInt64(CodeBuffer* buffer, uint64_t value);
+void emitSseMemory(CodeBuffer* buffer, unsigned char opcode, unsigned int xmm, unsigned int base, unsigned int index);
+void emitLoadImmediate(CodeBuffer* buffer, uint64_t value);
+void emitRaxMemory(CodeBuffer* buffer, unsigned char opcode, unsigned int depth);
+#endif
+
+/*
+ * Module Functions
+ */
+
+bool isJitSupported()
+{
+#ifdef JIT_X86_64
+    return true;
+#else
+    return false;
+#endif
+}
+
+JitCode createJitCode(Tree* tree, NameId* variable_ids, unsigned int variables_count)
+{
+    VERIFY(tree != NULL);
+    VERIFY(variable_ids != NULL || variables_count == 0);
+
+#ifdef JIT_X86_64
+    NameId assigned_id = NO_NAME_ID;
+    if (hasChildren(tree) && getOperation(getValue(tree)) == OPERATION_ASSIGNMENT) {
+        VERIFY(childrenCount(tree) == 2);
+        assigned_id = getNameId(firstChild(tree));
+        VERIFY(assigned_id != NO_NAME_ID);
+        tree = lastChild(tree);
+    }
+
+    CodeBuffer buffer = {NULL, 0, 0, 0, variable_ids, variables_count};
+
+    /* Prologue: push rbx; push rbp; sub rsp, 8 (align the stack for calls);
+                 mov rbx, rdi; mov rbp, rsi */
+    const unsigned char prologue[] = {0x53, 0x55, 0x48, 0x83, 0xEC, 0x08, 0x48, 0x89, 0xFB, 0x48, 0x89, 0xF5};
+    for (unsigned int i = 0; i < sizeof(prologue); ++i)
+    {
+        emitByte(&buffer, prologue[i]);
+    }
+
+    if (!compileJitNode(&buffer, tree, 0, 1)) {
+        deallocate(buffer.bytes);
+        return NULL;
+    }
+
+    /* Epilogue: movsd xmm0, [rbp]; add rsp, 8; pop rbp; pop rbx; ret */
+    emitSseMemory(&buffer, SSE_MOVSD_LOAD, REGISTER_XMM0, REGISTER_RBP, 0);
+    const unsigned char epilogue[] = {0x48, 0x83, 0xC4, 0x08, 0x5D, 0x5B, 0xC3};
+    for (unsigned int i = 0; i < sizeof(epilogue); ++i)
+    {
+        emitByte(&buffer, epilogue[i]);
+    }
+
+    JitCode code = ALLOCATE_ZEROED(ALLOC_PLANS, 1, sizeof(*code));
+    VERIFY(code != NULL);
+    if (!mapJitCode(code, &buffer)) {
+        deallocate(buffer.bytes);
+        deallocate(code);
+        return NULL;
+    }
+    deallocate(buffer.bytes);
+
+    code->variable_ids = variable_ids;
+    code->variables_count = variables_count;
+    code->slots = ALLOCATE(ALLOC_PLANS, (variables_count + 1) * sizeof(*code->slots));
+    code->scratch = ALLOCATE(ALLOC_PLANS, (buffer.max_depth + 1) * sizeof(*code->scratch));
+    VERIFY(code->slots != NULL && code->scratch != NULL);
+    code->memory_size = sizeof(*code) + code->mapping_size
+                      + (variables_count + 1) * sizeof(*code->slots)
+                      + (buffer.max_depth + 1) * sizeof(*code->scratch);
+    code->assigned_id = assigned_id;
+    return code;
+#else
+    return NULL;
+#endif
+}
+
+void destroyJitCode(JitCode code)
+{
+    if (code == NULL) {
+        return;
+    }
+
+#ifdef JIT_X86_64
+    munmap(code->mapping, code->mapping_size);
+#endif
+    deallocate(code->slots);
+    deallocate(code->scratch);
+    deallocate(code);
+}
+
+size_t getJitMemorySize(JitCode code)
+{
+    VERIFY(code != NULL);
+    return code->memory_size;
+}
+
+double runJitCode(JitCode code, HashTable variables)
+{
+    VERIFY(code != NULL);
+    VERIFY(variables != NULL);
+
+    for (unsigned int i = 0; i < code->variables_count; ++i)
+    {
+        if (!hashGetValueById(variables, code->variable_ids[i], &code->slots[i])) {
+            code->slots[i] = NAN;
+        }
+    }
+
+    double result = code->function(code->slots, code->scratch);
+
+    if (code->assigned_id != NO_NAME_ID) {
+        if (isnan((float)result)) {
+            return NAN;
+        }
+        hashInsertById(variables, code->assigned_id, result);
+    }
+    return result;
+}
+
+/*
+ * Internal Functions
+ */
+
+#ifdef JIT_X86_64
+
+/**
+ * Emit the code of an expression sub-tree, which stores it's value in scratch[depth].
+ * The operands of an operation are evaluated into scratch[depth], scratch[depth + 1], etc.
+ *
+ * @param
+ *      CodeBuffer* buffer - Buffer to emit into.
+ *      Tree* tree - Expression sub-tree.
+ *      unsigned int depth - Scratch index of the value.
+ *      unsigned int nesting - Nesting depth of the sub-tree in the expression (the root's is 1).
+ *
+ * @return
+ *      false iff the sub-tree contains an assignment, or is nested deeper than JIT_MAX_NESTING.
+ */
+bool compileJitNode(CodeBuffer* buffer, Tree* tree, unsigned int depth, unsigned int nesting)
+{
+    if (nesting > JIT_MAX_NESTING) {
+        return false;
+    }
+    if (depth > buffer->max_depth) {
+        buffer->max_depth = depth;
+    }
+
+    char* value = getValue(tree);
+    if (!hasChildren(tree)) {
+        if (getNameId(tree) != NO_NAME_ID) {
+            /* movsd xmm0, [rbx + 8 * slot]; movsd [rbp + 8 * depth], xmm0 */
+            emitSseMemory(buffer, SSE_MOVSD_LOAD, REGISTER_XMM0, REGISTER_RBX,
+                          findVariableSlot(buffer, getNameId(tree)));
+            emitSseMemory(buffer, SSE_MOVSD_STORE, REGISTER_XMM0, REGISTER_RBP, depth);
+        } else {
+            double number = getNumber(tree);
+            uint64_t bits;
+            memcpy(&bits, &number, sizeof(bits));
+            emitLoadImmediate(buffer, bits);
+            emitRaxMemory(buffer, 0x89, depth);
+        }
+        return true;
+    }
+
+    Operation operation = getOperation(value);
+    VERIFY(operation != OPERATION_INVALID);
+    if (operation == OPERATION_ASSIGNMENT) {
+        return false;
+    }
+
+    unsigned int operands_count = 0;
+    for (Tree* child = firstChild(tree); child != NULL; child = nextBrother(child))
+    {
+        if (!compileJitNode(buffer, child, depth + operands_count, nesting + 1)) {
+            return false;
+        }
+        operands_count += 1;
+    }
+
+    switch (operation)
+    {
+        case OPERATION_PLUS:
+            if (operands_count == 2) {
+                compileJitArithmetic(buffer, SSE_ADDSD, depth);
+            }
+            break;
+        case OPERATION_MINUS:
+            if (operands_count == 2) {
+                compileJitArithmetic(buffer, SSE_SUBSD, depth);
+            } else {
+                /* Flip the sign bit: mov rax, [rbp + 8 * depth]; btc rax, 63; mov [rbp + 8 * depth], rax */
+                emitRaxMemory(buffer, 0x8B, depth);
+                emitByte(buffer, 0x48);
+                emitByte(buffer, 0x0F);
+                emitByte(buffer, 0xBA);
+                emitByte(buffer, 0xF8);
+                emitByte(buffer, 63);
+                emitRaxMemory(buffer, 0x89, depth);
+            }
+            break;
+        case OPERATION_MULTIPLY:
+            compileJitArithmetic(buffer, SSE_MULSD, depth);
+            break;
+        case OPERATION_DIVIDE:
+            compileJitDivide(buffer, depth);
+            break;
+        default:
+            compileJitCall(buffer, operation, operands_count, depth);
+            break;
+    }
+    return true;
+}
+
+/**
+ * Emit a binary SSE2 operation: scratch[depth] = scratch[depth] op scratch[depth + 1].
+ *
+ * @param
+ *      CodeBuffer* buffer - Buffer to emit into.
+ *      unsigned char opcode - SSE2 opcode of the operation.
+ *      unsigned int depth - Scratch index of the first operand.
+ */
+void compileJitArithmetic(CodeBuffer* buffer, unsigned char opcode, unsigned int depth)
+{
+    emitSseMemory(buffer, SSE_MOVSD_LOAD, REGISTER_XMM0, REGISTER_RBP, depth);
+    emitSseMemory(buffer, opcode, REGISTER_XMM0, REGISTER_RBP, depth + 1);
+    emitSseMemory(buffer, SSE_MOVSD_STORE, REGISTER_XMM0, REGISTER_RBP, depth);
+}
+
+/**
+ * Emit a division, with the semantics of calculateDivide (division by 0 is NAN).
+ *
+ * @param
+ *      CodeBuffer* buffer - Buffer to emit into.
+ *      unsigned int depth - Scratch index of the dividend (the divisor follows it).
+ */
+void compileJitDivide(CodeBuffer* buffer, unsigned int depth)
+{
+    /* movsd xmm1, [divisor]; xorpd xmm2, xmm2; ucomisd xmm1, xmm2 */
+    emitSseMemory(buffer, SSE_MOVSD_LOAD, REGISTER_XMM1, REGISTER_RBP, depth + 1);
+    const unsigned char compare[] = {0x66, 0x0F, 0x57, 0xD2, 0x66, 0x0F, 0x2E, 0xCA};
+    for (unsigned int i = 0; i < sizeof(compare); ++i)
+    {
+        emitByte(buffer, compare[i]);
+    }
+
+    /* Unordered (jp) or non-zero (jne) divisors are divided, zero gives NAN */
+    emitByte(buffer, 0x7A);
+    size_t parity_jump = buffer->size;
+    emitByte(buffer, 0);
+    emitByte(buffer, 0x75);
+    size_t not_equal_jump = buffer->size;
+    emitByte(buffer, 0);
+
+    double nan = NAN;
+    uint64_t bits;
+    memcpy(&bits, &nan, sizeof(bits));
+    emitLoadImmediate(buffer, bits);
+    emitRaxMemory(buffer, 0x89, depth);
+    emitByte(buffer, 0xEB);
+    size_t end_jump = buffer->size;
+    emitByte(buffer, 0);
+
+    size_t divide = buffer->size;
+    buffer->bytes[parity_jump] = (unsigned char)(divide - (parity_jump + 1));
+    buffer->bytes[not_equal_jump] = (unsigned char)(divide - (not_equal_jump + 1));
+    emitSseMemory(buffer, SSE_MOVSD_LOAD, REGISTER_XMM0, REGISTER_RBP, depth);
+    emitByte(buffer, 0xF2);
+    emitByte(buffer, 0x0F);
+    emitByte(buffer, SSE_DIVSD);
+    emitByte(buffer, 0xC1);
+    emitSseMemory(buffer, SSE_MOVSD_STORE, REGISTER_XMM0, REGISTER_RBP, depth);
+    buffer->bytes[end_jump] = (unsigned char)(buffer->size - (end_jump + 1));
+}
+
+/**
+ * Emit a call to calculateOperation, on the operands in scratch[depth], scratch[depth + 1], etc.
+ *
+ * @param
+ *      CodeBuffer* buffer - Buffer to emit into.
+ *      Operation operation - Operation to calculate.
+ *      unsigned int operands_count - Amount of operands.
+ *      unsigned int depth - Scratch index of the first operand (and of the result).
+ */
+void compileJitCall(CodeBuffer* buffer, Operation operation, unsigned int operands_count, unsigned int depth)
+{
+    /* mov edi, operation */
+    emitByte(buffer, 0xBF);
+    emitInt32(buffer, (uint32_t)operation);
+    /* lea rsi, [rbp + 8 * depth] */
+    emitByte(buffer, 0x48);
+    emitByte(buffer, 0x8D);
+    emitByte(buffer, 0xB5);
+    emitInt32(buffer, (uint32_t)(depth * sizeof(double)));
+    /* mov edx, operands_count */
+    emitByte(buffer, 0xBA);
+    emitInt32(buffer, operands_count);
+    /* mov rax, calculateOperation; call rax */
+    double (*function)(Operation, double*, unsigned int) = calculateOperation;
+    uint64_t address;
+    memcpy(&address, &function, sizeof(address));
+    emitLoadImmediate(buffer, address);
+    emitByte(buffer, 0xFF);
+    emitByte(buffer, 0xD0);
+    /* movsd [rbp + 8 * depth], xmm0 */
+    emitSseMemory(buffer, SSE_MOVSD_STORE, REGISTER_XMM0, REGISTER_RBP, depth);
+}
+
+/**
+ * Find the slot of a variable (binary search in the sorted variable ids).
+ *
+ * @param
+ *      CodeBuffer* buffer - Buffer being emitted.
+ *      NameId id - Interned variable name.
+ *
+ * @preconditions
+ *      The variable is in the variable ids.
+ *
+ * @return
+ *      Index of the variable slot.
+ */
+unsigned int findVariableSlot(CodeBuffer* buffer, NameId id)
+{
+    unsigned int low = 0;
+    unsigned int high = buffer->variables_count;
+    while (low < high)
+    {
+        unsigned int middle = low + (high - low) / 2;
+        if (buffer->variable_ids[middle] == id) {
+            return middle;
+        } else if (buffer->variable_ids[middle] < id) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    panic();
+}
+
+/**
+ * Copy the emitted code into an executable mapping.
+ * The mapping is written while it's writable, and then made executable (and read-only).
+ *
+ * @param
+ *      JitCode code - Code which receives the mapping.
+ *      CodeBuffer* buffer - Emitted code.
+ *
+ * @return
+ *      false iff the mapping couldn't be created (e.g. executable memory is forbidden).
+ */
+bool mapJitCode(JitCode code, CodeBuffer* buffer)
+{
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mapping_size = (buffer->size + page_size - 1) / page_size * page_size;
+    void* mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    memcpy(mapping, buffer->bytes, buffer->size);
+    if (mprotect(mapping, mapping_size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(mapping, mapping_size);
+        return false;
+    }
+
+    code->mapping = mapping;
+    code->mapping_size = mapping_size;
+    /* ISO C has no conversion from an object pointer to a function pointer */
+    memcpy(&code->function, &mapping, sizeof(code->function));
+    return true;
+}
+
+/*
+ * Instruction Encoding
+ */
+
+void emitByte(CodeBuffer* buffer, unsigned char byte)
+{
+    if (buffer->size == buffer->capacity) {
+        buffer->capacity = (buffer->capacity == 0) ? 256 : 2 * buffer->capacity;
+        buffer->bytes = REALLOCATE(ALLOC_PLANS, buffer->bytes, buffer->capacity);
+        VERIFY(buffer->bytes != NULL);
+    }
+    buffer->bytes[buffer->size] = byte;
+    buffer->size += 1;
+}
+
+void emitInt32(CodeBuffer* buffer, uint32_t value)
+{
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        emitByte(buffer, (unsigned char)(value >> (8 * i)));
+    }
+}
+
+void emitInt64(CodeBuffer* buffer, uint64_t value)
+{
+    for (unsigned int i = 0; i < 8; ++i)
+    {
+        emitByte(buffer, (unsigned char)(value >> (8 * i)));
+    }
+}
+
+/* <opcode> xmm, [base + 8 * index] (scalar double, 32 bit displacement) */
+void emitSseMemory(CodeBuffer* buffer, unsigned char opcode, unsigned int xmm, unsigned int base, unsigned int index)
+{
+    emitByte(buffer, 0xF2);
+    emitByte(buffer, 0x0F);
+    emitByte(buffer, opcode);
+    emitByte(buffer, (unsigned char)(0x80 | (xmm << 3) | base));
+    emitInt32(buffer, (uint32_t)(index * sizeof(double)));
+}
+
+/* mov rax, value */
+void emitLoadImmediate(CodeBuffer* buffer, uint64_t value)
+{
+    emitByte(buffer, 0x48);
+    emitByte(buffer, 0xB8);
+    emitInt64(buffer, value);
+}
+
+/* mov rax, [rbp + 8 * index] (opcode 8B) or mov [rbp + 8 * index], rax (opcode 89) */
+void emitRaxMemory(CodeBuffer* buffer, unsigned char opcode, unsigned int index)
+{
+    emitByte(buffer, 0x48);
+    emitByte(buffer, opcode);
+    emitByte(buffer, 0x85);
+    emitInt32(buffer, (uint32_t)(index * sizeof(double)));
+}
+
+#endif /* JIT_X86_64 */
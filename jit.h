@@ -0,0 +1,98 @@
+/*
+ * Native Code Compilation Module
+ */
+
+#ifndef JIT_H_
+#define JIT_H_
+
+#include <stdbool.h>
+#include "tree.h"
+#include "hashtable.h"
+
+/*
+ * Types
+ */
+
+/* Expression compiled into native machine code */
+typedef struct JitCode_t* JitCode;
+
+/*
+ * Functions
+ */
+
+/**
+ * Check if native code compilation is supported on this host (x86-64 Linux).
+ * On other hosts createJitCode always returns NULL.
+ *
+ * @return
+ *      true iff expressions can be compiled into native code.
+ */
+bool isJitSupported();
+
+/**
+ * Compile an expression tree into native code.
+ * Arithmetic operations are compiled into SSE2 instructions, and the rest of the operations
+ * into calls to calculateOperation. Variables are loaded from slots, which are filled
+ * from the variables table on every run.
+ * The created code has to be destroyed by destroyJitCode.
+ *
+ * @param
+ *      Tree* tree - Expression tree to compile.
+ *      NameId* variable_ids - Sorted unique (interned) names of the variables read by the tree.
+ *                             The code references the array, so it has to outlive it.
+ *      unsigned int variables_count - Amount of variables.
+ *
+ * @preconditions
+ *      - tree != NULL
+ *      - tree is a valid arithmetic expression tree.
+ *      - variable_names contains all the variables read by the tree.
+ *
+ * @return
+ *      The compiled code, or NULL if compilation isn't supported on this host,
+ *      the tree contains a nested assignment (only an assignment at the root is supported),
+ *      or the tree is nested too deep to compile (it's interpreted instead).
+ */
+JitCode createJitCode(Tree* tree, NameId* variable_ids, unsigned int variables_count);
+
+/**
+ * Destroy compiled code.
+ * If the given code is NULL, then nothing is done.
+ *
+ * @param
+ *      JitCode code - Code to destroy.
+ */
+void destroyJitCode(JitCode code);
+
+/**
+ * Get the amount of memory used by compiled code (in bytes),
+ * including the pages which the machine code is mapped into.
+ *
+ * @param
+ *      JitCode code - Code to examine.
+ *
+ * @preconditions
+ *      code != NULL
+ *
+ * @return
+ *      Memory size of the code.
+ */
+size_t getJitMemorySize(JitCode code);
+
+/**
+ * Run compiled code.
+ * The result is identical to the result of evaluateExpressionTree on the compiled tree,
+ * including the update of the variables table by an assignment.
+ *
+ * @param
+ *      JitCode code - Code to run.
+ *      HashTable variables - variables to use for evaluation, and to update after assignment.
+ *
+ * @preconditions
+ *      code != NULL, variables != NULL
+ *
+ * @return
+ *      Evaluation result.
+ */
+double runJitCode(JitCode code, HashTable variables);
+
+#endif /* JIT_H_ */
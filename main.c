@@ -2,25 +2,75 @@
  * Main Module
  */
 
+#define _DEFAULT_SOURCE
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
+#include <errno.h>
 #include <getopt.h>
+#include <unistd.h>
 #include "tree.h"
 #include "parse.h"
 #include "calculate.h"
+#include "plancache.h"
+#include "formula.h"
+#include "shmtable.h"
+#include "reload.h"
+#include "codec.h"
+#include "batch.h"
+#include "stats.h"
+#include "alloc.h"
+#include "trace.h"
 #include "common.h"
 
+/*
+ * Constants
+ */
+
+/* Memory cap of the compiled lines cache (in bytes) */
+#define PLAN_CACHE_MAX_BYTES (16 * 1024 * 1024)
+
+/* Size of the chunks in which lines longer than MAX_LINE_LENGTH are read */
+#define LONG_LINE_CHUNK_SIZE (64 * 1024)
+
+/* Values returned by getopt_long for the long options */
+#define STATS_OPTION 256
+#define ALLOCATION_BUDGET_OPTION 257
+#define TRACE_OPTION 258
+#define PUBLISH_VARIABLES_OPTION 259
+#define SHARED_VARIABLES_OPTION 260
+#define WATCH_VARIABLES_OPTION 261
+#define RELOAD_POLICY_OPTION 262
+
 /*
  * Structs
  */
 
+/* Framing of the expressions read from stdin */
+typedef enum InputFormat_
+{
+    INPUT_LINES,            /* Lisp expressions, one per line */
+    INPUT_BINARY_TREES,     /* Binary tree frames (see codec.h) */
+    INPUT_BATCHES           /* Length-prefixed batches of Lisp expressions (see batch.h) */
+} InputFormat;
+
 /* Container for parsed command line arguments */
 typedef struct CommandLineArgs_
 {
     char* variable_input_file;
     char* output_file;
+    InputFormat input_format;
+    bool should_print_stats;
+    StatsFormat stats_format;
+    unsigned long long allocation_budget;
+    char* trace_file;
+    char* published_segment;    /* Shared memory segment which the variables file is published in */
+    char* shared_segment;       /* Shared memory segment of variables published by another process */
+    bool should_watch_variables;    /* Whether changes to the variables file are reloaded */
+    ReloadPolicy reload_policy;
 } CommandLineArgs;
 
 /*
@@ -28,8 +78,19 @@ typedef struct CommandLineArgs_
  */
 
 bool parseCommandLineArguments(int argc, char **argv, CommandLineArgs* parsed_args);
-void interact(HashTable variables, FILE* output_file);
-void getLine(char* buffer, unsigned int size);
+void interact(HashTable variables, VariableReloader reloader, FILE* output_file, InputFormat input_format);
+bool processBatch(BatchReader reader, PlanCache plan_cache, HashTable variables, FormulaEngine formulas,
+                  FILE* output_file, bool should_print_expression);
+bool processExpression(const char* expression, size_t length, PlanCache plan_cache, HashTable variables,
+                       FormulaEngine formulas, FILE* output_file, bool should_print_expression);
+bool processTree(Tree* tree, HashTable variables, FormulaEngine formulas,
+                 FILE* output_file, bool should_print_expression);
+bool processLine(CompiledLine* compiled, HashTable variables, FormulaEngine formulas,
+                 FILE* output_file, bool should_print_expression);
+bool processCommand(CompiledLine* compiled, HashTable variables, FILE* output_file, bool should_print_expression);
+bool getLine(char* buffer, unsigned int size);
+char* readInputChunk(char* buffer, unsigned int size);
+Tree* parseLongLine(const char* first_chunk);
 
 /*
  * Function Implementations
@@ -46,16 +107,29 @@ void getLine(char* buffer, unsigned int size);
  */
 int main(int argc, char **argv)
 {
+    startStartupTimer();
     int return_value = EXIT_FAILURE;
     FILE* variable_input_file = NULL;
     FILE* output_file = NULL;
+    FILE* trace_file = NULL;
     HashTable variables = NULL;
+    ShmTable shared_variables = NULL;
+    VariableReloader reloader = NULL;
 
     /* Parse args */
     CommandLineArgs parsed_args;
     bool had_parse_error = parseCommandLineArguments(argc, argv, &parsed_args);
     if (had_parse_error) {
-        printf("Invalid command line arguments, use [-v filename1] [-o filename2]\n");
+        printf("Invalid command line arguments, use [-v filename1] [-o filename2] [-b | -m] [--stats[=json]] [--alloc-budget=count] [--trace filename3] [--publish-variables=segment | --shared-variables=segment] [--watch-variables [--reload-policy=session|file]]\n");
+        goto end;
+    }
+    if (parsed_args.published_segment != NULL && parsed_args.variable_input_file == NULL) {
+        printf("Published variables must be given by a variable init file\n");
+        goto end;
+    }
+    if (parsed_args.should_watch_variables
+        && (parsed_args.variable_input_file == NULL || parsed_args.published_segment != NULL)) {
+        printf("Watched variables must be given by a variable init file, and can't be published\n");
         goto end;
     }
     if (parsed_args.variable_input_file != NULL
@@ -80,28 +154,80 @@ int main(int argc, char **argv)
             goto end;
         }
     }
+    if (parsed_args.trace_file != NULL) {
+        trace_file = fopen(parsed_args.trace_file, "w");
+        if (trace_file == NULL) {
+            printf("Trace file is read-only or cannot be created\n");
+            goto end;
+        }
+    }
 
-    /* Parse initial variables */
+    /* Call sites are enabled before the initial variables are parsed, so their allocations are reported */
+    if (parsed_args.should_print_stats) {
+        enableAllocationSites();
+    }
+
+    /* Parse initial variables (or publish them, and keep only the assignments in the process' own table,
+     * or watch them, and keep reloading the file's changes) */
     variables = createHashTable();
-    if (variable_input_file != NULL) {
+    if (parsed_args.published_segment != NULL) {
+        parseVariableInputFile(variable_input_file, variables);
+        shared_variables = publishShmTable(parsed_args.published_segment, variables);
+        destroyHashTable(variables);
+        variables = createHashTable();
+        if (shared_variables == NULL) {
+            printf("Shared variables segment cannot be created\n");
+            goto end;
+        }
+    } else if (parsed_args.should_watch_variables) {
+        reloader = createVariableReloader(parsed_args.variable_input_file, parsed_args.reload_policy, variables);
+        if (reloader == NULL) {
+            printf("Variable init file cannot be watched\n");
+            goto end;
+        }
+    } else if (variable_input_file != NULL) {
         parseVariableInputFile(variable_input_file, variables);
     }
+    if (parsed_args.shared_segment != NULL) {
+        shared_variables = attachShmTable(parsed_args.shared_segment);
+        if (shared_variables == NULL) {
+            printf("Shared variables segment doesn't exist or is invalid\n");
+            goto end;
+        }
+    }
+    hashSetSharedVariables(variables, shared_variables);
 
     /* Interact with user */
-    interact(variables, output_file);
+    setAllocationBudget(parsed_args.allocation_budget);
+    if (parsed_args.should_print_stats) {
+        enableStats();
+    }
+    if (trace_file != NULL) {
+        startTrace(trace_file);
+    }
+    interact(variables, reloader, output_file, parsed_args.input_format);
+    stopTrace();
+    if (parsed_args.should_print_stats) {
+        printStats(stderr, parsed_args.stats_format);
+    }
 
     return_value = EXIT_SUCCESS;
 
 end:
+    destroyVariableReloader(reloader);
     if (variables != NULL) {
         destroyHashTable(variables);
     }
+    detachShmTable(shared_variables);
     if (variable_input_file != NULL) {
         fclose(variable_input_file);
     }
     if (output_file != NULL) {
         fclose(output_file);
     }
+    if (trace_file != NULL) {
+        fclose(trace_file);
+    }
     return return_value;
 }
 
@@ -132,12 +258,80 @@ bool parseCommandLineArguments(int argc, char **argv, CommandLineArgs* parsed_ar
     /* Initialize to defaults */
     parsed_args->variable_input_file = NULL;
     parsed_args->output_file = NULL;
+    parsed_args->input_format = INPUT_LINES;
+    parsed_args->should_print_stats = false;
+    parsed_args->stats_format = STATS_TEXT;
+    parsed_args->allocation_budget = 0;
+    parsed_args->trace_file = NULL;
+    parsed_args->published_segment = NULL;
+    parsed_args->shared_segment = NULL;
+    parsed_args->should_watch_variables = false;
+    parsed_args->reload_policy = RELOAD_KEEP_SESSION;
 
     /* Parse args */
+    const struct option long_options[] = {
+        {"stats", optional_argument, NULL, STATS_OPTION},
+        {"alloc-budget", required_argument, NULL, ALLOCATION_BUDGET_OPTION},
+        {"trace", required_argument, NULL, TRACE_OPTION},
+        {"publish-variables", required_argument, NULL, PUBLISH_VARIABLES_OPTION},
+        {"shared-variables", required_argument, NULL, SHARED_VARIABLES_OPTION},
+        {"watch-variables", no_argument, NULL, WATCH_VARIABLES_OPTION},
+        {"reload-policy", required_argument, NULL, RELOAD_POLICY_OPTION},
+        {NULL, 0, NULL, 0}
+    };
     int c;
-    while ((c = getopt(argc, argv, "v:o:")) != -1)
+    while ((c = getopt_long(argc, argv, "v:o:bm", long_options, NULL)) != -1)
     {
         switch (c) {
+            case STATS_OPTION:
+                parsed_args->should_print_stats = true;
+                if (optarg != NULL && strcmp(optarg, "json") == 0) {
+                    parsed_args->stats_format = STATS_JSON;
+                } else if (optarg != NULL && strcmp(optarg, "text") != 0) {
+                    return true;
+                }
+                break;
+            case ALLOCATION_BUDGET_OPTION: {
+                char* end;
+                parsed_args->allocation_budget = strtoull(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || parsed_args->allocation_budget == 0) {
+                    return true;
+                }
+                break;
+            }
+            case TRACE_OPTION:
+                parsed_args->trace_file = optarg;
+                break;
+            case PUBLISH_VARIABLES_OPTION:
+            case SHARED_VARIABLES_OPTION:
+                if (parsed_args->published_segment != NULL || parsed_args->shared_segment != NULL) {
+                    return true;
+                }
+                if (c == PUBLISH_VARIABLES_OPTION) {
+                    parsed_args->published_segment = optarg;
+                } else {
+                    parsed_args->shared_segment = optarg;
+                }
+                break;
+            case WATCH_VARIABLES_OPTION:
+                parsed_args->should_watch_variables = true;
+                break;
+            case RELOAD_POLICY_OPTION:
+                if (strcmp(optarg, "session") == 0) {
+                    parsed_args->reload_policy = RELOAD_KEEP_SESSION;
+                } else if (strcmp(optarg, "file") == 0) {
+                    parsed_args->reload_policy = RELOAD_PREFER_FILE;
+                } else {
+                    return true;
+                }
+                break;
+            case 'b':
+            case 'm':
+                if (parsed_args->input_format != INPUT_LINES) {
+                    return true;
+                }
+                parsed_args->input_format = (c == 'b') ? INPUT_BINARY_TREES : INPUT_BATCHES;
+                break;
             case 'v':
                 parsed_args->variable_input_file =  optarg;
                 break;
@@ -161,13 +355,16 @@ bool parseCommandLineArguments(int argc, char **argv, CommandLineArgs* parsed_ar
  * @param
  * 		HashTable variables - initial variables to use for evaluating expressions.
  * 		                      Note: this table is updated by assignment expressions.
+ * 		VariableReloader reloader - Reloader of the variables file, whose changes are applied
+ * 		                            between lines (or NULL if the file isn't watched).
  * 		FILE* output_file - file which output will be printed into.
  * 		                    If NULL is passed, then stdout is used for output.
+ * 		InputFormat input_format - Framing of the expressions read from stdin.
  *
  * @preconditions
  *      - variables != NULL
  */
-void interact(HashTable variables, FILE* output_file)
+void interact(HashTable variables, VariableReloader reloader, FILE* output_file, InputFormat input_format)
 {
     bool should_print_expression = true;
     if (output_file == NULL) {
@@ -175,64 +372,390 @@ void interact(HashTable variables, FILE* output_file)
         should_print_expression = false;
     }
 
-    while (true)
+    PlanCache plan_cache = createPlanCache(PLAN_CACHE_MAX_BYTES);
+    FormulaEngine formulas = createFormulaEngine(variables);
+    TreeDecoder decoder = (input_format == INPUT_BINARY_TREES) ? createTreeDecoder() : NULL;
+    BatchReader batch_reader = (input_format == INPUT_BATCHES) ? createBatchReader(STDIN_FILENO) : NULL;
+
+    bool is_done = false;
+    while (!is_done)
     {
-        char lisp_expression[MAX_LINE_LENGTH + 1];
-        getLine(lisp_expression, sizeof(lisp_expression));
+        if (reloader != NULL) {
+            applyVariableReload(reloader, variables);
+        }
+        startLineAllocations();
+        traceNextLine();
 
-        Tree* parse_tree = parseLispExpression(lisp_expression);
+        /* Statistics requests are printed while waiting for the input, and between lines */
+        allowStatsRequests(true);
+        handleStatsRequest(stderr);
+        uint64_t read_start = startStageTimer();
+        if (input_format == INPUT_BINARY_TREES) {
+            /* Frames are decoded straight into trees (they have no text to key the cache by) */
+            Tree* tree = readTreeFrame(decoder, stdin);
+            allowStatsRequests(false);
+            stopStageTimer(STAGE_READ, read_start);
+            is_done = processTree(tree, variables, formulas, output_file, should_print_expression);
+        } else if (input_format == INPUT_BATCHES) {
+            /* Like at the end of the lines input, the end of the batches input is unexpected */
+            VERIFY(readBatch(batch_reader));
+            allowStatsRequests(false);
+            stopStageTimer(STAGE_READ, read_start);
+            is_done = processBatch(batch_reader, plan_cache, variables, formulas,
+                                   output_file, should_print_expression);
+        } else {
+            char lisp_expression[MAX_LINE_LENGTH + 1];
+            bool is_whole_line = getLine(lisp_expression, sizeof(lisp_expression));
+            uint64_t parse_start = stopStageTimer(STAGE_READ, read_start);
+            if (is_whole_line) {
+                allowStatsRequests(false);
+                CompiledLine* compiled = planCacheGet(plan_cache, lisp_expression, variables);
+                stopStageTimer(STAGE_PARSE, parse_start);
+                is_done = processLine(compiled, variables, formulas, output_file, should_print_expression);
+            } else {
+                /* The line is too long to be read as a whole (or cached), so it's parsed while it's read */
+                Tree* tree = parseLongLine(lisp_expression);
+                allowStatsRequests(false);
+                is_done = processTree(tree, variables, formulas, output_file, should_print_expression);
+            }
+        }
 
-        if (should_print_expression) {
-            char expression_string[MAX_LINE_LENGTH + 1];
-            expressionToString(parse_tree, expression_string, sizeof(expression_string));
-            fprintf(output_file, "%s\n", expression_string);
+        /* The output of each line (a batch writes it's own) is written before the next line is read */
+        if (input_format != INPUT_BATCHES) {
+            uint64_t write_start = startStageTimer();
+            VERIFY(fflush(output_file) == 0);
+            stopStageTimer(STAGE_WRITE, write_start);
         }
+        stopStartupTimer();
+    }
 
-        if (isEndCommand(parse_tree)) {
-            destroyTree(parse_tree);
-            fprintf(output_file, "Exiting...\n");
-            break;
+    destroyBatchReader(batch_reader);
+    destroyTreeDecoder(decoder);
+    destroyFormulaEngine(formulas);
+    destroyPlanCache(plan_cache);
+}
+
+/**
+ * Evaluate the expressions of a batch, and print all their results at once.
+ * The results are gathered in memory, and written to the output file by a single write.
+ *
+ * @param
+ * 		BatchReader reader - Reader of the batch.
+ * 		PlanCache plan_cache - Cache of compiled expressions.
+ * 		HashTable variables - variables to use for evaluation, and to update after assignment.
+ * 		FormulaEngine formulas - Formula engine of the variables.
+ * 		FILE* output_file - file which output will be printed into.
+ * 		bool should_print_expression - Whether the expression string is printed before it's result.
+ *
+ * @preconditions
+ *      - reader != NULL, plan_cache != NULL, variables != NULL, formulas != NULL, output_file != NULL
+ *
+ * @return
+ *      true iff the batch has an end command (the expressions after it are ignored).
+ */
+bool processBatch(BatchReader reader, PlanCache plan_cache, HashTable variables, FormulaEngine formulas,
+                  FILE* output_file, bool should_print_expression)
+{
+    char* results = NULL;
+    size_t results_length = 0;
+    FILE* results_file = open_memstream(&results, &results_length);
+    VERIFY(results_file != NULL);
+
+    bool is_end_command = false;
+    for (unsigned int i = 0; i < batchSize(reader) && !is_end_command; ++i)
+    {
+        size_t length;
+        const char* expression = batchExpression(reader, i, &length);
+        startLineAllocations();
+        if (i > 0) {
+            /* The first expression is attributed the line of the batch's read */
+            traceNextLine();
         }
+        is_end_command = processExpression(expression, length, plan_cache, variables, formulas,
+                                           results_file, should_print_expression);
+    }
 
-        double result = evaluateExpressionTree(parse_tree, variables);
-        if (isAssignmentExpression(parse_tree)) {
-            if (isnan((float)result)) {
-                fprintf(output_file, "Invalid Assignment\n");
-            } else {
-                char* var_name = getValue(firstChild(parse_tree));
-                fprintf(output_file, "%s = %.2f\n", var_name, result);
-            }
+    uint64_t write_start = startStageTimer();
+    VERIFY(fclose(results_file) == 0);
+    VERIFY(fflush(output_file) == 0);
+    writeBatchResults(fileno(output_file), results, results_length);
+    stopStageTimer(STAGE_WRITE, write_start);
+    free(results);
+    return is_end_command;
+}
+
+/**
+ * Evaluate a single input expression, which isn't null-terminated, and print it's result.
+ * Expressions which fit in a line are compiled through the cache, like lines are.
+ *
+ * @param
+ * 		const char* expression - Lisp expression.
+ * 		size_t length - Expression length.
+ * 		PlanCache plan_cache - Cache of compiled expressions.
+ * 		HashTable variables - variables to use for evaluation, and to update after assignment.
+ * 		FormulaEngine formulas - Formula engine of the variables.
+ * 		FILE* output_file - file which output will be printed into.
+ * 		bool should_print_expression - Whether the expression string is printed before it's result.
+ *
+ * @preconditions
+ *      - expression != NULL, plan_cache != NULL, variables != NULL, formulas != NULL, output_file != NULL
+ *
+ * @return
+ *      true iff the expression is an end command.
+ */
+bool processExpression(const char* expression, size_t length, PlanCache plan_cache, HashTable variables,
+                       FormulaEngine formulas, FILE* output_file, bool should_print_expression)
+{
+    if (length > MAX_LINE_LENGTH) {
+        uint64_t parse_start = startStageTimer();
+        LispParser parser = createLispParser();
+        feedLispParser(parser, expression, length);
+        Tree* tree = finishLispParser(parser);
+        stopStageTimer(STAGE_PARSE, parse_start);
+        return processTree(tree, variables, formulas, output_file, should_print_expression);
+    }
+
+    uint64_t parse_start = startStageTimer();
+    char lisp_expression[MAX_LINE_LENGTH + 1];
+    memcpy(lisp_expression, expression, length);
+    lisp_expression[length] = '\0';
+    CompiledLine* compiled = planCacheGet(plan_cache, lisp_expression, variables);
+    stopStageTimer(STAGE_PARSE, parse_start);
+    return processLine(compiled, variables, formulas, output_file, should_print_expression);
+}
+
+/**
+ * Compile a single input expression tree, which isn't cached, evaluate it, and print it's result.
+ *
+ * @param
+ * 		Tree* tree - Parse tree of the expression, or NULL if it was rejected by the parser.
+ * 		             The tree is destroyed.
+ * 		HashTable variables - variables to use for evaluation, and to update after assignment.
+ * 		FormulaEngine formulas - Formula engine of the variables.
+ * 		FILE* output_file - file which output will be printed into.
+ * 		bool should_print_expression - Whether the expression string is printed before it's result.
+ *
+ * @preconditions
+ *      - variables != NULL, formulas != NULL, output_file != NULL
+ *
+ * @return
+ *      true iff the expression is an end command.
+ */
+bool processTree(Tree* tree, HashTable variables, FormulaEngine formulas,
+                 FILE* output_file, bool should_print_expression)
+{
+    uint64_t parse_start = startStageTimer();
+    CompiledLine compiled;
+    compileTree(tree, variables, &compiled);
+    stopStageTimer(STAGE_PARSE, parse_start);
+    bool is_end_command = processLine(&compiled, variables, formulas, output_file, should_print_expression);
+    releaseCompiledLine(&compiled);
+    return is_end_command;
+}
+
+/**
+ * Evaluate a single compiled input line, and print it's result.
+ *
+ * @param
+ * 		CompiledLine* compiled - Compiled line to process.
+ * 		HashTable variables - variables to use for evaluation, and to update after assignment.
+ * 		FormulaEngine formulas - Formula engine of the variables.
+ * 		FILE* output_file - file which output will be printed into.
+ * 		bool should_print_expression - Whether the expression string is printed before it's result.
+ *
+ * @preconditions
+ *      - compiled != NULL, variables != NULL, formulas != NULL, output_file != NULL
+ *
+ * @return
+ *      true iff the line is an end command.
+ */
+bool processLine(CompiledLine* compiled, HashTable variables, FormulaEngine formulas,
+                 FILE* output_file, bool should_print_expression)
+{
+    if (compiled->is_end_command || compiled->is_invalid
+        || compiled->is_checkpoint_command || compiled->is_rollback_command) {
+        return processCommand(compiled, variables, output_file, should_print_expression);
+    }
+
+    /* Formulas read by the line are recomputed (if dirty) before it's evaluated */
+    uint64_t evaluate_start = startStageTimer();
+    refreshFormulas(formulas, compiled->variable_ids, compiled->variables_count);
+    double result;
+    if (compiled->is_binding) {
+        result = bindFormula(formulas, getValue(firstChild(compiled->tree)), lastChild(compiled->tree));
+    } else {
+        result = evaluateCompiledLine(compiled, variables);
+    }
+    uint64_t format_start = stopStageTimer(STAGE_EVALUATE, evaluate_start);
+
+    if (should_print_expression) {
+        fprintf(output_file, "%s\n", compiled->expression_string);
+    }
+    if (compiled->is_assignment || compiled->is_binding) {
+        if (isnan((float)result)) {
+            fprintf(output_file, "Invalid Assignment\n");
         } else {
-            if (isnan((float)result)) {
-                fprintf(output_file, "Invalid Result\n");
-            } else {
-                fprintf(output_file, "res = %.2f\n", result);
-            }
+            char* var_name = getValue(firstChild(compiled->tree));
+            fprintf(output_file, "%s = %.2f\n", var_name, result);
         }
+    } else {
+        if (isnan((float)result)) {
+            fprintf(output_file, "Invalid Result\n");
+        } else {
+            fprintf(output_file, "res = %.2f\n", result);
+        }
+    }
+    stopStageTimer(STAGE_FORMAT, format_start);
+    return false;
+}
+
+/**
+ * Process a line which isn't evaluated: a command, or a line which was rejected by the parser.
+ *
+ * @param
+ * 		CompiledLine* compiled - Compiled line to process.
+ * 		HashTable variables - variables to checkpoint and roll back.
+ * 		FILE* output_file - file which output will be printed into.
+ * 		bool should_print_expression - Whether the expression string is printed before it's result.
+ *
+ * @preconditions
+ *      - compiled != NULL, variables != NULL, output_file != NULL
+ *
+ * @return
+ *      true iff the line is an end command.
+ */
+bool processCommand(CompiledLine* compiled, HashTable variables, FILE* output_file, bool should_print_expression)
+{
+    if (should_print_expression) {
+        fprintf(output_file, "%s\n", compiled->expression_string);
+    }
 
-        destroyTree(parse_tree);
+    if (compiled->is_end_command) {
+        fprintf(output_file, "Exiting...\n");
+        return true;
+    }
+    if (compiled->is_invalid) {
+        fprintf(output_file, "Invalid Result\n");
+        return false;
+    }
+    if (compiled->is_checkpoint_command) {
+        fprintf(output_file, "Checkpoint %u\n", hashCheckpoint(variables));
+        return false;
+    }
+    if (compiled->is_rollback_command) {
+        double checkpoint = getNumber(firstChild(compiled->tree));
+        if (checkpoint <= UINT_MAX && hashRollback(variables, (unsigned int)checkpoint)) {
+            fprintf(output_file, "Rolled back to checkpoint %u\n", (unsigned int)checkpoint);
+        } else {
+            fprintf(output_file, "Invalid Checkpoint\n");
+        }
+        return false;
     }
+    return false;
 }
 
 /**
  * Receive a single input line from the user.
-
+ * If the line doesn't fit in the buffer, then only it's first chunk is read into the buffer
+ * (the rest of it is read by parseLongLine).
+ *
  * @param
  *      char* buffer      - Pre-allocated buffer to store line in.
  *      unsigned int size - Buffer size.
  *
  * @preconditions
  *      buffer != NULL
+ *
+ * @return
+ *      true iff the whole line was read (the new-line is removed).
  */
-void getLine(char* buffer, unsigned int size)
+bool getLine(char* buffer, unsigned int size)
 {
     VERIFY(buffer != NULL);
-    char* fgets_result = fgets(buffer, size, stdin);
-    VERIFY(0 == ferror(stdin));
-    VERIFY(fgets_result != NULL);
+    VERIFY(readInputChunk(buffer, size) != NULL);
 
     size_t last_char_index = strlen(buffer) - 1;
     if (buffer[last_char_index] == '\n') {
         buffer[last_char_index] = '\0';
+        return true;
+    }
+    return feof(stdin);
+}
+
+/**
+ * Read a chunk of an input line from the user, like fgets does: until the new-line (which is kept),
+ * or until the buffer is full.
+ * Unlike fgets, a read which is interrupted by a statistics request (see allowStatsRequests)
+ * keeps the characters which were already read, and is resumed after the statistics are printed.
+ *
+ * @param
+ *      char* buffer      - Pre-allocated buffer to store the chunk in.
+ *      unsigned int size - Buffer size.
+ *
+ * @preconditions
+ *      buffer != NULL, size > 1
+ *
+ * @return
+ *      The buffer, or NULL if the input ended before any character was read.
+ */
+char* readInputChunk(char* buffer, unsigned int size)
+{
+    VERIFY(buffer != NULL && size > 1);
+    unsigned int length = 0;
+    while (length < size - 1)
+    {
+        int character = getc_unlocked(stdin);
+        if (character == EOF) {
+            if (!ferror(stdin) || errno != EINTR) {
+                break;
+            }
+            clearerr(stdin);
+            handleStatsRequest(stderr);
+            continue;
+        }
+        buffer[length] = (char)character;
+        length += 1;
+        if (character == '\n') {
+            break;
+        }
+    }
+    VERIFY(0 == ferror(stdin));
+    buffer[length] = '\0';
+    return (length > 0) ? buffer : NULL;
+}
+
+/**
+ * Parse a long input line, while it's read from the user in chunks.
+ * Only a single chunk of the line is kept in memory at a time.
+ *
+ * @param
+ *      const char* first_chunk - The first chunk of the line, which was already read (see getLine).
+ *
+ * @preconditions
+ *      first_chunk != NULL
+ *
+ * @return
+ *      Parse tree, or NULL if the expression is nested too deep.
+ */
+Tree* parseLongLine(const char* first_chunk)
+{
+    VERIFY(first_chunk != NULL);
+    LispParser parser = createLispParser();
+    feedLispParser(parser, first_chunk, strlen(first_chunk));
+
+    bool is_line_end = false;
+    while (!is_line_end)
+    {
+        char chunk[LONG_LINE_CHUNK_SIZE];
+        if (readInputChunk(chunk, sizeof(chunk)) == NULL) {
+            /* The last line doesn't have to end with a new-line */
+            break;
+        }
+
+        size_t chunk_length = strlen(chunk);
+        is_line_end = (chunk[chunk_length - 1] == '\n');
+        feedLispParser(parser, chunk, chunk_length);
     }
+
+    return finishLispParser(parser);
 }
@@ -0,0 +1,264 @@
+/*
+ * Expression Optimization Module
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "optimize.h"
+#include "calculate.h"
+#include "alloc.h"
+#include "common.h"
+
+/*
+ * Constants
+ */
+
+/* Operations that have no side effects, and may be folded when all their operands are constant */
+const char* FOLDABLE_OPERATIONS[] = {"+", "-", "*", "/", "$", "min", "max", "average", "median"};
+
+/* Maximal length of an integer literal string (including the null-terminator) */
+#define MAX_LITERAL_LENGTH 32
+
+/*
+ * Internal Function Declarations
+ */
+
+void optimizeExpressionTree_(Tree* tree, HashTable variables);
+bool foldConstantExpression(Tree* tree, HashTable variables);
+bool applyIdentity(Tree* tree);
+bool isConstantExpression(Tree* tree);
+bool isLiteralEqual(Tree* tree, int value);
+bool isOperation(Tree* tree, const char* operation, unsigned int children_count);
+char* createLiteralString(double value);
+
+/*
+ * Module Functions
+ */
+
+unsigned int optimizeExpressionTree(Tree* tree, HashTable variables)
+{
+    VERIFY(tree != NULL);
+    VERIFY(variables != NULL);
+
+    unsigned int original_size = treeSize(tree);
+    optimizeExpressionTree_(tree, variables);
+    return original_size - treeSize(tree);
+}
+
+/*
+ * Internal Functions
+ */
+
+/**
+ * Sub-routine of optimizeExpressionTree.
+ * Optimize the nodes in post-order (the children sub-trees first, and then the node itself),
+ * without recursion, so trees of any depth are optimized.
+ *
+ * @param
+ *      Tree* tree - Expression sub-tree to optimize.
+ *      HashTable variables - variables table used for evaluating constant sub-trees.
+ *
+ * @preconditions
+ *      tree != NULL, variables != NULL
+ */
+void optimizeExpressionTree_(Tree* tree, HashTable variables)
+{
+    VERIFY(tree != NULL);
+
+    /* Optimizing a node modifies only it's own sub-tree, so the next node is found by it's links afterwards */
+    for (Tree* node = firstPostOrderNode(tree); node != NULL; node = nextPostOrderNode(tree, node))
+    {
+        /* An identity may expose another one (e.g. -(-(x*1))), so apply them until none matches */
+        if (!foldConstantExpression(node, variables)) {
+            while (applyIdentity(node));
+        }
+    }
+}
+
+/**
+ * Fold an operation whose operands are all constant into a single constant.
+ *
+ * @param
+ *      Tree* tree - Expression sub-tree to fold.
+ *      HashTable variables - variables table used for the evaluation.
+ *
+ * @preconditions
+ *      tree != NULL, variables != NULL
+ *
+ * @return
+ *      true iff the sub-tree was folded.
+ */
+bool foldConstantExpression(Tree* tree, HashTable variables)
+{
+    VERIFY(tree != NULL);
+
+    if (!hasChildren(tree) || isConstantExpression(tree)) {
+        /* Already as simple as it gets */
+        return false;
+    }
+    if (!IS_STRING_IN_ARRAY(getValue(tree), FOLDABLE_OPERATIONS)) {
+        return false;
+    }
+    for (Tree* child = firstChild(tree);
+         child != NULL;
+         child = nextBrother(child))
+    {
+        if (!isConstantExpression(child)) {
+            return false;
+        }
+    }
+
+    double value = evaluateExpressionTree(tree, variables);
+    char* literal = createLiteralString(value);
+    if (literal == NULL) {
+        return false;
+    }
+
+    destroyChildren(tree);
+    if (value < 0) {
+        setValue(tree, copyString("-"));
+        Tree* child = createTree(literal);
+        setNumber(child, (long long int)-value);
+        addChild(tree, child);
+    } else {
+        setValue(tree, literal);
+        setNumber(tree, (long long int)value);
+    }
+    return true;
+}
+
+/**
+ * Apply a single exact identity to the tree node, if one matches.
+ *
+ * @param
+ *      Tree* tree - Expression sub-tree to simplify.
+ *
+ * @preconditions
+ *      tree != NULL
+ *
+ * @return
+ *      true iff an identity was applied.
+ */
+bool applyIdentity(Tree* tree)
+{
+    VERIFY(tree != NULL);
+
+    if (isOperation(tree, "*", 2)) {
+        if (isLiteralEqual(lastChild(tree), 1)) {
+            replaceWithChild(tree, firstChild(tree));
+            return true;
+        }
+        if (isLiteralEqual(firstChild(tree), 1)) {
+            replaceWithChild(tree, lastChild(tree));
+            return true;
+        }
+    } else if (isOperation(tree, "/", 2) || isOperation(tree, "-", 2)) {
+        int neutral = (strcmp(getValue(tree), "/") == 0) ? 1 : 0;
+        if (isLiteralEqual(lastChild(tree), neutral)) {
+            replaceWithChild(tree, firstChild(tree));
+            return true;
+        }
+    } else if (isOperation(tree, "+", 1)) {
+        replaceWithChild(tree, firstChild(tree));
+        return true;
+    } else if (isOperation(tree, "-", 1) && isOperation(firstChild(tree), "-", 1)) {
+        Tree* negation = firstChild(tree);
+        replaceWithChild(tree, negation);
+        replaceWithChild(tree, firstChild(tree));
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Check if the given sub-tree is a constant: a number literal, or an unary minus of one.
+ *
+ * @param
+ *      Tree* tree - Expression sub-tree to examine.
+ *
+ * @preconditions
+ *      tree != NULL
+ *
+ * @return
+ *      true iff the sub-tree is a constant.
+ */
+bool isConstantExpression(Tree* tree)
+{
+    VERIFY(tree != NULL);
+    if (isOperation(tree, "-", 1)) {
+        tree = firstChild(tree);
+    }
+    return (!hasChildren(tree) && hasNumber(tree));
+}
+
+/**
+ * Check if the given sub-tree is a number literal with the given value.
+ *
+ * @param
+ *      Tree* tree - Expression sub-tree to examine.
+ *      int value - Value to compare to.
+ *
+ * @preconditions
+ *      tree != NULL
+ *
+ * @return
+ *      true iff the sub-tree is a literal equal to value.
+ */
+bool isLiteralEqual(Tree* tree, int value)
+{
+    VERIFY(tree != NULL);
+    return (   !hasChildren(tree)
+            && hasNumber(tree)
+            && getNumber(tree) == value);
+}
+
+/**
+ * Check if the given sub-tree is an operation with the given amount of operands.
+ *
+ * @param
+ *      Tree* tree - Expression sub-tree to examine.
+ *      const char* operation - Operation string.
+ *      unsigned int children_count - Amount of operands.
+ *
+ * @preconditions
+ *      tree != NULL, operation != NULL
+ *
+ * @return
+ *      true iff the sub-tree is the given operation.
+ */
+bool isOperation(Tree* tree, const char* operation, unsigned int children_count)
+{
+    VERIFY(tree != NULL);
+    return (   childrenCount(tree) == children_count
+            && strcmp(getValue(tree), operation) == 0);
+}
+
+/**
+ * Create the literal string of the absolute value of a folded result.
+ *
+ * @param
+ *      double value - Folded value.
+ *
+ * @return
+ *      A new string (which has to be released by deallocate),
+ *      or NULL if the value can't be represented by a constant expression
+ *      (i.e. it's NAN, -0, not an integer, or out of the range of literals).
+ */
+char* createLiteralString(double value)
+{
+    if (   isnan(value)
+        || value != trunc(value)
+        || fabs(value) > INT_MAX
+        || (value == 0 && signbit(value))) {
+        return NULL;
+    }
+
+    char* literal = ALLOCATE(ALLOC_TREES, MAX_LITERAL_LENGTH);
+    VERIFY(literal != NULL);
+    snprintf(literal, MAX_LITERAL_LENGTH, "%.0f", fabs(value));
+    return literal;
+}
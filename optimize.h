@@ -0,0 +1,43 @@
+/*
+ * Expression Optimization Module
+ */
+
+#ifndef OPTIMIZE_H_
+#define OPTIMIZE_H_
+
+#include "tree.h"
+#include "hashtable.h"
+
+/*
+ * Functions
+ */
+
+/**
+ * Simplify an expression tree in place, before it's evaluated.
+ * Sub-trees whose operands are all constants are folded into a single constant
+ * (an integer literal, or an unary minus of an integer literal),
+ * and the following identities are applied: x*1, 1*x, x/1, x-0, +x, -(-x) => x.
+ *
+ * The simplified tree evaluates to exactly the same result as the original one
+ * (including NAN results, and the sign of zero results), so sub-trees that evaluate
+ * to NAN or to a value which isn't representable as a constant are not folded,
+ * and x+0 is not simplified (since -0+0 is 0).
+ * Assignments are never folded or removed.
+ *
+ * Note: the tree should be converted to a string before it's optimized.
+ *
+ * @param
+ *      Tree* tree - Expression tree to optimize.
+ *      HashTable variables - variables table used for evaluating constant sub-trees
+ *                            (constant sub-trees don't access it).
+ *
+ * @preconditions
+ *      - tree != NULL, variables != NULL
+ *      - tree is a valid arithmetic expression tree.
+ *
+ * @return
+ *      Amount of tree nodes that were removed.
+ */
+unsigned int optimizeExpressionTree(Tree* tree, HashTable variables);
+
+#endif /* OPTIMIZE_H_ */
@@ -7,7 +7,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <stdint.h>
 #include "parse.h"
+#include "scan.h"
+#include "stats.h"
+#include "alloc.h"
 #include "common.h"
 
 /*
@@ -20,21 +24,72 @@ const char* DELIMITERS = " \t";
 /* String representing an end command. */
 #define END_COMMAND "<>"
 
+/* Strings representing the checkpoint and rollback commands. */
+#define CHECKPOINT_COMMAND "<checkpoint>"
+#define ROLLBACK_COMMAND "<rollback>"
+
+/* String representing a formula binding operator. */
+#define BINDING_OPERATOR ":="
+
+/* Size of the blocks in which the parser indexes it's input (a multiple of SCAN_WORD_BITS) */
+#define PARSE_BLOCK_SIZE 4096
+
 /* Array of all possible operator strings. */
-const char* OPERATORS[] = {"+", "-", "*", "/", "$", "="};
+const char* OPERATORS[] = {"+", "-", "*", "/", "$", "=", BINDING_OPERATOR};
+
+/*
+ * Types
+ */
+
+/* Part of an operation expression string, relative to the strings of it's operands */
+typedef enum ExpressionPart_
+{
+    EXPRESSION_PART_BEFORE,     /* Before the first operand */
+    EXPRESSION_PART_BETWEEN,    /* Between two consecutive operands */
+    EXPRESSION_PART_AFTER,      /* After the last operand */
+} ExpressionPart;
+
+/* Incremental Lisp expression parser.
+   The open nodes are kept in the tree that is being built (the innermost one is node),
+   and the token that is being read is accumulated across chunks. */
+struct LispParser_t
+{
+    Tree* tree;                 /* Root of the parsed tree, or NULL before the first node */
+    Tree* node;                 /* Innermost open node */
+    unsigned int depth;         /* Amount of open nodes */
+    bool is_in_token;           /* A node was opened, and it's token is being read */
+    char* token;
+    size_t token_length;
+    size_t token_capacity;
+    bool is_done;               /* The root was closed */
+    bool is_line_end;           /* The new-line after the expression was read */
+    bool is_rejected;           /* The expression is nested too deep (the rest of the input is ignored) */
+};
+
+/*
+ * Globals
+ */
+
+/* Maximal nesting depth of parsed expressions */
+unsigned int maxExpressionDepth = DEFAULT_MAX_EXPRESSION_DEPTH;
 
 /*
  * Internal Function Declarations
  */
 
-Tree* parseLispExpression_(const char** sub_string_pointer);
+void feedLispBlock(LispParser parser, const char* block, size_t length);
+void parseStructuralCharacter(LispParser parser, char structural);
+void appendToToken(LispParser parser, const char* segment, size_t length);
+void openExpressionNode(LispParser parser, const char* segment, size_t length);
+bool isNameSegment(const char* segment, size_t length);
 void printLisp_(Tree* tree);
 
 void expressionToString_(Tree* tree, char** buffer_pointer, char* buffer_end);
 void terminalExpressionToString(Tree* tree, char** buffer_pointer, char* buffer_end);
-void unaryOperatorExpressionToString(Tree* tree, char** buffer_pointer, char* buffer_end);
-void binaryOperatorExpressionToString(Tree* tree, char** buffer_pointer, char* buffer_end);
-void functionExpressionToString(Tree* tree, char** buffer_pointer, char* buffer_end);
+void operationExpressionToString(Tree* tree, ExpressionPart part, char** buffer_pointer, char* buffer_end);
+void unaryOperatorExpressionToString(Tree* tree, ExpressionPart part, char** buffer_pointer, char* buffer_end);
+void binaryOperatorExpressionToString(Tree* tree, ExpressionPart part, char** buffer_pointer, char* buffer_end);
+void functionExpressionToString(Tree* tree, ExpressionPart part, char** buffer_pointer, char* buffer_end);
 void appendToBuffer(char* appendage, char** buffer_pointer, char* buffer_end);
 
 /*
@@ -44,13 +99,67 @@ void appendToBuffer(char* appendage, char** buffer_pointer, char* buffer_end);
 Tree* parseLispExpression(const char* string)
 {
     VERIFY(string != NULL);
-    Tree* tree = parseLispExpression_(&string);
-    /* Check that the entire string was processed,
-     * i.e. the parsing ended successfully at the null-terminator */
-    VERIFY(*string == '\0');
+    LispParser parser = createLispParser();
+    feedLispParser(parser, string, strlen(string));
+    return finishLispParser(parser);
+}
+
+LispParser createLispParser()
+{
+    LispParser parser = ALLOCATE_ZEROED(ALLOC_PARSING, 1, sizeof(*parser));
+    VERIFY(parser != NULL);
+    return parser;
+}
+
+void feedLispParser(LispParser parser, const char* chunk, size_t length)
+{
+    VERIFY(parser != NULL);
+    VERIFY(chunk != NULL);
+
+    for (size_t offset = 0; offset < length && !parser->is_rejected; offset += PARSE_BLOCK_SIZE)
+    {
+        size_t block_length = (length - offset < PARSE_BLOCK_SIZE) ? length - offset : PARSE_BLOCK_SIZE;
+        feedLispBlock(parser, chunk + offset, block_length);
+    }
+}
+
+Tree* finishLispParser(LispParser parser)
+{
+    VERIFY(parser != NULL);
+    VERIFY(parser->is_done || parser->is_rejected);
+
+    Tree* tree = parser->tree;
+    deallocate(parser->token);
+    deallocate(parser);
     return tree;
 }
 
+void setMaxExpressionDepth(unsigned int max_depth)
+{
+    VERIFY(max_depth > 0);
+    maxExpressionDepth = max_depth;
+}
+
+unsigned int getMaxExpressionDepth()
+{
+    return maxExpressionDepth;
+}
+
+void parseNumberLiteral(Tree* tree)
+{
+    VERIFY(tree != NULL);
+    char* literal = getValue(tree);
+    if (!hasChildren(tree) && isNumber(literal)) {
+        errno = 0;
+        long long int number = strtoll(literal, NULL, 10);
+        if (errno == ERANGE) {
+            setOutOfRangeNumber(tree);
+        } else {
+            setNumber(tree, number);
+        }
+    }
+}
+
 void printLisp(Tree* tree)
 {
     VERIFY(tree != NULL);
@@ -64,12 +173,32 @@ bool isAssignmentExpression(Tree* tree)
     return (strcmp(getValue(tree), "=") == 0);
 }
 
+bool isBindingExpression(Tree* tree)
+{
+    VERIFY(tree != NULL);
+    return (strcmp(getValue(tree), BINDING_OPERATOR) == 0);
+}
+
 bool isEndCommand(Tree* tree)
 {
     VERIFY(tree != NULL);
     return (!hasChildren(tree) && strcmp(getValue(tree), END_COMMAND) == 0);
 }
 
+bool isCheckpointCommand(Tree* tree)
+{
+    VERIFY(tree != NULL);
+    return (!hasChildren(tree) && strcmp(getValue(tree), CHECKPOINT_COMMAND) == 0);
+}
+
+bool isRollbackCommand(Tree* tree)
+{
+    VERIFY(tree != NULL);
+    return (childrenCount(tree) == 1
+            && hasNumber(firstChild(tree))
+            && strcmp(getValue(tree), ROLLBACK_COMMAND) == 0);
+}
+
 void expressionToString(Tree* tree, char* buffer, unsigned int buffer_size)
 {
     VERIFY(tree != NULL);
@@ -78,6 +207,30 @@ void expressionToString(Tree* tree, char* buffer, unsigned int buffer_size)
     expressionToString_(tree, &buffer, buffer + buffer_size);
 }
 
+size_t expressionStringSize(Tree* tree)
+{
+    VERIFY(tree != NULL);
+
+    /* Each node takes at most it's value and 5 more chars ("(" value "(" before it's operands,
+     * "," after one of them, and "))" after them), and a terminal root takes "()" */
+    size_t size = 3;
+    Tree* node = tree;
+    while (node != NULL)
+    {
+        size += strlen(getValue(node)) + 5;
+        if (hasChildren(node)) {
+            node = firstChild(node);
+            continue;
+        }
+        while (node != tree && nextBrother(node) == NULL)
+        {
+            node = getParent(node);
+        }
+        node = (node == tree) ? NULL : nextBrother(node);
+    }
+    return size;
+}
+
 void parseVariableInputFile(FILE* input_file, HashTable table)
 {
     VERIFY(input_file != NULL);
@@ -140,60 +293,170 @@ void parseVariableAssignmentLine(char* line, HashTable table)
  */
 
 /**
- * Sub-routine of parseLispExpression.
- * This function gets a sub-string pointer by reference,
- * and updates it as it parses the sub-string.
+ * Parse a block of the input.
+ * The structural characters of the block are indexed first (see scanStructure),
+ * and then the parser jumps between them: the bytes between them are tokens,
+ * which are copied as a whole.
  *
  * @param
- * 		const char** sub_string_pointer - Sub-string to parse.
- *                                        This value is updated as the parsing is performed.
+ * 		LispParser parser - Parser to use.
+ * 		const char* block - Block of the input.
+ * 		size_t length - Block length (at most PARSE_BLOCK_SIZE).
+ */
+void feedLispBlock(LispParser parser, const char* block, size_t length)
+{
+    uint64_t bitmap[PARSE_BLOCK_SIZE / SCAN_WORD_BITS];
+    scanStructure(block, length, bitmap);
+
+    const char* c = block;  /* The first byte which wasn't consumed */
+    for (size_t i = 0; i < (length + SCAN_WORD_BITS - 1) / SCAN_WORD_BITS; ++i)
+    {
+        for (uint64_t word = bitmap[i]; word != 0; word &= word - 1)
+        {
+            const char* structural = block + i * SCAN_WORD_BITS + __builtin_ctzll(word);
+            if (parser->is_in_token) {
+                /* Tokens end at the next parenthesis */
+                if (*structural == '\n') {
+                    continue;
+                }
+                openExpressionNode(parser, c, structural - c);
+                parser->is_in_token = false;
+            } else {
+                /* Only structural characters may appear outside of tokens */
+                VERIFY(structural == c);
+            }
+
+            parseStructuralCharacter(parser, *structural);
+            if (parser->is_rejected) {
+                return;
+            }
+            c = structural + 1;
+        }
+    }
+
+    /* The rest of the block is the beginning of a token, which may end in a following block */
+    if (parser->is_in_token) {
+        appendToToken(parser, c, block + length - c);
+    } else {
+        VERIFY(c == block + length);
+    }
+}
+
+/**
+ * Parse a single structural character which is outside of tokens.
  *
- * @preconditions
- *      sub_string_pointer != NULL && *sub_string_pointer != NULL
+ * @param
+ * 		LispParser parser - Parser to update.
+ * 		char structural - Structural character to parse.
+ */
+void parseStructuralCharacter(LispParser parser, char structural)
+{
+    if (parser->is_done) {
+        /* Only the line's new-line may follow the expression */
+        VERIFY(structural == '\n' && !parser->is_line_end);
+        parser->is_line_end = true;
+    } else if (structural == '(') {
+        parser->depth += 1;
+        if (parser->depth > maxExpressionDepth) {
+            destroyTree(parser->tree);
+            parser->tree = NULL;
+            parser->is_rejected = true;
+            return;
+        }
+        parser->is_in_token = true;
+        parser->token_length = 0;
+    } else {
+        VERIFY(structural == ')' && parser->node != NULL);
+        parseNumberLiteral(parser->node);
+        parser->node = getParent(parser->node);
+        parser->depth -= 1;
+        parser->is_done = (parser->depth == 0);
+    }
+}
+
+/**
+ * Append a segment of the input to the token that is being read by a parser.
  *
- * @post-conditions
- *      sub_string_pointer points to the end of the parsed sub-string,
- *      i.e. after the closing ')' that matches the first opening '('.
+ * @param
+ * 		LispParser parser - Parser to update.
+ * 		const char* segment - Segment of the input.
+ * 		size_t length - Segment length.
+ */
+void appendToToken(LispParser parser, const char* segment, size_t length)
+{
+    if (parser->token_length + length + 1 > parser->token_capacity) {
+        size_t capacity = 2 * (parser->token_length + length + 1);
+        char* token = REALLOCATE(ALLOC_PARSING, parser->token, capacity);
+        VERIFY(token != NULL);
+        parser->token = token;
+        parser->token_capacity = capacity;
+    }
+    memcpy(parser->token + parser->token_length, segment, length);
+    parser->token_length += length;
+}
+
+/**
+ * Create a tree node from the token that was read by a parser (the root of the opened expression),
+ * and make it the innermost open node.
  *
- * @return
- *		Parse tree.
+ * @param
+ * 		LispParser parser - Parser to update.
+ * 		const char* segment - The last segment of the token.
+ * 		size_t length - Segment length.
  */
-Tree* parseLispExpression_(const char** sub_string_pointer)
-{
-    VERIFY(sub_string_pointer != NULL && *sub_string_pointer != NULL);
-
-    const char* c = *sub_string_pointer;
-    VERIFY(*c == '(');
-    c += 1;
-
-    const char* expression_root_start = c;
-    /* Search for first parenthesis */
-    c =  strpbrk(c, "()");
-    VERIFY(c != NULL);
-
-    /* Copy the expression root to a new buffer, and create a tree node with it. */
-    unsigned int expression_root_length = c - expression_root_start;
-    char* expression_root = malloc(expression_root_length + 1);
-    VERIFY(expression_root != NULL);
-    memcpy(expression_root, expression_root_start, expression_root_length);
-    expression_root[expression_root_length] = '\0';
-    Tree* tree = createTree(expression_root);
-
-    while (*c == '(') {
-        *sub_string_pointer = c;
-        Tree* child = parseLispExpression_(sub_string_pointer);
-        addChild(tree, child);
-        c = *sub_string_pointer;
+void openExpressionNode(LispParser parser, const char* segment, size_t length)
+{
+    /* Tokens that are split between blocks are accumulated, the rest are copied directly */
+    if (parser->token_length > 0) {
+        appendToToken(parser, segment, length);
+        segment = parser->token;
+        length = parser->token_length;
+    }
+    Tree* node;
+    if (isNameSegment(segment, length)) {
+        /* Names are interned rather than copied */
+        node = createNameTree(internName(segment, length));
+    } else {
+        char* expression_root = ALLOCATE(ALLOC_TREES, length + 1);
+        VERIFY(expression_root != NULL);
+        memcpy(expression_root, segment, length);
+        expression_root[length] = '\0';
+        node = createTree(expression_root);
     }
+    COUNT_STAT(COUNTER_NODES_PARSED);
 
-    VERIFY(*c == ')');
-    *sub_string_pointer = c + 1;
+    if (parser->node == NULL) {
+        parser->tree = node;
+    } else {
+        addChild(parser->node, node);
+    }
+    parser->node = node;
+}
 
-    return tree;
+/**
+ * Check if a token is a (non-empty) name, like isName.
+ *
+ * @param
+ * 		const char* segment - The token (which isn't null-terminated).
+ * 		size_t length - Token length.
+ *
+ * @return
+ *		true iff the token is made of letters only, and isn't empty.
+ */
+bool isNameSegment(const char* segment, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (!isLetter(segment[i])) {
+            return false;
+        }
+    }
+    return (length > 0);
 }
 
 /**
  * Print the given tree as a lisp expression of the same form as in parseLispExpression.
+ * The tree is walked iteratively, by the parent and brother links of the nodes.
  *
  * @param
  * 		Tree* tree - Tree to print.
@@ -204,20 +467,36 @@ Tree* parseLispExpression_(const char** sub_string_pointer)
 void printLisp_(Tree* tree)
 {
     VERIFY(tree != NULL);
-    printf("(%s", getValue(tree));
-    for (Tree* child = firstChild(tree);
-         child != NULL;
-         child = nextBrother(child))
+
+    Tree* node = tree;
+    while (true)
     {
-        printLisp_(child);
+        printf("(%s", getValue(node));
+        if (hasChildren(node)) {
+            node = firstChild(node);
+            continue;
+        }
+
+        /* Close the node, and the ancestors whose children are done */
+        printf(")");
+        while (node != tree && nextBrother(node) == NULL)
+        {
+            node = getParent(node);
+            printf(")");
+        }
+        if (node == tree) {
+            return;
+        }
+        node = nextBrother(node);
     }
-    printf(")");
 }
 
 /**
  * Sub-routine of expressionToString.
  * This function gets the buffer pointer by reference,
  * and advances it as it generates the resulting string.
+ * The tree is walked iteratively, by the parent and brother links of the nodes:
+ * the string of each operation is written in parts, around the strings of it's operands.
  *
  * @param
  *      Tree* tree - Expression tree to convert.
@@ -235,25 +514,27 @@ void expressionToString_(Tree* tree, char** buffer_pointer, char* buffer_end)
     VERIFY(tree != NULL);
     VERIFY(buffer_pointer != NULL && *buffer_pointer != NULL);
 
-    unsigned int children_count = childrenCount(tree);
-    if (children_count == 0) {
-        terminalExpressionToString(tree, buffer_pointer, buffer_end);
-        return;
-    }
-
-    char* operation = getValue(tree);
+    Tree* node = tree;
+    while (true)
+    {
+        if (hasChildren(node)) {
+            operationExpressionToString(node, EXPRESSION_PART_BEFORE, buffer_pointer, buffer_end);
+            node = firstChild(node);
+            continue;
+        }
+        terminalExpressionToString(node, buffer_pointer, buffer_end);
 
-    if (IS_STRING_IN_ARRAY(operation, OPERATORS)) {
-        if (children_count == 1) {
-            unaryOperatorExpressionToString(tree, buffer_pointer, buffer_end);
-        } else if (children_count == 2) {
-            binaryOperatorExpressionToString(tree, buffer_pointer, buffer_end);
-        } else {
-            panic();
+        /* Close the operations whose operands are done */
+        while (node != tree && nextBrother(node) == NULL)
+        {
+            node = getParent(node);
+            operationExpressionToString(node, EXPRESSION_PART_AFTER, buffer_pointer, buffer_end);
         }
-    } else {
-        /* Assume it's a function */
-        functionExpressionToString(tree, buffer_pointer, buffer_end);
+        if (node == tree) {
+            return;
+        }
+        operationExpressionToString(getParent(node), EXPRESSION_PART_BETWEEN, buffer_pointer, buffer_end);
+        node = nextBrother(node);
     }
 }
 
@@ -291,10 +572,48 @@ void terminalExpressionToString(Tree* tree, char** buffer_pointer, char* buffer_
 
 /**
  * Sub-routine of expressionToString_,
+ * operates on expression trees representing operations (writes a single part of their string).
+ *
+ * @param
+ *      Tree* tree - Expression tree to convert.
+ *      ExpressionPart part - The part of the string to write.
+ *      char** buffer_pointer - pointer to buffer given by reference.
+ *      char* buffer_end - pointer to the end of the buffer.
+ *
+ * @preconditions
+ *      - tree != NULL, buffer_pointer != NULL, *buffer_pointer != NULL, buffer_end != NULL
+ *      - The buffer has to be large enough for the resulting string.
+ *      - hasChildren(tree)
+ */
+void operationExpressionToString(Tree* tree, ExpressionPart part, char** buffer_pointer, char* buffer_end)
+{
+    VERIFY(tree != NULL);
+    VERIFY(hasChildren(tree));
+
+    unsigned int children_count = childrenCount(tree);
+    char* operation = getValue(tree);
+
+    if (IS_STRING_IN_ARRAY(operation, OPERATORS)) {
+        if (children_count == 1) {
+            unaryOperatorExpressionToString(tree, part, buffer_pointer, buffer_end);
+        } else if (children_count == 2) {
+            binaryOperatorExpressionToString(tree, part, buffer_pointer, buffer_end);
+        } else {
+            panic();
+        }
+    } else {
+        /* Assume it's a function */
+        functionExpressionToString(tree, part, buffer_pointer, buffer_end);
+    }
+}
+
+/**
+ * Sub-routine of operationExpressionToString,
  * operates on expression trees representing unary operator operations.
  *
  * @param
  *      Tree* tree - Expression tree to convert.
+ *      ExpressionPart part - The part of the string to write.
  *      char** buffer_pointer - pointer to buffer given by reference.
  *      char* buffer_end - pointer to the end of the buffer.
  *
@@ -303,25 +622,33 @@ void terminalExpressionToString(Tree* tree, char** buffer_pointer, char* buffer_
  *      - The buffer has to be large enough for the resulting string.
  *      - childrenCount(tree) == 1
  */
-void unaryOperatorExpressionToString(Tree* tree, char** buffer_pointer, char* buffer_end)
+void unaryOperatorExpressionToString(Tree* tree, ExpressionPart part, char** buffer_pointer, char* buffer_end)
 {
     VERIFY(tree != NULL);
     VERIFY(buffer_pointer != NULL);
     VERIFY(childrenCount(tree) == 1);
 
-    appendToBuffer("(", buffer_pointer, buffer_end);
-    char* operator = getValue(tree);
-    appendToBuffer(operator, buffer_pointer, buffer_end);
-    expressionToString_(firstChild(tree), buffer_pointer, buffer_end);
-    appendToBuffer(")", buffer_pointer, buffer_end);
+    switch (part)
+    {
+        case EXPRESSION_PART_BEFORE:
+            appendToBuffer("(", buffer_pointer, buffer_end);
+            appendToBuffer(getValue(tree), buffer_pointer, buffer_end);
+            break;
+        case EXPRESSION_PART_AFTER:
+            appendToBuffer(")", buffer_pointer, buffer_end);
+            break;
+        default:
+            panic();
+    }
 }
 
 /**
- * Sub-routine of expressionToString_,
+ * Sub-routine of operationExpressionToString,
  * operates on expression trees representing binary operator operations.
  *
  * @param
  *      Tree* tree - Expression tree to convert.
+ *      ExpressionPart part - The part of the string to write.
  *      char** buffer_pointer - pointer to buffer given by reference.
  *      char* buffer_end - pointer to the end of the buffer.
  *
@@ -330,26 +657,35 @@ void unaryOperatorExpressionToString(Tree* tree, char** buffer_pointer, char* bu
  *      - The buffer has to be large enough for the resulting string.
  *      - childrenCount(tree) == 2.
  */
-void binaryOperatorExpressionToString(Tree* tree, char** buffer_pointer, char* buffer_end)
+void binaryOperatorExpressionToString(Tree* tree, ExpressionPart part, char** buffer_pointer, char* buffer_end)
 {
     VERIFY(tree != NULL);
     VERIFY(buffer_pointer != NULL);
     VERIFY(childrenCount(tree) == 2);
 
-    appendToBuffer("(", buffer_pointer, buffer_end);
-    expressionToString_(firstChild(tree), buffer_pointer, buffer_end);
-    char* operator = getValue(tree);
-    appendToBuffer(operator, buffer_pointer, buffer_end);
-    expressionToString_(lastChild(tree), buffer_pointer, buffer_end);
-    appendToBuffer(")", buffer_pointer, buffer_end);
+    switch (part)
+    {
+        case EXPRESSION_PART_BEFORE:
+            appendToBuffer("(", buffer_pointer, buffer_end);
+            break;
+        case EXPRESSION_PART_BETWEEN:
+            appendToBuffer(getValue(tree), buffer_pointer, buffer_end);
+            break;
+        case EXPRESSION_PART_AFTER:
+            appendToBuffer(")", buffer_pointer, buffer_end);
+            break;
+        default:
+            panic();
+    }
 }
 
 /**
- * Sub-routine of expressionToString_,
+ * Sub-routine of operationExpressionToString,
  * operates on expression trees representing general function operations.
  *
  * @param
  *      Tree* tree - Expression tree to convert.
+ *      ExpressionPart part - The part of the string to write.
  *      char** buffer_pointer - pointer to buffer given by reference.
  *      char* buffer_end - pointer to the end of the buffer.
  *
@@ -358,28 +694,28 @@ void binaryOperatorExpressionToString(Tree* tree, char** buffer_pointer, char* b
  *      - The buffer has to be large enough for the resulting string.
  *      - childrenCount(tree) >= 1.
  */
-void functionExpressionToString(Tree* tree, char** buffer_pointer, char* buffer_end)
+void functionExpressionToString(Tree* tree, ExpressionPart part, char** buffer_pointer, char* buffer_end)
 {
     VERIFY(tree != NULL);
     VERIFY(buffer_pointer != NULL);
     VERIFY(childrenCount(tree) >= 1);
 
-    appendToBuffer("(", buffer_pointer, buffer_end);
-
-    char* function = getValue(tree);
-    appendToBuffer(function, buffer_pointer, buffer_end);
-
-    appendToBuffer("(", buffer_pointer, buffer_end);
-
-    Tree* child = firstChild(tree);
-    expressionToString_(child, buffer_pointer, buffer_end);
-    for (child = nextBrother(child); child != NULL; child = nextBrother(child))
+    switch (part)
     {
-        appendToBuffer(",", buffer_pointer, buffer_end);
-        expressionToString_(child, buffer_pointer, buffer_end);
+        case EXPRESSION_PART_BEFORE:
+            appendToBuffer("(", buffer_pointer, buffer_end);
+            appendToBuffer(getValue(tree), buffer_pointer, buffer_end);
+            appendToBuffer("(", buffer_pointer, buffer_end);
+            break;
+        case EXPRESSION_PART_BETWEEN:
+            appendToBuffer(",", buffer_pointer, buffer_end);
+            break;
+        case EXPRESSION_PART_AFTER:
+            appendToBuffer("))", buffer_pointer, buffer_end);
+            break;
+        default:
+            panic();
     }
-
-    appendToBuffer("))", buffer_pointer, buffer_end);
 }
 
 /**
@@ -5,6 +5,7 @@
 #ifndef PARSE_H_
 #define PARSE_H_
 
+#include <stdio.h>
 #include "tree.h"
 #include "hashtable.h"
 
@@ -14,6 +15,16 @@
 
 #define MAX_LINE_LENGTH 1024
 
+/* Default maximal nesting depth of parsed expressions (see setMaxExpressionDepth) */
+#define DEFAULT_MAX_EXPRESSION_DEPTH 10000
+
+/*
+ * Types
+ */
+
+/* Incremental parser of a single Lisp expression, which is given it's input in chunks */
+typedef struct LispParser_t* LispParser;
+
 /*
  * Functions
  */
@@ -22,6 +33,10 @@
  * Parse a Lisp expression of the form: (str<Child_1><Child2>...<Child_n>)
  * where <Child_x> are sub-expressions,
  * and return a parse tree.
+ * Number literals are parsed once, and their value is attached to their tree node (see getNumber).
+ * Literals that overflow 64 bit integers are rejected: their number is NAN,
+ * so any expression that uses them is invalid.
+ * Expressions nested deeper than the maximal expression depth are rejected.
  * The created tree has to be destroyed by destroyTree.
  *
  * @param
@@ -31,10 +46,89 @@
  *      string != NULL
  *
  * @return
- *		Parse tree.
+ *		Parse tree, or NULL if the expression is nested too deep.
  */
 Tree* parseLispExpression(const char* string);
 
+/**
+ * Create an incremental parser of a Lisp expression (of the same form as in parseLispExpression),
+ * for expressions which are read in chunks, and aren't kept in memory as a whole.
+ * The parser keeps it's state between chunks, so the input is parsed in a single pass,
+ * using memory proportional to the tree (and the longest token).
+ * The created parser has to be finished by finishLispParser.
+ *
+ * @return
+ *      The created parser.
+ */
+LispParser createLispParser();
+
+/**
+ * Parse the next chunk of the input.
+ * The expression may be followed by a single new-line (the end of it's input line).
+ * After an expression is rejected for being nested too deep, the rest of it's input is ignored.
+ *
+ * @param
+ *      LispParser parser - Parser to use.
+ *      const char* chunk - Next chunk of the input (not necessarily null-terminated).
+ *      size_t length - Chunk length.
+ *
+ * @preconditions
+ *      parser != NULL, chunk != NULL
+ */
+void feedLispParser(LispParser parser, const char* chunk, size_t length);
+
+/**
+ * Finish parsing, and destroy the parser.
+ *
+ * @param
+ *      LispParser parser - Parser to finish.
+ *
+ * @preconditions
+ *      - parser != NULL
+ *      - The whole expression was given to the parser.
+ *
+ * @return
+ *      Parse tree (as returned by parseLispExpression), or NULL if the expression is nested too deep.
+ */
+Tree* finishLispParser(LispParser parser);
+
+/**
+ * Parse the number of a literal tree node once, rather than on every evaluation (see getNumber).
+ * If the given node is a leaf, and it's value is a number literal, then it's number is set.
+ * The number is kept exactly (as a 64 bit integer). Literals that overflow it get an out of range
+ * number (see setOutOfRangeNumber), which is evaluated as NAN.
+ *
+ * @param
+ * 		Tree* tree - Parsed tree node.
+ *
+ * @preconditions
+ *      tree != NULL
+ */
+void parseNumberLiteral(Tree* tree);
+
+/**
+ * Set the maximal nesting depth of expressions accepted by parseLispExpression
+ * (the depth of a single node expression is 1).
+ * All the tree passes (parsing, optimization, compilation, evaluation, printing and destruction)
+ * are iterative, so they handle any depth, but native compilation gives up on deep expressions
+ * (which are interpreted instead).
+ *
+ * @param
+ *      unsigned int max_depth - Maximal expression depth.
+ *
+ * @preconditions
+ *      max_depth > 0
+ */
+void setMaxExpressionDepth(unsigned int max_depth);
+
+/**
+ * Get the maximal nesting depth of expressions accepted by parseLispExpression.
+ *
+ * @return
+ *      Maximal expression depth (DEFAULT_MAX_EXPRESSION_DEPTH unless it was set).
+ */
+unsigned int getMaxExpressionDepth();
+
 /**
  * Print the given tree as a lisp expression of the same form as in parseLispExpression.
  * Used for testing and debugging.
@@ -62,6 +156,22 @@ void printLisp(Tree* tree);
  */
 bool isAssignmentExpression(Tree* tree);
 
+/**
+ * Check if the given expression tree represents a formula binding expression,
+ * i.e. (:=(name)(expression)), which binds a variable to an expression
+ * rather than to it's current value.
+ *
+ * @param
+ *      Tree* tree - Expression tree to examine.
+ *
+ * @preconditions
+ *      tree != NULL
+ *
+ * @return
+ *      true iff the Expression tree represents a formula binding expression.
+ */
+bool isBindingExpression(Tree* tree);
+
 /**
  * Check if the given expression tree represents the quit command.
  *
@@ -76,6 +186,36 @@ bool isAssignmentExpression(Tree* tree);
  */
 bool isEndCommand(Tree* tree);
 
+/**
+ * Check if the given expression tree represents the checkpoint command,
+ * which takes a checkpoint of the variables (see hashCheckpoint).
+ *
+ * @param
+ *      Tree* tree - Expression tree to examine.
+ *
+ * @preconditions
+ *      tree != NULL
+ *
+ * @return
+ *      true iff the Expression tree represents a checkpoint command.
+ */
+bool isCheckpointCommand(Tree* tree);
+
+/**
+ * Check if the given expression tree represents the rollback command,
+ * which rolls the variables back to the checkpoint given by it's single (number) child.
+ *
+ * @param
+ *      Tree* tree - Expression tree to examine.
+ *
+ * @preconditions
+ *      tree != NULL
+ *
+ * @return
+ *      true iff the Expression tree represents a rollback command.
+ */
+bool isRollbackCommand(Tree* tree);
+
 /**
  * Convert and expression tree to an equivalent expression string (infix notation, not lisp).
  *
@@ -91,6 +231,20 @@ bool isEndCommand(Tree* tree);
  */
 void expressionToString(Tree* tree, char* buffer, unsigned int buffer_size);
 
+/**
+ * Get a buffer size that is large enough for the string of an expression tree (see expressionToString).
+ *
+ * @param
+ *      Tree* tree - Expression tree.
+ *
+ * @preconditions
+ *      tree != NULL
+ *
+ * @return
+ *      Buffer size (including the null-terminator).
+ */
+size_t expressionStringSize(Tree* tree);
+
 /**
  * Parse variable initialization file.
  *
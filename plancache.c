@@ -0,0 +1,548 @@
+/*
+ * Plan Cache Module
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "plancache.h"
+#include "parse.h"
+#include "calculate.h"
+#include "optimize.h"
+#include "stats.h"
+#include "alloc.h"
+#include "common.h"
+
+/*
+ * Types
+ */
+
+/*
+ * Cache entry.
+ * Entries are chained in their hash bucket, and kept in a doubly linked list
+ * ordered from the most recently used to the least recently used.
+ */
+typedef struct CacheEntry_
+{
+    char* line;
+    unsigned int hash;
+    size_t size;
+    bool is_jit_counted;        /* Whether the size includes the compiled code (which is compiled lazily) */
+    CompiledLine compiled;
+    struct CacheEntry_* next_in_bucket;
+    struct CacheEntry_* newer;
+    struct CacheEntry_* older;
+} CacheEntry;
+
+struct PlanCache_t
+{
+    CacheEntry** buckets;
+    unsigned int buckets_count;
+    CacheEntry* newest;
+    CacheEntry* oldest;
+    size_t max_bytes;
+    /* Compiled line that didn't fit in the cache, released on the next call */
+    CacheEntry* transient;
+    PlanCacheStats stats;
+};
+
+/*
+ * Constants
+ */
+
+/* Minimal size of an expression tree that is evaluated through an expression DAG
+   (for smaller trees, sharing sub-expressions doesn't pay for building the DAG) */
+#define DAG_MIN_TREE_SIZE 32
+
+/* Amount of evaluations of a line by the interpreter, after which it's compiled into native code */
+#define JIT_THRESHOLD 16
+
+/* Amount of hash buckets allocated by the first insertion (doubled whenever the amount of entries exceeds it) */
+#define INITIAL_BUCKETS_COUNT 64
+
+/*
+ * Internal Function Declarations
+ */
+
+CacheEntry* createCacheEntry(const char* line, unsigned int hash, HashTable variables);
+void destroyCacheEntry(CacheEntry* entry);
+void linkNewest(PlanCache cache, CacheEntry* entry);
+void unlinkEntry(PlanCache cache, CacheEntry* entry);
+void removeEntry(PlanCache cache, CacheEntry* entry);
+void growBuckets(PlanCache cache);
+void countJitCode(PlanCache cache);
+bool hasAssignment(Tree* tree);
+unsigned int collectVariableIds(Tree* tree, NameId* ids, unsigned int ids_count);
+int compareNameIds(const void* a, const void* b);
+
+/*
+ * Module Functions
+ */
+
+void compileLine(const char* line, HashTable variables, OUT CompiledLine* compiled)
+{
+    VERIFY(line != NULL);
+    VERIFY(compiled != NULL);
+
+    compileTree(parseLispExpression(line), variables, compiled);
+    if (compiled->is_invalid) {
+        deallocate(compiled->expression_string);
+        compiled->expression_string = copyString(line);
+    }
+}
+
+void compileTree(Tree* tree, HashTable variables, OUT CompiledLine* compiled)
+{
+    VERIFY(compiled != NULL);
+
+    compiled->tree = tree;
+    compiled->is_invalid = (tree == NULL);
+
+    compiled->dag = NULL;
+    compiled->is_memoizable = false;
+    compiled->has_memo = false;
+    compiled->variables_count = 0;
+    compiled->variable_ids = NULL;
+    compiled->memo_versions = NULL;
+    compiled->executions_count = 0;
+    compiled->jit = NULL;
+    compiled->is_binding = false;
+    compiled->is_end_command = false;
+    compiled->is_checkpoint_command = false;
+    compiled->is_rollback_command = false;
+    compiled->is_assignment = false;
+    if (compiled->is_invalid) {
+        compiled->expression_string = copyString("");
+        return;
+    }
+
+    size_t expression_string_size = expressionStringSize(tree);
+    compiled->expression_string = ALLOCATE(ALLOC_PLANS, expression_string_size);
+    VERIFY(compiled->expression_string != NULL);
+    expressionToString(tree, compiled->expression_string, expression_string_size);
+
+    compiled->is_end_command = isEndCommand(compiled->tree);
+    compiled->is_checkpoint_command = isCheckpointCommand(compiled->tree);
+    compiled->is_rollback_command = isRollbackCommand(compiled->tree);
+    /* Note: identities may turn the root into a nested assignment (e.g. +(a=1)),
+     * so the expression kind is determined before optimizing. */
+    compiled->is_assignment = isAssignmentExpression(compiled->tree);
+    if (compiled->is_end_command || compiled->is_checkpoint_command || compiled->is_rollback_command) {
+        return;
+    }
+
+    compiled->is_binding = isBindingExpression(compiled->tree);
+    unsigned int folded_count = optimizeExpressionTree(compiled->tree, variables);
+    ADD_STAT(COUNTER_NODES_FOLDED, folded_count);
+    unsigned int tree_size = treeSize(compiled->tree);
+    if (tree_size >= DAG_MIN_TREE_SIZE && !compiled->is_binding) {
+        compiled->dag = createExpressionDag(compiled->tree);
+        if (compiled->dag != NULL) {
+            ADD_STAT(COUNTER_DAG_NODES_SHARED, getDagRemovedNodeCount(compiled->dag));
+        }
+    }
+
+    /* Find the (unique) variables read by the expression */
+    NameId* ids = ALLOCATE(ALLOC_PLANS, tree_size * sizeof(*ids));
+    VERIFY(ids != NULL);
+    unsigned int ids_count = collectVariableIds(compiled->tree, ids, 0);
+    qsort(ids, ids_count, sizeof(*ids), compareNameIds);
+    unsigned int unique_count = 0;
+    for (unsigned int i = 0; i < ids_count; ++i)
+    {
+        if (unique_count == 0 || ids[unique_count - 1] != ids[i]) {
+            ids[unique_count] = ids[i];
+            unique_count += 1;
+        }
+    }
+    compiled->variables_count = unique_count;
+    compiled->variable_ids = ids;
+
+    compiled->is_memoizable = !hasAssignment(compiled->tree);
+    if (compiled->is_memoizable) {
+        compiled->memo_versions = ALLOCATE(ALLOC_PLANS, (unique_count + 1) * sizeof(*compiled->memo_versions));
+        VERIFY(compiled->memo_versions != NULL);
+    }
+}
+
+void releaseCompiledLine(CompiledLine* compiled)
+{
+    VERIFY(compiled != NULL);
+    destroyTree(compiled->tree);
+    destroyExpressionDag(compiled->dag);
+    destroyJitCode(compiled->jit);
+    deallocate(compiled->expression_string);
+    deallocate(compiled->variable_ids);
+    deallocate(compiled->memo_versions);
+}
+
+double evaluateCompiledLine(CompiledLine* compiled, HashTable variables)
+{
+    VERIFY(compiled != NULL);
+    VERIFY(!compiled->is_invalid);
+    VERIFY(!compiled->is_end_command);
+    VERIFY(!compiled->is_checkpoint_command && !compiled->is_rollback_command);
+    VERIFY(!compiled->is_binding);
+
+    /* Check whether the memoized result is still valid */
+    if (compiled->has_memo) {
+        bool is_valid = true;
+        for (unsigned int i = 0; i < compiled->variables_count && is_valid; ++i)
+        {
+            is_valid = (hashGetVersionById(variables, compiled->variable_ids[i]) == compiled->memo_versions[i]);
+        }
+        if (is_valid) {
+            return compiled->memo_result;
+        }
+    }
+
+    double result;
+    if (compiled->jit != NULL) {
+        result = runJitCode(compiled->jit, variables);
+    } else {
+        if (compiled->dag != NULL) {
+            result = evaluateExpressionDag(compiled->dag, variables);
+        } else {
+            result = evaluateExpressionTree(compiled->tree, variables);
+        }
+
+        /* Compilation is attempted once, when the line becomes hot */
+        compiled->executions_count += 1;
+        if (compiled->executions_count == JIT_THRESHOLD) {
+            compiled->jit = createJitCode(compiled->tree, compiled->variable_ids, compiled->variables_count);
+        }
+    }
+
+    /* The expression has no assignments, so the versions didn't change during the evaluation */
+    if (compiled->is_memoizable) {
+        for (unsigned int i = 0; i < compiled->variables_count; ++i)
+        {
+            compiled->memo_versions[i] = hashGetVersionById(variables, compiled->variable_ids[i]);
+        }
+        compiled->memo_result = result;
+        compiled->has_memo = true;
+    }
+
+    return result;
+}
+
+PlanCache createPlanCache(size_t max_bytes)
+{
+    PlanCache cache = ALLOCATE_ZEROED(ALLOC_PLANS, 1, sizeof(*cache));
+    VERIFY(cache != NULL);
+    /* The buckets are allocated by the first insertion, so creating a cache doesn't allocate them */
+    cache->max_bytes = max_bytes;
+    return cache;
+}
+
+void destroyPlanCache(PlanCache cache)
+{
+    if (cache == NULL) {
+        return;
+    }
+
+    CacheEntry* entry = cache->newest;
+    while (entry != NULL)
+    {
+        CacheEntry* older = entry->older;
+        destroyCacheEntry(entry);
+        entry = older;
+    }
+    destroyCacheEntry(cache->transient);
+    deallocate(cache->buckets);
+    deallocate(cache);
+}
+
+CompiledLine* planCacheGet(PlanCache cache, const char* line, HashTable variables)
+{
+    VERIFY(cache != NULL);
+    VERIFY(line != NULL);
+
+    destroyCacheEntry(cache->transient);
+    cache->transient = NULL;
+
+    /* The previous line may have been compiled into native code since it was returned */
+    countJitCode(cache);
+    while (cache->stats.bytes > cache->max_bytes)
+    {
+        cache->stats.evictions += 1;
+        removeEntry(cache, cache->oldest);
+    }
+
+    /* Lookup */
+    unsigned int hash = hashString(HASH_SEED, line);
+    for (CacheEntry* entry = (cache->buckets_count > 0) ? cache->buckets[hash % cache->buckets_count] : NULL;
+         entry != NULL;
+         entry = entry->next_in_bucket)
+    {
+        if (entry->hash == hash && strcmp(entry->line, line) == 0) {
+            cache->stats.hits += 1;
+            COUNT_STAT(COUNTER_CACHE_HITS);
+            unlinkEntry(cache, entry);
+            linkNewest(cache, entry);
+            return &entry->compiled;
+        }
+    }
+    cache->stats.misses += 1;
+    COUNT_STAT(COUNTER_CACHE_MISSES);
+
+    /* Compile, and make room for the new entry */
+    CacheEntry* entry = createCacheEntry(line, hash, variables);
+    if (entry->size > cache->max_bytes) {
+        cache->transient = entry;
+        return &entry->compiled;
+    }
+    while (cache->stats.bytes + entry->size > cache->max_bytes)
+    {
+        cache->stats.evictions += 1;
+        removeEntry(cache, cache->oldest);
+    }
+
+    /* Insert */
+    if (cache->stats.entries >= cache->buckets_count) {
+        growBuckets(cache);
+    }
+    unsigned int bucket = hash % cache->buckets_count;
+    entry->next_in_bucket = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+    linkNewest(cache, entry);
+    cache->stats.entries += 1;
+    cache->stats.bytes += entry->size;
+
+    return &entry->compiled;
+}
+
+void getPlanCacheStats(PlanCache cache, OUT PlanCacheStats* stats)
+{
+    VERIFY(cache != NULL);
+    VERIFY(stats != NULL);
+    countJitCode(cache);
+    *stats = cache->stats;
+}
+
+/*
+ * Internal Functions
+ */
+
+/**
+ * Compile a line into a new cache entry (which isn't linked into the cache yet).
+ *
+ * @param
+ *      const char* line - Lisp expression line.
+ *      unsigned int hash - Hash of the line.
+ *      HashTable variables - variables table used for compiling.
+ *
+ * @return
+ *      The created entry.
+ */
+CacheEntry* createCacheEntry(const char* line, unsigned int hash, HashTable variables)
+{
+    CacheEntry* entry = ALLOCATE_ZEROED(ALLOC_PLANS, 1, sizeof(*entry));
+    VERIFY(entry != NULL);
+    entry->line = copyString(line);
+    entry->hash = hash;
+    compileLine(line, variables, &entry->compiled);
+
+    entry->size = sizeof(*entry)
+                + strlen(entry->line) + 1
+                + strlen(entry->compiled.expression_string) + 1
+                + entry->compiled.variables_count * (sizeof(char*) + sizeof(unsigned long));
+    if (entry->compiled.tree != NULL) {
+        entry->size += treeMemorySize(entry->compiled.tree);
+    }
+    if (entry->compiled.dag != NULL) {
+        entry->size += getDagMemorySize(entry->compiled.dag);
+    }
+    return entry;
+}
+
+/**
+ * Destroy a cache entry, and release it's compiled line.
+ * If the given entry is NULL, then nothing is done.
+ *
+ * @param
+ *      CacheEntry* entry - Entry to destroy.
+ */
+void destroyCacheEntry(CacheEntry* entry)
+{
+    if (entry == NULL) {
+        return;
+    }
+    releaseCompiledLine(&entry->compiled);
+    deallocate(entry->line);
+    deallocate(entry);
+}
+
+/**
+ * Link an entry as the most recently used entry of the cache.
+ *
+ * @param
+ *      PlanCache cache - Cache to modify.
+ *      CacheEntry* entry - Unlinked entry.
+ */
+void linkNewest(PlanCache cache, CacheEntry* entry)
+{
+    entry->older = cache->newest;
+    entry->newer = NULL;
+    if (cache->newest != NULL) {
+        cache->newest->newer = entry;
+    } else {
+        cache->oldest = entry;
+    }
+    cache->newest = entry;
+}
+
+/**
+ * Unlink an entry from the recently used list of the cache.
+ *
+ * @param
+ *      PlanCache cache - Cache to modify.
+ *      CacheEntry* entry - Linked entry.
+ */
+void unlinkEntry(PlanCache cache, CacheEntry* entry)
+{
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+    entry->newer = NULL;
+    entry->older = NULL;
+}
+
+/**
+ * Remove an entry from the cache and destroy it.
+ *
+ * @param
+ *      PlanCache cache - Cache to modify.
+ *      CacheEntry* entry - Entry to remove.
+ *
+ * @preconditions
+ *      entry != NULL, entry is in the cache.
+ */
+void removeEntry(PlanCache cache, CacheEntry* entry)
+{
+    VERIFY(entry != NULL);
+
+    CacheEntry** link = &cache->buckets[entry->hash % cache->buckets_count];
+    while (*link != entry)
+    {
+        VERIFY(*link != NULL);
+        link = &(*link)->next_in_bucket;
+    }
+    *link = entry->next_in_bucket;
+
+    unlinkEntry(cache, entry);
+    cache->stats.entries -= 1;
+    cache->stats.bytes -= entry->size;
+    destroyCacheEntry(entry);
+}
+
+/**
+ * Double the amount of hash buckets (or allocate the first ones), and redistribute the entries.
+ *
+ * @param
+ *      PlanCache cache - Cache to modify.
+ */
+void growBuckets(PlanCache cache)
+{
+    unsigned int buckets_count = (cache->buckets_count > 0) ? cache->buckets_count * 2 : INITIAL_BUCKETS_COUNT;
+    CacheEntry** buckets = ALLOCATE_ZEROED(ALLOC_PLANS, buckets_count, sizeof(*buckets));
+    VERIFY(buckets != NULL);
+
+    for (CacheEntry* entry = cache->newest; entry != NULL; entry = entry->older)
+    {
+        unsigned int bucket = entry->hash % buckets_count;
+        entry->next_in_bucket = buckets[bucket];
+        buckets[bucket] = entry;
+    }
+
+    deallocate(cache->buckets);
+    cache->buckets = buckets;
+    cache->buckets_count = buckets_count;
+}
+
+/**
+ * Check if an expression tree contains an assignment or a formula binding.
+ *
+ * @param
+ *      Tree* tree - Expression tree to examine.
+ *
+ * @return
+ *      true iff the tree contains an assignment or a binding operation.
+ */
+bool hasAssignment(Tree* tree)
+{
+    for (Tree* node = tree; node != NULL; node = nextPreOrderNode(tree, node))
+    {
+        if (hasChildren(node) && (isAssignmentExpression(node) || isBindingExpression(node))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Collect the interned names of all the variable terminals of an expression tree (with repetitions).
+ *
+ * @param
+ *      Tree* tree - Expression tree to examine.
+ *      NameId* ids - Array which the ids are added to (large enough for all the tree nodes).
+ *      unsigned int ids_count - Amount of ids already in the array.
+ *
+ * @return
+ *      Amount of ids in the array.
+ */
+unsigned int collectVariableIds(Tree* tree, NameId* ids, unsigned int ids_count)
+{
+    for (Tree* node = tree; node != NULL; node = nextPreOrderNode(tree, node))
+    {
+        if (!hasChildren(node) && getNameId(node) != NO_NAME_ID) {
+            ids[ids_count] = getNameId(node);
+            ids_count += 1;
+        }
+    }
+    return ids_count;
+}
+
+/**
+ * Compares two interned names by their ids (used as a callback for the qsort function).
+ *
+ * @param
+ *      const void* a - Pointer to the first id
+ *      const void* b - Pointer to the second id
+ *
+ * @return
+ *      Negative, 0 or positive, if the first id is smaller, equal or larger than the second.
+ */
+int compareNameIds(const void* a, const void* b)
+{
+    NameId first = *(const NameId*)a;
+    NameId second = *(const NameId*)b;
+    return (first > second) - (first < second);
+}
+
+/**
+ * Add the size of the native code of the most recently used entry to the cache's size,
+ * if it was compiled since it was counted. Lines are compiled when they're evaluated,
+ * so only the entry which was returned last may have been compiled since.
+ *
+ * @param
+ *      PlanCache cache - Cache to modify.
+ */
+void countJitCode(PlanCache cache)
+{
+    CacheEntry* entry = cache->newest;
+    if (entry == NULL || entry->is_jit_counted || entry->compiled.jit == NULL) {
+        return;
+    }
+    size_t jit_size = getJitMemorySize(entry->compiled.jit);
+    entry->size += jit_size;
+    cache->stats.bytes += jit_size;
+    entry->is_jit_counted = true;
+}
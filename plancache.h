@@ -0,0 +1,184 @@
+/*
+ * Plan Cache Module
+ */
+
+#ifndef PLANCACHE_H_
+#define PLANCACHE_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "tree.h"
+#include "dag.h"
+#include "jit.h"
+#include "hashtable.h"
+#include "common.h"
+
+/*
+ * Types
+ */
+
+/* Compiled form of a single input line */
+typedef struct CompiledLine_
+{
+    Tree* tree;                 /* Optimized expression tree */
+    ExpressionDag dag;          /* DAG of the tree, or NULL if the tree is evaluated directly */
+    char* expression_string;    /* Infix string of the expression (before optimization) */
+    bool is_invalid;            /* The line was rejected by the parser (tree is NULL) */
+    bool is_end_command;
+    bool is_checkpoint_command;
+    bool is_rollback_command;   /* The checkpoint is the number of the tree's child */
+    bool is_assignment;
+    bool is_binding;            /* Formula binding (:=), evaluated by the formula engine */
+
+    unsigned int variables_count;
+    NameId* variable_ids;           /* Variables read by the expression (sorted interned names) */
+
+    /* Result memoization (only for expressions without assignments) */
+    bool is_memoizable;
+    bool has_memo;
+    double memo_result;
+    unsigned long* memo_versions;   /* Versions of the variables when memo_result was calculated */
+
+    /* Tiered execution: a line is interpreted until it's hot, and then compiled into native code */
+    unsigned long executions_count;
+    JitCode jit;                    /* Native code of the line, or NULL */
+} CompiledLine;
+
+/* Counters of a plan cache */
+typedef struct PlanCacheStats_
+{
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned int entries;
+    size_t bytes;
+} PlanCacheStats;
+
+/* Bounded LRU cache from input line text to it's compiled form */
+typedef struct PlanCache_t* PlanCache;
+
+/*
+ * Functions
+ */
+
+/**
+ * Compile an input line: parse it, convert it to an infix string, optimize it,
+ * and build an expression DAG for it if it's large enough.
+ * A line which is rejected by the parser (nested too deep) is compiled as invalid,
+ * and it's expression string is the line itself.
+ * The compiled line has to be released by releaseCompiledLine.
+ *
+ * @param
+ *      const char* line - Lisp expression line to compile.
+ *      HashTable variables - variables table used for optimizing (not accessed).
+ *      CompiledLine* compiled - Out parameter that receives the compiled line.
+ *
+ * @preconditions
+ *      line != NULL, variables != NULL, compiled != NULL
+ */
+void compileLine(const char* line, HashTable variables, OUT CompiledLine* compiled);
+
+/**
+ * Compile an already parsed expression tree, like compileLine.
+ * The compiled line takes the ownership of the tree.
+ * If the given tree is NULL (the expression was rejected by the parser),
+ * then the line is compiled as invalid, with an empty expression string.
+ *
+ * @param
+ *      Tree* tree - Parse tree to compile, or NULL.
+ *      HashTable variables - variables table used for optimizing (not accessed).
+ *      CompiledLine* compiled - Out parameter that receives the compiled line.
+ *
+ * @preconditions
+ *      variables != NULL, compiled != NULL
+ */
+void compileTree(Tree* tree, HashTable variables, OUT CompiledLine* compiled);
+
+/**
+ * Release the resources of a compiled line.
+ *
+ * @param
+ *      CompiledLine* compiled - Compiled line to release.
+ *
+ * @preconditions
+ *      compiled != NULL
+ */
+void releaseCompiledLine(CompiledLine* compiled);
+
+/**
+ * Evaluate a compiled line.
+ * If the expression is an assignment, the given variables table is updated.
+ * Results of expressions without assignments are memoized along with the versions
+ * of the variables they read, and are reused as long as none of these variables changed.
+ * A line which is evaluated often is compiled into native code (where supported),
+ * which is used for it's following evaluations.
+ *
+ * @param
+ *      CompiledLine* compiled - Compiled line to evaluate.
+ *      HashTable variables - variables to use for evaluation, and to update after assignment.
+ *
+ * @preconditions
+ *      - compiled != NULL, variables != NULL
+ *      - !compiled->is_invalid, !compiled->is_binding, and compiled isn't a command
+ *
+ * @return
+ *      Evaluation result.
+ */
+double evaluateCompiledLine(CompiledLine* compiled, HashTable variables);
+
+/**
+ * Create a new empty plan cache.
+ * The created cache has to be destroyed by destroyPlanCache.
+ *
+ * @param
+ *      size_t max_bytes - Memory cap of the cached entries.
+ *                         A cap of 0 disables caching (every line is compiled).
+ *
+ * @return
+ *      The created cache.
+ */
+PlanCache createPlanCache(size_t max_bytes);
+
+/**
+ * Destroy a plan cache and all of it's entries.
+ * If the given cache is NULL, then nothing is done.
+ *
+ * @param
+ *      PlanCache cache - Cache to destroy.
+ */
+void destroyPlanCache(PlanCache cache);
+
+/**
+ * Get the compiled form of an input line.
+ * On a cache hit the line is neither parsed nor formatted.
+ * On a miss the line is compiled and cached (evicting the least recently used entries
+ * while the memory cap is exceeded).
+ * Native code which the previously returned line was compiled into (see evaluateCompiledLine)
+ * is counted in the cache's memory from this call on.
+ *
+ * @param
+ *      PlanCache cache - Cache to use.
+ *      const char* line - Lisp expression line.
+ *      HashTable variables - variables table used for compiling (not accessed).
+ *
+ * @preconditions
+ *      cache != NULL, line != NULL, variables != NULL
+ *
+ * @return
+ *      The compiled line. It remains valid until the next call with the same cache.
+ */
+CompiledLine* planCacheGet(PlanCache cache, const char* line, HashTable variables);
+
+/**
+ * Get the counters of a plan cache.
+ *
+ * @param
+ *      PlanCache cache - Cache to examine.
+ *      PlanCacheStats* stats - Out parameter that receives the counters.
+ *
+ * @preconditions
+ *      cache != NULL, stats != NULL
+ */
+void getPlanCacheStats(PlanCache cache, OUT PlanCacheStats* stats);
+
+#endif /* PLANCACHE_H_ */
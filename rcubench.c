@@ -0,0 +1,198 @@
+/*
+ * Concurrent Variable Table Benchmark
+ *
+ * Measures the read throughput of the concurrent table (see rcutable.h) with 1 to 32 reading threads,
+ * while a writer thread keeps assigning values, and compares it with a HashTable behind a readers-writer lock.
+ * Usage: ./rcubench [milliseconds per measurement]
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+#include "rcutable.h"
+#include "hashtable.h"
+#include "stats.h"
+#include "common.h"
+
+/*
+ * Constants
+ */
+
+/* Amount of variables in the table */
+#define BENCH_VARIABLES 1024
+
+/* Time that the writer sleeps between assignments (in nanoseconds) */
+#define BENCH_WRITE_INTERVAL 10000
+
+/* Maximal amount of reading threads */
+#define BENCH_MAX_READERS 32
+
+/* Default duration of each measurement (in milliseconds) */
+#define BENCH_DEFAULT_DURATION 200
+
+/*
+ * Types
+ */
+
+/* Table which is measured */
+typedef enum BenchTableKind_
+{
+    BENCH_RCU_TABLE,
+    BENCH_LOCKED_TABLE
+} BenchTableKind;
+
+/* State shared by the threads of a measurement */
+typedef struct BenchShared_
+{
+    BenchTableKind kind;
+    RcuTable rcu_table;
+    HashTable locked_table;
+    pthread_rwlock_t lock;
+    NameId ids[BENCH_VARIABLES];
+    bool is_stopping;
+} BenchShared;
+
+/* Thread of a measurement */
+typedef struct BenchThread_
+{
+    pthread_t thread;
+    BenchShared* shared;
+    unsigned long long operations_count;
+} BenchThread;
+
+/*
+ * Function Declarations
+ */
+
+double measureReads(BenchShared* shared, unsigned int readers_count, unsigned int duration);
+void* readBenchValues(void* argument);
+void* writeBenchValues(void* argument);
+
+/*
+ * Function Implementations
+ */
+
+int main(int argc, char** argv)
+{
+    unsigned int duration = (argc > 1) ? (unsigned int)atoi(argv[1]) : BENCH_DEFAULT_DURATION;
+    VERIFY(duration > 0);
+
+    BenchShared shared;
+    shared.rcu_table = createRcuTable();
+    shared.locked_table = createHashTable();
+    VERIFY(pthread_rwlock_init(&shared.lock, NULL) == 0);
+    for (unsigned int i = 0; i < BENCH_VARIABLES; ++i)
+    {
+        /* Names of letters only, like the calculator's variables */
+        char name[4] = {(char)('a' + i / 676), (char)('a' + i / 26 % 26), (char)('a' + i % 26), '\0'};
+        shared.ids[i] = internName(name, 3);
+        rcuTableInsert(shared.rcu_table, shared.ids[i], i);
+        hashInsertById(shared.locked_table, shared.ids[i], i);
+    }
+
+    printf("%8s %20s %20s\n", "readers", "rcu (reads/s)", "rwlock (reads/s)");
+    for (unsigned int readers_count = 1; readers_count <= BENCH_MAX_READERS; readers_count *= 2)
+    {
+        shared.kind = BENCH_RCU_TABLE;
+        double rcu_throughput = measureReads(&shared, readers_count, duration);
+        shared.kind = BENCH_LOCKED_TABLE;
+        double locked_throughput = measureReads(&shared, readers_count, duration);
+        printf("%8u %20.0f %20.0f\n", readers_count, rcu_throughput, locked_throughput);
+    }
+
+    VERIFY(pthread_rwlock_destroy(&shared.lock) == 0);
+    destroyHashTable(shared.locked_table);
+    destroyRcuTable(shared.rcu_table);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Run readers and a writer on the table for a while.
+ *
+ * @param
+ *      BenchShared* shared - State of the measurement (with the measured table).
+ *      unsigned int readers_count - Amount of reading threads.
+ *      unsigned int duration - Duration of the measurement (in milliseconds).
+ *
+ * @return
+ *      Total reads per second of the readers.
+ */
+double measureReads(BenchShared* shared, unsigned int readers_count, unsigned int duration)
+{
+    BenchThread threads[BENCH_MAX_READERS + 1];
+    shared->is_stopping = false;
+    uint64_t start = readClock();
+    for (unsigned int i = 0; i <= readers_count; ++i)
+    {
+        threads[i].shared = shared;
+        threads[i].operations_count = 0;
+        VERIFY(pthread_create(&threads[i].thread, NULL,
+                              (i == 0) ? writeBenchValues : readBenchValues, &threads[i]) == 0);
+    }
+
+    struct timespec sleep_time = {duration / 1000, (long)(duration % 1000) * 1000000};
+    nanosleep(&sleep_time, NULL);
+    __atomic_store_n(&shared->is_stopping, true, __ATOMIC_RELEASE);
+
+    unsigned long long reads_count = 0;
+    for (unsigned int i = 0; i <= readers_count; ++i)
+    {
+        VERIFY(pthread_join(threads[i].thread, NULL) == 0);
+        reads_count += (i == 0) ? 0 : threads[i].operations_count;
+    }
+    return reads_count / ((readClock() - start) / 1e9);
+}
+
+/**
+ * Main function of a reading thread: reads the variables in turn until the measurement stops.
+ */
+void* readBenchValues(void* argument)
+{
+    BenchThread* thread = argument;
+    BenchShared* shared = thread->shared;
+    RcuReader reader = (shared->kind == BENCH_RCU_TABLE) ? createRcuReader(shared->rcu_table) : NULL;
+    unsigned int index = 0;
+    while (!__atomic_load_n(&shared->is_stopping, __ATOMIC_ACQUIRE))
+    {
+        double value = 0;
+        if (shared->kind == BENCH_RCU_TABLE) {
+            rcuTableGetValue(reader, shared->ids[index], &value);
+        } else {
+            VERIFY(pthread_rwlock_rdlock(&shared->lock) == 0);
+            hashGetValueById(shared->locked_table, shared->ids[index], &value);
+            VERIFY(pthread_rwlock_unlock(&shared->lock) == 0);
+        }
+        index = (index + 1) % BENCH_VARIABLES;
+        thread->operations_count += 1;
+    }
+    destroyRcuReader(reader);
+    return NULL;
+}
+
+/**
+ * Main function of the writing thread: assigns the variables in turn until the measurement stops.
+ */
+void* writeBenchValues(void* argument)
+{
+    BenchThread* thread = argument;
+    BenchShared* shared = thread->shared;
+    unsigned int index = 0;
+    while (!__atomic_load_n(&shared->is_stopping, __ATOMIC_ACQUIRE))
+    {
+        if (shared->kind == BENCH_RCU_TABLE) {
+            rcuTableInsert(shared->rcu_table, shared->ids[index], thread->operations_count);
+        } else {
+            VERIFY(pthread_rwlock_wrlock(&shared->lock) == 0);
+            hashInsertById(shared->locked_table, shared->ids[index], thread->operations_count);
+            VERIFY(pthread_rwlock_unlock(&shared->lock) == 0);
+        }
+        index = (index + 1) % BENCH_VARIABLES;
+        thread->operations_count += 1;
+        struct timespec sleep_time = {0, BENCH_WRITE_INTERVAL};
+        nanosleep(&sleep_time, NULL);
+    }
+    return NULL;
+}
@@ -0,0 +1,298 @@
+/*
+ * Concurrent Variable Table Module
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "rcutable.h"
+#include "container.h"
+#include "alloc.h"
+#include "common.h"
+
+/*
+ * Constants
+ */
+
+/* Amount of slots allocated by the first insertion (a power of 2) */
+#define RCU_TABLE_INITIAL_CAPACITY 16
+
+/* Size of a cache line, which each reader's counter is kept alone in (so readers don't share lines) */
+#define CACHE_LINE_SIZE 64
+
+/*
+ * Types
+ */
+
+/* Slot of a value. The id is set once (when the slot is claimed), so probing never skips a slot
+ * which was claimed before the read started. A deleted value keeps it's slot, so it's reinserted there. */
+typedef struct RcuSlot_
+{
+    NameId id;                  /* NO_NAME_ID if the slot wasn't claimed */
+    unsigned int is_set;        /* 0 if the value was deleted */
+    uint64_t value_bits;        /* Bits of the value (so it's read and written as a single word) */
+} RcuSlot;
+
+/* Array of slots, which is replaced as a whole when it fills up */
+typedef struct RcuSlots_
+{
+    unsigned int mask;          /* Amount of slots - 1 */
+    unsigned int used_count;    /* Amount of claimed slots (including the deleted values) */
+    RcuSlot slots[];
+} RcuSlots;
+
+struct RcuReader_t
+{
+    /* Incremented when the reader starts reading (so it's odd) and when it's done */
+    unsigned long long reads_counter;
+    RcuTable table;
+    LIST_LINK(struct RcuReader_t) link;
+    char padding[CACHE_LINE_SIZE - sizeof(unsigned long long) - sizeof(RcuTable) - 2 * sizeof(void*)];
+};
+
+DEFINE_LIST(RcuReaderList, rcuReaderList, struct RcuReader_t, link)
+
+struct RcuTable_t
+{
+    RcuSlots* slots;            /* Current slots (NULL before the first insertion) */
+    unsigned int count;         /* Amount of values */
+    pthread_mutex_t writers_lock;
+    RcuReaderList readers;      /* Modified under the writers' lock */
+};
+
+/*
+ * Internal Function Declarations
+ */
+
+RcuSlot* findRcuSlot(RcuSlots* slots, NameId id);
+void growRcuSlots(RcuTable table);
+void waitForRcuReaders(RcuTable table);
+
+/*
+ * Module Functions
+ */
+
+RcuTable createRcuTable()
+{
+    RcuTable table = ALLOCATE(ALLOC_VARIABLES, sizeof(*table));
+    VERIFY(table != NULL);
+    table->slots = NULL;
+    table->count = 0;
+    VERIFY(pthread_mutex_init(&table->writers_lock, NULL) == 0);
+    rcuReaderListInit(&table->readers);
+    return table;
+}
+
+void destroyRcuTable(RcuTable table)
+{
+    if (table == NULL) {
+        return;
+    }
+
+    VERIFY(table->readers.count == 0);
+    VERIFY(pthread_mutex_destroy(&table->writers_lock) == 0);
+    deallocate(table->slots);
+    deallocate(table);
+}
+
+RcuReader createRcuReader(RcuTable table)
+{
+    VERIFY(table != NULL);
+
+    /* The reader is allocated under the lock, like all of the table's memory (the allocator isn't thread-safe) */
+    VERIFY(pthread_mutex_lock(&table->writers_lock) == 0);
+    RcuReader reader = ALLOCATE(ALLOC_VARIABLES, sizeof(*reader));
+    VERIFY(reader != NULL);
+    reader->reads_counter = 0;
+    reader->table = table;
+    rcuReaderListInsertLast(&table->readers, reader);
+    VERIFY(pthread_mutex_unlock(&table->writers_lock) == 0);
+    return reader;
+}
+
+void destroyRcuReader(RcuReader reader)
+{
+    if (reader == NULL) {
+        return;
+    }
+
+    RcuTable table = reader->table;
+    VERIFY(pthread_mutex_lock(&table->writers_lock) == 0);
+    rcuReaderListRemove(&table->readers, reader);
+    deallocate(reader);
+    VERIFY(pthread_mutex_unlock(&table->writers_lock) == 0);
+}
+
+bool rcuTableGetValue(RcuReader reader, NameId id, OUT double* value)
+{
+    VERIFY(reader != NULL);
+    VERIFY(value != NULL);
+
+    /* The read is announced before the slots are loaded (both are sequentially consistent),
+     * so a writer which replaced the slots either sees the announcement, or the read sees the new slots */
+    unsigned long long reads_counter = reader->reads_counter + 1;
+    __atomic_store_n(&reader->reads_counter, reads_counter, __ATOMIC_SEQ_CST);
+    RcuSlots* slots = __atomic_load_n(&reader->table->slots, __ATOMIC_SEQ_CST);
+
+    /* The slots are never full, so the probing ends within a pass over them */
+    bool is_found = false;
+    if (slots != NULL) {
+        for (unsigned int index = id & slots->mask; ; index = (index + 1) & slots->mask)
+        {
+            RcuSlot* slot = &slots->slots[index];
+            NameId slot_id = __atomic_load_n(&slot->id, __ATOMIC_ACQUIRE);
+            if (slot_id == NO_NAME_ID) {
+                break;
+            }
+            if (slot_id == id) {
+                if (__atomic_load_n(&slot->is_set, __ATOMIC_ACQUIRE)) {
+                    uint64_t value_bits = __atomic_load_n(&slot->value_bits, __ATOMIC_ACQUIRE);
+                    memcpy(value, &value_bits, sizeof(*value));
+                    is_found = true;
+                }
+                break;
+            }
+        }
+    }
+
+    __atomic_store_n(&reader->reads_counter, reads_counter + 1, __ATOMIC_RELEASE);
+    return is_found;
+}
+
+void rcuTableInsert(RcuTable table, NameId id, double value)
+{
+    VERIFY(table != NULL);
+    VERIFY(id != NO_NAME_ID);
+
+    uint64_t value_bits;
+    memcpy(&value_bits, &value, sizeof(value_bits));
+
+    VERIFY(pthread_mutex_lock(&table->writers_lock) == 0);
+    /* A new name claims a slot, which is kept empty if the slots would be more than 3/4 full */
+    RcuSlot* slot = (table->slots != NULL) ? findRcuSlot(table->slots, id) : NULL;
+    if (slot == NULL
+        || (slot->id == NO_NAME_ID && 4 * (table->slots->used_count + 1) > 3 * (table->slots->mask + 1))) {
+        growRcuSlots(table);
+        slot = findRcuSlot(table->slots, id);
+    }
+
+    __atomic_store_n(&slot->value_bits, value_bits, __ATOMIC_RELEASE);
+    if (!slot->is_set) {
+        __atomic_store_n(&slot->is_set, 1, __ATOMIC_RELEASE);
+        __atomic_store_n(&table->count, table->count + 1, __ATOMIC_RELAXED);
+    }
+    if (slot->id == NO_NAME_ID) {
+        /* The slot is published last, so readers which find it see it's value */
+        __atomic_store_n(&slot->id, id, __ATOMIC_RELEASE);
+        table->slots->used_count += 1;
+    }
+    VERIFY(pthread_mutex_unlock(&table->writers_lock) == 0);
+}
+
+bool rcuTableDelete(RcuTable table, NameId id)
+{
+    VERIFY(table != NULL);
+
+    VERIFY(pthread_mutex_lock(&table->writers_lock) == 0);
+    RcuSlot* slot = (table->slots != NULL && id != NO_NAME_ID) ? findRcuSlot(table->slots, id) : NULL;
+    bool is_deleted = (slot != NULL && slot->is_set);
+    if (is_deleted) {
+        __atomic_store_n(&slot->is_set, 0, __ATOMIC_RELEASE);
+        __atomic_store_n(&table->count, table->count - 1, __ATOMIC_RELAXED);
+    }
+    VERIFY(pthread_mutex_unlock(&table->writers_lock) == 0);
+    return is_deleted;
+}
+
+unsigned int rcuTableGetSize(RcuTable table)
+{
+    VERIFY(table != NULL);
+    return __atomic_load_n(&table->count, __ATOMIC_RELAXED);
+}
+
+/*
+ * Internal Functions
+ */
+
+/**
+ * Find the slot of a name, or the slot which it would be claimed by (called by writers).
+ *
+ * @param
+ *      RcuSlots* slots - Slots to search.
+ *      NameId id - Interned name.
+ *
+ * @return
+ *      The slot with the id, or the empty slot at the end of it's probing.
+ */
+RcuSlot* findRcuSlot(RcuSlots* slots, NameId id)
+{
+    unsigned int index = id & slots->mask;
+    while (slots->slots[index].id != NO_NAME_ID && slots->slots[index].id != id)
+    {
+        index = (index + 1) & slots->mask;
+    }
+    return &slots->slots[index];
+}
+
+/**
+ * Copy the values into new slots, with room for at least one more value, and replace the current slots
+ * (called by writers). The deleted values aren't copied, so they free their slots.
+ * The old slots are released once no reader may see them.
+ *
+ * @param
+ *      RcuTable table - Table to modify.
+ */
+void growRcuSlots(RcuTable table)
+{
+    unsigned int capacity = RCU_TABLE_INITIAL_CAPACITY;
+    while (2 * (table->count + 1) > capacity)
+    {
+        capacity *= 2;
+    }
+    RcuSlots* slots = ALLOCATE_ZEROED(ALLOC_VARIABLES, 1, sizeof(RcuSlots) + capacity * sizeof(RcuSlot));
+    VERIFY(slots != NULL);
+    slots->mask = capacity - 1;
+    slots->used_count = 0;
+
+    RcuSlots* old_slots = table->slots;
+    if (old_slots != NULL) {
+        for (unsigned int i = 0; i <= old_slots->mask; ++i)
+        {
+            if (old_slots->slots[i].is_set) {
+                *findRcuSlot(slots, old_slots->slots[i].id) = old_slots->slots[i];
+                slots->used_count += 1;
+            }
+        }
+    }
+
+    __atomic_store_n(&table->slots, slots, __ATOMIC_SEQ_CST);
+    if (old_slots != NULL) {
+        waitForRcuReaders(table);
+        deallocate(old_slots);
+    }
+}
+
+/**
+ * Wait until every reader which was reading when this is called is done (called by writers).
+ * Readers which start reading later see the current slots, so they aren't waited for.
+ *
+ * @param
+ *      RcuTable table - Table whose readers are waited for.
+ */
+void waitForRcuReaders(RcuTable table)
+{
+    for (RcuReader reader = table->readers.first; reader != NULL; reader = reader->link.next)
+    {
+        unsigned long long reads_counter = __atomic_load_n(&reader->reads_counter, __ATOMIC_SEQ_CST);
+        if (reads_counter % 2 == 0) {
+            continue;
+        }
+        while (__atomic_load_n(&reader->reads_counter, __ATOMIC_ACQUIRE) == reads_counter)
+        {
+            sched_yield();
+        }
+    }
+}
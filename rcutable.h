@@ -0,0 +1,144 @@
+/*
+ * Concurrent Variable Table Module
+ */
+
+#ifndef RCUTABLE_H_
+#define RCUTABLE_H_
+
+#include <stdbool.h>
+#include "intern.h"
+#include "common.h"
+
+/*
+ * Concurrent Variable Table
+ *
+ * A variable table for read-mostly sharing between threads: any amount of threads read values
+ * while other threads assign them. Reads are wait-free (they never lock, retry or wait for a writer),
+ * and writes are serialized by a lock.
+ *
+ * The values are kept in an open addressing array of slots, keyed by the interned ids of the names
+ * (like HashTable). A slot's id is set once, by the write which claims the slot, and it's value is
+ * a single 64-bit word, so a reader sees either the old or the new value of a slot, never a mix.
+ * When the array fills up, the writer copies it into a larger one, and releases the old array
+ * only after every reader which might still see it is done (read-copy-update): each reader
+ * announces it's reads in a counter of it's own, which the writer waits on.
+ *
+ * Names must be interned before the threads share the table (interning isn't thread-safe),
+ * and the allocator isn't thread-safe either, so only writers of the table may allocate meanwhile.
+ */
+
+/*
+ * Types
+ */
+
+typedef struct RcuTable_t* RcuTable;
+
+/* Registration of a reading thread (each thread reads through it's own reader) */
+typedef struct RcuReader_t* RcuReader;
+
+/*
+ * Functions
+ */
+
+/**
+ * Create an empty table (the slots are allocated by the first insertion).
+ *
+ * @return
+ *      The created table.
+ */
+RcuTable createRcuTable();
+
+/**
+ * Destroy a table, and release it's values.
+ *
+ * @param
+ *      RcuTable table - Table to destroy (NULL is ignored).
+ *
+ * @preconditions
+ *      The readers of the table were destroyed, and no thread writes to it.
+ */
+void destroyRcuTable(RcuTable table);
+
+/**
+ * Register a thread as a reader of a table (takes the writers' lock).
+ *
+ * @param
+ *      RcuTable table - Table to read.
+ *
+ * @preconditions
+ *      table != NULL
+ *
+ * @return
+ *      The reader, which has to be destroyed by destroyRcuReader before the table is destroyed.
+ */
+RcuReader createRcuReader(RcuTable table);
+
+/**
+ * Unregister a reader (takes the writers' lock).
+ *
+ * @param
+ *      RcuReader reader - Reader to destroy (NULL is ignored).
+ */
+void destroyRcuReader(RcuReader reader);
+
+/**
+ * Get the value of a name (wait-free).
+ * Each reader must be used by a single thread at a time.
+ *
+ * @param
+ *      RcuReader reader - Reader of the thread.
+ *      NameId id - Interned name of the variable.
+ *      OUT double* value - The value, if the name is in the table.
+ *
+ * @preconditions
+ *      reader != NULL, value != NULL
+ *
+ * @return
+ *      true iff the name is in the table.
+ */
+bool rcuTableGetValue(RcuReader reader, NameId id, OUT double* value);
+
+/**
+ * Insert (or modify) the value of a name.
+ * Concurrent readers see either the old or the new value, until the write returns.
+ *
+ * @param
+ *      RcuTable table - Table to modify.
+ *      NameId id - Interned name of the variable.
+ *      double value - The new value.
+ *
+ * @preconditions
+ *      table != NULL, id != NO_NAME_ID
+ */
+void rcuTableInsert(RcuTable table, NameId id, double value);
+
+/**
+ * Delete the value of a name.
+ *
+ * @param
+ *      RcuTable table - Table to modify.
+ *      NameId id - Interned name of the variable.
+ *
+ * @preconditions
+ *      table != NULL
+ *
+ * @return
+ *      true iff the name was in the table.
+ */
+bool rcuTableDelete(RcuTable table, NameId id);
+
+/**
+ * Get the amount of values in a table (at some point during the call).
+ *
+ * @param
+ *      RcuTable table - Table to check.
+ *
+ * @preconditions
+ *      table != NULL
+ *
+ * @return
+ *      Amount of values.
+ */
+unsigned int rcuTableGetSize(RcuTable table);
+
+#endif /* RCUTABLE_H_ */
@@ -0,0 +1,285 @@
+/*
+ * Vector Reduction Module
+ */
+
+#include <stddef.h>
+#include <math.h>
+#include "reduce.h"
+#include "common.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define REDUCE_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Types
+ */
+
+/* Kernel that reduces an array of doubles into a single value */
+typedef double (*ReduceFunc)(const double*, unsigned int);
+
+/* Set of kernels implemented with the same instruction set */
+typedef struct ReduceKernels_
+{
+    ReduceFunc min;
+    ReduceFunc max;
+} ReduceKernels;
+
+/*
+ * Internal Function Declarations
+ */
+
+const ReduceKernels* getKernels();
+double lastZero(const double* values, unsigned int count, double result);
+double reduceMinScalar(const double* values, unsigned int count);
+double reduceMaxScalar(const double* values, unsigned int count);
+double reduceSumScalar(const double* values, unsigned int count);
+#ifdef REDUCE_X86
+double reduceMinSse2(const double* values, unsigned int count);
+double reduceMaxSse2(const double* values, unsigned int count);
+double reduceMinAvx(const double* values, unsigned int count);
+double reduceMaxAvx(const double* values, unsigned int count);
+#endif
+
+/*
+ * Constants
+ */
+
+const ReduceKernels SCALAR_KERNELS = {reduceMinScalar, reduceMaxScalar};
+#ifdef REDUCE_X86
+const ReduceKernels SSE2_KERNELS = {reduceMinSse2, reduceMaxSse2};
+const ReduceKernels AVX_KERNELS = {reduceMinAvx, reduceMaxAvx};
+#endif
+
+/*
+ * Module Functions
+ */
+
+double reduceMin(const double* values, unsigned int count)
+{
+    VERIFY(values != NULL);
+    VERIFY(count > 0);
+    double result = getKernels()->min(values, count);
+    return lastZero(values, count, result);
+}
+
+double reduceMax(const double* values, unsigned int count)
+{
+    VERIFY(values != NULL);
+    VERIFY(count > 0);
+    double result = getKernels()->max(values, count);
+    return lastZero(values, count, result);
+}
+
+double reduceSum(const double* values, unsigned int count)
+{
+    VERIFY(values != NULL);
+    /* Floating point addition isn't associative, so the sum isn't split into vector lanes */
+    return reduceSumScalar(values, count);
+}
+
+/*
+ * Internal Functions
+ */
+
+/**
+ * Select the best kernel set supported by the running CPU.
+ * The selection is done once, on the first call.
+ *
+ * @return
+ *      Kernel set to use.
+ */
+const ReduceKernels* getKernels()
+{
+    static const ReduceKernels* kernels = NULL;
+    if (kernels != NULL) {
+        return kernels;
+    }
+
+    kernels = &SCALAR_KERNELS;
+#ifdef REDUCE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx")) {
+        kernels = &AVX_KERNELS;
+    } else if (__builtin_cpu_supports("sse2")) {
+        kernels = &SSE2_KERNELS;
+    }
+#endif
+    return kernels;
+}
+
+/**
+ * Fix the sign of a zero min/max result.
+ * A sequential fmin/fmax fold returns the later operand on ties, so when the result is zero,
+ * it has the sign of the last zero in the array. The vector kernels compare lanes
+ * out of order, so this is restored here.
+ *
+ * @param
+ *      const double* values - Reduced values.
+ *      unsigned int count - Amount of values in the array.
+ *      double result - Result of the reduction.
+ *
+ * @return
+ *      The result, with the sign of the last zero if the result is zero.
+ */
+double lastZero(const double* values, unsigned int count, double result)
+{
+    if (result != 0) {
+        return result;
+    }
+    for (unsigned int i = count; i > 0; --i)
+    {
+        if (values[i - 1] == 0) {
+            return values[i - 1];
+        }
+    }
+    return result;
+}
+
+/*
+ * Scalar Kernels
+ */
+
+double reduceMinScalar(const double* values, unsigned int count)
+{
+    double result = INFINITY;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        if (isnan(values[i])) {
+            return NAN;
+        }
+        result = (values[i] <= result) ? values[i] : result;
+    }
+    return result;
+}
+
+double reduceMaxScalar(const double* values, unsigned int count)
+{
+    double result = -INFINITY;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        if (isnan(values[i])) {
+            return NAN;
+        }
+        result = (values[i] >= result) ? values[i] : result;
+    }
+    return result;
+}
+
+double reduceSumScalar(const double* values, unsigned int count)
+{
+    double sum = 0;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        sum += values[i];
+    }
+    return sum;
+}
+
+#ifdef REDUCE_X86
+
+/*
+ * SSE2 Kernels
+ * Two lanes are processed per instruction. NAN operands are tracked with an unordered
+ * comparison mask, since minpd/maxpd don't propagate NAN from both operands.
+ */
+
+__attribute__((target("sse2")))
+double reduceMinSse2(const double* values, unsigned int count)
+{
+    __m128d accumulator = _mm_set1_pd(INFINITY);
+    __m128d nan_mask = _mm_setzero_pd();
+    unsigned int i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128d current = _mm_loadu_pd(values + i);
+        nan_mask = _mm_or_pd(nan_mask, _mm_cmpunord_pd(current, current));
+        accumulator = _mm_min_pd(accumulator, current);
+    }
+    if (_mm_movemask_pd(nan_mask) != 0) {
+        return NAN;
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, accumulator);
+    double result = fmin(lanes[0], lanes[1]);
+    double tail = reduceMinScalar(values + i, count - i);
+    return isnan(tail) ? NAN : fmin(result, tail);
+}
+
+__attribute__((target("sse2")))
+double reduceMaxSse2(const double* values, unsigned int count)
+{
+    __m128d accumulator = _mm_set1_pd(-INFINITY);
+    __m128d nan_mask = _mm_setzero_pd();
+    unsigned int i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128d current = _mm_loadu_pd(values + i);
+        nan_mask = _mm_or_pd(nan_mask, _mm_cmpunord_pd(current, current));
+        accumulator = _mm_max_pd(accumulator, current);
+    }
+    if (_mm_movemask_pd(nan_mask) != 0) {
+        return NAN;
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, accumulator);
+    double result = fmax(lanes[0], lanes[1]);
+    double tail = reduceMaxScalar(values + i, count - i);
+    return isnan(tail) ? NAN : fmax(result, tail);
+}
+
+/*
+ * AVX Kernels
+ * Same as the SSE2 kernels, with four lanes per instruction.
+ */
+
+__attribute__((target("avx")))
+double reduceMinAvx(const double* values, unsigned int count)
+{
+    __m256d accumulator = _mm256_set1_pd(INFINITY);
+    __m256d nan_mask = _mm256_setzero_pd();
+    unsigned int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d current = _mm256_loadu_pd(values + i);
+        nan_mask = _mm256_or_pd(nan_mask, _mm256_cmp_pd(current, current, _CMP_UNORD_Q));
+        accumulator = _mm256_min_pd(accumulator, current);
+    }
+    if (_mm256_movemask_pd(nan_mask) != 0) {
+        return NAN;
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, accumulator);
+    double result = fmin(fmin(lanes[0], lanes[1]), fmin(lanes[2], lanes[3]));
+    double tail = reduceMinScalar(values + i, count - i);
+    return isnan(tail) ? NAN : fmin(result, tail);
+}
+
+__attribute__((target("avx")))
+double reduceMaxAvx(const double* values, unsigned int count)
+{
+    __m256d accumulator = _mm256_set1_pd(-INFINITY);
+    __m256d nan_mask = _mm256_setzero_pd();
+    unsigned int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d current = _mm256_loadu_pd(values + i);
+        nan_mask = _mm256_or_pd(nan_mask, _mm256_cmp_pd(current, current, _CMP_UNORD_Q));
+        accumulator = _mm256_max_pd(accumulator, current);
+    }
+    if (_mm256_movemask_pd(nan_mask) != 0) {
+        return NAN;
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, accumulator);
+    double result = fmax(fmax(lanes[0], lanes[1]), fmax(lanes[2], lanes[3]));
+    double tail = reduceMaxScalar(values + i, count - i);
+    return isnan(tail) ? NAN : fmax(result, tail);
+}
+
+#endif /* REDUCE_X86 */
@@ -0,0 +1,68 @@
+/*
+ * Vector Reduction Module
+ */
+
+#ifndef REDUCE_H_
+#define REDUCE_H_
+
+/*
+ * Functions
+ */
+
+/**
+ * Find the minimum of an array of values.
+ * If any of the values is NAN, then NAN is returned.
+ * Ties between 0 and -0 are resolved like a left-to-right fmin fold,
+ * i.e. the last zero in the array wins.
+ *
+ * The reduction kernel (AVX, SSE2 or scalar) is selected at runtime
+ * according to the features supported by the CPU.
+ *
+ * @param
+ *      const double* values - Values to reduce.
+ *      unsigned int count - Amount of values in the array.
+ *
+ * @preconditions
+ *      values != NULL, count > 0
+ *
+ * @return
+ *      Minimum value.
+ */
+double reduceMin(const double* values, unsigned int count);
+
+/**
+ * Find the maximum of an array of values.
+ * If any of the values is NAN, then NAN is returned.
+ * Ties between 0 and -0 are resolved like a left-to-right fmax fold.
+ *
+ * @param
+ *      const double* values - Values to reduce.
+ *      unsigned int count - Amount of values in the array.
+ *
+ * @preconditions
+ *      values != NULL, count > 0
+ *
+ * @return
+ *      Maximum value.
+ */
+double reduceMax(const double* values, unsigned int count);
+
+/**
+ * Sum an array of values.
+ * If any of the values is NAN, then NAN is returned.
+ * The values are added left to right (unlike min and max, which are exact in any order,
+ * a regrouped sum may differ in the last bits), so it's always the same as a sequential loop.
+ *
+ * @param
+ *      const double* values - Values to reduce.
+ *      unsigned int count - Amount of values in the array.
+ *
+ * @preconditions
+ *      values != NULL
+ *
+ * @return
+ *      Sum of the values.
+ */
+double reduceSum(const double* values, unsigned int count);
+
+#endif /* REDUCE_H_ */
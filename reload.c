@@ -0,0 +1,752 @@
+/*
+ * Variable File Reload Module
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "reload.h"
+#include "parse.h"
+#include "stats.h"
+#include "alloc.h"
+#include "common.h"
+
+/*
+ * Constants
+ */
+
+/* Minimal amount of slots in the index of a snapshot (a power of 2) */
+#define RELOAD_MIN_CAPACITY 16
+
+/* Events which mean that the file was written (in place, or by renaming a new file over it) */
+#define RELOAD_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO)
+
+/* Events which are watched: the file is also being written while it's modified (or truncated) */
+#define RELOAD_WATCHED_EVENTS (RELOAD_EVENTS | IN_MODIFY)
+
+/* Time that a loaded version must stay unmodified to be applied (in nanoseconds) */
+#define RELOAD_SETTLE_TIME 10000000
+
+/* Size of the buffer which inotify events are read into */
+#define RELOAD_EVENTS_BUFFER_SIZE 4096
+
+/*
+ * Types
+ */
+
+/* Assignment of the file. The name is referred to by it's offset in the snapshot's text. */
+typedef struct ReloadEntry_
+{
+    size_t name_offset;
+    uint32_t name_length;
+    uint32_t hash;              /* hashBytes of the name */
+    double value;
+} ReloadEntry;
+
+/* Loaded version of the file. All of it's memory is mapped, so it's loaded without the allocator. */
+typedef struct ReloadSnapshot_
+{
+    char* text;                 /* Copy of the file (so it doesn't change while it's the baseline) */
+    size_t text_size;           /* Size of the text's mapping */
+    ReloadEntry* entries;       /* Entries of the names, in the order they first appear in the file */
+    size_t entries_size;        /* Size of the entries' mapping */
+    unsigned int entries_count;
+    uint32_t* slots;            /* Open addressing index of the entries (index + 1, 0 if the slot is empty) */
+    size_t slots_size;
+    uint32_t slots_mask;        /* Amount of slots - 1 */
+} ReloadSnapshot;
+
+/* Change of a variable, which refers to the name in the text of the snapshot it's from */
+typedef struct ReloadChange_
+{
+    const char* name;
+    uint32_t name_length;
+    bool is_removed;            /* Whether the name was removed from the file (rather than assigned) */
+    bool had_old_value;         /* Whether the name was in the baseline */
+    double old_value;
+    double new_value;
+} ReloadChange;
+
+/* Changes found by a diff */
+typedef struct ReloadChanges_
+{
+    ReloadChange* changes;
+    size_t changes_size;        /* Size of the changes' mapping (which is reserved for the worst case) */
+    unsigned int count;
+} ReloadChanges;
+
+struct VariableReloader_t
+{
+    char* path;
+    const char* file_name;      /* Last component of the path (the name in the events of it's directory) */
+    ReloadPolicy policy;
+    int inotify_fd;
+    int stop_pipe[2];           /* Written to by destroyVariableReloader, to wake the thread up */
+    pthread_t thread;
+    ReloadSnapshot baseline;    /* Owned by the thread, once it's started */
+    pthread_mutex_t lock;
+    pthread_cond_t applied_condition;
+    ReloadChanges pending;      /* Changes handed over by the thread (modified under the lock) */
+    bool has_pending;           /* Also read without the lock, so checking for changes between lines is cheap */
+    bool is_stopping;
+};
+
+/*
+ * Internal Function Declarations
+ */
+
+void* watchVariableFile(void* argument);
+uint32_t readReloadEvents(VariableReloader reloader);
+void reloadVariableFile(VariableReloader reloader);
+bool isReloadedFileChanged(const char* path, const struct stat* status);
+bool loadReloadSnapshot(const char* path, OUT ReloadSnapshot* snapshot, OUT struct stat* status,
+                        OUT const char** error);
+bool parseReloadLine(ReloadSnapshot* snapshot, size_t line_offset, size_t length);
+size_t nextReloadToken(const char* line, size_t length, size_t* position);
+uint32_t* findReloadSlot(const ReloadSnapshot* snapshot, const char* name, uint32_t length, uint32_t hash);
+const ReloadEntry* findReloadEntry(const ReloadSnapshot* snapshot, const char* name, uint32_t length, uint32_t hash);
+void unloadReloadSnapshot(ReloadSnapshot* snapshot);
+bool diffReloadSnapshots(const ReloadSnapshot* baseline, const ReloadSnapshot* snapshot, OUT ReloadChanges* changes);
+bool applyReloadChange(const ReloadChange* change, ReloadPolicy policy, HashTable variables);
+void* mapReloadMemory(size_t size);
+void unmapReloadMemory(void* memory, size_t size);
+
+/*
+ * Module Functions
+ */
+
+VariableReloader createVariableReloader(const char* path, ReloadPolicy policy, HashTable variables)
+{
+    VERIFY(path != NULL);
+    VERIFY(variables != NULL);
+
+    VariableReloader reloader = ALLOCATE(ALLOC_VARIABLES, sizeof(*reloader));
+    VERIFY(reloader != NULL);
+    size_t path_length = strlen(path);
+    reloader->path = ALLOCATE(ALLOC_VARIABLES, path_length + 1);
+    VERIFY(reloader->path != NULL);
+    memcpy(reloader->path, path, path_length + 1);
+    reloader->policy = policy;
+    reloader->has_pending = false;
+    reloader->is_stopping = false;
+
+    /* The directory is watched rather than the file, so a file which is replaced by a rename is still watched */
+    const char* slash = strrchr(reloader->path, '/');
+    reloader->file_name = (slash != NULL) ? slash + 1 : reloader->path;
+    char* directory = ALLOCATE(ALLOC_VARIABLES, path_length + 2);
+    VERIFY(directory != NULL);
+    if (slash == NULL) {
+        strcpy(directory, ".");
+    } else {
+        size_t directory_length = (slash == reloader->path) ? 1 : (size_t)(slash - reloader->path);
+        memcpy(directory, reloader->path, directory_length);
+        directory[directory_length] = '\0';
+    }
+    reloader->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    bool is_watched = (reloader->inotify_fd != -1)
+                      && inotify_add_watch(reloader->inotify_fd, directory, RELOAD_WATCHED_EVENTS) != -1;
+    deallocate(directory);
+    if (!is_watched || pipe(reloader->stop_pipe) != 0) {
+        if (reloader->inotify_fd != -1) {
+            close(reloader->inotify_fd);
+        }
+        deallocate(reloader->path);
+        deallocate(reloader);
+        return NULL;
+    }
+
+    /* The baseline is loaded after the watch is added, so a write meanwhile is reloaded */
+    const char* error = NULL;
+    struct stat status;
+    VERIFY(loadReloadSnapshot(reloader->path, &reloader->baseline, &status, &error));
+    for (unsigned int i = 0; i < reloader->baseline.entries_count; ++i)
+    {
+        const ReloadEntry* entry = &reloader->baseline.entries[i];
+        char name[MAX_LINE_LENGTH + 1];
+        memcpy(name, reloader->baseline.text + entry->name_offset, entry->name_length);
+        name[entry->name_length] = '\0';
+        hashInsert(variables, name, entry->value);
+    }
+
+    VERIFY(pthread_mutex_init(&reloader->lock, NULL) == 0);
+    VERIFY(pthread_cond_init(&reloader->applied_condition, NULL) == 0);
+    VERIFY(pthread_create(&reloader->thread, NULL, watchVariableFile, reloader) == 0);
+    return reloader;
+}
+
+unsigned int applyVariableReload(VariableReloader reloader, HashTable variables)
+{
+    VERIFY(reloader != NULL);
+    VERIFY(variables != NULL);
+
+    if (!__atomic_load_n(&reloader->has_pending, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+
+    VERIFY(pthread_mutex_lock(&reloader->lock) == 0);
+    unsigned int changed_count = 0;
+    for (unsigned int i = 0; i < reloader->pending.count; ++i)
+    {
+        if (applyReloadChange(&reloader->pending.changes[i], reloader->policy, variables)) {
+            changed_count += 1;
+            COUNT_STAT(COUNTER_VARIABLES_RELOADED);
+        }
+    }
+    __atomic_store_n(&reloader->has_pending, false, __ATOMIC_RELEASE);
+    VERIFY(pthread_cond_signal(&reloader->applied_condition) == 0);
+    VERIFY(pthread_mutex_unlock(&reloader->lock) == 0);
+    return changed_count;
+}
+
+void destroyVariableReloader(VariableReloader reloader)
+{
+    if (reloader == NULL) {
+        return;
+    }
+
+    /* The thread is woken up whether it waits for the file, or for it's changes to be applied */
+    VERIFY(pthread_mutex_lock(&reloader->lock) == 0);
+    reloader->is_stopping = true;
+    VERIFY(pthread_cond_signal(&reloader->applied_condition) == 0);
+    VERIFY(pthread_mutex_unlock(&reloader->lock) == 0);
+    VERIFY(write(reloader->stop_pipe[1], "", 1) == 1);
+    VERIFY(pthread_join(reloader->thread, NULL) == 0);
+
+    unloadReloadSnapshot(&reloader->baseline);
+    VERIFY(pthread_cond_destroy(&reloader->applied_condition) == 0);
+    VERIFY(pthread_mutex_destroy(&reloader->lock) == 0);
+    close(reloader->stop_pipe[0]);
+    close(reloader->stop_pipe[1]);
+    close(reloader->inotify_fd);
+    deallocate(reloader->path);
+    deallocate(reloader);
+}
+
+/*
+ * Internal Functions
+ */
+
+/**
+ * Main function of the reloading thread: reloads the file whenever it's written, until the reloader is destroyed.
+ *
+ * @param
+ *      void* argument - The reloader.
+ */
+void* watchVariableFile(void* argument)
+{
+    VariableReloader reloader = argument;
+    /* Signals (such as statistics requests) are handled by the main thread */
+    sigset_t signals;
+    sigfillset(&signals);
+    VERIFY(pthread_sigmask(SIG_BLOCK, &signals, NULL) == 0);
+
+    struct pollfd descriptors[2] = {
+        {reloader->inotify_fd, POLLIN, 0},
+        {reloader->stop_pipe[0], POLLIN, 0}
+    };
+    while (true)
+    {
+        if (poll(descriptors, ARRAY_LENGTH(descriptors), -1) == -1) {
+            VERIFY(errno == EINTR);
+            continue;
+        }
+        if (descriptors[1].revents != 0) {
+            break;
+        }
+        if (readReloadEvents(reloader) & RELOAD_EVENTS) {
+            reloadVariableFile(reloader);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Read the pending events of the watched directory.
+ *
+ * @param
+ *      VariableReloader reloader - The reloader.
+ *
+ * @return
+ *      Events of the file, or 0 if there were none (lost events count as a write of the file,
+ *      since it might have been written). The kernel merges repeated events, so their order isn't kept.
+ */
+uint32_t readReloadEvents(VariableReloader reloader)
+{
+    /* Aligned for the events (which are read straight into it) */
+    uint64_t buffer[RELOAD_EVENTS_BUFFER_SIZE / sizeof(uint64_t)];
+    uint32_t file_events = 0;
+    ssize_t length;
+    while ((length = read(reloader->inotify_fd, buffer, sizeof(buffer))) > 0)
+    {
+        const char* events = (const char*)buffer;
+        for (ssize_t offset = 0; offset < length; )
+        {
+            const struct inotify_event* event = (const struct inotify_event*)(events + offset);
+            if (event->mask & IN_Q_OVERFLOW) {
+                file_events |= IN_CLOSE_WRITE;
+            } else if (event->len > 0 && strcmp(event->name, reloader->file_name) == 0) {
+                file_events |= event->mask;
+            }
+            offset += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return file_events;
+}
+
+/**
+ * Load the file, and hand it's changes from the baseline over to the main thread.
+ * The new version becomes the baseline once the changes are applied (the removed names refer to the old one).
+ * A version might be loaded while the file is rewritten in place (e.g. after it was truncated, and before
+ * it's written), so it's applied only if the file isn't modified for a while after it was loaded.
+ * Otherwise it's dropped, and the file is loaded again once it's written.
+ *
+ * @param
+ *      VariableReloader reloader - The reloader.
+ */
+void reloadVariableFile(VariableReloader reloader)
+{
+    ReloadSnapshot snapshot;
+    ReloadChanges changes;
+    const char* error = NULL;
+    struct stat status;
+    bool is_loaded;
+    bool is_changed;
+    uint32_t file_events;
+    do {
+        is_loaded = loadReloadSnapshot(reloader->path, &snapshot, &status, &error);
+        struct timespec settle_time = {0, RELOAD_SETTLE_TIME};
+        nanosleep(&settle_time, NULL);
+        file_events = readReloadEvents(reloader);
+        is_changed = (file_events != 0) || isReloadedFileChanged(reloader->path, &status);
+        if (is_loaded && is_changed) {
+            unloadReloadSnapshot(&snapshot);
+            is_loaded = false;
+        }
+    } while (file_events & RELOAD_EVENTS);
+    if (!is_loaded) {
+        if (!is_changed) {
+            fprintf(stderr, "Variable file reload failed (%s), the file is ignored until it's written again\n", error);
+        }
+        return;
+    }
+    if (!diffReloadSnapshots(&reloader->baseline, &snapshot, &changes)) {
+        fprintf(stderr, "Variable file reload failed (out of memory), the file is ignored until it's written again\n");
+        unloadReloadSnapshot(&snapshot);
+        return;
+    }
+
+    if (changes.count > 0) {
+        VERIFY(pthread_mutex_lock(&reloader->lock) == 0);
+        reloader->pending = changes;
+        __atomic_store_n(&reloader->has_pending, true, __ATOMIC_RELEASE);
+        while (reloader->has_pending && !reloader->is_stopping)
+        {
+            VERIFY(pthread_cond_wait(&reloader->applied_condition, &reloader->lock) == 0);
+        }
+        VERIFY(pthread_mutex_unlock(&reloader->lock) == 0);
+    }
+
+    unmapReloadMemory(changes.changes, changes.changes_size);
+    unloadReloadSnapshot(&reloader->baseline);
+    reloader->baseline = snapshot;
+}
+
+/**
+ * Check whether the file was modified (or replaced) since it was loaded.
+ *
+ * @param
+ *      const char* path - Path of the file.
+ *      const struct stat* status - Status of the file when it was loaded.
+ *
+ * @return
+ *      true iff the file's status changed (or it can't be read).
+ */
+bool isReloadedFileChanged(const char* path, const struct stat* status)
+{
+    struct stat current;
+    return stat(path, &current) != 0
+           || current.st_dev != status->st_dev
+           || current.st_ino != status->st_ino
+           || current.st_size != status->st_size
+           || current.st_mtim.tv_sec != status->st_mtim.tv_sec
+           || current.st_mtim.tv_nsec != status->st_mtim.tv_nsec
+           || current.st_ctim.tv_sec != status->st_ctim.tv_sec
+           || current.st_ctim.tv_nsec != status->st_ctim.tv_nsec;
+}
+
+/**
+ * Load a version of the file into a snapshot.
+ * The file is read (rather than mapped), so the snapshot isn't modified by later writes to the file.
+ *
+ * @param
+ *      const char* path - Path of the file.
+ *      OUT ReloadSnapshot* snapshot - The loaded snapshot.
+ *      OUT struct stat* status - Status of the file when it was loaded (even if it isn't valid).
+ *      OUT const char** error - Description of the error, if the file couldn't be loaded.
+ *
+ * @return
+ *      true iff the file was loaded (and is valid).
+ */
+bool loadReloadSnapshot(const char* path, OUT ReloadSnapshot* snapshot, OUT struct stat* status,
+                        OUT const char** error)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+    memset(status, 0, sizeof(*status));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1 || fstat(fd, status) != 0) {
+        if (fd != -1) {
+            close(fd);
+        }
+        *error = "the file can't be read";
+        return false;
+    }
+
+    /* The text is null-terminated, so an empty file has a mapping too */
+    snapshot->text_size = (size_t)status->st_size + 1;
+    snapshot->text = mapReloadMemory(snapshot->text_size);
+    size_t text_length = 0;
+    while (snapshot->text != NULL && text_length < snapshot->text_size - 1)
+    {
+        ssize_t read_length = read(fd, snapshot->text + text_length, snapshot->text_size - 1 - text_length);
+        if (read_length == 0 || (read_length == -1 && errno != EINTR)) {
+            break;
+        }
+        text_length += (read_length > 0) ? (size_t)read_length : 0;
+    }
+    close(fd);
+    if (snapshot->text == NULL) {
+        *error = "out of memory";
+        return false;
+    }
+
+    /* Each line has at most one entry, and the index is at most half full */
+    size_t lines_count = 1;
+    for (const char* line_end = memchr(snapshot->text, '\n', text_length); line_end != NULL;
+         line_end = memchr(line_end + 1, '\n', text_length - (size_t)(line_end + 1 - snapshot->text)))
+    {
+        lines_count += 1;
+    }
+    size_t capacity = RELOAD_MIN_CAPACITY;
+    while (capacity < 2 * lines_count)
+    {
+        capacity *= 2;
+    }
+    snapshot->entries_size = lines_count * sizeof(ReloadEntry);
+    snapshot->entries = mapReloadMemory(snapshot->entries_size);
+    snapshot->slots_size = capacity * sizeof(uint32_t);
+    snapshot->slots = mapReloadMemory(snapshot->slots_size);
+    snapshot->slots_mask = (uint32_t)(capacity - 1);
+    if (snapshot->entries == NULL || snapshot->slots == NULL || capacity > UINT32_MAX) {
+        unloadReloadSnapshot(snapshot);
+        *error = "out of memory";
+        return false;
+    }
+
+    /* Like fgets, the text after the last new line is a line only if it isn't empty */
+    for (size_t line_offset = 0; line_offset < text_length; )
+    {
+        const char* line_end = memchr(snapshot->text + line_offset, '\n', text_length - line_offset);
+        size_t length = (line_end != NULL) ? (size_t)(line_end - snapshot->text) - line_offset : text_length - line_offset;
+        if (!parseReloadLine(snapshot, line_offset, length)) {
+            unloadReloadSnapshot(snapshot);
+            *error = "the file isn't a valid variable init file";
+            return false;
+        }
+        line_offset += length + 1;
+    }
+    return true;
+}
+
+/**
+ * Parse an assignment line of the file (like parseVariableAssignmentLine), and add it to a snapshot.
+ * If the name was already assigned by an earlier line, it's value is replaced.
+ *
+ * @param
+ *      ReloadSnapshot* snapshot - Snapshot whose text has the line.
+ *      size_t line_offset - Offset of the line in the text.
+ *      size_t length - Length of the line (without it's new line).
+ *
+ * @return
+ *      true iff the line is valid.
+ */
+bool parseReloadLine(ReloadSnapshot* snapshot, size_t line_offset, size_t length)
+{
+    /* Longer lines don't fit in the line buffer of parseVariableInputFile */
+    if (length >= MAX_LINE_LENGTH) {
+        return false;
+    }
+    const char* line = snapshot->text + line_offset;
+
+    /* Parse name */
+    size_t position = 0;
+    size_t name_length = nextReloadToken(line, length, &position);
+    const char* name = line + position - name_length;
+    if (name_length == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < name_length; ++i)
+    {
+        if (!isLetter(name[i])) {
+            return false;
+        }
+    }
+
+    /* Parse '=' */
+    size_t token_length = nextReloadToken(line, length, &position);
+    if (token_length != 1 || line[position - 1] != '=') {
+        return false;
+    }
+
+    /* Parse number (which must be the whole token) */
+    token_length = nextReloadToken(line, length, &position);
+    if (token_length == 0) {
+        return false;
+    }
+    char number[MAX_LINE_LENGTH + 1];
+    memcpy(number, line + position - token_length, token_length);
+    number[token_length] = '\0';
+    char* number_end;
+    errno = 0;
+    long int value = strtol(number, &number_end, 10);
+    if (errno != 0 || *number_end != '\0') {
+        return false;
+    }
+
+    /* Make sure there are no remaining tokens */
+    if (nextReloadToken(line, length, &position) != 0) {
+        return false;
+    }
+
+    uint32_t hash = hashBytes(HASH_SEED, name, name_length);
+    uint32_t* slot = findReloadSlot(snapshot, name, (uint32_t)name_length, hash);
+    if (*slot == 0) {
+        ReloadEntry* entry = &snapshot->entries[snapshot->entries_count];
+        entry->name_offset = (size_t)(name - snapshot->text);
+        entry->name_length = (uint32_t)name_length;
+        entry->hash = hash;
+        snapshot->entries_count += 1;
+        *slot = snapshot->entries_count;
+    }
+    snapshot->entries[*slot - 1].value = (double)value;
+    return true;
+}
+
+/**
+ * Find the next token of a line (the tokens are separated by DELIMITERS, like in parseVariableAssignmentLine).
+ *
+ * @param
+ *      const char* line - The line.
+ *      size_t length - Length of the line.
+ *      size_t* position - Position to search from, which is advanced to the end of the token.
+ *
+ * @return
+ *      Length of the token (which ends at the new position), or 0 if there are no more tokens.
+ */
+size_t nextReloadToken(const char* line, size_t length, size_t* position)
+{
+    size_t start = *position;
+    while (start < length && (line[start] == ' ' || line[start] == '\t'))
+    {
+        start += 1;
+    }
+    size_t end = start;
+    while (end < length && line[end] != ' ' && line[end] != '\t')
+    {
+        end += 1;
+    }
+    *position = end;
+    return end - start;
+}
+
+/**
+ * Find the slot of a name in the index of a snapshot.
+ *
+ * @param
+ *      const ReloadSnapshot* snapshot - Snapshot to search.
+ *      const char* name - The name (which isn't null-terminated).
+ *      uint32_t length - Length of the name.
+ *      uint32_t hash - hashBytes of the name.
+ *
+ * @return
+ *      The slot of the name's entry, or the empty slot at the end of it's probing.
+ */
+uint32_t* findReloadSlot(const ReloadSnapshot* snapshot, const char* name, uint32_t length, uint32_t hash)
+{
+    for (uint32_t index = hash & snapshot->slots_mask; ; index = (index + 1) & snapshot->slots_mask)
+    {
+        uint32_t* slot = &snapshot->slots[index];
+        if (*slot == 0) {
+            return slot;
+        }
+        const ReloadEntry* entry = &snapshot->entries[*slot - 1];
+        if (entry->hash == hash && entry->name_length == length
+            && memcmp(snapshot->text + entry->name_offset, name, length) == 0) {
+            return slot;
+        }
+    }
+}
+
+/**
+ * Find the entry of a name in a snapshot.
+ *
+ * @return
+ *      The entry, or NULL if the name isn't assigned in the snapshot.
+ */
+const ReloadEntry* findReloadEntry(const ReloadSnapshot* snapshot, const char* name, uint32_t length, uint32_t hash)
+{
+    uint32_t* slot = findReloadSlot(snapshot, name, length, hash);
+    return (*slot != 0) ? &snapshot->entries[*slot - 1] : NULL;
+}
+
+/**
+ * Free the memory of a snapshot.
+ *
+ * @param
+ *      ReloadSnapshot* snapshot - Snapshot to free (it's mappings may be NULL).
+ */
+void unloadReloadSnapshot(ReloadSnapshot* snapshot)
+{
+    unmapReloadMemory(snapshot->text, snapshot->text_size);
+    unmapReloadMemory(snapshot->entries, snapshot->entries_size);
+    unmapReloadMemory(snapshot->slots, snapshot->slots_size);
+    memset(snapshot, 0, sizeof(*snapshot));
+}
+
+/**
+ * Find the changes from the baseline to a new version of the file.
+ * The changes' memory is reserved for the case that every name changed, and only the changes found are touched.
+ *
+ * @param
+ *      const ReloadSnapshot* baseline - Previous version of the file.
+ *      const ReloadSnapshot* snapshot - New version of the file.
+ *      OUT ReloadChanges* changes - The changed names (which refer to the texts of both snapshots).
+ *
+ * @return
+ *      false iff there's no memory for the changes.
+ */
+bool diffReloadSnapshots(const ReloadSnapshot* baseline, const ReloadSnapshot* snapshot, OUT ReloadChanges* changes)
+{
+    changes->count = 0;
+    changes->changes_size = ((size_t)baseline->entries_count + snapshot->entries_count + 1) * sizeof(ReloadChange);
+    changes->changes = mapReloadMemory(changes->changes_size);
+    if (changes->changes == NULL) {
+        return false;
+    }
+
+    /* Assigned and changed names */
+    for (unsigned int i = 0; i < snapshot->entries_count; ++i)
+    {
+        const ReloadEntry* entry = &snapshot->entries[i];
+        const char* name = snapshot->text + entry->name_offset;
+        const ReloadEntry* old_entry = findReloadEntry(baseline, name, entry->name_length, entry->hash);
+        if (old_entry == NULL || old_entry->value != entry->value) {
+            ReloadChange* change = &changes->changes[changes->count++];
+            change->name = name;
+            change->name_length = entry->name_length;
+            change->is_removed = false;
+            change->had_old_value = (old_entry != NULL);
+            change->old_value = (old_entry != NULL) ? old_entry->value : 0;
+            change->new_value = entry->value;
+        }
+    }
+
+    /* Removed names */
+    for (unsigned int i = 0; i < baseline->entries_count; ++i)
+    {
+        const ReloadEntry* entry = &baseline->entries[i];
+        const char* name = baseline->text + entry->name_offset;
+        if (findReloadEntry(snapshot, name, entry->name_length, entry->hash) == NULL) {
+            ReloadChange* change = &changes->changes[changes->count++];
+            change->name = name;
+            change->name_length = entry->name_length;
+            change->is_removed = true;
+            change->had_old_value = true;
+            change->old_value = entry->value;
+            change->new_value = 0;
+        }
+    }
+    return true;
+}
+
+/**
+ * Apply a change to the variables table, according to the policy.
+ *
+ * @param
+ *      const ReloadChange* change - The change.
+ *      ReloadPolicy policy - Precedence of the file over the session's assignments.
+ *      HashTable variables - The variables table.
+ *
+ * @return
+ *      true iff the variable was changed (or deleted).
+ */
+bool applyReloadChange(const ReloadChange* change, ReloadPolicy policy, HashTable variables)
+{
+    char name[MAX_LINE_LENGTH + 1];
+    memcpy(name, change->name, change->name_length);
+    name[change->name_length] = '\0';
+
+    /* A variable holds the file's value unless it was assigned (or deleted) in the session */
+    bool is_contained = hashContains(variables, name);
+    double value = is_contained ? hashGetValue(variables, name) : 0;
+    bool is_file_value = change->had_old_value ? (is_contained && value == change->old_value) : !is_contained;
+    if (!is_file_value && policy == RELOAD_KEEP_SESSION) {
+        return false;
+    }
+
+    if (change->is_removed) {
+        if (!is_contained) {
+            return false;
+        }
+        hashDelete(variables, name);
+        return true;
+    }
+    /* The value isn't reassigned if it didn't change, so the results which read it stay memoized */
+    if (is_contained && value == change->new_value) {
+        return false;
+    }
+    hashInsert(variables, name, change->new_value);
+    return true;
+}
+
+/**
+ * Map anonymous memory (which the thread may use without the allocator).
+ * The pages are committed when they're first touched.
+ *
+ * @param
+ *      size_t size - Size of the memory (more than 0).
+ *
+ * @return
+ *      The zero-filled memory, or NULL if it couldn't be mapped.
+ */
+void* mapReloadMemory(size_t size)
+{
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return (memory != MAP_FAILED) ? memory : NULL;
+}
+
+/**
+ * Unmap memory of mapReloadMemory.
+ *
+ * @param
+ *      void* memory - The memory (NULL is ignored).
+ *      size_t size - It's size.
+ */
+void unmapReloadMemory(void* memory, size_t size)
+{
+    if (memory != NULL) {
+        VERIFY(munmap(memory, size) == 0);
+    }
+}
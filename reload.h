@@ -0,0 +1,91 @@
+/*
+ * Variable File Reload Module
+ */
+
+#ifndef RELOAD_H_
+#define RELOAD_H_
+
+#include "hashtable.h"
+#include "common.h"
+
+/*
+ * Variable File Reload
+ *
+ * Watches the variable init file (with inotify), and applies the changes made to it to the variables
+ * of a running calculator, without reloading the whole file into the table.
+ *
+ * The file is loaded into a snapshot (a copy of it's text, and an index of it's assignments by name),
+ * which is the baseline of the next reload. When the file is written (closed after writing, or renamed
+ * over), a background thread loads it into a new snapshot, and diffs it with the baseline:
+ * the changed and added assignments, and the names which were removed from the file, are the changes.
+ * The thread doesn't touch the variables table (which isn't thread-safe), it hands the changes over,
+ * and they're applied all at once by applyVariableReload, which is called between input lines.
+ * So a reload of a large file with a few changed lines modifies only these few variables.
+ *
+ * The background thread doesn't allocate with the allocator, or intern names (neither is thread-safe),
+ * it keeps the snapshots and changes in memory of it's own (anonymous mappings).
+ * A reloaded file which isn't valid is reported, and ignored (the baseline is kept).
+ * A version is applied only if the file stays unmodified for a moment after it's loaded, so a file which
+ * is rewritten in place isn't applied half-written. Renaming a new file over it is atomic, so it's preferred.
+ */
+
+/*
+ * Types
+ */
+
+typedef struct VariableReloader_t* VariableReloader;
+
+/* Precedence of the variable file over assignments made in the session */
+typedef enum ReloadPolicy_
+{
+    RELOAD_KEEP_SESSION,    /* A variable which was assigned in the session keeps it's value */
+    RELOAD_PREFER_FILE      /* A variable which was changed in the file takes the file's value */
+} ReloadPolicy;
+
+/*
+ * Functions
+ */
+
+/**
+ * Load the variable file into a table, and start watching it.
+ * Like parseVariableInputFile, an invalid file is an error (which panics).
+ *
+ * @param
+ *      const char* path - Path of the variable file.
+ *      ReloadPolicy policy - Precedence of the file's changes over the session's assignments.
+ *      HashTable variables - Table which the file's variables are loaded into.
+ *
+ * @preconditions
+ *      path != NULL, variables != NULL
+ *
+ * @return
+ *      The reloader, or NULL if the file can't be read or watched.
+ */
+VariableReloader createVariableReloader(const char* path, ReloadPolicy policy, HashTable variables);
+
+/**
+ * Apply the changes of the last reload of the file, if there are any (called between input lines).
+ * A variable whose value in the table isn't it's value in the previous version of the file
+ * was assigned in the session, and is changed only by RELOAD_PREFER_FILE.
+ *
+ * @param
+ *      VariableReloader reloader - The reloader.
+ *      HashTable variables - Table which the file was loaded into.
+ *
+ * @preconditions
+ *      reloader != NULL, variables != NULL
+ *
+ * @return
+ *      Amount of variables which were changed (or deleted).
+ */
+unsigned int applyVariableReload(VariableReloader reloader, HashTable variables);
+
+/**
+ * Stop watching the file, and free the reloader.
+ *
+ * @param
+ *      VariableReloader reloader - Reloader to destroy (NULL is ignored).
+ */
+void destroyVariableReloader(VariableReloader reloader);
+
+#endif /* RELOAD_H_ */
@@ -0,0 +1,149 @@
+/*
+ * Structural Scanning Module
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "scan.h"
+#include "common.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Types
+ */
+
+/* Kernel that indexes the structural characters of SCAN_WORD_BITS bytes into a bitmap word */
+typedef uint64_t (*ScanFunc)(const char*);
+
+/*
+ * Internal Function Declarations
+ */
+
+ScanFunc getScanKernel();
+uint64_t scanWordScalar(const char* block);
+#ifdef SCAN_X86
+uint64_t scanWordSse2(const char* block);
+uint64_t scanWordAvx2(const char* block);
+#endif
+
+/*
+ * Module Functions
+ */
+
+void scanStructure(const char* block, size_t length, uint64_t* bitmap)
+{
+    VERIFY(block != NULL);
+    VERIFY(bitmap != NULL);
+
+    ScanFunc scan = getScanKernel();
+    size_t i = 0;
+    for (; i + SCAN_WORD_BITS <= length; i += SCAN_WORD_BITS)
+    {
+        bitmap[i / SCAN_WORD_BITS] = scan(block + i);
+    }
+
+    /* The last partial word is scanned from a padded copy */
+    if (i < length) {
+        char tail[SCAN_WORD_BITS] = {0};
+        memcpy(tail, block + i, length - i);
+        bitmap[i / SCAN_WORD_BITS] = scan(tail);
+    }
+}
+
+/*
+ * Internal Functions
+ */
+
+/**
+ * Select the best scanning kernel supported by the running CPU.
+ * The selection is done once, on the first call.
+ *
+ * @return
+ *      Kernel to use.
+ */
+ScanFunc getScanKernel()
+{
+    static ScanFunc kernel = NULL;
+    if (kernel != NULL) {
+        return kernel;
+    }
+
+    kernel = scanWordScalar;
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernel = scanWordAvx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        kernel = scanWordSse2;
+    }
+#endif
+    return kernel;
+}
+
+/*
+ * Scanning Kernels
+ * Each kernel compares SCAN_WORD_BITS bytes against the structural characters,
+ * and packs the comparison results into a bitmap word (byte i into bit i).
+ */
+
+uint64_t scanWordScalar(const char* block)
+{
+    uint64_t word = 0;
+    for (unsigned int i = 0; i < SCAN_WORD_BITS; ++i)
+    {
+        char c = block[i];
+        if (c == '(' || c == ')' || c == '\n') {
+            word |= (uint64_t)1 << i;
+        }
+    }
+    return word;
+}
+
+#ifdef SCAN_X86
+
+/* SSE2: four 16 byte vectors per word */
+__attribute__((target("sse2")))
+uint64_t scanWordSse2(const char* block)
+{
+    const __m128i open = _mm_set1_epi8('(');
+    const __m128i close = _mm_set1_epi8(')');
+    const __m128i new_line = _mm_set1_epi8('\n');
+
+    uint64_t word = 0;
+    for (unsigned int i = 0; i < SCAN_WORD_BITS; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i*)(block + i));
+        __m128i matches = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, open),
+                                                     _mm_cmpeq_epi8(bytes, close)),
+                                       _mm_cmpeq_epi8(bytes, new_line));
+        word |= (uint64_t)(uint16_t)_mm_movemask_epi8(matches) << i;
+    }
+    return word;
+}
+
+/* AVX2: two 32 byte vectors per word */
+__attribute__((target("avx2")))
+uint64_t scanWordAvx2(const char* block)
+{
+    const __m256i open = _mm256_set1_epi8('(');
+    const __m256i close = _mm256_set1_epi8(')');
+    const __m256i new_line = _mm256_set1_epi8('\n');
+
+    uint64_t word = 0;
+    for (unsigned int i = 0; i < SCAN_WORD_BITS; i += 32)
+    {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*)(block + i));
+        __m256i matches = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, open),
+                                                          _mm256_cmpeq_epi8(bytes, close)),
+                                          _mm256_cmpeq_epi8(bytes, new_line));
+        word |= (uint64_t)(uint32_t)_mm256_movemask_epi8(matches) << i;
+    }
+    return word;
+}
+
+#endif /* SCAN_X86 */
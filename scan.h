@@ -0,0 +1,41 @@
+/*
+ * Structural Scanning Module
+ */
+
+#ifndef SCAN_H_
+#define SCAN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Constants
+ */
+
+/* Amount of input bytes which are indexed by a single bitmap word */
+#define SCAN_WORD_BITS 64
+
+/*
+ * Functions
+ */
+
+/**
+ * Index the structural characters of a block of Lisp input, i.e. '(', ')' and new-lines.
+ * Bit (i % 64) of bitmap word (i / 64) is set iff byte i of the block is structural,
+ * so the parser can jump between structural characters without examining the bytes between them.
+ *
+ * The scanning kernel (AVX2, SSE2 or scalar) is selected at runtime
+ * according to the features supported by the CPU.
+ *
+ * @param
+ *      const char* block - Block of input to index.
+ *      size_t length - Block length.
+ *      uint64_t* bitmap - Bitmap that receives the index.
+ *                         It has to have room for (length + 63) / 64 words.
+ *
+ * @preconditions
+ *      block != NULL, bitmap != NULL
+ */
+void scanStructure(const char* block, size_t length, uint64_t* bitmap);
+
+#endif /* SCAN_H_ */
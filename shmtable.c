@@ -0,0 +1,281 @@
+/*
+ * Shared Variable Table Module
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shmtable.h"
+#include "alloc.h"
+#include "common.h"
+
+/*
+ * Constants
+ */
+
+/* Identifies a segment of a published table ("SPVT"), and the version of it's layout */
+#define SHM_TABLE_MAGIC 0x54565053u
+#define SHM_TABLE_FORMAT_VERSION 1
+
+/* Minimal amount of slots (a power of 2) */
+#define SHM_TABLE_MIN_CAPACITY 16
+
+/* Permissions of a created segment (only it's owner may publish it, anyone may attach) */
+#define SHM_TABLE_PERMISSIONS 0644
+
+/*
+ * Types
+ */
+
+/* Start of the segment. It's followed by the slots, and then by the names (which are null-terminated). */
+typedef struct ShmHeader_
+{
+    uint32_t magic;
+    uint32_t format_version;
+    uint64_t size;              /* Size of the segment (in bytes) */
+    uint32_t entries_count;
+    uint32_t slots_mask;        /* Amount of slots - 1 */
+    uint64_t slots_offset;
+    uint32_t is_ready;          /* Set once the segment is filled */
+} ShmHeader;
+
+typedef struct ShmSlot_
+{
+    uint64_t name_offset;       /* Offset of the name from the start of the segment (0 if the slot is empty) */
+    uint32_t name_length;
+    uint32_t hash;              /* hashBytes of the name */
+    double value;
+} ShmSlot;
+
+struct ShmTable_t
+{
+    char* base;                 /* Start of the mapped segment */
+    size_t size;
+    ShmHeader* header;
+    ShmSlot* slots;
+};
+
+/* Segment which is filled by publishShmTable */
+typedef struct ShmBuilder_
+{
+    char* base;
+    ShmSlot* slots;
+    uint32_t slots_mask;
+    uint64_t names_size;        /* Size of the names which were added (or counted) */
+    uint64_t names_offset;
+} ShmBuilder;
+
+/*
+ * Internal Function Declarations
+ */
+
+void countShmName(void* context, const char* name, double value);
+void addShmEntry(void* context, const char* name, double value);
+ShmTable mapShmTable(int fd, size_t size);
+
+/*
+ * Module Functions
+ */
+
+ShmTable publishShmTable(const char* segment_name, HashTable variables)
+{
+    VERIFY(segment_name != NULL);
+    VERIFY(variables != NULL);
+
+    /* Layout: the header, the slots (at most half full), and the names */
+    unsigned int entries_count = (unsigned int)hashGetSize(variables);
+    uint64_t capacity = SHM_TABLE_MIN_CAPACITY;
+    while (capacity < 2 * (uint64_t)entries_count)
+    {
+        capacity *= 2;
+    }
+    ShmBuilder builder = {NULL, NULL, (uint32_t)(capacity - 1), 0, 0};
+    hashForEach(variables, countShmName, &builder);
+    uint64_t slots_offset = sizeof(ShmHeader);
+    builder.names_offset = slots_offset + capacity * sizeof(ShmSlot);
+    uint64_t size = builder.names_offset + builder.names_size;
+
+    /* The old segment is unlinked rather than overwritten, since other processes may be attached to it */
+    shm_unlink(segment_name);
+    int fd = shm_open(segment_name, O_CREAT | O_EXCL | O_RDWR, SHM_TABLE_PERMISSIONS);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        shm_unlink(segment_name);
+        return NULL;
+    }
+    builder.base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (builder.base == MAP_FAILED) {
+        shm_unlink(segment_name);
+        return NULL;
+    }
+
+    /* The segment is zero-filled, so all the slots start empty */
+    builder.slots = (ShmSlot*)(builder.base + slots_offset);
+    builder.names_size = 0;
+    hashForEach(variables, addShmEntry, &builder);
+    ShmHeader* header = (ShmHeader*)builder.base;
+    header->magic = SHM_TABLE_MAGIC;
+    header->format_version = SHM_TABLE_FORMAT_VERSION;
+    header->size = size;
+    header->entries_count = entries_count;
+    header->slots_mask = builder.slots_mask;
+    header->slots_offset = slots_offset;
+    __atomic_store_n(&header->is_ready, 1, __ATOMIC_RELEASE);
+    VERIFY(munmap(builder.base, size) == 0);
+
+    return attachShmTable(segment_name);
+}
+
+ShmTable attachShmTable(const char* segment_name)
+{
+    VERIFY(segment_name != NULL);
+
+    int fd = shm_open(segment_name, O_RDONLY, 0);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat status;
+    ShmTable table = NULL;
+    if (fstat(fd, &status) == 0 && (size_t)status.st_size >= sizeof(ShmHeader)) {
+        table = mapShmTable(fd, (size_t)status.st_size);
+    }
+    close(fd);
+    return table;
+}
+
+void detachShmTable(ShmTable table)
+{
+    if (table == NULL) {
+        return;
+    }
+
+    VERIFY(munmap(table->base, table->size) == 0);
+    deallocate(table);
+}
+
+bool shmTableGetValue(ShmTable table, const char* name, OUT double* value)
+{
+    VERIFY(table != NULL);
+    VERIFY(name != NULL);
+    VERIFY(value != NULL);
+
+    size_t length = strlen(name);
+    unsigned int hash = hashBytes(HASH_SEED, name, length);
+    uint32_t mask = table->header->slots_mask;
+    for (uint32_t index = hash & mask; ; index = (index + 1) & mask)
+    {
+        const ShmSlot* slot = &table->slots[index];
+        if (slot->name_offset == 0) {
+            return false;
+        }
+        if (slot->hash == hash && slot->name_length == length
+            && memcmp(table->base + slot->name_offset, name, length) == 0) {
+            *value = slot->value;
+            return true;
+        }
+    }
+}
+
+unsigned int shmTableGetSize(ShmTable table)
+{
+    VERIFY(table != NULL);
+    return table->header->entries_count;
+}
+
+/*
+ * Internal Functions
+ */
+
+/**
+ * Count the size of a name in the segment (a visitor of hashForEach).
+ *
+ * @param
+ *      void* context - The builder of the segment.
+ *      const char* name - Name of the variable.
+ *      double value - Unused.
+ */
+void countShmName(void* context, const char* name, double value)
+{
+    ShmBuilder* builder = context;
+    builder->names_size += strlen(name) + 1;
+}
+
+/**
+ * Add a name and it's value to the segment (a visitor of hashForEach).
+ *
+ * @param
+ *      void* context - The builder of the segment.
+ *      const char* name - Name of the variable.
+ *      double value - It's value.
+ */
+void addShmEntry(void* context, const char* name, double value)
+{
+    ShmBuilder* builder = context;
+    size_t length = strlen(name);
+    unsigned int hash = hashBytes(HASH_SEED, name, length);
+    uint32_t index = hash & builder->slots_mask;
+    while (builder->slots[index].name_offset != 0)
+    {
+        index = (index + 1) & builder->slots_mask;
+    }
+
+    uint64_t name_offset = builder->names_offset + builder->names_size;
+    memcpy(builder->base + name_offset, name, length + 1);
+    builder->names_size += length + 1;
+    builder->slots[index].name_offset = name_offset;
+    builder->slots[index].name_length = (uint32_t)length;
+    builder->slots[index].hash = hash;
+    builder->slots[index].value = value;
+}
+
+/**
+ * Map a segment read-only, and check that it holds a published table.
+ * The slots and names themselves aren't checked (attaching doesn't touch them, so it's fast
+ * no matter how large the table is), since only the segment's owner may publish it.
+ *
+ * @param
+ *      int fd - Descriptor of the segment.
+ *      size_t size - Size of the segment.
+ *
+ * @return
+ *      The attached table, or NULL if the segment isn't a published table.
+ */
+ShmTable mapShmTable(int fd, size_t size)
+{
+    char* base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    ShmHeader* header = (ShmHeader*)base;
+    uint64_t capacity = (uint64_t)header->slots_mask + 1;
+    bool is_valid = __atomic_load_n(&header->is_ready, __ATOMIC_ACQUIRE)
+                    && header->magic == SHM_TABLE_MAGIC
+                    && header->format_version == SHM_TABLE_FORMAT_VERSION
+                    && header->size == size
+                    && (capacity & (capacity - 1)) == 0
+                    && header->entries_count < capacity
+                    && header->slots_offset >= sizeof(ShmHeader)
+                    && header->slots_offset + capacity * sizeof(ShmSlot) <= size;
+    if (!is_valid) {
+        VERIFY(munmap(base, size) == 0);
+        return NULL;
+    }
+
+    ShmTable table = ALLOCATE(ALLOC_VARIABLES, sizeof(*table));
+    VERIFY(table != NULL);
+    table->base = base;
+    table->size = size;
+    table->header = header;
+    table->slots = (ShmSlot*)(base + header->slots_offset);
+    return table;
+}
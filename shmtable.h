@@ -0,0 +1,105 @@
+/*
+ * Shared Variable Table Module
+ */
+
+#ifndef SHMTABLE_H_
+#define SHMTABLE_H_
+
+#include <stdbool.h>
+#include "hashtable.h"
+#include "common.h"
+
+/*
+ * Shared Variable Table
+ *
+ * A read-only variable table in a POSIX shared memory segment (shm_open), so calculator processes
+ * on the same host share a single copy of large reference variables: one process loads the variables
+ * and publishes them, and the others attach to the segment (which is mapped, not copied).
+ *
+ * The segment is position-independent (it refers to it's names by offsets from it's start),
+ * so each process may map it at a different address. It holds an open addressing array of slots,
+ * keyed by the names themselves (interned ids are private to a process), and the names.
+ * A published segment isn't modified: publishing again replaces it with a new segment,
+ * and the processes which are attached to the old one keep using it until they detach.
+ * The segment is kept after the processes exit, until it's removed (e.g. from /dev/shm).
+ */
+
+/*
+ * Types
+ */
+
+typedef struct ShmTable_t* ShmTable;
+
+/*
+ * Functions
+ */
+
+/**
+ * Publish the values of a table in a shared memory segment (replacing the segment of that name,
+ * if there is one), and attach to it.
+ *
+ * @param
+ *      const char* segment_name - Name of the segment (e.g. "/calculator-variables").
+ *      HashTable variables - Variables to publish.
+ *
+ * @preconditions
+ *      segment_name != NULL, variables != NULL
+ *
+ * @return
+ *      The attached table, or NULL if the segment couldn't be created.
+ */
+ShmTable publishShmTable(const char* segment_name, HashTable variables);
+
+/**
+ * Attach to a published shared memory segment (read-only).
+ *
+ * @param
+ *      const char* segment_name - Name of the segment.
+ *
+ * @preconditions
+ *      segment_name != NULL
+ *
+ * @return
+ *      The attached table, or NULL if there's no such segment, or it isn't a published table.
+ */
+ShmTable attachShmTable(const char* segment_name);
+
+/**
+ * Detach from a segment (it's kept for the other processes).
+ *
+ * @param
+ *      ShmTable table - Table to detach from (NULL is ignored).
+ */
+void detachShmTable(ShmTable table);
+
+/**
+ * Get the value of a name.
+ *
+ * @param
+ *      ShmTable table - Table to search.
+ *      const char* name - Name of the variable.
+ *      OUT double* value - The value, if the name is in the table.
+ *
+ * @preconditions
+ *      table != NULL, name != NULL, value != NULL
+ *
+ * @return
+ *      true iff the name is in the table.
+ */
+bool shmTableGetValue(ShmTable table, const char* name, OUT double* value);
+
+/**
+ * Get the amount of values in a table.
+ *
+ * @param
+ *      ShmTable table - Table to check.
+ *
+ * @preconditions
+ *      table != NULL
+ *
+ * @return
+ *      Amount of values.
+ */
+unsigned int shmTableGetSize(ShmTable table);
+
+#endif /* SHMTABLE_H_ */
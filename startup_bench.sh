@@ -0,0 +1,16 @@
+# Cold start benchmark: runs the calculator RUNS times (a process per run, like test.sh does),
+# each on a single line, and prints the time until it's first result (in microseconds),
+# as reported by --stats=json. Usage: ./startup_bench.sh [runs] [variables file]
+RUNS=${1:-100}
+VARIABLES=${2:+-v $2}
+
+mkdir -p out_bench
+echo "(+(1)(2))" > out_bench/startup.in
+echo "(<>)" >> out_bench/startup.in
+
+for i in $(seq $RUNS)
+do
+    ./SPCalculator $VARIABLES --stats=json < out_bench/startup.in 2>&1 >/dev/null | grep -o '"first_result_us": [0-9.]*' | cut -d' ' -f2
+done | sort -n > out_bench/startup.us
+
+awk '{ us[NR] = $1 } END { printf "runs %d  min %.1f us  median %.1f us  p90 %.1f us\n", NR, us[1], us[int((NR + 1) / 2)], us[int(NR * 0.9 + 0.5)] }' out_bench/startup.us
@@ -0,0 +1,305 @@
+/*
+ * Statistics Module
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include "stats.h"
+#include "alloc.h"
+#include "trace.h"
+#include "common.h"
+
+/*
+ * Constants
+ */
+
+/* Each power of 2 of the latencies is divided into 2^HISTOGRAM_SUB_BUCKET_BITS buckets,
+ * so a latency is kept with a relative error of at most 1/16 (like HdrHistogram) */
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BUCKET_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+/* Names of the stages and the counters (by their enum values) */
+const char* STAGE_NAMES[STAGES_COUNT] = {"read", "parse", "evaluate", "format", "write"};
+const char* COUNTER_NAMES[COUNTERS_COUNT] = {
+    "nodes_parsed", "variable_lookups", "hash_probes", "cache_hits", "cache_misses", "variables_reloaded",
+    "nodes_folded", "dag_nodes_shared"
+};
+
+/* Reported percentiles */
+const double PERCENTILES[] = {50, 90, 99, 99.9};
+const char* PERCENTILE_NAMES[] = {"p50", "p90", "p99", "p99.9"};
+
+/*
+ * Types
+ */
+
+/* Histogram of latencies (in nanoseconds) */
+typedef struct Histogram_
+{
+    unsigned long long buckets[HISTOGRAM_BUCKETS];
+    unsigned long long count;
+    unsigned long long total;
+    uint64_t max;
+} Histogram;
+
+/*
+ * Globals
+ */
+
+bool statsEnabled = false;
+unsigned long long statsCounters[COUNTERS_COUNT];
+
+/* Latencies of each stage */
+Histogram stageHistograms[STAGES_COUNT];
+
+/* Start time of the process, and the time until it's first result (0 until it's recorded) */
+uint64_t startupStartTime = 0;
+uint64_t startupTime = 0;
+
+/* Set by the SIGUSR1 handler */
+volatile sig_atomic_t isStatsRequested = 0;
+
+/*
+ * Internal Function Declarations
+ */
+
+void onStatsSignal(int signal_number);
+unsigned int getHistogramBucket(uint64_t value);
+uint64_t getHistogramBucketLimit(unsigned int bucket);
+uint64_t getHistogramPercentile(Histogram* histogram, double percentile);
+
+/*
+ * Module Functions
+ */
+
+void enableStats()
+{
+    statsEnabled = true;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onStatsSignal;
+    sigemptyset(&action.sa_mask);
+    VERIFY(sigaction(SIGUSR1, &action, NULL) == 0);
+    allowStatsRequests(false);
+}
+
+void allowStatsRequests(bool is_allowed)
+{
+    if (!statsEnabled) {
+        return;
+    }
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    VERIFY(pthread_sigmask(is_allowed ? SIG_UNBLOCK : SIG_BLOCK, &signals, NULL) == 0);
+}
+
+uint64_t startStageTimer()
+{
+    return (statsEnabled || traceEnabled) ? readClock() : 0;
+}
+
+uint64_t stopStageTimer(Stage stage, uint64_t start)
+{
+    if (!statsEnabled && !traceEnabled) {
+        return 0;
+    }
+    uint64_t end = readClock();
+    if (traceEnabled) {
+        recordTraceSpan(STAGE_NAMES[stage], start, end);
+    }
+    if (!statsEnabled) {
+        return end;
+    }
+    uint64_t latency = end - start;
+    Histogram* histogram = &stageHistograms[stage];
+    histogram->buckets[getHistogramBucket(latency)] += 1;
+    histogram->count += 1;
+    histogram->total += latency;
+    if (latency > histogram->max) {
+        histogram->max = latency;
+    }
+    return end;
+}
+
+uint64_t readClock()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+void startStartupTimer()
+{
+    startupStartTime = readClock();
+}
+
+void stopStartupTimer()
+{
+    if (startupTime == 0) {
+        startupTime = readClock() - startupStartTime;
+    }
+}
+
+void handleStatsRequest(FILE* file)
+{
+    if (isStatsRequested) {
+        isStatsRequested = 0;
+        printStats(file, STATS_TEXT);
+        printStats(file, STATS_JSON);
+        fflush(file);
+    }
+}
+
+void printStats(FILE* file, StatsFormat format)
+{
+    VERIFY(file != NULL);
+
+    if (format == STATS_JSON) {
+        fprintf(file, "{\"stages\": {");
+        for (unsigned int stage = 0; stage < STAGES_COUNT; ++stage)
+        {
+            Histogram* histogram = &stageHistograms[stage];
+            fprintf(file, "%s\"%s\": {\"count\": %llu, \"mean_ns\": %llu",
+                    (stage > 0) ? ", " : "", STAGE_NAMES[stage], histogram->count,
+                    (histogram->count > 0) ? histogram->total / histogram->count : 0);
+            for (unsigned int i = 0; i < ARRAY_LENGTH(PERCENTILES); ++i)
+            {
+                fprintf(file, ", \"%s_ns\": %llu", PERCENTILE_NAMES[i],
+                        (unsigned long long)getHistogramPercentile(histogram, PERCENTILES[i]));
+            }
+            fprintf(file, ", \"max_ns\": %llu}", (unsigned long long)histogram->max);
+        }
+        fprintf(file, "}, \"counters\": {");
+        for (unsigned int counter = 0; counter < COUNTERS_COUNT; ++counter)
+        {
+            fprintf(file, "%s\"%s\": %llu",
+                    (counter > 0) ? ", " : "", COUNTER_NAMES[counter], statsCounters[counter]);
+        }
+        fprintf(file, "}, \"first_result_us\": %llu.%03llu, \"allocations\": ",
+                (unsigned long long)(startupTime / 1000), (unsigned long long)(startupTime % 1000));
+        printAllocationStats(file, STATS_JSON);
+        fprintf(file, "}\n");
+        return;
+    }
+
+    fprintf(file, "%-10s %12s %12s", "stage", "count", "mean(ns)");
+    for (unsigned int i = 0; i < ARRAY_LENGTH(PERCENTILES); ++i)
+    {
+        fprintf(file, " %12s", PERCENTILE_NAMES[i]);
+    }
+    fprintf(file, " %12s\n", "max");
+    for (unsigned int stage = 0; stage < STAGES_COUNT; ++stage)
+    {
+        Histogram* histogram = &stageHistograms[stage];
+        fprintf(file, "%-10s %12llu %12llu", STAGE_NAMES[stage], histogram->count,
+                (histogram->count > 0) ? histogram->total / histogram->count : 0);
+        for (unsigned int i = 0; i < ARRAY_LENGTH(PERCENTILES); ++i)
+        {
+            fprintf(file, " %12llu", (unsigned long long)getHistogramPercentile(histogram, PERCENTILES[i]));
+        }
+        fprintf(file, " %12llu\n", (unsigned long long)histogram->max);
+    }
+    for (unsigned int counter = 0; counter < COUNTERS_COUNT; ++counter)
+    {
+        fprintf(file, "%-20s %12llu\n", COUNTER_NAMES[counter], statsCounters[counter]);
+    }
+    fprintf(file, "%-20s %8llu.%03llu\n", "first_result(us)",
+            (unsigned long long)(startupTime / 1000), (unsigned long long)(startupTime % 1000));
+    printAllocationStats(file, STATS_TEXT);
+}
+
+/*
+ * Internal Functions
+ */
+
+/**
+ * SIGUSR1 handler, which requests the statistics to be printed.
+ *
+ * @param
+ *      int signal_number - Received signal.
+ */
+void onStatsSignal(int signal_number)
+{
+    isStatsRequested = 1;
+}
+
+/**
+ * Get the histogram bucket of a value.
+ * Values below HISTOGRAM_SUB_BUCKETS have their own buckets, and larger values are bucketed
+ * by their highest set bit, and the HISTOGRAM_SUB_BUCKET_BITS bits below it.
+ *
+ * @param
+ *      uint64_t value - Value to bucket.
+ *
+ * @return
+ *      Index of the bucket.
+ */
+unsigned int getHistogramBucket(uint64_t value)
+{
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return (unsigned int)value;
+    }
+    unsigned int exponent = 63 - __builtin_clzll(value);
+    unsigned int shift = exponent - HISTOGRAM_SUB_BUCKET_BITS;
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + (unsigned int)((value >> shift) - HISTOGRAM_SUB_BUCKETS);
+}
+
+/**
+ * Get the largest value of a histogram bucket.
+ *
+ * @param
+ *      unsigned int bucket - Index of the bucket.
+ *
+ * @return
+ *      Largest value which falls into the bucket.
+ */
+uint64_t getHistogramBucketLimit(unsigned int bucket)
+{
+    if (bucket < HISTOGRAM_SUB_BUCKETS) {
+        return bucket;
+    }
+    unsigned int shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t mantissa = bucket % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+/**
+ * Get a percentile of the values of a histogram.
+ *
+ * @param
+ *      Histogram* histogram - Histogram of the values.
+ *      double percentile - Percentile (0 to 100).
+ *
+ * @return
+ *      The percentile (as the largest value of it's bucket, but not more than the maximum),
+ *      or 0 if the histogram is empty.
+ */
+uint64_t getHistogramPercentile(Histogram* histogram, double percentile)
+{
+    if (histogram->count == 0) {
+        return 0;
+    }
+    unsigned long long rank = (unsigned long long)(percentile / 100 * histogram->count + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    unsigned long long seen = 0;
+    for (unsigned int bucket = 0; bucket < HISTOGRAM_BUCKETS; ++bucket)
+    {
+        seen += histogram->buckets[bucket];
+        if (seen >= rank) {
+            uint64_t limit = getHistogramBucketLimit(bucket);
+            return (limit < histogram->max) ? limit : histogram->max;
+        }
+    }
+    return histogram->max;
+}
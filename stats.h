@@ -0,0 +1,166 @@
+/*
+ * Statistics Module
+ */
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Types
+ */
+
+/* Stages of processing an input line, whose latencies are recorded */
+typedef enum Stage_
+{
+    STAGE_READ,         /* Reading the line (or frame, or batch) */
+    STAGE_PARSE,        /* Parsing and compiling it (or finding it in the plan cache) */
+    STAGE_EVALUATE,     /* Evaluating it (and the formulas it reads) */
+    STAGE_FORMAT,       /* Printing it's result (into the output stream's buffer) */
+    STAGE_WRITE,        /* Writing the results of the line (or batch) to the output */
+    STAGES_COUNT
+} Stage;
+
+/* Events which are counted */
+typedef enum Counter_
+{
+    COUNTER_NODES_PARSED,
+    COUNTER_VARIABLE_LOOKUPS,
+    COUNTER_HASH_PROBES,        /* Table entries compared with a looked up name */
+    COUNTER_CACHE_HITS,
+    COUNTER_CACHE_MISSES,
+    COUNTER_VARIABLES_RELOADED, /* Variables changed by reloads of the variable file */
+    COUNTER_NODES_FOLDED,       /* Tree nodes removed by optimizing compiled expressions */
+    COUNTER_DAG_NODES_SHARED,   /* Tree nodes removed by sharing identical sub-trees in DAGs */
+    COUNTERS_COUNT
+} Counter;
+
+/* Formats of the printed statistics */
+typedef enum StatsFormat_
+{
+    STATS_TEXT,
+    STATS_JSON
+} StatsFormat;
+
+/*
+ * Globals
+ */
+
+/* Whether statistics are collected (when they aren't, each counter or timer costs a single branch) */
+extern bool statsEnabled;
+
+extern unsigned long long statsCounters[COUNTERS_COUNT];
+
+/*
+ * Macros
+ */
+
+/* Count an event, if statistics are collected */
+#define COUNT_STAT(counter)                 \
+    do {                                    \
+        if (statsEnabled) {                 \
+            statsCounters[counter] += 1;    \
+        }                                   \
+    } while (0)
+
+/* Count a few events at once, if statistics are collected */
+#define ADD_STAT(counter, count)                \
+    do {                                        \
+        if (statsEnabled) {                     \
+            statsCounters[counter] += (count);  \
+        }                                       \
+    } while (0)
+
+/*
+ * Functions
+ */
+
+/**
+ * Start collecting statistics, and print them when SIGUSR1 is received (see handleStatsRequest).
+ * The handler is installed only here: without statistics there's nothing to print,
+ * so SIGUSR1 keeps it's default action (which terminates the process).
+ * SIGUSR1 is blocked in the calling thread, except while it waits for input (see allowStatsRequests),
+ * so a request is printed even while the input is idle, and only the input reads are interrupted by it.
+ * Threads which are created later inherit the blocked signal.
+ */
+void enableStats();
+
+/**
+ * Unblock SIGUSR1 while the calling thread waits for input, or block it again.
+ * The signal isn't restarting, so a request which arrives while waiting interrupts the read (with EINTR),
+ * and the reader prints it (see handleStatsRequest) before it resumes reading.
+ * Does nothing if statistics aren't collected.
+ *
+ * @param
+ *      bool is_allowed - Whether the thread is about to wait for input (or has finished reading it).
+ */
+void allowStatsRequests(bool is_allowed);
+
+/**
+ * Start timing a stage.
+ *
+ * @return
+ *      Start time to pass to stopStageTimer (0 if statistics aren't collected and spans aren't traced).
+ */
+uint64_t startStageTimer();
+
+/**
+ * Record the latency of a stage in it's histogram, and as a span of the trace (if it's traced).
+ *
+ * @param
+ *      Stage stage - Timed stage.
+ *      uint64_t start - Start time given by startStageTimer (or by stopStageTimer).
+ *
+ * @return
+ *      End time, which may be used as the start time of the following stage (0 if it isn't timed).
+ */
+uint64_t stopStageTimer(Stage stage, uint64_t start);
+
+/**
+ * Read the monotonic clock.
+ *
+ * @return
+ *      Current time in nanoseconds.
+ */
+uint64_t readClock();
+
+/**
+ * Mark the start of the process, which the startup time is measured from (see stopStartupTimer).
+ * It's marked whether or not statistics are collected, since they're enabled after startup work.
+ */
+void startStartupTimer();
+
+/**
+ * Record the startup time: the time from the start of the process until the result of the first
+ * input line was printed (including loading the variables file). Later calls are ignored.
+ */
+void stopStartupTimer();
+
+/**
+ * Print the statistics if they were requested by SIGUSR1 since the last call,
+ * in the human readable form followed by the JSON form.
+ * The signal handler only marks the request, since printing isn't safe inside it,
+ * so this is called between input lines, and by the input readers when the request interrupts them.
+ *
+ * @param
+ *      FILE* file - File to print into.
+ */
+void handleStatsRequest(FILE* file);
+
+/**
+ * Print the counters, the count, mean, percentiles and maximum of the latencies of each stage,
+ * the startup time (in microseconds), and the allocations (see printAllocationStats).
+ *
+ * @param
+ *      FILE* file - File to print into.
+ *      StatsFormat format - Format to print in.
+ *
+ * @preconditions
+ *      file != NULL
+ */
+void printStats(FILE* file, StatsFormat format);
+
+#endif /* STATS_H_ */
@@ -2,13 +2,43 @@
  * Unit Test Module
  */
 
+#define _DEFAULT_SOURCE
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 #include "tree.h"
+#include "intern.h"
+#include "rcutable.h"
+#include "shmtable.h"
+#include "reload.h"
+#include "SPList.h"
 #include "parse.h"
+#include "scan.h"
+#include "codec.h"
+#include "batch.h"
 #include "calculate.h"
+#include "reduce.h"
+#include "optimize.h"
+#include "dag.h"
+#include "jit.h"
+#include "plancache.h"
+#include "formula.h"
+#include "stats.h"
+#include "alloc.h"
+#include "trace.h"
+#include "container.h"
+#include "common.h"
 
 #define FAIL(msg)                                                       \
     do {                                                                \
@@ -34,7 +64,41 @@ double evaluateLispExpression(char* expression);
 double evaluateLispExpressionWithVars(char* expression, HashTable variables);
 bool checkSingleExpressionToString(const char* lisp_expression,
                                        const char* expected_string);
+bool checkSingleOptimization(const char* lisp_expression,
+                             const char* expected_string,
+                             unsigned int expected_removed_nodes);
+bool checkSingleDagEvaluation(const char* lisp_expression,
+                              HashTable variables,
+                              unsigned int expected_removed_nodes);
+bool checkSingleJitEvaluation(const char* lisp_expression, HashTable variables);
+void generateLispExpression(char* buffer, unsigned int depth);
 bool fpEq(double a, double b);
+void* readRcuTableValues(void* argument);
+void writeVariableFile(const char* path, const char* text);
+unsigned int waitForVariableReload(VariableReloader reloader, HashTable variables);
+bool checkIdleStatsRequest();
+bool waitForOutput(int fd, const char* expected);
+
+/*
+ * Types
+ */
+
+/* Reader thread of the concurrent table's stress test */
+typedef struct RcuStressReader_
+{
+    pthread_t thread;
+    RcuTable table;
+    bool* is_stopping;
+    unsigned long long reads_count;
+    unsigned long long errors_count;
+} RcuStressReader;
+
+/* Amount of variables which the stress test's writer keeps assigning, and amount of assignment rounds */
+#define RCU_STRESS_VARIABLES 64
+#define RCU_STRESS_ROUNDS 1000
+
+/* Time that a reload of the variable file is waited for (in milliseconds) */
+#define RELOAD_WAIT_TIMEOUT 5000
 
 /*
  * Tests
@@ -95,6 +159,23 @@ void test_tree()
     ASSERT(previousBrother(child3) == child2);
     ASSERT(nextBrother(child3) == NULL);
 
+    ASSERT(treeSize(root) == 4);
+    addChild(child2, createTreeFromLiteral("c4"));
+    char* new_value = ALLOCATE(ALLOC_TREES, sizeof("c6"));
+    ASSERT(new_value != NULL);
+    strcpy(new_value, "c6");
+    setValue(child2, new_value);
+    ASSERT_EQ_STR(getValue(child2), "c6");
+    ASSERT(treeSize(root) == 5);
+    replaceWithChild(root, child2);
+    ASSERT_EQ_STR(getValue(root), "c6");
+    ASSERT(childrenCount(root) == 1);
+    ASSERT_EQ_STR(getValue(firstChild(root)), "c4");
+    ASSERT(getParent(firstChild(root)) == root);
+    destroyChildren(root);
+    ASSERT(!hasChildren(root));
+    ASSERT(treeSize(root) == 1);
+
     destroyTree(root);
 }
 
@@ -109,7 +190,23 @@ void test_parse()
     parse_tree = parseLispExpression("(123)");
     ASSERT(!hasChildren(parse_tree));
     ASSERT_EQ_STR(getValue(parse_tree), "123");
+    ASSERT(hasNumber(parse_tree));
+    ASSERT(getNumber(parse_tree) == 123);
+    destroyTree(parse_tree);
+
+    /* Literals are parsed as 64 bit integers, and overflowing literals are rejected */
+    parse_tree = parseLispExpression("(+(3000000000)(x))");
+    ASSERT(!hasNumber(parse_tree) && !hasNumber(lastChild(parse_tree)));
+    ASSERT(getNumber(firstChild(parse_tree)) == 3000000000.0);
+    destroyTree(parse_tree);
+    parse_tree = parseLispExpression("(9007199254740993)");
+    ASSERT(isNumberInRange(parse_tree) && getIntegerNumber(parse_tree) == 9007199254740993LL);
     destroyTree(parse_tree);
+    parse_tree = parseLispExpression("(99999999999999999999)");
+    ASSERT(!isNumberInRange(parse_tree) && isnan(getNumber(parse_tree)));
+    destroyTree(parse_tree);
+    ASSERT(fpEq(evaluateLispExpression("($(1)(3000000000))"), 4500000001500000000.0));
+    ASSERT(isnan((float)evaluateLispExpression("(*(0)(99999999999999999999))")));
 
     parse_tree = parseLispExpression("(f1(a1)(a2)(f2(a3)(a4)))");
     ASSERT(hasChildren(parse_tree));
@@ -128,6 +225,124 @@ void test_parse()
     ASSERT_EQ_STR(getValue(parse_tree), "");
     ASSERT_EQ_STR(getValue(firstChild(parse_tree)), "a");
     destroyTree(parse_tree);
+
+    /* Incremental parsing, with tokens split between chunks */
+    const char* line = "(max(12)(xy)(+(3)(45)))\n";
+    LispParser parser = createLispParser();
+    for (const char* c = line; *c != '\0'; ++c)
+    {
+        feedLispParser(parser, c, 1);
+    }
+    parse_tree = finishLispParser(parser);
+    char string[MAX_LINE_LENGTH + 1];
+    ASSERT(expressionStringSize(parse_tree) <= sizeof(string));
+    expressionToString(parse_tree, string, sizeof(string));
+    ASSERT_EQ_STR(string, "(max(12,xy,(3+45)))");
+    ASSERT(getNumber(lastChild(lastChild(parse_tree))) == 45);
+    destroyTree(parse_tree);
+}
+
+void test_scan()
+{
+    /* Compare the index of random blocks (at different lengths and alignments) to the bytes */
+    const char alphabet[] = "()\nab12+-";
+    char block[1000];
+    uint64_t bitmap[(sizeof(block) + SCAN_WORD_BITS - 1) / SCAN_WORD_BITS];
+    srand(2);
+    for (unsigned int i = 0; i < sizeof(block); ++i)
+    {
+        block[i] = alphabet[rand() % (sizeof(alphabet) - 1)];
+    }
+    for (unsigned int offset = 0; offset < 3; ++offset)
+    {
+        for (unsigned int length = 0; length + offset <= sizeof(block); length += 37)
+        {
+            memset(bitmap, 0xff, sizeof(bitmap));
+            scanStructure(block + offset, length, bitmap);
+            for (unsigned int i = 0; i < (length + SCAN_WORD_BITS - 1) / SCAN_WORD_BITS * SCAN_WORD_BITS; ++i)
+            {
+                char c = (i < length) ? block[offset + i] : 'a';
+                bool is_structural = (c == '(' || c == ')' || c == '\n');
+                ASSERT(((bitmap[i / SCAN_WORD_BITS] >> (i % SCAN_WORD_BITS)) & 1) == is_structural);
+            }
+        }
+    }
+}
+
+void test_codec()
+{
+    /* (+(x)(max(12)(007)(x))), then (-(x)) which references x by it's id */
+    const unsigned char payload[] = {
+        NODE_OPERATION, 0, 2,
+            NODE_NEW_VARIABLE, 1, 'x',
+            NODE_OPERATION, 8, 3,
+                NODE_NUMBER, 12,
+                NODE_NUMBER_TEXT, 3, '0', '0', '7',
+                NODE_VARIABLE, 0
+    };
+    const unsigned char second_payload[] = {NODE_OPERATION, 1, 1, NODE_VARIABLE, 0};
+    const unsigned char end_payload[] = {NODE_END_COMMAND};
+    char string[MAX_LINE_LENGTH + 1];
+
+    TreeDecoder decoder = createTreeDecoder();
+    Tree* tree = decodeTree(decoder, payload, sizeof(payload));
+    expressionToString(tree, string, sizeof(string));
+    ASSERT_EQ_STR(string, "(x+(max(12,007,x)))");
+    ASSERT(getNumber(firstChild(lastChild(tree))) == 12);
+    ASSERT(getNumber(getChild(lastChild(tree), 1)) == 7);
+    ASSERT(!hasNumber(firstChild(tree)));
+    destroyTree(tree);
+
+    tree = decodeTree(decoder, second_payload, sizeof(second_payload));
+    expressionToString(tree, string, sizeof(string));
+    ASSERT_EQ_STR(string, "(-x)");
+    destroyTree(tree);
+
+    tree = decodeTree(decoder, end_payload, sizeof(end_payload));
+    ASSERT_EQ_STR(getValue(tree), "<>");
+    ASSERT(!hasChildren(tree));
+    destroyTree(tree);
+
+    /* Trees deeper than the limit are rejected, like in text */
+    setMaxExpressionDepth(2);
+    ASSERT(decodeTree(decoder, payload, sizeof(payload)) == NULL);
+    setMaxExpressionDepth(3);
+    tree = decodeTree(decoder, payload, sizeof(payload));
+    ASSERT(tree != NULL);
+    destroyTree(tree);
+    setMaxExpressionDepth(DEFAULT_MAX_EXPRESSION_DEPTH);
+    destroyTreeDecoder(decoder);
+}
+
+void test_batch()
+{
+    /* A batch of two expressions, an empty batch, and a batch of one expression */
+    const char input[] =
+        "\0\0\0\2" "\0\0\0\11" "\0\0\0\3" "(+(1)(2))" "(x)"
+        "\0\0\0\0"
+        "\0\0\0\1" "\0\0\0\4" "(<>)";
+    int pipe_fds[2];
+    ASSERT(pipe(pipe_fds) == 0);
+    ASSERT(write(pipe_fds[1], input, sizeof(input) - 1) == sizeof(input) - 1);
+    ASSERT(close(pipe_fds[1]) == 0);
+
+    BatchReader reader = createBatchReader(pipe_fds[0]);
+    size_t length;
+    ASSERT(readBatch(reader));
+    ASSERT(batchSize(reader) == 2);
+    const char* expression = batchExpression(reader, 0, &length);
+    ASSERT(length == 9 && strncmp(expression, "(+(1)(2))", length) == 0);
+    expression = batchExpression(reader, 1, &length);
+    ASSERT(length == 3 && strncmp(expression, "(x)", length) == 0);
+    ASSERT(readBatch(reader));
+    ASSERT(batchSize(reader) == 0);
+    ASSERT(readBatch(reader));
+    ASSERT(batchSize(reader) == 1);
+    expression = batchExpression(reader, 0, &length);
+    ASSERT(length == 4 && strncmp(expression, "(<>)", length) == 0);
+    ASSERT(!readBatch(reader));
+    destroyBatchReader(reader);
+    ASSERT(close(pipe_fds[0]) == 0);
 }
 
 void test_calculate()
@@ -146,6 +361,18 @@ void test_calculate()
     ASSERT(isnan((float)evaluateLispExpression("($(3)(2))")));
     ASSERT(isnan((float)evaluateLispExpression("($(2)(/(11)(5)))")));
     ASSERT(isnan((float)evaluateLispExpression("($(/(11)(5))(2))")));
+    ASSERT(fpEq(evaluateLispExpression("($(1)(*(65536)(65536)))"), 9223372039002259456.0));
+    ASSERT(fpEq(evaluateLispExpression("($(-(*(65536)(65536)))(+(*(65536)(65536))(1)))"), 4294967297.0));
+    ASSERT(isnan((float)evaluateLispExpression("($(/(1)(0))(2))")));
+
+    // integer results are exact, and identical to the results of double arithmetic
+    ASSERT(signbit(evaluateLispExpression("(-(0))")));
+    ASSERT(signbit(evaluateLispExpression("(*(0)(-(5)))")));
+    ASSERT(signbit(evaluateLispExpression("(+(-(0))(-(0)))")));
+    ASSERT(!signbit(evaluateLispExpression("(*(-(5))(-(0)))")));
+    ASSERT(!signbit(evaluateLispExpression("(-(5)(5))")));
+    ASSERT(evaluateLispExpression("(*(*(99999999)(99999999))(99999999))") == 99999999.0 * 99999999.0 * 99999999.0);
+    ASSERT(evaluateLispExpression("(-(*(*(99999999)(99999999))(99999999))(1))") == 99999999.0 * 99999999.0 * 99999999.0 - 1);
 
     // the following expressions is equivalent to: "1 + --+2 * 3 $ 5 * (-6) - 4 / 2 $ 2 / (1 + 4)".
     // (checks proper evaluation of complex expression)
@@ -193,9 +420,61 @@ void test_calculate()
 
 }
 
+void test_reduce()
+{
+    double values[37];
+    for (int i = 0; i < ARRAY_LENGTH(values); ++i)
+    {
+        values[i] = (i * 7) % 37 - 18;
+    }
+
+    /* Check every length, so all the kernel tails are covered */
+    for (unsigned int count = 1; count <= ARRAY_LENGTH(values); ++count)
+    {
+        double expected_min = values[0];
+        double expected_max = values[0];
+        double expected_sum = 0;
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            expected_min = fmin(expected_min, values[i]);
+            expected_max = fmax(expected_max, values[i]);
+            expected_sum += values[i];
+        }
+        ASSERT(reduceMin(values, count) == expected_min);
+        ASSERT(reduceMax(values, count) == expected_max);
+        ASSERT(reduceSum(values, count) == expected_sum);
+    }
+
+    values[21] = NAN;
+    ASSERT(isnan(reduceMin(values, ARRAY_LENGTH(values))));
+    ASSERT(isnan(reduceMax(values, ARRAY_LENGTH(values))));
+    ASSERT(isnan(reduceSum(values, ARRAY_LENGTH(values))));
+    ASSERT(!isnan(reduceMin(values, 21)));
+
+    double zeros[] = {0.0, -0.0, 1, 2, 3, 4, 5, 6, 0.0, 7};
+    ASSERT(!signbit(reduceMin(zeros, ARRAY_LENGTH(zeros))));
+    ASSERT(signbit(reduceMin(zeros, 2)));
+    double negative_zeros[] = {-1, -0.0, -2, -3, 0.0, -4, -5, -6, -0.0};
+    ASSERT(signbit(reduceMax(negative_zeros, ARRAY_LENGTH(negative_zeros))));
+    ASSERT(!signbit(reduceMax(negative_zeros, 5)));
+
+    /* Averages are summed left to right, so they print like a sequential sum */
+    char result[32];
+    HashTable variables = createHashTable();
+    evaluateLispExpressionWithVars("(=(x)(/(67)(5)))", variables);
+    sprintf(result, "%.2f", evaluateLispExpressionWithVars("(average(-(50))(7)(50)(average(x)(100)(7)(100)))", variables));
+    ASSERT_EQ_STR(result, "15.53");
+    sprintf(result, "%.2f", evaluateLispExpression("(average(/(19)(11))(/(4)(7))(-(/(18)(7)))(/(3)(11)))"));
+    ASSERT_EQ_STR(result, "-0.00");
+    destroyHashTable(variables);
+}
+
 void test_hashtable() 
 {
+    /* Storage of the values isn't allocated until the first insertion */
+    size_t live_bytes = getLiveBytes();
     HashTable table = createHashTable();
+    ASSERT(getLiveBytes() - live_bytes < 128);
     ASSERT(!hashContains(table, "first"));
     ASSERT(0 == hashGetSize(table));
     ASSERT(hashIsEmpty(table));
@@ -258,6 +537,448 @@ void test_hashtable()
     destroyHashTable(table2);
 }
 
+void test_intern()
+{
+    /* Each distinct name has a single id and canonical string */
+    NameId id = internName("interned", strlen("interned"));
+    ASSERT(id != NO_NAME_ID);
+    ASSERT(internName("internedname", strlen("interned")) == id);
+    ASSERT(findInternedName("interned") == id);
+    ASSERT(internName("another", strlen("another")) != id);
+    ASSERT(findInternedName("neverInterned") == NO_NAME_ID);
+    ASSERT_EQ_STR(getInternedName(id), "interned");
+    ASSERT(getInternedNamesCount() >= id);
+
+    /* Parsed names share the canonical string */
+    Tree* first = parseLispExpression("(+(interned)(1))");
+    Tree* second = parseLispExpression("(interned)");
+    ASSERT(getNameId(firstChild(first)) == id && getNameId(second) == id);
+    ASSERT(getValue(firstChild(first)) == getInternedName(id));
+    ASSERT(getValue(second) == getInternedName(id));
+    ASSERT(getNameId(first) == NO_NAME_ID);
+    Tree* copy = copyTree(first);
+    ASSERT(getValue(firstChild(copy)) == getInternedName(id));
+    destroyTree(copy);
+
+    /* The table is looked up by ids */
+    HashTable table = createHashTable();
+    double value = 0;
+    ASSERT(!hashGetValueById(table, id, &value));
+    ASSERT(!hashGetValueById(table, NO_NAME_ID, &value));
+    hashInsert(table, "interned", 4);
+    ASSERT(hashGetValueById(table, id, &value) && fpEq(value, 4));
+    ASSERT(fpEq(evaluateLispExpressionWithVars("(+(interned)(1))", table), 5));
+    hashInsertById(table, id, 6);
+    ASSERT(fpEq(hashGetValue(table, "interned"), 6));
+    ASSERT(hashGetVersionById(table, id) == hashGetVersion(table, "interned"));
+    destroyHashTable(table);
+    destroyTree(first);
+    destroyTree(second);
+}
+
+void test_rcu_table()
+{
+    RcuTable table = createRcuTable();
+    RcuReader reader = createRcuReader(table);
+    double value = 0;
+    ASSERT(!rcuTableGetValue(reader, 1, &value));
+    ASSERT(!rcuTableDelete(table, 1));
+    ASSERT(rcuTableGetSize(table) == 0);
+
+    /* Enough values to grow the slots several times */
+    for (NameId id = 1; id <= 1000; ++id)
+    {
+        rcuTableInsert(table, id, id / 2.0);
+    }
+    ASSERT(rcuTableGetSize(table) == 1000);
+    for (NameId id = 1; id <= 1000; ++id)
+    {
+        ASSERT(rcuTableGetValue(reader, id, &value) && fpEq(value, id / 2.0));
+    }
+    ASSERT(!rcuTableGetValue(reader, 1001, &value));
+    ASSERT(!rcuTableGetValue(reader, NO_NAME_ID, &value));
+
+    /* Deleted values keep their slots until the slots are copied */
+    ASSERT(rcuTableDelete(table, 500));
+    ASSERT(!rcuTableDelete(table, 500));
+    ASSERT(!rcuTableGetValue(reader, 500, &value));
+    ASSERT(rcuTableGetSize(table) == 999);
+    rcuTableInsert(table, 500, -1);
+    rcuTableInsert(table, 1, 7);
+    ASSERT(rcuTableGetValue(reader, 500, &value) && fpEq(value, -1));
+    ASSERT(rcuTableGetValue(reader, 1, &value) && fpEq(value, 7));
+    ASSERT(rcuTableGetSize(table) == 1000);
+    destroyRcuReader(reader);
+    destroyRcuTable(table);
+
+    /* Stress: readers check every value they see while a writer keeps assigning, deleting and adding
+     * values (which replaces the slots). Variable i is only assigned multiples of i, in increasing order. */
+    table = createRcuTable();
+    for (NameId id = 1; id <= RCU_STRESS_VARIABLES; ++id)
+    {
+        rcuTableInsert(table, id, 0);
+    }
+    bool is_stopping = false;
+    RcuStressReader readers[31];
+    for (unsigned int i = 0; i < ARRAY_LENGTH(readers); ++i)
+    {
+        readers[i].table = table;
+        readers[i].is_stopping = &is_stopping;
+        readers[i].reads_count = 0;
+        readers[i].errors_count = 0;
+        ASSERT(pthread_create(&readers[i].thread, NULL, readRcuTableValues, &readers[i]) == 0);
+    }
+    for (unsigned int round = 1; round <= RCU_STRESS_ROUNDS; ++round)
+    {
+        for (NameId id = 1; id <= RCU_STRESS_VARIABLES; ++id)
+        {
+            rcuTableInsert(table, id, (double)id * round);
+        }
+        rcuTableDelete(table, round % RCU_STRESS_VARIABLES + 1);
+        rcuTableInsert(table, RCU_STRESS_VARIABLES + round, 0);
+        if (round % 64 == 0) {
+            sched_yield();
+        }
+    }
+    __atomic_store_n(&is_stopping, true, __ATOMIC_RELEASE);
+    for (unsigned int i = 0; i < ARRAY_LENGTH(readers); ++i)
+    {
+        ASSERT(pthread_join(readers[i].thread, NULL) == 0);
+        ASSERT(readers[i].errors_count == 0);
+        ASSERT(readers[i].reads_count > 0);
+    }
+    /* The variable deleted in the last round, and the added ones */
+    ASSERT(rcuTableGetSize(table) == RCU_STRESS_VARIABLES - 1 + RCU_STRESS_ROUNDS);
+    destroyRcuTable(table);
+}
+
+void test_shm_table()
+{
+    char segment_name[64];
+    sprintf(segment_name, "/spcalculator-test-%d", (int)getpid());
+    ASSERT(attachShmTable(segment_name) == NULL);
+
+    HashTable published = createHashTable();
+    hashInsert(published, "shared", 3);
+    hashInsert(published, "overlaid", 4);
+    for (unsigned int i = 0; i < 100; ++i)
+    {
+        char name[3] = {(char)('a' + i / 26), (char)('a' + i % 26), '\0'};
+        hashInsert(published, name, i);
+    }
+    ShmTable publisher = publishShmTable(segment_name, published);
+    destroyHashTable(published);
+    ASSERT(publisher != NULL);
+
+    /* Another attachment maps the same segment (at another address) */
+    ShmTable shared = attachShmTable(segment_name);
+    ASSERT(shared != NULL);
+    ASSERT(shmTableGetSize(shared) == 102);
+    double value = 0;
+    ASSERT(shmTableGetValue(shared, "shared", &value) && fpEq(value, 3));
+    ASSERT(shmTableGetValue(shared, "dv", &value) && fpEq(value, 99));
+    ASSERT(!shmTableGetValue(shared, "missing", &value));
+    detachShmTable(publisher);
+
+    /* The table's own values are consulted first */
+    HashTable variables = createHashTable();
+    hashSetSharedVariables(variables, shared);
+    ASSERT(hashContains(variables, "shared") && hashGetSize(variables) == 0);
+    ASSERT(fpEq(evaluateLispExpressionWithVars("(+(shared)(overlaid))", variables), 7));
+    ASSERT(fpEq(evaluateLispExpressionWithVars("(=(overlaid)(10))", variables), 10));
+    ASSERT(fpEq(evaluateLispExpressionWithVars("(+(shared)(overlaid))", variables), 13));
+    ASSERT(hashGetVersion(variables, "shared") == 0);
+    ASSERT(shmTableGetValue(shared, "overlaid", &value) && fpEq(value, 4));
+    hashDelete(variables, "overlaid");
+    ASSERT(fpEq(hashGetValue(variables, "overlaid"), 4));
+    hashDelete(variables, "overlaid");
+    ASSERT(hashContains(variables, "overlaid"));
+    ASSERT(isnan(evaluateLispExpressionWithVars("(missing)", variables)));
+    destroyHashTable(variables);
+    detachShmTable(shared);
+
+    /* Segments which aren't published tables aren't attached */
+    ASSERT(shm_unlink(segment_name) == 0);
+    ASSERT(attachShmTable(segment_name) == NULL);
+    int fd = shm_open(segment_name, O_CREAT | O_RDWR, 0600);
+    ASSERT(fd != -1 && ftruncate(fd, 4096) == 0);
+    close(fd);
+    ASSERT(attachShmTable(segment_name) == NULL);
+    ASSERT(shm_unlink(segment_name) == 0);
+}
+
+void test_variable_reload()
+{
+    char path[64];
+    sprintf(path, "/tmp/spcalculator-test-%d.vars", (int)getpid());
+    writeVariableFile(path, "kept = 1\nchanged = 2\nremoved = 3\nsession = 4\n");
+    HashTable variables = createHashTable();
+    VariableReloader reloader = createVariableReloader(path, RELOAD_KEEP_SESSION, variables);
+    ASSERT(reloader != NULL);
+    ASSERT(hashGetSize(variables) == 4);
+    ASSERT(fpEq(hashGetValue(variables, "changed"), 2));
+    ASSERT(applyVariableReload(reloader, variables) == 0);
+
+    /* Only the changed names are applied, and a variable which was assigned in the session keeps it's value */
+    hashInsert(variables, "session", 40);
+    unsigned long kept_version = hashGetVersion(variables, "kept");
+    writeVariableFile(path, "kept = 1\nchanged = 20\nsession = 5\nadded = 6\n");
+    ASSERT(waitForVariableReload(reloader, variables) == 3);
+    ASSERT(fpEq(hashGetValue(variables, "changed"), 20));
+    ASSERT(fpEq(hashGetValue(variables, "added"), 6));
+    ASSERT(!hashContains(variables, "removed"));
+    ASSERT(fpEq(hashGetValue(variables, "session"), 40));
+    ASSERT(hashGetVersion(variables, "kept") == kept_version);
+
+    /* An invalid version is ignored, and the next one is diffed with the last valid version */
+    writeVariableFile(path, "changed = twenty\n");
+    writeVariableFile(path, "kept = 1\nchanged = 21\nsession = 5\nadded = 6\n");
+    ASSERT(waitForVariableReload(reloader, variables) == 1);
+    ASSERT(fpEq(hashGetValue(variables, "changed"), 21));
+    destroyVariableReloader(reloader);
+
+    /* The file takes precedence, and a file which is replaced by a rename is still watched */
+    reloader = createVariableReloader(path, RELOAD_PREFER_FILE, variables);
+    ASSERT(reloader != NULL);
+    ASSERT(fpEq(hashGetValue(variables, "session"), 5));
+    hashInsert(variables, "session", 50);
+    char new_path[72];
+    sprintf(new_path, "%s.new", path);
+    writeVariableFile(new_path, "kept = 1\nchanged = 21\nsession = 7\n");
+    ASSERT(rename(new_path, path) == 0);
+    ASSERT(waitForVariableReload(reloader, variables) == 2);
+    ASSERT(fpEq(hashGetValue(variables, "session"), 7));
+    ASSERT(!hashContains(variables, "added"));
+    destroyVariableReloader(reloader);
+
+    ASSERT(unlink(path) == 0);
+    destroyHashTable(variables);
+}
+
+void test_list()
+{
+    SPList list = listCreate();
+    ASSERT(list != NULL);
+
+    /* Owned elements are inserted as they are, and copied elements are copies */
+    SPListElement owned = createElement("owned", 1);
+    ASSERT(SP_LIST_SUCCESS == listInsertFirstOwned(list, owned));
+    ASSERT(listGetFirst(list) == owned);
+    SPListElement copied = createElement("a name longer than an inline string", 2);
+    ASSERT(SP_LIST_SUCCESS == listInsertLast(list, copied));
+    ASSERT(listGetNext(list) != copied);
+    ASSERT(areElementsEqual(listGetCurrent(list), copied));
+    destroyElement(copied);
+    ASSERT(SP_LIST_NULL_ARGUMENT == listInsertLastOwned(list, NULL));
+    ASSERT(2 == listGetSize(list));
+
+    /* Strings can be replaced by strings of any length */
+    ASSERT(SP_ELEMENT_SUCCESS == setElementStr(owned, "another name longer than an inline string"));
+    ASSERT(isElementStrEquals(owned, "another name longer than an inline string"));
+    ASSERT(SP_ELEMENT_SUCCESS == setElementStr(owned, "short"));
+    ASSERT(isElementStrEquals(owned, "short"));
+
+    /* Released nodes are reused, so only the element of an owned insert is allocated */
+    listGetFirst(list);
+    ASSERT(SP_LIST_SUCCESS == listRemoveCurrent(list));
+    size_t live_bytes = getLiveBytes();
+    for (unsigned int i = 0; i < 1000; ++i)
+    {
+        ASSERT(SP_LIST_SUCCESS == listInsertFirstOwned(list, createElement("x", i)));
+        listGetFirst(list);
+        ASSERT(isElementValueEquals(listGetCurrent(list), i));
+        ASSERT(SP_LIST_SUCCESS == listRemoveCurrent(list));
+        ASSERT(getLiveBytes() == live_bytes);
+    }
+    listDestroy(list);
+}
+
+/* Instantiations of the container templates */
+#define IS_NUMBER_EQUAL(first, second) ((first) == (second))
+#define HASH_NUMBER(number) ((number) / 2)
+DEFINE_VECTOR(NumberVector, numberVector, unsigned int, ALLOC_EVALUATION)
+DEFINE_MAP(NumberMap, numberMap, unsigned int, double, HASH_NUMBER, IS_NUMBER_EQUAL, ALLOC_EVALUATION)
+
+typedef struct Item_
+{
+    unsigned int number;
+    LIST_LINK(struct Item_) link;
+} Item;
+DEFINE_LIST(ItemList, itemList, Item, link)
+
+void test_containers()
+{
+    size_t live_bytes = getLiveBytes();
+
+    /* A vector moves from it's buffer to the heap */
+    unsigned int buffer[4];
+    NumberVector vector;
+    numberVectorInit(&vector, buffer, ARRAY_LENGTH(buffer));
+    for (unsigned int i = 0; i < 100; ++i)
+    {
+        numberVectorPush(&vector, i);
+        ASSERT(vector.items == buffer || i >= ARRAY_LENGTH(buffer));
+    }
+    ASSERT(vector.count == 100 && vector.items[0] == 0 && vector.items[99] == 99);
+    numberVectorDestroy(&vector);
+
+    /* A map doesn't allocate until it's used, and finds keys after colliding keys are removed */
+    NumberMap map;
+    numberMapInit(&map);
+    ASSERT(numberMapFind(&map, 1) == NULL);
+    ASSERT(getLiveBytes() == live_bytes);
+    bool is_new = false;
+    for (unsigned int i = 0; i < 1000; ++i)
+    {
+        *numberMapInsert(&map, i, &is_new) = i;
+        ASSERT(is_new);
+    }
+    *numberMapInsert(&map, 7, &is_new) = 70;
+    ASSERT(!is_new && map.count == 1000);
+    double value = 0;
+    for (unsigned int i = 0; i < 1000; i += 2)
+    {
+        ASSERT(numberMapRemove(&map, i, (i == 6) ? &value : NULL));
+    }
+    ASSERT(value == 6 && !numberMapRemove(&map, 6, NULL));
+    ASSERT(map.count == 500);
+    for (unsigned int i = 1; i < 1000; i += 2)
+    {
+        ASSERT(numberMapFind(&map, i) != NULL);
+        ASSERT(*numberMapFind(&map, i) == ((i == 7) ? 70 : i));
+        ASSERT(numberMapFind(&map, i - 1) == NULL);
+    }
+    unsigned int slots_count = 0;
+    unsigned int index = 0;
+    for (NumberMapSlot* slot = numberMapNext(&map, &index); slot != NULL; slot = numberMapNext(&map, &index))
+    {
+        ASSERT(slot->key % 2 == 1);
+        slots_count += 1;
+    }
+    ASSERT(slots_count == 500);
+    numberMapDestroy(&map);
+
+    /* Elements are linked in place */
+    Item items[3] = {{0}, {1}, {2}};
+    ItemList list;
+    itemListInit(&list);
+    itemListInsertLast(&list, &items[1]);
+    itemListInsertFirst(&list, &items[0]);
+    itemListInsertLast(&list, &items[2]);
+    itemListRemove(&list, &items[1]);
+    ASSERT(list.count == 2 && list.first == &items[0] && list.last == &items[2]);
+    ASSERT(items[0].link.next == &items[2] && items[2].link.previous == &items[0]);
+    itemListRemove(&list, &items[0]);
+    itemListRemove(&list, &items[2]);
+    ASSERT(list.count == 0 && list.first == NULL && list.last == NULL);
+
+    ASSERT(getLiveBytes() == live_bytes);
+}
+
+void countDiff(void* context, const char* name, bool is_set, double value)
+{
+    *(unsigned int*)context += 1;
+}
+
+void test_checkpoints()
+{
+    /* Changing a map keeps the old map intact */
+    VarMap empty = createVarMap();
+    VarMap map = varMapInsert(empty, "a", 1);
+    char name[16];
+    for (unsigned int i = 0; i < 1000; ++i)
+    {
+        sprintf(name, "v%u", i);
+        VarMap next = varMapInsert(map, name, i);
+        releaseVarMap(map);
+        map = next;
+    }
+    VarMap changed = varMapInsert(map, "a", 2);
+    VarMap deleted = varMapDelete(changed, "v7");
+    double value;
+    ASSERT(varMapGet(map, "a", &value) && value == 1);
+    ASSERT(varMapGet(changed, "a", &value) && value == 2);
+    ASSERT(varMapGet(changed, "v7", &value) && value == 7);
+    ASSERT(!varMapGet(deleted, "v7", &value));
+    ASSERT(!varMapGet(empty, "a", &value));
+    ASSERT(varMapSize(map) == 1001 && varMapSize(deleted) == 1000);
+
+    /* Only the differences are reported */
+    unsigned int differences = 0;
+    varMapDiff(map, deleted, countDiff, &differences);
+    ASSERT(differences == 2);
+    differences = 0;
+    varMapDiff(empty, map, countDiff, &differences);
+    ASSERT(differences == 1001);
+    releaseVarMap(deleted);
+    releaseVarMap(changed);
+    releaseVarMap(map);
+    releaseVarMap(empty);
+
+    /* Roll a table back and forth between checkpoints */
+    HashTable table = createHashTable();
+    hashInsert(table, "x", 1);
+    hashInsert(table, "y", 2);
+    ASSERT(hashCheckpoint(table) == 1);
+    hashInsert(table, "x", 10);
+    hashDelete(table, "y");
+    hashInsert(table, "z", 3);
+    unsigned long version = hashGetVersion(table, "z");
+    ASSERT(hashCheckpoint(table) == 2);
+    ASSERT(hashRollback(table, 1));
+    ASSERT(fpEq(1, hashGetValue(table, "x")) && fpEq(2, hashGetValue(table, "y")));
+    ASSERT(!hashContains(table, "z"));
+    ASSERT(hashRollback(table, 2));
+    ASSERT(fpEq(10, hashGetValue(table, "x")) && fpEq(3, hashGetValue(table, "z")));
+    ASSERT(!hashContains(table, "y"));
+    ASSERT(hashGetVersion(table, "z") != version);
+    ASSERT(!hashRollback(table, 0) && !hashRollback(table, 3));
+
+    /* Commands are recognized by the compiler */
+    CompiledLine compiled;
+    compileLine("(<checkpoint>)", table, &compiled);
+    ASSERT(compiled.is_checkpoint_command && !compiled.is_rollback_command);
+    releaseCompiledLine(&compiled);
+    compileLine("(<rollback>(2))", table, &compiled);
+    ASSERT(compiled.is_rollback_command && getNumber(firstChild(compiled.tree)) == 2);
+    releaseCompiledLine(&compiled);
+    compileLine("(<rollback>(x))", table, &compiled);
+    ASSERT(!compiled.is_rollback_command);
+    releaseCompiledLine(&compiled);
+    destroyHashTable(table);
+
+    /* A rollback restores the values of formulas, but keeps them bound */
+    table = createHashTable();
+    FormulaEngine formulas = createFormulaEngine(table);
+    NameId names[] = {internName("d", 1)};
+    hashInsert(table, "a", 1);
+    Tree* binding = parseLispExpression("(:=(c)(+(a)(1)))");
+    bindFormula(formulas, "c", lastChild(binding));
+    destroyTree(binding);
+    binding = parseLispExpression("(:=(d)(*(c)(2)))");
+    bindFormula(formulas, "d", lastChild(binding));
+    destroyTree(binding);
+    hashInsert(table, "a", 10);
+    refreshFormulas(formulas, names, 1);
+    ASSERT(fpEq(hashGetValue(table, "d"), 22));
+    ASSERT(hashCheckpoint(table) == 1);
+    hashInsert(table, "a", 100);
+    refreshFormulas(formulas, names, 1);
+    ASSERT(fpEq(hashGetValue(table, "d"), 202));
+    ASSERT(hashRollback(table, 1));
+    ASSERT(isFormula(formulas, "c") && isFormula(formulas, "d"));
+    refreshFormulas(formulas, names, 1);
+    ASSERT(fpEq(hashGetValue(table, "d"), 22));
+    hashInsert(table, "a", 5);
+    refreshFormulas(formulas, names, 1);
+    ASSERT(fpEq(hashGetValue(table, "d"), 12));
+    hashInsert(table, "c", 7);
+    refreshFormulas(formulas, names, 1);
+    ASSERT(fpEq(hashGetValue(table, "d"), 14));
+    destroyFormulaEngine(formulas);
+    destroyHashTable(table);
+}
+
 void test_variable_file_parsing()
 {
     HashTable table = createHashTable();
@@ -287,6 +1008,91 @@ void test_variable_file_parsing()
     destroyHashTable(table);
 }
 
+void test_deep_nesting()
+{
+    /* A unary minus chain nested millions deep, i.e. (-(-(...(-(7))...))) */
+    const unsigned int depth = 2000000;
+    unsigned int length = 3 * depth + 3;
+    char* lisp_expression = malloc(length + 1);
+    ASSERT(lisp_expression != NULL);
+    for (unsigned int i = 0; i < depth; ++i)
+    {
+        memcpy(lisp_expression + 2 * i, "(-", 2);
+        lisp_expression[2 * depth + 3 + i] = ')';
+    }
+    memcpy(lisp_expression + 2 * depth, "(7)", 3);
+    lisp_expression[length] = '\0';
+
+    /* Too deep for the default depth limit */
+    ASSERT(getMaxExpressionDepth() == DEFAULT_MAX_EXPRESSION_DEPTH);
+    ASSERT(parseLispExpression(lisp_expression) == NULL);
+    HashTable variables = createHashTable();
+    CompiledLine compiled;
+    compileLine(lisp_expression, variables, &compiled);
+    ASSERT(compiled.is_invalid);
+    ASSERT_EQ_STR(compiled.expression_string, lisp_expression);
+    releaseCompiledLine(&compiled);
+
+    setMaxExpressionDepth(depth + 1);
+    Tree* tree = parseLispExpression(lisp_expression);
+    ASSERT(tree != NULL);
+    ASSERT(treeSize(tree) == depth + 1);
+
+    /* Also parse it in chunks */
+    LispParser parser = createLispParser();
+    for (unsigned int i = 0; i < length; i += 4096)
+    {
+        feedLispParser(parser, lisp_expression + i, (length - i < 4096) ? length - i : 4096);
+    }
+    Tree* chunked_tree = finishLispParser(parser);
+    ASSERT(treeSize(chunked_tree) == depth + 1);
+    destroyTree(chunked_tree);
+
+    ASSERT(evaluateExpressionTree(tree, variables) == 7);
+    Tree* copy = copyTree(tree);
+    setValue(copy, copyString("+"));
+    ASSERT(evaluateExpressionTree(copy, variables) == -7);
+    destroyTree(copy);
+
+    /* The compilation passes (optimization, DAG building) handle it too, native compilation gives up on it */
+    ASSERT(createJitCode(tree, NULL, 0) == NULL);
+    compileLine(lisp_expression, variables, &compiled);
+    ASSERT(!compiled.is_invalid);
+    ASSERT(evaluateCompiledLine(&compiled, variables) == 7);
+    releaseCompiledLine(&compiled);
+    lisp_expression[2 * depth + 1] = 'a';
+    hashInsert(variables, "a", 5);
+    compileLine(lisp_expression, variables, &compiled);
+    ASSERT(!compiled.is_invalid);
+    ASSERT(evaluateCompiledLine(&compiled, variables) == 5);
+    releaseCompiledLine(&compiled);
+    lisp_expression[2 * depth + 1] = '7';
+    destroyHashTable(variables);
+
+    /* The infix string is the lisp expression without the parentheses around the literal */
+    ASSERT(expressionStringSize(tree) >= length + 1);
+    char* string = malloc(length + 1);
+    ASSERT(string != NULL);
+    expressionToString(tree, string, length + 1);
+    ASSERT(strlen(string) == length - 2);
+    ASSERT(strncmp(string, lisp_expression, 2 * depth) == 0);
+    ASSERT(string[2 * depth] == '7');
+    ASSERT_EQ_STR(string + 2 * depth + 1, lisp_expression + 2 * depth + 3);
+    free(string);
+    destroyTree(tree);
+    setMaxExpressionDepth(DEFAULT_MAX_EXPRESSION_DEPTH);
+
+    /* The limit is inclusive */
+    setMaxExpressionDepth(3);
+    tree = parseLispExpression("(+(-(1))(2))");
+    ASSERT(tree != NULL);
+    destroyTree(tree);
+    ASSERT(parseLispExpression("(+(-(-(1)))(2))") == NULL);
+    setMaxExpressionDepth(DEFAULT_MAX_EXPRESSION_DEPTH);
+
+    free(lisp_expression);
+}
+
 void test_expression_to_string()
 {
     ASSERT(checkSingleExpressionToString("(+(5)(2))", "(5+2)"));
@@ -300,15 +1106,520 @@ void test_expression_to_string()
     ASSERT(checkSingleExpressionToString("(max(5)(32)(+(17)(5)))", "(max(5,32,(17+5)))"));
 }
 
+void test_optimize()
+{
+    ASSERT(checkSingleOptimization("(+(3)(4))", "(7)", 2));
+    ASSERT(checkSingleOptimization("(-(3)(4))", "(-1)", 1));
+    ASSERT(checkSingleOptimization("(*(x)(1))", "(x)", 2));
+    ASSERT(checkSingleOptimization("(*(1)(+(x)(y)))", "(x+y)", 2));
+    ASSERT(checkSingleOptimization("(/(-(x)(0))(1))", "(x)", 4));
+    ASSERT(checkSingleOptimization("(-(-(+(x))))", "(x)", 3));
+    ASSERT(checkSingleOptimization("(-(-(5)))", "(5)", 2));
+    ASSERT(checkSingleOptimization("($(1)(4))", "(10)", 2));
+    ASSERT(checkSingleOptimization("(max(1)(5)(-(3)))", "(5)", 4));
+    ASSERT(checkSingleOptimization("(median(1)(5)(-(3)))", "(1)", 4));
+    ASSERT(checkSingleOptimization("(+(x)(min(4)(*(2)(3))))", "(x+4)", 4));
+    ASSERT(checkSingleOptimization("(=(a)(*(+(1)(2))(1)))", "(a=3)", 4));
+
+    /* Results that are not representable exactly are kept */
+    ASSERT(checkSingleOptimization("(/(3)(0))", "(3/0)", 0));
+    ASSERT(checkSingleOptimization("(/(1)(2))", "(1/2)", 0));
+    ASSERT(checkSingleOptimization("($(3)(2))", "(3$2)", 0));
+    ASSERT(checkSingleOptimization("(-(0))", "(-0)", 0));
+    ASSERT(checkSingleOptimization("(*(0)(-(1)))", "(0*(-1))", 0));
+    ASSERT(checkSingleOptimization("(+(x)(0))", "(x+0)", 0));
+    ASSERT(checkSingleOptimization("(*(2000000000)(2))", "(2000000000*2)", 0));
+}
+
+void test_dag()
+{
+    HashTable variables = createHashTable();
+    hashInsert(variables, "a", 3);
+    hashInsert(variables, "b", -7);
+
+    ASSERT(checkSingleDagEvaluation("(1)", variables, 0));
+    ASSERT(checkSingleDagEvaluation("(+(a)(b))", variables, 0));
+    ASSERT(checkSingleDagEvaluation("(+(a)(a))", variables, 1));
+    ASSERT(checkSingleDagEvaluation("(min(*(a)(b))(*(a)(b))(+(*(a)(b))(1)))", variables, 6));
+    ASSERT(checkSingleDagEvaluation("(median(-(a))(-(a))(b)(-(a)(b)))", variables, 4));
+    ASSERT(checkSingleDagEvaluation("(max(/(a)(0))(/(a)(0)))", variables, 3));
+    ASSERT(checkSingleDagEvaluation("($(a)(-(b)))", variables, 0));
+    ASSERT(checkSingleDagEvaluation("(+(c)(*(c)(1)))", variables, 1));
+    ASSERT(checkSingleDagEvaluation("(=(c)(+(*(a)(b))(*(a)(b))))", variables, 3));
+    ASSERT(fpEq(hashGetValue(variables, "c"), -42));
+    ASSERT(checkSingleDagEvaluation("(=(d)(/(c)(0)))", variables, 0));
+    ASSERT(!hashContains(variables, "d"));
+
+    /* Nested assignments are not supported */
+    Tree* tree = parseLispExpression("(+(=(e)(1))(e))");
+    ASSERT(createExpressionDag(tree) == NULL);
+    destroyTree(tree);
+
+    destroyHashTable(variables);
+}
+
+void test_jit()
+{
+    HashTable variables = createHashTable();
+    hashInsert(variables, "a", 3);
+    hashInsert(variables, "b", -4);
+    hashInsert(variables, "z", 0);
+    hashInsert(variables, "w", -0.0);
+
+    ASSERT(checkSingleJitEvaluation("(7)", variables));
+    ASSERT(checkSingleJitEvaluation("(-(z))", variables));
+    ASSERT(checkSingleJitEvaluation("(+(w))", variables));
+    ASSERT(checkSingleJitEvaluation("(/(a)(z))", variables));
+    ASSERT(checkSingleJitEvaluation("(/(a)(w))", variables));
+    ASSERT(checkSingleJitEvaluation("(/(b)(a))", variables));
+    ASSERT(checkSingleJitEvaluation("(+(a)(n))", variables));
+    ASSERT(checkSingleJitEvaluation("(median(a)(b)(z)(-(a)(b)))", variables));
+    ASSERT(checkSingleJitEvaluation("(min(w)(z))", variables));
+
+    /* Differential test against the interpreter, on random expressions */
+    srand(1);
+    for (int i = 0; i < 5000; ++i)
+    {
+        char line[4 * MAX_LINE_LENGTH];
+        line[0] = '\0';
+        generateLispExpression(line, 5);
+        if (strlen(line) <= MAX_LINE_LENGTH) {
+            ASSERT(checkSingleJitEvaluation(line, variables));
+        }
+    }
+
+    if (isJitSupported()) {
+        /* Root assignment */
+        CompiledLine compiled;
+        compileLine("(=(c)(*(a)(b)))", variables, &compiled);
+        JitCode code = createJitCode(compiled.tree, compiled.variable_ids, compiled.variables_count);
+        ASSERT(code != NULL);
+        ASSERT(fpEq(runJitCode(code, variables), -12));
+        ASSERT(fpEq(hashGetValue(variables, "c"), -12));
+        hashInsert(variables, "b", 0);
+        ASSERT(fpEq(runJitCode(code, variables), 0));
+        ASSERT(fpEq(hashGetValue(variables, "c"), 0));
+        hashDelete(variables, "b");
+        ASSERT(isnan(runJitCode(code, variables)));
+        ASSERT(fpEq(hashGetValue(variables, "c"), 0));
+        destroyJitCode(code);
+        releaseCompiledLine(&compiled);
+
+        /* Nested assignments are not supported */
+        compileLine("(+(=(e)(1))(e))", variables, &compiled);
+        ASSERT(createJitCode(compiled.tree, compiled.variable_ids, compiled.variables_count) == NULL);
+        releaseCompiledLine(&compiled);
+    }
+
+    /* Hot lines are compiled */
+    hashInsert(variables, "b", 5);
+    PlanCache cache = createPlanCache(1024 * 1024);
+    for (int i = 0; i < 100; ++i)
+    {
+        hashInsert(variables, "a", i);
+        CompiledLine* compiled = planCacheGet(cache, "(+(*(a)(b))(1))", variables);
+        ASSERT(fpEq(evaluateCompiledLine(compiled, variables), 5 * i + 1));
+        if (i == 99) {
+            ASSERT((compiled->jit != NULL) == isJitSupported());
+        }
+    }
+    PlanCacheStats stats;
+    getPlanCacheStats(cache, &stats);
+    size_t hot_bytes = stats.bytes;
+    destroyPlanCache(cache);
+
+    /* The native code is counted in the cache's memory, and is evicted with it's line */
+    if (isJitSupported()) {
+        cache = createPlanCache(hot_bytes - 1);
+        for (int i = 0; i < 100; ++i)
+        {
+            hashInsert(variables, "a", i);
+            CompiledLine* compiled = planCacheGet(cache, "(+(*(a)(b))(1))", variables);
+            ASSERT(fpEq(evaluateCompiledLine(compiled, variables), 5 * i + 1));
+        }
+        getPlanCacheStats(cache, &stats);
+        ASSERT(stats.bytes < hot_bytes && stats.evictions > 0);
+        destroyPlanCache(cache);
+    }
+
+    destroyHashTable(variables);
+}
+
+void test_plan_cache()
+{
+    HashTable variables = createHashTable();
+    PlanCache cache = createPlanCache(1024 * 1024);
+    PlanCacheStats stats;
+
+    CompiledLine* compiled = planCacheGet(cache, "(=(a)(*(3)(1)))", variables);
+    ASSERT_EQ_STR(compiled->expression_string, "(a=(3*1))");
+    ASSERT(compiled->is_assignment);
+    ASSERT(!compiled->is_end_command);
+    ASSERT(fpEq(evaluateCompiledLine(compiled, variables), 3));
+
+    compiled = planCacheGet(cache, "(+(a)(1))", variables);
+    ASSERT(fpEq(evaluateCompiledLine(compiled, variables), 4));
+    compiled = planCacheGet(cache, "(=(a)(*(3)(1)))", variables);
+    ASSERT(compiled->is_assignment);
+    compiled = planCacheGet(cache, "(<>)", variables);
+    ASSERT(compiled->is_end_command);
+
+    getPlanCacheStats(cache, &stats);
+    ASSERT(stats.hits == 1);
+    ASSERT(stats.misses == 3);
+    ASSERT(stats.evictions == 0);
+    ASSERT(stats.entries == 3);
+    destroyPlanCache(cache);
+
+    cache = createPlanCache(1024 * 1024);
+    planCacheGet(cache, "(1)", variables);
+    getPlanCacheStats(cache, &stats);
+    size_t entry_size = stats.bytes;
+    destroyPlanCache(cache);
+
+    /* A cache that fits two entries evicts the least recently used one */
+    cache = createPlanCache(2 * entry_size);
+    planCacheGet(cache, "(1)", variables);
+    planCacheGet(cache, "(2)", variables);
+    planCacheGet(cache, "(1)", variables);
+    planCacheGet(cache, "(3)", variables);
+    planCacheGet(cache, "(1)", variables);
+    planCacheGet(cache, "(2)", variables);
+    getPlanCacheStats(cache, &stats);
+    ASSERT(stats.hits == 2);
+    ASSERT(stats.misses == 4);
+    ASSERT(stats.evictions == 2);
+    ASSERT(stats.entries == 2);
+    ASSERT(stats.bytes <= 2 * entry_size);
+    destroyPlanCache(cache);
+
+    /* Many entries (the hash buckets are grown) */
+    cache = createPlanCache(1024 * 1024);
+    char line[MAX_LINE_LENGTH + 1];
+    for (int round = 0; round < 2; ++round)
+    {
+        for (int i = 0; i < 200; ++i)
+        {
+            sprintf(line, "(+(%d)(a))", i);
+            compiled = planCacheGet(cache, line, variables);
+            ASSERT(fpEq(evaluateCompiledLine(compiled, variables), i + 3));
+        }
+    }
+    getPlanCacheStats(cache, &stats);
+    ASSERT(stats.hits == 200 && stats.misses == 200 && stats.entries == 200);
+    destroyPlanCache(cache);
+
+    cache = createPlanCache(0);
+    compiled = planCacheGet(cache, "(+(a)(1))", variables);
+    ASSERT(fpEq(evaluateCompiledLine(compiled, variables), 4));
+    planCacheGet(cache, "(+(a)(1))", variables);
+    getPlanCacheStats(cache, &stats);
+    ASSERT(stats.hits == 0 && stats.misses == 2 && stats.entries == 0);
+    destroyPlanCache(cache);
+
+    destroyHashTable(variables);
+}
+
+void test_memoization()
+{
+    HashTable variables = createHashTable();
+    ASSERT(hashGetVersion(variables, "a") == 0);
+    hashInsert(variables, "a", 1);
+    unsigned long version = hashGetVersion(variables, "a");
+    ASSERT(version != 0);
+    hashInsert(variables, "b", 2);
+    ASSERT(hashGetVersion(variables, "a") == version);
+    hashInsert(variables, "a", 1);
+    ASSERT(hashGetVersion(variables, "a") > version);
+
+    PlanCache cache = createPlanCache(1024 * 1024);
+    const char* median_line = "(median(a)(b)(c)(+(a)(b))(*(b)(3)))";
+    CompiledLine* compiled = planCacheGet(cache, median_line, variables);
+    ASSERT(compiled->is_memoizable);
+    ASSERT(compiled->variables_count == 3);
+    ASSERT(isnan(evaluateCompiledLine(compiled, variables)));
+    ASSERT(compiled->has_memo);
+
+    evaluateCompiledLine(planCacheGet(cache, "(=(c)(10))", variables), variables);
+    compiled = planCacheGet(cache, median_line, variables);
+    ASSERT(fpEq(evaluateCompiledLine(compiled, variables), 3));
+    ASSERT(fpEq(evaluateCompiledLine(compiled, variables), 3));
+    hashInsert(variables, "b", 20);
+    ASSERT(fpEq(evaluateCompiledLine(compiled, variables), 20));
+    hashDelete(variables, "c");
+    ASSERT(isnan(evaluateCompiledLine(compiled, variables)));
+
+    /* Assignments are never memoized */
+    compiled = planCacheGet(cache, "(=(d)(+(b)(1)))", variables);
+    ASSERT(!compiled->is_memoizable);
+    ASSERT(fpEq(evaluateCompiledLine(compiled, variables), 21));
+    compiled = planCacheGet(cache, "(+(=(d)(1))(d))", variables);
+    ASSERT(!compiled->is_memoizable);
+
+    destroyPlanCache(cache);
+    destroyHashTable(variables);
+}
+
+void test_formulas()
+{
+    HashTable variables = createHashTable();
+    FormulaEngine formulas = createFormulaEngine(variables);
+    hashInsert(variables, "a", 1);
+    hashInsert(variables, "b", 2);
+
+    /* c := a + b, d := c * 10 */
+    Tree* binding = parseLispExpression("(:=(c)(+(a)(b)))");
+    ASSERT(isBindingExpression(binding));
+    ASSERT(fpEq(bindFormula(formulas, "c", lastChild(binding)), 3));
+    destroyTree(binding);
+    binding = parseLispExpression("(:=(d)(*(c)(10)))");
+    ASSERT(fpEq(bindFormula(formulas, "d", lastChild(binding)), 30));
+    destroyTree(binding);
+    ASSERT(isFormula(formulas, "c") && isFormula(formulas, "d"));
+    ASSERT(!isFormula(formulas, "a"));
+
+    /* Changes propagate lazily */
+    NameId names[] = {internName("d", 1)};
+    hashInsert(variables, "a", 5);
+    ASSERT(fpEq(hashGetValue(variables, "d"), 30));
+    refreshFormulas(formulas, names, 1);
+    ASSERT(fpEq(hashGetValue(variables, "c"), 7));
+    ASSERT(fpEq(hashGetValue(variables, "d"), 70));
+
+    /* Invalid values remove the variable, until the formula is valid again */
+    hashDelete(variables, "b");
+    refreshFormulas(formulas, names, 1);
+    ASSERT(!hashContains(variables, "c") && !hashContains(variables, "d"));
+    hashInsert(variables, "b", 0);
+    refreshFormulas(formulas, names, 1);
+    ASSERT(fpEq(hashGetValue(variables, "d"), 50));
+
+    /* Cycles and nested assignments aren't bound */
+    binding = parseLispExpression("(:=(a)(+(d)(1)))");
+    ASSERT(isnan(bindFormula(formulas, "a", lastChild(binding))));
+    destroyTree(binding);
+    binding = parseLispExpression("(:=(e)(+(=(a)(1))(1)))");
+    ASSERT(isnan(bindFormula(formulas, "e", lastChild(binding))));
+    destroyTree(binding);
+    ASSERT(!isFormula(formulas, "a") && !isFormula(formulas, "e"));
+    ASSERT(fpEq(hashGetValue(variables, "a"), 5));
+
+    /* A plain assignment unbinds the formula */
+    hashInsert(variables, "c", 100);
+    ASSERT(!isFormula(formulas, "c"));
+    hashInsert(variables, "a", 0);
+    refreshFormulas(formulas, names, 1);
+    ASSERT(fpEq(hashGetValue(variables, "c"), 100));
+    ASSERT(fpEq(hashGetValue(variables, "d"), 1000));
+
+    destroyFormulaEngine(formulas);
+    destroyHashTable(variables);
+}
+
+void test_stats()
+{
+    enableStats();
+    unsigned long long nodes_parsed = statsCounters[COUNTER_NODES_PARSED];
+    Tree* tree = parseLispExpression("(+(1)(*(2)(3)))");
+    ASSERT(statsCounters[COUNTER_NODES_PARSED] == nodes_parsed + 5);
+    destroyTree(tree);
+
+    /* (*(2)(3)) is folded into a single node */
+    unsigned long long nodes_folded = statsCounters[COUNTER_NODES_FOLDED];
+    HashTable variables = createHashTable();
+    CompiledLine compiled;
+    compileLine("(+(a)(*(2)(3)))", variables, &compiled);
+    ASSERT(statsCounters[COUNTER_NODES_FOLDED] == nodes_folded + 2);
+    releaseCompiledLine(&compiled);
+
+    /* The 11 products share 3 DAG nodes, of their 33 tree nodes */
+    unsigned long long dag_nodes_shared = statsCounters[COUNTER_DAG_NODES_SHARED];
+    compileLine("(min(*(a)(b))(*(a)(b))(*(a)(b))(*(a)(b))(*(a)(b))(*(a)(b))"
+                "(*(a)(b))(*(a)(b))(*(a)(b))(*(a)(b))(*(a)(b)))", variables, &compiled);
+    ASSERT(compiled.dag != NULL);
+    ASSERT(statsCounters[COUNTER_DAG_NODES_SHARED] == dag_nodes_shared + 30);
+    releaseCompiledLine(&compiled);
+    destroyHashTable(variables);
+
+    /* Latencies of 1us to 100us (the timers themselves add a few nanoseconds) */
+    for (uint64_t latency = 1000; latency <= 100000; latency += 1000)
+    {
+        stopStageTimer(STAGE_EVALUATE, startStageTimer() - latency);
+    }
+
+    char* output = NULL;
+    size_t output_length = 0;
+    FILE* output_file = open_memstream(&output, &output_length);
+    ASSERT(output_file != NULL);
+    printStats(output_file, STATS_JSON);
+    ASSERT(fclose(output_file) == 0);
+    char* evaluate = strstr(output, "\"evaluate\": {\"count\": 100, ");
+    ASSERT(evaluate != NULL);
+    unsigned long long p50;
+    unsigned long long p99;
+    ASSERT(sscanf(strstr(evaluate, "\"p50_ns\""), "\"p50_ns\": %llu", &p50) == 1);
+    ASSERT(sscanf(strstr(evaluate, "\"p99_ns\""), "\"p99_ns\": %llu", &p99) == 1);
+    ASSERT(p50 >= 50000 && p50 < 50000 * 17 / 16 + 1000);
+    ASSERT(p99 >= 99000 && p99 < 99000 * 17 / 16 + 1000);
+    free(output);
+
+    /* SIGUSR1 requests both forms, it's blocked until the input is waited for */
+    ASSERT(raise(SIGUSR1) == 0);
+    output_file = open_memstream(&output, &output_length);
+    ASSERT(output_file != NULL);
+    handleStatsRequest(output_file);
+    ASSERT(fflush(output_file) == 0 && output_length == 0);
+    allowStatsRequests(true);
+    handleStatsRequest(output_file);
+    allowStatsRequests(false);
+    ASSERT(fclose(output_file) == 0);
+    ASSERT(strncmp(output, "stage", 5) == 0 && strstr(output, "\n{\"stages\": {") != NULL);
+    free(output);
+    statsEnabled = false;
+
+    ASSERT(checkIdleStatsRequest());
+}
+
+void test_alloc()
+{
+    /* Everything allocated for a parsed tree and a lookup is released */
+    size_t live_bytes = getLiveBytes();
+    HashTable variables = createHashTable();
+    hashInsert(variables, "x", 2);
+    Tree* tree = parseLispExpression("(+(x)(*(2)(3)))");
+    ASSERT(getLiveBytes() > live_bytes);
+    ASSERT(getPeakBytes() >= getLiveBytes());
+    size_t tree_live_bytes = getLiveBytes();
+    ASSERT(fpEq(8, evaluateExpressionTree(tree, variables)));
+    ASSERT(fpEq(2, hashGetValue(variables, "x")));
+    ASSERT(getLiveBytes() == tree_live_bytes);
+    destroyTree(tree);
+    destroyHashTable(variables);
+    ASSERT(getLiveBytes() == live_bytes);
+
+    /* Resized memory is accounted by it's new size, and zeroed memory is zeroed */
+    unsigned int* numbers = ALLOCATE_ZEROED(ALLOC_EVALUATION, 4, sizeof(*numbers));
+    ASSERT(numbers != NULL && numbers[3] == 0);
+    ASSERT(getLiveBytes() == live_bytes + 4 * sizeof(*numbers));
+    numbers = REALLOCATE(ALLOC_EVALUATION, numbers, 64 * sizeof(*numbers));
+    ASSERT(numbers != NULL && numbers[3] == 0);
+    ASSERT(getLiveBytes() == live_bytes + 64 * sizeof(*numbers));
+    deallocate(numbers);
+    ASSERT(getLiveBytes() == live_bytes);
+
+    /* Sites are reported with their category, once they're enabled */
+    enableAllocationSites();
+    tree = parseLispExpression("(1)");
+    destroyTree(tree);
+    char* output = NULL;
+    size_t output_length = 0;
+    FILE* output_file = open_memstream(&output, &output_length);
+    ASSERT(output_file != NULL);
+    printAllocationStats(output_file, STATS_JSON);
+    ASSERT(fclose(output_file) == 0);
+    ASSERT(strstr(output, "{\"site\": \"tree.c:") != NULL);
+    ASSERT(strstr(output, "\"category\": \"trees\"") != NULL);
+    free(output);
+}
+
+void test_trace()
+{
+    char* output = NULL;
+    size_t output_length = 0;
+    FILE* output_file = open_memstream(&output, &output_length);
+    ASSERT(output_file != NULL);
+    startTrace(output_file);
+
+    /* More spans than the ring buffer holds */
+    const unsigned int spans_count = 200000;
+    for (unsigned int i = 0; i < spans_count; ++i)
+    {
+        stopTraceSpan("span", startTraceSpan());
+    }
+    traceNextLine();
+    ASSERT(fpEq(evaluateLispExpression("(median(3)(1)(2))"), 2));
+    stopTrace();
+    ASSERT(fclose(output_file) == 0);
+
+    ASSERT(strncmp(output, "{\"traceEvents\": [\n", strlen("{\"traceEvents\": [\n")) == 0);
+    ASSERT_EQ_STR(output + output_length - strlen("\n]}\n"), "\n]}\n");
+    /* Each event is written in it's own line */
+    const char span_prefix[] = "{\"name\":\"span\"";
+    unsigned int found_count = 0;
+    for (char* line = output; line != NULL; line = memchr(line, '\n', output + output_length - line))
+    {
+        line += (*line == '\n') ? 1 : 0;
+        if (strncmp(line, span_prefix, strlen(span_prefix)) == 0) {
+            found_count += 1;
+        }
+    }
+    ASSERT(found_count == spans_count);
+    char* median = strstr(output, "{\"name\":\"median\",\"ph\":\"X\"");
+    ASSERT(median != NULL && strstr(median, "\"args\":{\"line\":1}}") != NULL);
+    free(output);
+
+    /* Spans aren't recorded when tracing is stopped */
+    ASSERT(startTraceSpan() == 0);
+
+    /* The calculator (built by make all) writes the output of each input line in a span of it's own */
+    char input_path[64];
+    char trace_path[64];
+    char command[256];
+    sprintf(input_path, "/tmp/spcalculator-test-%d.in", (int)getpid());
+    sprintf(trace_path, "/tmp/spcalculator-test-%d.json", (int)getpid());
+    FILE* input_file = fopen(input_path, "w");
+    ASSERT(input_file != NULL);
+    fprintf(input_file, "(+(1)(2))\n(=(a)(3))\n(*(a)(2))\n(<>)\n");
+    ASSERT(fclose(input_file) == 0);
+    sprintf(command, "./SPCalculator --trace %s < %s > /dev/null", trace_path, input_path);
+    ASSERT(system(command) == 0);
+
+    FILE* trace_file = fopen(trace_path, "r");
+    ASSERT(trace_file != NULL);
+    char line[256];
+    unsigned int write_spans_count = 0;
+    while (fgets(line, sizeof(line), trace_file) != NULL)
+    {
+        if (strstr(line, "{\"name\":\"write\"") != NULL) {
+            write_spans_count += 1;
+        }
+    }
+    ASSERT(fclose(trace_file) == 0);
+    ASSERT(write_spans_count == 4);
+    ASSERT(unlink(input_path) == 0);
+    ASSERT(unlink(trace_path) == 0);
+}
+
 int main()
 {
     printf("Running Tests...\n");
     test_tree();
     test_parse();
+    test_scan();
+    test_codec();
+    test_batch();
     test_calculate();
+    test_reduce();
+    test_optimize();
+    test_dag();
+    test_jit();
+    test_plan_cache();
+    test_memoization();
+    test_formulas();
     test_hashtable();
+    test_intern();
+    test_rcu_table();
+    test_shm_table();
+    test_variable_reload();
+    test_list();
+    test_containers();
+    test_checkpoints();
     test_variable_file_parsing();
     test_expression_to_string();
+    test_deep_nesting();
+    test_stats();
+    test_alloc();
+    test_trace();
     printf("All Tests Passed.\n");
 
     return EXIT_SUCCESS;
@@ -321,7 +1632,7 @@ int main()
 Tree* createTreeFromLiteral(const char* string)
 {
     size_t string_length = strlen(string);
-    char* string_copy = malloc(string_length + 1);
+    char* string_copy = ALLOCATE(ALLOC_TREES, string_length + 1);
     ASSERT(string_copy != NULL);
     memcpy(string_copy, string, string_length + 1);
     return createTree(string_copy);
@@ -343,6 +1654,135 @@ double evaluateLispExpressionWithVars(char* expression, HashTable variables)
     return res;
 }
 
+/**
+ * Main function of a reader thread of the concurrent table's stress test: reads the assigned variables
+ * until the test stops, and counts the values which the writer couldn't have assigned.
+ */
+void* readRcuTableValues(void* argument)
+{
+    RcuStressReader* stress_reader = argument;
+    RcuReader reader = createRcuReader(stress_reader->table);
+    double last_values[RCU_STRESS_VARIABLES + 1] = {0};
+    do {
+        for (NameId id = 1; id <= RCU_STRESS_VARIABLES; ++id)
+        {
+            double value;
+            if (rcuTableGetValue(reader, id, &value)) {
+                double round = value / id;
+                if (round != floor(round) || round > RCU_STRESS_ROUNDS || value < last_values[id]) {
+                    stress_reader->errors_count += 1;
+                }
+                last_values[id] = value;
+            }
+            stress_reader->reads_count += 1;
+        }
+    } while (!__atomic_load_n(stress_reader->is_stopping, __ATOMIC_ACQUIRE));
+    destroyRcuReader(reader);
+    return NULL;
+}
+
+/* Write a variable file (the file is closed after it's written, like the writes which are reloaded) */
+void writeVariableFile(const char* path, const char* text)
+{
+    FILE* file = fopen(path, "w");
+    ASSERT(file != NULL);
+    ASSERT(fputs(text, file) >= 0);
+    ASSERT(fclose(file) == 0);
+}
+
+/**
+ * Apply the reloads of the variable file between "input lines", until one of them changes variables.
+ *
+ * @return
+ *      Amount of variables changed by that reload.
+ */
+unsigned int waitForVariableReload(VariableReloader reloader, HashTable variables)
+{
+    for (unsigned int waited = 0; waited < RELOAD_WAIT_TIMEOUT; ++waited)
+    {
+        unsigned int changed_count = applyVariableReload(reloader, variables);
+        if (changed_count > 0) {
+            return changed_count;
+        }
+        struct timespec sleep_time = {0, 1000000};
+        nanosleep(&sleep_time, NULL);
+    }
+    FAIL("the variable file wasn't reloaded");
+    return 0;
+}
+
+/**
+ * Run the calculator (built by make all) with statistics, and request them with SIGUSR1
+ * while it waits for the next input line.
+ *
+ * @return
+ *      true iff the statistics are printed before the next line is given.
+ */
+bool checkIdleStatsRequest()
+{
+    int input_pipe[2];
+    int output_pipe[2];
+    int errors_pipe[2];
+    ASSERT(pipe(input_pipe) == 0 && pipe(output_pipe) == 0 && pipe(errors_pipe) == 0);
+    pid_t pid = fork();
+    ASSERT(pid != -1);
+    if (pid == 0) {
+        dup2(input_pipe[0], STDIN_FILENO);
+        dup2(output_pipe[1], STDOUT_FILENO);
+        dup2(errors_pipe[1], STDERR_FILENO);
+        close(input_pipe[1]);
+        close(output_pipe[0]);
+        close(errors_pipe[0]);
+        execl("./SPCalculator", "SPCalculator", "--stats", (char*)NULL);
+        _exit(EXIT_FAILURE);
+    }
+    close(input_pipe[0]);
+    close(output_pipe[1]);
+    close(errors_pipe[1]);
+
+    /* Once the first result is printed, the statistics are enabled, and the next line is waited for */
+    ASSERT(write(input_pipe[1], "(+(1)(2))\n", 10) == 10);
+    bool is_printed = waitForOutput(output_pipe[0], "res = 3.00");
+    if (is_printed) {
+        ASSERT(kill(pid, SIGUSR1) == 0);
+        is_printed = waitForOutput(errors_pipe[0], "{\"stages\": {");
+    }
+
+    ASSERT(write(input_pipe[1], "(<>)\n", 5) == 5);
+    close(input_pipe[1]);
+    int status;
+    ASSERT(waitpid(pid, &status, 0) == pid);
+    close(output_pipe[0]);
+    close(errors_pipe[0]);
+    return is_printed && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+/**
+ * Read the output of a process until it contains a string, or until it's silent for a few seconds.
+ *
+ * @return
+ *      true iff the string was read.
+ */
+bool waitForOutput(int fd, const char* expected)
+{
+    char output[4096];
+    size_t output_length = 0;
+    struct pollfd descriptor = {fd, POLLIN, 0};
+    while (output_length < sizeof(output) - 1 && poll(&descriptor, 1, 5000) == 1)
+    {
+        ssize_t read_length = read(fd, output + output_length, sizeof(output) - 1 - output_length);
+        if (read_length <= 0) {
+            return false;
+        }
+        output_length += read_length;
+        output[output_length] = '\0';
+        if (strstr(output, expected) != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
 bool checkSingleExpressionToString(const char* lisp_expression,
                                        const char* expected_string)
 {
@@ -354,6 +1794,106 @@ bool checkSingleExpressionToString(const char* lisp_expression,
     return test_passed;
 }
 
+bool checkSingleOptimization(const char* lisp_expression,
+                             const char* expected_string,
+                             unsigned int expected_removed_nodes)
+{
+    char buffer[MAX_LINE_LENGTH + 1];
+    HashTable variables = createHashTable();
+    Tree* tree = parseLispExpression(lisp_expression);
+    unsigned int removed_nodes = optimizeExpressionTree(tree, variables);
+    expressionToString(tree, buffer, sizeof(buffer));
+    bool test_passed = (   strcmp(buffer, expected_string) == 0
+                        && removed_nodes == expected_removed_nodes);
+    destroyTree(tree);
+    destroyHashTable(variables);
+    return test_passed;
+}
+
+/* Evaluate an expression both as a tree and as a DAG, and compare the results */
+bool checkSingleDagEvaluation(const char* lisp_expression,
+                              HashTable variables,
+                              unsigned int expected_removed_nodes)
+{
+    Tree* tree = parseLispExpression(lisp_expression);
+    ExpressionDag dag = createExpressionDag(tree);
+    ASSERT(dag != NULL);
+    double dag_result = evaluateExpressionDag(dag, variables);
+    double tree_result = evaluateExpressionTree(tree, variables);
+    bool test_passed = (   (isnan(dag_result) ? isnan(tree_result) : dag_result == tree_result)
+                        && getDagRemovedNodeCount(dag) == expected_removed_nodes
+                        && getDagNodeCount(dag) + expected_removed_nodes
+                           == treeSize(tree) - (isAssignmentExpression(tree) ? 1 : 0));
+    destroyExpressionDag(dag);
+    destroyTree(tree);
+    return test_passed;
+}
+
+/**
+ * Compile an expression into native code, and compare the result of running it
+ * with the result of the interpreter (bitwise, or both NAN).
+ * If native code isn't supported, it only checks that it's not created.
+ *
+ * @param
+ *      const char* lisp_expression - Expression to check (without assignments).
+ *      HashTable variables - variables to use for evaluation.
+ *
+ * @return
+ *      true iff the results are identical.
+ */
+bool checkSingleJitEvaluation(const char* lisp_expression, HashTable variables)
+{
+    CompiledLine compiled;
+    compileLine(lisp_expression, variables, &compiled);
+    JitCode code = createJitCode(compiled.tree, compiled.variable_ids, compiled.variables_count);
+
+    bool is_identical = (code == NULL) && !isJitSupported();
+    if (code != NULL) {
+        double expected = evaluateExpressionTree(compiled.tree, variables);
+        double result = runJitCode(code, variables);
+        is_identical = (isnan(expected) && isnan(result))
+                       || memcmp(&expected, &result, sizeof(result)) == 0;
+        destroyJitCode(code);
+    }
+
+    releaseCompiledLine(&compiled);
+    return is_identical;
+}
+
+/**
+ * Append a random lisp expression (without assignments) to a string.
+ *
+ * @param
+ *      char* buffer - String to append to (large enough for 4^depth terminals).
+ *      unsigned int depth - Maximal depth of the expression.
+ */
+void generateLispExpression(char* buffer, unsigned int depth)
+{
+    const char* terminals[] = {"0", "1", "2", "7", "99999999", "a", "b", "z", "w", "n"};
+    const char* operations[] = {"+", "-", "*", "/", "$", "min", "max", "average", "median"};
+
+    strcat(buffer, "(");
+    if (depth == 0 || rand() % 4 == 0) {
+        strcat(buffer, terminals[rand() % ARRAY_LENGTH(terminals)]);
+    } else {
+        int operation = rand() % ARRAY_LENGTH(operations);
+        int operands_count;
+        if (operation <= 1) {
+            operands_count = 1 + rand() % 2;
+        } else if (operation <= 4) {
+            operands_count = 2;
+        } else {
+            operands_count = 1 + rand() % 4;
+        }
+        strcat(buffer, operations[operation]);
+        for (int i = 0; i < operands_count; ++i)
+        {
+            generateLispExpression(buffer, depth - 1);
+        }
+    }
+    strcat(buffer, ")");
+}
+
 /* Check floating point equality up to small error */
 bool fpEq(double a, double b)
 {
@@ -0,0 +1,271 @@
+/*
+ * Trace Module
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "trace.h"
+#include "stats.h"
+#include "common.h"
+
+/*
+ * Constants
+ */
+
+/* Amount of spans which the ring buffer holds (a power of 2) */
+#define TRACE_BUFFER_SIZE (1 << 16)
+
+/* Time that the writer thread sleeps when the ring buffer is empty (in nanoseconds).
+ * The buffer holds more spans than are usually recorded meanwhile, so the writer wakes up rarely. */
+#define TRACE_WRITER_SLEEP_TIME (5000000)
+
+/* Size of the buffer in which the writer thread formats events */
+#define TRACE_OUTPUT_BUFFER_SIZE (64 * 1024)
+
+/* Maximal length of a formatted event (span names are short literals, like the stage names) */
+#define MAX_TRACE_EVENT_LENGTH 256
+
+/*
+ * Types
+ */
+
+/* Recorded span */
+typedef struct TraceSpan_
+{
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+    unsigned long long line;
+} TraceSpan;
+
+/*
+ * Globals
+ */
+
+bool traceEnabled = false;
+
+/* Ring buffer of the spans, with the amounts of spans which were recorded (by the main thread)
+ * and written (by the writer thread). Each counter is only modified by one of the threads. */
+TraceSpan traceBuffer[TRACE_BUFFER_SIZE];
+unsigned long long recordedSpansCount = 0;
+unsigned long long writtenSpansCount = 0;
+
+/* Set when tracing stops, so the writer thread exits once the ring buffer is drained */
+bool isTraceStopping = false;
+
+FILE* traceFile = NULL;
+pthread_t traceWriter;
+
+/* Time in which tracing started (the time stamps of the trace are relative to it) */
+uint64_t traceStartTime = 0;
+
+/* Input line which the recorded spans are attributed to */
+unsigned long long tracedLine = 0;
+
+/* Events formatted by the writer thread, which weren't written to the file yet */
+char traceOutput[TRACE_OUTPUT_BUFFER_SIZE];
+size_t traceOutputLength = 0;
+
+/*
+ * Internal Function Declarations
+ */
+
+void* writeTraceSpans(void* argument);
+void writeTraceSpan(TraceSpan* span);
+void appendTraceString(const char* string);
+void appendTraceNumber(unsigned long long number);
+void appendTraceTime(uint64_t nanoseconds);
+
+/*
+ * Module Functions
+ */
+
+void startTrace(FILE* file)
+{
+    VERIFY(file != NULL);
+    VERIFY(!traceEnabled);
+
+    traceFile = file;
+    traceStartTime = readClock();
+    recordedSpansCount = 0;
+    writtenSpansCount = 0;
+    isTraceStopping = false;
+    tracedLine = 0;
+    traceOutputLength = 0;
+
+    /* The metadata event is first, so each span is written after a separator */
+    fprintf(traceFile, "{\"traceEvents\": [\n"
+                       "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, "
+                       "\"args\": {\"name\": \"SPCalculator\"}}");
+    VERIFY(pthread_create(&traceWriter, NULL, writeTraceSpans, NULL) == 0);
+    traceEnabled = true;
+}
+
+void stopTrace()
+{
+    if (!traceEnabled) {
+        return;
+    }
+    traceEnabled = false;
+    __atomic_store_n(&isTraceStopping, true, __ATOMIC_RELEASE);
+    VERIFY(pthread_join(traceWriter, NULL) == 0);
+    fprintf(traceFile, "\n]}\n");
+    traceFile = NULL;
+}
+
+void traceNextLine()
+{
+    tracedLine += 1;
+}
+
+uint64_t startTraceSpan()
+{
+    return traceEnabled ? readClock() : 0;
+}
+
+void stopTraceSpan(const char* name, uint64_t start)
+{
+    if (traceEnabled) {
+        recordTraceSpan(name, start, readClock());
+    }
+}
+
+void recordTraceSpan(const char* name, uint64_t start, uint64_t end)
+{
+    /* Wait for the writer thread if the ring buffer is full (spans are never dropped) */
+    unsigned long long index = recordedSpansCount;
+    while (index - __atomic_load_n(&writtenSpansCount, __ATOMIC_ACQUIRE) == TRACE_BUFFER_SIZE)
+    {
+        sched_yield();
+    }
+
+    TraceSpan* span = &traceBuffer[index % TRACE_BUFFER_SIZE];
+    span->name = name;
+    span->start = start;
+    span->end = end;
+    span->line = tracedLine;
+    __atomic_store_n(&recordedSpansCount, index + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Internal Functions
+ */
+
+/**
+ * Main function of the writer thread, which writes recorded spans until tracing stops.
+ *
+ * @param
+ *      void* argument - Unused.
+ *
+ * @return
+ *      NULL.
+ */
+void* writeTraceSpans(void* argument)
+{
+    unsigned long long index = writtenSpansCount;
+    while (true)
+    {
+        /* The flag is read first, so the spans recorded before it was set are written */
+        bool is_stopping = __atomic_load_n(&isTraceStopping, __ATOMIC_ACQUIRE);
+        unsigned long long recorded_count = __atomic_load_n(&recordedSpansCount, __ATOMIC_ACQUIRE);
+        if (index == recorded_count) {
+            if (is_stopping) {
+                break;
+            }
+            struct timespec sleep_time = {0, TRACE_WRITER_SLEEP_TIME};
+            nanosleep(&sleep_time, NULL);
+            continue;
+        }
+        for (; index != recorded_count; ++index)
+        {
+            writeTraceSpan(&traceBuffer[index % TRACE_BUFFER_SIZE]);
+        }
+        __atomic_store_n(&writtenSpansCount, index, __ATOMIC_RELEASE);
+    }
+    fwrite(traceOutput, 1, traceOutputLength, traceFile);
+    return NULL;
+}
+
+/**
+ * Write a span as a complete ("X") trace event, whose times are in microseconds.
+ * There are several events for each input line, so they're formatted by hand rather than by fprintf,
+ * and without whitespace.
+ *
+ * @param
+ *      TraceSpan* span - Span to write.
+ */
+void writeTraceSpan(TraceSpan* span)
+{
+    if (traceOutputLength > TRACE_OUTPUT_BUFFER_SIZE - MAX_TRACE_EVENT_LENGTH) {
+        fwrite(traceOutput, 1, traceOutputLength, traceFile);
+        traceOutputLength = 0;
+    }
+    appendTraceString(",\n{\"name\":\"");
+    appendTraceString(span->name);
+    appendTraceString("\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":");
+    appendTraceTime(span->start - traceStartTime);
+    appendTraceString(",\"dur\":");
+    appendTraceTime(span->end - span->start);
+    appendTraceString(",\"args\":{\"line\":");
+    appendTraceNumber(span->line);
+    appendTraceString("}}");
+}
+
+/**
+ * Append a string to the formatted events.
+ *
+ * @param
+ *      const char* string - String to append.
+ */
+void appendTraceString(const char* string)
+{
+    size_t length = strlen(string);
+    memcpy(traceOutput + traceOutputLength, string, length);
+    traceOutputLength += length;
+}
+
+/**
+ * Append a number (in decimal) to the formatted events.
+ *
+ * @param
+ *      unsigned long long number - Number to append.
+ */
+void appendTraceNumber(unsigned long long number)
+{
+    char digits[20];
+    unsigned int digits_count = 0;
+    do {
+        digits[digits_count] = (char)('0' + number % 10);
+        digits_count += 1;
+        number /= 10;
+    } while (number != 0);
+    while (digits_count > 0)
+    {
+        digits_count -= 1;
+        traceOutput[traceOutputLength] = digits[digits_count];
+        traceOutputLength += 1;
+    }
+}
+
+/**
+ * Append a time (in microseconds, with 3 decimal digits) to the formatted events.
+ *
+ * @param
+ *      uint64_t nanoseconds - Time to append.
+ */
+void appendTraceTime(uint64_t nanoseconds)
+{
+    appendTraceNumber(nanoseconds / 1000);
+    unsigned int fraction = (unsigned int)(nanoseconds % 1000);
+    traceOutput[traceOutputLength] = '.';
+    traceOutput[traceOutputLength + 1] = (char)('0' + fraction / 100);
+    traceOutput[traceOutputLength + 2] = (char)('0' + fraction / 10 % 10);
+    traceOutput[traceOutputLength + 3] = (char)('0' + fraction % 10);
+    traceOutputLength += 4;
+}
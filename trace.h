@@ -0,0 +1,82 @@
+/*
+ * Trace Module
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Tracing
+ *
+ * Spans (e.g. of the stages of each input line, see stopStageTimer) are written as Chrome trace events,
+ * which can be viewed by chrome://tracing or Perfetto, so individual slow lines can be inspected.
+ * Spans are recorded into a lock-free ring buffer, which a background thread drains into the trace file,
+ * so recording a span doesn't format or write anything.
+ * Only the main thread records spans (the buffer has a single producer and a single consumer).
+ */
+
+/*
+ * Globals
+ */
+
+/* Whether spans are recorded (when they aren't, each span costs a single branch) */
+extern bool traceEnabled;
+
+/*
+ * Functions
+ */
+
+/**
+ * Start recording spans into a trace file, and start the thread that writes them.
+ *
+ * @param
+ *      FILE* file - File to write the trace into (which has to stay open until stopTrace is called).
+ *
+ * @preconditions
+ *      file != NULL, and tracing isn't started already.
+ */
+void startTrace(FILE* file);
+
+/**
+ * Stop recording spans, and wait for all the recorded spans to be written.
+ * If tracing isn't started, then nothing is done.
+ */
+void stopTrace();
+
+/**
+ * Attribute the following spans to the next input line.
+ */
+void traceNextLine();
+
+/**
+ * Start a span.
+ *
+ * @return
+ *      Start time to pass to stopTraceSpan (0 if spans aren't recorded).
+ */
+uint64_t startTraceSpan();
+
+/**
+ * Record a span which ends now.
+ *
+ * @param
+ *      const char* name - Name of the span (a string which is never released, e.g. a literal).
+ *      uint64_t start - Start time given by startTraceSpan (or by readClock).
+ */
+void stopTraceSpan(const char* name, uint64_t start);
+
+/**
+ * Record a span.
+ *
+ * @param
+ *      const char* name - Name of the span (a string which is never released, e.g. a literal).
+ *      uint64_t start - Start time (as given by readClock).
+ *      uint64_t end - End time (as given by readClock).
+ */
+void recordTraceSpan(const char* name, uint64_t start, uint64_t end);
+
+#endif /* TRACE_H_ */
@@ -4,7 +4,10 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include "tree.h"
+#include "alloc.h"
 #include "common.h"
 
 /*
@@ -13,13 +16,21 @@
 
 /*
  * Tree node data structure.
- * Each tree node has a string value which it own's (and frees when the node is destroyed).
+ * Each tree node has a string value which it own's (and frees when the node is destroyed),
+ * unless the value is an interned name which is shared by all the nodes of the name.
+ * A node optionally has a number which was parsed from the value (exactly, as an integer),
+ * or the id of the name which the value is.
  * children nodes are kept as an intrusive linked list.
  */
 struct Tree
 {
     char* value;
+    NameId nameId;
     unsigned childrenCount;
+    bool isValueShared;
+    bool hasNumber;
+    bool isNumberInRange;
+    long long int number;       /* Valid iff isNumberInRange */
     Tree* firstChild;
     Tree* lastChild;
     Tree* nextBrother;
@@ -34,9 +45,14 @@ struct Tree
 Tree* createTree(char* value)
 {
     VERIFY(value != NULL);
-    Tree* tree = malloc(sizeof(Tree));
+    Tree* tree = ALLOCATE(ALLOC_TREES, sizeof(Tree));
     VERIFY(tree != NULL);
     tree->value = value;
+    tree->isValueShared = false;
+    tree->nameId = NO_NAME_ID;
+    tree->hasNumber = false;
+    tree->isNumberInRange = false;
+    tree->number = 0;
     tree->childrenCount = 0;
     tree->firstChild = NULL;
     tree->lastChild = NULL;
@@ -46,24 +62,49 @@ Tree* createTree(char* value)
     return tree;
 }
 
+Tree* createNameTree(NameId name_id)
+{
+    /* The shared value is never modified or freed through the node */
+    Tree* tree = createTree((char*)getInternedName(name_id));
+    tree->isValueShared = true;
+    tree->nameId = name_id;
+    return tree;
+}
+
 void destroyTree(Tree* tree)
 {
     if (tree == NULL) {
         return;
     }
 
-    /* Destroy Children */
-    Tree* child = tree->firstChild;
-    while (child != NULL)
+    /* Destroy the nodes in post-order, by the parent links (so the depth of the tree is unlimited) */
+    Tree* node = tree;
+    while (true)
     {
-        Tree* next_child = child->nextBrother;
-        destroyTree(child);
-        child = next_child;
-    }
+        while (node->firstChild != NULL)
+        {
+            node = node->firstChild;
+        }
+
+        /* The node is a leaf (all it's children were destroyed) */
+        Tree* next = node->nextBrother;
+        Tree* parent = node->parent;
+        if (!node->isValueShared) {
+            deallocate(node->value);
+        }
+        deallocate(node);
+        if (node == tree) {
+            break;
+        }
 
-    /* Destroy this the given node */
-    free(tree->value);
-    free(tree);
+        if (next != NULL) {
+            parent->firstChild = next;
+            node = next;
+        } else {
+            parent->firstChild = NULL;
+            node = parent;
+        }
+    }
 }
 
 char* getValue(Tree* tree)
@@ -72,6 +113,15 @@ char* getValue(Tree* tree)
     return tree->value;
 }
 
+NameId getNameId(Tree* tree)
+{
+    VERIFY(tree != NULL);
+    if (tree->nameId == NO_NAME_ID && isName(tree->value)) {
+        tree->nameId = internName(tree->value, strlen(tree->value));
+    }
+    return tree->nameId;
+}
+
 unsigned int childrenCount(Tree* tree)
 {
     VERIFY(tree != NULL);
@@ -172,3 +222,223 @@ void addChild(Tree* tree, Tree* child)
     tree->childrenCount += 1;
     child->parent = tree;
 }
+
+void setValue(Tree* tree, char* value)
+{
+    VERIFY(tree != NULL);
+    VERIFY(value != NULL);
+    if (!tree->isValueShared) {
+        deallocate(tree->value);
+    }
+    tree->value = value;
+    tree->isValueShared = false;
+    tree->nameId = NO_NAME_ID;
+    tree->hasNumber = false;
+}
+
+void setNumber(Tree* tree, long long int number)
+{
+    VERIFY(tree != NULL);
+    tree->hasNumber = true;
+    tree->isNumberInRange = true;
+    tree->number = number;
+}
+
+void setOutOfRangeNumber(Tree* tree)
+{
+    VERIFY(tree != NULL);
+    tree->hasNumber = true;
+    tree->isNumberInRange = false;
+    tree->number = 0;
+}
+
+bool hasNumber(Tree* tree)
+{
+    VERIFY(tree != NULL);
+    return tree->hasNumber;
+}
+
+bool isNumberInRange(Tree* tree)
+{
+    VERIFY(tree != NULL);
+    VERIFY(tree->hasNumber);
+    return tree->isNumberInRange;
+}
+
+long long int getIntegerNumber(Tree* tree)
+{
+    VERIFY(tree != NULL);
+    VERIFY(tree->hasNumber && tree->isNumberInRange);
+    return tree->number;
+}
+
+double getNumber(Tree* tree)
+{
+    VERIFY(tree != NULL);
+    VERIFY(tree->hasNumber);
+    return tree->isNumberInRange ? (double)tree->number : NAN;
+}
+
+void destroyChildren(Tree* tree)
+{
+    VERIFY(tree != NULL);
+
+    Tree* child = tree->firstChild;
+    while (child != NULL)
+    {
+        Tree* next_child = child->nextBrother;
+        destroyTree(child);
+        child = next_child;
+    }
+
+    tree->childrenCount = 0;
+    tree->firstChild = NULL;
+    tree->lastChild = NULL;
+}
+
+void replaceWithChild(Tree* tree, Tree* child)
+{
+    VERIFY(tree != NULL && child != NULL);
+    VERIFY(child->parent == tree);
+
+    /* Detach the child from it's brothers */
+    if (child->previousBrother != NULL) {
+        child->previousBrother->nextBrother = child->nextBrother;
+    } else {
+        tree->firstChild = child->nextBrother;
+    }
+    if (child->nextBrother != NULL) {
+        child->nextBrother->previousBrother = child->previousBrother;
+    } else {
+        tree->lastChild = child->previousBrother;
+    }
+    tree->childrenCount -= 1;
+
+    /* Destroy the other children, and move the child's contents into the tree node */
+    destroyChildren(tree);
+    if (!tree->isValueShared) {
+        deallocate(tree->value);
+    }
+    tree->value = child->value;
+    tree->isValueShared = child->isValueShared;
+    tree->nameId = child->nameId;
+    tree->hasNumber = child->hasNumber;
+    tree->isNumberInRange = child->isNumberInRange;
+    tree->number = child->number;
+    tree->childrenCount = child->childrenCount;
+    tree->firstChild = child->firstChild;
+    tree->lastChild = child->lastChild;
+    for (Tree* grandchild = tree->firstChild;
+         grandchild != NULL;
+         grandchild = grandchild->nextBrother)
+    {
+        grandchild->parent = tree;
+    }
+
+    deallocate(child);
+}
+
+unsigned int treeSize(Tree* tree)
+{
+    VERIFY(tree != NULL);
+
+    unsigned int size = 0;
+    for (Tree* node = tree; node != NULL; node = nextPreOrderNode(tree, node))
+    {
+        size += 1;
+    }
+    return size;
+}
+
+Tree* copyTree(Tree* tree)
+{
+    VERIFY(tree != NULL);
+
+    /* Copy in pre-order, keeping the copy of the current node's parent */
+    Tree* copy = NULL;
+    Tree* copy_parent = NULL;
+    Tree* node = tree;
+    while (true)
+    {
+        Tree* node_copy = node->isValueShared ? createNameTree(node->nameId)
+                                              : createTree(copyString(node->value));
+        node_copy->nameId = node->nameId;
+        node_copy->hasNumber = node->hasNumber;
+        node_copy->isNumberInRange = node->isNumberInRange;
+        node_copy->number = node->number;
+        if (copy_parent == NULL) {
+            copy = node_copy;
+        } else {
+            addChild(copy_parent, node_copy);
+        }
+
+        if (node->firstChild != NULL) {
+            node = node->firstChild;
+            copy_parent = node_copy;
+            continue;
+        }
+
+        /* Climb to the next brother, if there's one */
+        copy_parent = node_copy;
+        while (node != tree && node->nextBrother == NULL)
+        {
+            node = node->parent;
+            copy_parent = copy_parent->parent;
+        }
+        if (node == tree) {
+            return copy;
+        }
+        node = node->nextBrother;
+        copy_parent = copy_parent->parent;
+    }
+}
+
+size_t treeMemorySize(Tree* tree)
+{
+    VERIFY(tree != NULL);
+
+    size_t size = 0;
+    for (Tree* node = tree; node != NULL; node = nextPreOrderNode(tree, node))
+    {
+        size += sizeof(*node) + (node->isValueShared ? 0 : strlen(node->value) + 1);
+    }
+    return size;
+}
+
+Tree* nextPreOrderNode(Tree* tree, Tree* node)
+{
+    VERIFY(tree != NULL && node != NULL);
+    if (node->firstChild != NULL) {
+        return node->firstChild;
+    }
+    while (node != tree)
+    {
+        if (node->nextBrother != NULL) {
+            return node->nextBrother;
+        }
+        node = node->parent;
+    }
+    return NULL;
+}
+
+Tree* firstPostOrderNode(Tree* tree)
+{
+    VERIFY(tree != NULL);
+    while (tree->firstChild != NULL)
+    {
+        tree = tree->firstChild;
+    }
+    return tree;
+}
+
+Tree* nextPostOrderNode(Tree* tree, Tree* node)
+{
+    VERIFY(tree != NULL && node != NULL);
+    if (node == tree) {
+        return NULL;
+    }
+    if (node->nextBrother != NULL) {
+        return firstPostOrderNode(node->nextBrother);
+    }
+    return node->parent;
+}
@@ -6,6 +6,8 @@
 #define TREE_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+#include "intern.h"
 
 /*
  * Types
@@ -33,6 +35,22 @@ typedef struct Tree Tree;
  */
 Tree* createTree(char* value);
 
+/**
+ * Create a new tree node of a variable name, whose value is the interned name
+ * (which the node shares, so nothing is copied).
+ * The created tree has to be destroyed by destroyTree.
+ *
+ * @param
+ * 		NameId name_id - Interned name to store in the tree node.
+ *
+ * @preconditions
+ *      name_id was given by internName.
+ *
+ * @return
+ *		Pointer to the new tree node.
+ */
+Tree* createNameTree(NameId name_id);
+
 /**
  * Destroy a previously created tree, and all of it's children sub-trees recursively.
  * Values assigned to tree nodes are freed as well.
@@ -60,6 +78,21 @@ void destroyTree(Tree* tree);
  */
 char* getValue(Tree* tree);
 
+/**
+ * Get the interned id of the value stored in the tree node, if it's a name.
+ * Values of nodes which weren't created by createNameTree are interned on the first call.
+ *
+ * @param
+ * 		Tree* tree - Tree node to retrieve the name from.
+ *
+ * @preconditions
+ *      tree != NULL
+ *
+ * @return
+ *		Id of the node's value, or NO_NAME_ID if the value isn't a name.
+ */
+NameId getNameId(Tree* tree);
+
 /**
  * Get the amount of children sub-tree the given tree has.
  *
@@ -208,4 +241,215 @@ bool isRoot(Tree* tree);
  */
 void addChild(Tree* tree, Tree* child);
 
+/**
+ * Replace the value stored in the tree node.
+ * The previous value is freed, and the tree node takes ownership of the new value.
+ * The number of the node (if any) is removed, since it was parsed from the previous value.
+ *
+ * @param
+ * 		Tree* tree - Tree node to modify.
+ * 		char* value - New value to store in the tree node.
+ *
+ * @preconditions
+ *      tree != NULL, value != NULL, value points to memory allocated by malloc.
+ */
+void setValue(Tree* tree, char* value);
+
+/**
+ * Attach a number to the tree node (the parsed form of it's value),
+ * so the value doesn't have to be parsed again.
+ *
+ * @param
+ * 		Tree* tree - Tree node to modify.
+ * 		long long int number - Number to attach.
+ *
+ * @preconditions
+ *      tree != NULL
+ */
+void setNumber(Tree* tree, long long int number);
+
+/**
+ * Attach a number to the tree node, whose value is a literal too large for a long long int.
+ *
+ * @param
+ * 		Tree* tree - Tree node to modify.
+ *
+ * @preconditions
+ *      tree != NULL
+ */
+void setOutOfRangeNumber(Tree* tree);
+
+/**
+ * Check if a number is attached to the tree node.
+ *
+ * @param
+ * 		Tree* tree - Tree node to examine.
+ *
+ * @preconditions
+ *      tree != NULL
+ *
+ * @return
+ *		true iff the tree node has a number.
+ */
+bool hasNumber(Tree* tree);
+
+/**
+ * Check if the number attached to the tree node fits in a long long int.
+ *
+ * @param
+ * 		Tree* tree - Tree node to examine.
+ *
+ * @preconditions
+ *      tree != NULL, hasNumber(tree)
+ *
+ * @return
+ *		true iff the number isn't out of range (see setOutOfRangeNumber).
+ */
+bool isNumberInRange(Tree* tree);
+
+/**
+ * Get the exact number attached to the tree node.
+ *
+ * @param
+ * 		Tree* tree - Tree node to examine.
+ *
+ * @preconditions
+ *      tree != NULL, hasNumber(tree), isNumberInRange(tree)
+ *
+ * @return
+ *		The number of the tree node.
+ */
+long long int getIntegerNumber(Tree* tree);
+
+/**
+ * Get the number attached to the tree node as a double.
+ *
+ * @param
+ * 		Tree* tree - Tree node to examine.
+ *
+ * @preconditions
+ *      tree != NULL, hasNumber(tree)
+ *
+ * @return
+ *		The number of the tree node (rounded to a double), or NAN if it's out of range.
+ */
+double getNumber(Tree* tree);
+
+/**
+ * Destroy all the children sub-trees of the given tree.
+ * The given tree node itself is kept (and becomes a leaf).
+ *
+ * @param
+ * 		Tree* tree - Tree node whose children are destroyed.
+ *
+ * @preconditions
+ *      tree != NULL
+ */
+void destroyChildren(Tree* tree);
+
+/**
+ * Replace the contents of a tree node with the contents of one of it's children.
+ * The tree node takes the value and the children of the given child,
+ * all the other children are destroyed, and the child node itself is freed.
+ * The tree node keeps it's position in it's parent.
+ *
+ * @param
+ * 		Tree* tree - Tree node to replace.
+ * 		Tree* child - Child whose contents replace the tree node.
+ *
+ * @preconditions
+ *      - tree != NULL, child != NULL
+ *      - getParent(child) == tree
+ */
+void replaceWithChild(Tree* tree, Tree* child);
+
+/**
+ * Count the nodes in the given tree (including the root node).
+ *
+ * @param
+ * 		Tree* tree - Tree to examine.
+ *
+ * @preconditions
+ *      tree != NULL
+ *
+ * @return
+ *		Amount of nodes in the tree.
+ */
+unsigned int treeSize(Tree* tree);
+
+/**
+ * Create a deep copy of the given tree (including the values and numbers).
+ * The created tree is a root tree, and has to be destroyed by destroyTree.
+ *
+ * @param
+ * 		Tree* tree - Tree to copy.
+ *
+ * @preconditions
+ *      tree != NULL
+ *
+ * @return
+ *		The copy of the tree.
+ */
+Tree* copyTree(Tree* tree);
+
+/**
+ * Get the amount of memory used by the given tree (in bytes), including the node values.
+ *
+ * @param
+ * 		Tree* tree - Tree to examine.
+ *
+ * @preconditions
+ *      tree != NULL
+ *
+ * @return
+ *		Memory size of the tree.
+ */
+size_t treeMemorySize(Tree* tree);
+
+/**
+ * Get the next node of a tree in pre-order (a node before it's children), by the parent and brother links,
+ * so trees of any depth are traversed without recursion. The traversal starts at the root.
+ *
+ * @param
+ * 		Tree* tree - Root of the traversed tree.
+ * 		Tree* node - Current node.
+ *
+ * @preconditions
+ *      tree != NULL, node != NULL, node is in the tree.
+ *
+ * @return
+ *		The next node, or NULL if the traversal is done.
+ */
+Tree* nextPreOrderNode(Tree* tree, Tree* node);
+
+/**
+ * Get the first node of a tree in post-order (a node after it's children): it's leftmost leaf.
+ *
+ * @param
+ * 		Tree* tree - Root of the traversed tree.
+ *
+ * @preconditions
+ *      tree != NULL
+ *
+ * @return
+ *		The first node.
+ */
+Tree* firstPostOrderNode(Tree* tree);
+
+/**
+ * Get the next node of a tree in post-order, by the parent and brother links.
+ * Only the links of the current node are used, so it's sub-tree may be modified before the call.
+ *
+ * @param
+ * 		Tree* tree - Root of the traversed tree.
+ * 		Tree* node - Current node.
+ *
+ * @preconditions
+ *      tree != NULL, node != NULL, node is in the tree.
+ *
+ * @return
+ *		The next node, or NULL if the traversal is done (the current node is the root).
+ */
+Tree* nextPostOrderNode(Tree* tree, Tree* node);
+
 #endif /* TREE_H_ */
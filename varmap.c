@@ -0,0 +1,762 @@
+/*
+ * Persistent Variable Map Module
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "varmap.h"
+#include "alloc.h"
+#include "common.h"
+
+/*
+ * Constants
+ */
+
+/* Amount of hash bits which index a node */
+#define VARMAP_NODE_BITS 5
+
+/* Amount of hash bits (nodes deeper than all of them hold only names with identical hashes) */
+#define VARMAP_HASH_BITS 32
+
+/*
+ * Types
+ */
+
+/* Immutable name and value (shared by all the nodes which hold it) */
+typedef struct VarMapEntry_
+{
+    unsigned int references;
+    unsigned int hash;
+    double value;
+    char name[];
+} VarMapEntry;
+
+typedef struct VarMapNode_ VarMapNode;
+
+typedef union VarMapSlot_
+{
+    VarMapEntry* entry;
+    VarMapNode* node;
+} VarMapSlot;
+
+/*
+ * Immutable trie node (shared by all the maps which hold it).
+ * The slots hold the entries (ordered by their hash fragments) followed by the sub-nodes.
+ * A node below all the hash bits (a collision node) has no maps, and holds only entries.
+ */
+struct VarMapNode_
+{
+    unsigned int references;
+    uint32_t entry_map;         /* Hash fragments of the entries */
+    uint32_t node_map;          /* Hash fragments of the sub-nodes */
+    unsigned int entries_count;
+    unsigned int nodes_count;
+    VarMapSlot slots[];
+};
+
+struct VarMap_t
+{
+    unsigned int references;
+    unsigned int size;
+    VarMapNode* root;
+};
+
+/*
+ * Internal Function Declarations
+ */
+
+VarMap createVarMapWithRoot(VarMapNode* root, unsigned int size);
+VarMapEntry* createVarMapEntry(const char* name, unsigned int hash, double value);
+VarMapNode* createVarMapNode(uint32_t entry_map, uint32_t node_map,
+                             unsigned int entries_count, VarMapEntry** entries,
+                             unsigned int nodes_count, VarMapNode** nodes);
+void releaseVarMapEntry(VarMapEntry* entry);
+void releaseVarMapNode(VarMapNode* node);
+VarMapNode* insertIntoVarMapNode(VarMapNode* node, unsigned int shift, VarMapEntry* entry, OUT bool* is_new);
+VarMapNode* mergeVarMapEntries(VarMapEntry* entry1, VarMapEntry* entry2, unsigned int shift);
+VarMapNode* deleteFromVarMapNode(VarMapNode* node, unsigned int shift, const char* name, unsigned int hash);
+VarMapEntry* findVarMapEntry(VarMapNode* node, unsigned int shift, const char* name, unsigned int hash);
+void diffVarMapNodes(VarMapNode* from, VarMapNode* to, unsigned int shift,
+                     VarMapDiffCallback callback, void* context);
+void diffVarMapEntryAndNode(VarMapEntry* from, VarMapNode* to, unsigned int shift,
+                            VarMapDiffCallback callback, void* context);
+void diffVarMapNodeAndEntry(VarMapNode* from, VarMapEntry* to, unsigned int shift,
+                            VarMapDiffCallback callback, void* context);
+void reportVarMapNode(VarMapNode* node, bool is_set, VarMapDiffCallback callback, void* context);
+unsigned int getVarMapFragment(unsigned int hash, unsigned int shift);
+unsigned int getVarMapEntryIndex(VarMapNode* node, uint32_t bit);
+unsigned int getVarMapNodeIndex(VarMapNode* node, uint32_t bit);
+
+/*
+ * Module Functions
+ */
+
+VarMap createVarMap()
+{
+    return createVarMapWithRoot(createVarMapNode(0, 0, 0, NULL, 0, NULL), 0);
+}
+
+VarMap retainVarMap(VarMap map)
+{
+    VERIFY(map != NULL);
+    map->references += 1;
+    return map;
+}
+
+void releaseVarMap(VarMap map)
+{
+    if (map == NULL) {
+        return;
+    }
+    map->references -= 1;
+    if (map->references == 0) {
+        releaseVarMapNode(map->root);
+        deallocate(map);
+    }
+}
+
+VarMap varMapInsert(VarMap map, const char* name, double value)
+{
+    VERIFY(map != NULL);
+    VERIFY(name != NULL);
+
+    VarMapEntry* entry = createVarMapEntry(name, hashString(HASH_SEED, name), value);
+    bool is_new;
+    VarMapNode* root = insertIntoVarMapNode(map->root, 0, entry, &is_new);
+    releaseVarMapEntry(entry);
+    return createVarMapWithRoot(root, map->size + (is_new ? 1 : 0));
+}
+
+VarMap varMapDelete(VarMap map, const char* name)
+{
+    VERIFY(map != NULL);
+    VERIFY(name != NULL);
+
+    VarMapNode* root = deleteFromVarMapNode(map->root, 0, name, hashString(HASH_SEED, name));
+    if (root == NULL) {
+        return retainVarMap(map);
+    }
+    return createVarMapWithRoot(root, map->size - 1);
+}
+
+bool varMapGet(VarMap map, const char* name, OUT double* value)
+{
+    VERIFY(map != NULL);
+    VERIFY(name != NULL);
+    VERIFY(value != NULL);
+
+    VarMapEntry* entry = findVarMapEntry(map->root, 0, name, hashString(HASH_SEED, name));
+    if (entry == NULL) {
+        return false;
+    }
+    *value = entry->value;
+    return true;
+}
+
+unsigned int varMapSize(VarMap map)
+{
+    VERIFY(map != NULL);
+    return map->size;
+}
+
+void varMapDiff(VarMap from, VarMap to, VarMapDiffCallback callback, void* context)
+{
+    VERIFY(from != NULL);
+    VERIFY(to != NULL);
+    VERIFY(callback != NULL);
+    diffVarMapNodes(from->root, to->root, 0, callback, context);
+}
+
+/*
+ * Internal Functions
+ */
+
+/**
+ * Create a map.
+ *
+ * @param
+ *      VarMapNode* root - Root node of the map (the map takes over the reference to it).
+ *      unsigned int size - Amount of entries under the root.
+ *
+ * @return
+ *      The created map.
+ */
+VarMap createVarMapWithRoot(VarMapNode* root, unsigned int size)
+{
+    VarMap map = ALLOCATE(ALLOC_CHECKPOINTS, sizeof(*map));
+    VERIFY(map != NULL);
+    map->references = 1;
+    map->size = size;
+    map->root = root;
+    return map;
+}
+
+/**
+ * Create an entry.
+ *
+ * @param
+ *      const char* name - Entry name (which is copied).
+ *      unsigned int hash - Hash of the name.
+ *      double value - Entry value.
+ *
+ * @return
+ *      The created entry (with a single reference).
+ */
+VarMapEntry* createVarMapEntry(const char* name, unsigned int hash, double value)
+{
+    size_t name_size = strlen(name) + 1;
+    VarMapEntry* entry = ALLOCATE(ALLOC_CHECKPOINTS, sizeof(*entry) + name_size);
+    VERIFY(entry != NULL);
+    entry->references = 1;
+    entry->hash = hash;
+    entry->value = value;
+    memcpy(entry->name, name, name_size);
+    return entry;
+}
+
+/**
+ * Create a node, which takes a reference to each of it's entries and sub-nodes.
+ *
+ * @param
+ *      uint32_t entry_map - Hash fragments of the entries.
+ *      uint32_t node_map - Hash fragments of the sub-nodes.
+ *      unsigned int entries_count - Amount of entries.
+ *      VarMapEntry** entries - Entries, ordered by their hash fragments (may be NULL if there are none).
+ *      unsigned int nodes_count - Amount of sub-nodes.
+ *      VarMapNode** nodes - Sub-nodes, ordered by their hash fragments (may be NULL if there are none).
+ *
+ * @return
+ *      The created node (with a single reference).
+ */
+VarMapNode* createVarMapNode(uint32_t entry_map, uint32_t node_map,
+                             unsigned int entries_count, VarMapEntry** entries,
+                             unsigned int nodes_count, VarMapNode** nodes)
+{
+    VarMapNode* node = ALLOCATE(ALLOC_CHECKPOINTS, sizeof(*node) + (entries_count + nodes_count) * sizeof(VarMapSlot));
+    VERIFY(node != NULL);
+    node->references = 1;
+    node->entry_map = entry_map;
+    node->node_map = node_map;
+    node->entries_count = entries_count;
+    node->nodes_count = nodes_count;
+    for (unsigned int i = 0; i < entries_count; ++i)
+    {
+        entries[i]->references += 1;
+        node->slots[i].entry = entries[i];
+    }
+    for (unsigned int i = 0; i < nodes_count; ++i)
+    {
+        nodes[i]->references += 1;
+        node->slots[entries_count + i].node = nodes[i];
+    }
+    return node;
+}
+
+/**
+ * Release a reference to an entry, and destroy it with it's last reference.
+ *
+ * @param
+ *      VarMapEntry* entry - Entry to release.
+ */
+void releaseVarMapEntry(VarMapEntry* entry)
+{
+    entry->references -= 1;
+    if (entry->references == 0) {
+        deallocate(entry);
+    }
+}
+
+/**
+ * Release a reference to a node, and destroy it (and release it's slots) with it's last reference.
+ *
+ * @param
+ *      VarMapNode* node - Node to release.
+ */
+void releaseVarMapNode(VarMapNode* node)
+{
+    node->references -= 1;
+    if (node->references > 0) {
+        return;
+    }
+    for (unsigned int i = 0; i < node->entries_count; ++i)
+    {
+        releaseVarMapEntry(node->slots[i].entry);
+    }
+    for (unsigned int i = 0; i < node->nodes_count; ++i)
+    {
+        releaseVarMapNode(node->slots[node->entries_count + i].node);
+    }
+    deallocate(node);
+}
+
+/**
+ * Create a copy of a node with an entry inserted (or replacing the entry of the same name).
+ * The recursion is bounded by the amount of hash bits.
+ *
+ * @param
+ *      VarMapNode* node - Node to insert into.
+ *      unsigned int shift - Position of the node's hash fragment in the hash.
+ *      VarMapEntry* entry - Entry to insert (the new node takes a reference to it).
+ *      bool* is_new - Whether the entry's name wasn't in the node (output parameter).
+ *
+ * @return
+ *      The new node (with a single reference).
+ */
+VarMapNode* insertIntoVarMapNode(VarMapNode* node, unsigned int shift, VarMapEntry* entry, OUT bool* is_new)
+{
+    VarMapEntry* entries[VARMAP_HASH_BITS + 1];
+    VarMapNode* nodes[VARMAP_HASH_BITS + 1];
+
+    if (shift >= VARMAP_HASH_BITS) {
+        /* Collision node: replace the entry of the same name, or append the entry */
+        VarMapEntry** collisions = ALLOCATE(ALLOC_CHECKPOINTS, (node->entries_count + 1) * sizeof(*collisions));
+        VERIFY(collisions != NULL);
+        *is_new = true;
+        for (unsigned int i = 0; i < node->entries_count; ++i)
+        {
+            collisions[i] = node->slots[i].entry;
+            if (strcmp(collisions[i]->name, entry->name) == 0) {
+                collisions[i] = entry;
+                *is_new = false;
+            }
+        }
+        unsigned int count = node->entries_count;
+        if (*is_new) {
+            collisions[count] = entry;
+            count += 1;
+        }
+        VarMapNode* new_node = createVarMapNode(0, 0, count, collisions, 0, NULL);
+        deallocate(collisions);
+        return new_node;
+    }
+
+    for (unsigned int i = 0; i < node->entries_count; ++i)
+    {
+        entries[i] = node->slots[i].entry;
+    }
+    for (unsigned int i = 0; i < node->nodes_count; ++i)
+    {
+        nodes[i] = node->slots[node->entries_count + i].node;
+    }
+
+    uint32_t bit = (uint32_t)1 << getVarMapFragment(entry->hash, shift);
+    unsigned int entry_index = getVarMapEntryIndex(node, bit);
+    unsigned int node_index = getVarMapNodeIndex(node, bit);
+    if ((node->node_map & bit) != 0) {
+        /* Insert into the sub-node */
+        VarMapNode* child = insertIntoVarMapNode(nodes[node_index], shift + VARMAP_NODE_BITS, entry, is_new);
+        nodes[node_index] = child;
+        VarMapNode* new_node = createVarMapNode(node->entry_map, node->node_map,
+                                                node->entries_count, entries,
+                                                node->nodes_count, nodes);
+        releaseVarMapNode(child);
+        return new_node;
+    }
+
+    if ((node->entry_map & bit) == 0) {
+        /* Add the entry */
+        *is_new = true;
+        memmove(&entries[entry_index + 1], &entries[entry_index],
+                (node->entries_count - entry_index) * sizeof(*entries));
+        entries[entry_index] = entry;
+        return createVarMapNode(node->entry_map | bit, node->node_map,
+                                node->entries_count + 1, entries,
+                                node->nodes_count, nodes);
+    }
+
+    VarMapEntry* existing = entries[entry_index];
+    if (strcmp(existing->name, entry->name) == 0) {
+        /* Replace the entry */
+        *is_new = false;
+        entries[entry_index] = entry;
+        return createVarMapNode(node->entry_map, node->node_map,
+                                node->entries_count, entries,
+                                node->nodes_count, nodes);
+    }
+
+    /* Push both entries down into a new sub-node */
+    *is_new = true;
+    VarMapNode* child = mergeVarMapEntries(existing, entry, shift + VARMAP_NODE_BITS);
+    memmove(&entries[entry_index], &entries[entry_index + 1],
+            (node->entries_count - entry_index - 1) * sizeof(*entries));
+    memmove(&nodes[node_index + 1], &nodes[node_index],
+            (node->nodes_count - node_index) * sizeof(*nodes));
+    nodes[node_index] = child;
+    VarMapNode* new_node = createVarMapNode(node->entry_map & ~bit, node->node_map | bit,
+                                            node->entries_count - 1, entries,
+                                            node->nodes_count + 1, nodes);
+    releaseVarMapNode(child);
+    return new_node;
+}
+
+/**
+ * Create a node holding two entries of different names.
+ *
+ * @param
+ *      VarMapEntry* entry1 - First entry.
+ *      VarMapEntry* entry2 - Second entry.
+ *      unsigned int shift - Position of the node's hash fragment in the hash.
+ *
+ * @return
+ *      The created node (with a single reference).
+ */
+VarMapNode* mergeVarMapEntries(VarMapEntry* entry1, VarMapEntry* entry2, unsigned int shift)
+{
+    VarMapEntry* entries[2] = {entry1, entry2};
+    if (shift >= VARMAP_HASH_BITS) {
+        return createVarMapNode(0, 0, 2, entries, 0, NULL);
+    }
+
+    unsigned int fragment1 = getVarMapFragment(entry1->hash, shift);
+    unsigned int fragment2 = getVarMapFragment(entry2->hash, shift);
+    if (fragment1 == fragment2) {
+        VarMapNode* child = mergeVarMapEntries(entry1, entry2, shift + VARMAP_NODE_BITS);
+        VarMapNode* node = createVarMapNode(0, (uint32_t)1 << fragment1, 0, NULL, 1, &child);
+        releaseVarMapNode(child);
+        return node;
+    }
+
+    if (fragment1 > fragment2) {
+        entries[0] = entry2;
+        entries[1] = entry1;
+    }
+    return createVarMapNode(((uint32_t)1 << fragment1) | ((uint32_t)1 << fragment2), 0, 2, entries, 0, NULL);
+}
+
+/**
+ * Create a copy of a node with an entry deleted.
+ * A sub-node which is left with a single entry is replaced by the entry,
+ * so a map always has the same shape for the same names.
+ *
+ * @param
+ *      VarMapNode* node - Node to delete from.
+ *      unsigned int shift - Position of the node's hash fragment in the hash.
+ *      const char* name - Name of the entry.
+ *      unsigned int hash - Hash of the name.
+ *
+ * @return
+ *      The new node (with a single reference), or NULL if the node doesn't have the name.
+ */
+VarMapNode* deleteFromVarMapNode(VarMapNode* node, unsigned int shift, const char* name, unsigned int hash)
+{
+    VarMapEntry* entries[VARMAP_HASH_BITS + 1];
+    VarMapNode* nodes[VARMAP_HASH_BITS + 1];
+
+    if (shift >= VARMAP_HASH_BITS) {
+        VarMapEntry** collisions = ALLOCATE(ALLOC_CHECKPOINTS, node->entries_count * sizeof(*collisions));
+        VERIFY(collisions != NULL);
+        unsigned int count = 0;
+        for (unsigned int i = 0; i < node->entries_count; ++i)
+        {
+            if (strcmp(node->slots[i].entry->name, name) != 0) {
+                collisions[count] = node->slots[i].entry;
+                count += 1;
+            }
+        }
+        VarMapNode* new_node = NULL;
+        if (count < node->entries_count) {
+            new_node = createVarMapNode(0, 0, count, collisions, 0, NULL);
+        }
+        deallocate(collisions);
+        return new_node;
+    }
+
+    for (unsigned int i = 0; i < node->entries_count; ++i)
+    {
+        entries[i] = node->slots[i].entry;
+    }
+    for (unsigned int i = 0; i < node->nodes_count; ++i)
+    {
+        nodes[i] = node->slots[node->entries_count + i].node;
+    }
+
+    uint32_t bit = (uint32_t)1 << getVarMapFragment(hash, shift);
+    unsigned int entry_index = getVarMapEntryIndex(node, bit);
+    unsigned int node_index = getVarMapNodeIndex(node, bit);
+    if ((node->entry_map & bit) != 0) {
+        if (strcmp(entries[entry_index]->name, name) != 0) {
+            return NULL;
+        }
+        memmove(&entries[entry_index], &entries[entry_index + 1],
+                (node->entries_count - entry_index - 1) * sizeof(*entries));
+        return createVarMapNode(node->entry_map & ~bit, node->node_map,
+                                node->entries_count - 1, entries,
+                                node->nodes_count, nodes);
+    }
+    if ((node->node_map & bit) == 0) {
+        return NULL;
+    }
+
+    VarMapNode* child = deleteFromVarMapNode(nodes[node_index], shift + VARMAP_NODE_BITS, name, hash);
+    if (child == NULL) {
+        return NULL;
+    }
+    VarMapNode* new_node;
+    if (child->nodes_count == 0 && child->entries_count == 1) {
+        /* Inline the last entry of the sub-node */
+        memmove(&nodes[node_index], &nodes[node_index + 1],
+                (node->nodes_count - node_index - 1) * sizeof(*nodes));
+        memmove(&entries[entry_index + 1], &entries[entry_index],
+                (node->entries_count - entry_index) * sizeof(*entries));
+        entries[entry_index] = child->slots[0].entry;
+        new_node = createVarMapNode(node->entry_map | bit, node->node_map & ~bit,
+                                    node->entries_count + 1, entries,
+                                    node->nodes_count - 1, nodes);
+    } else {
+        nodes[node_index] = child;
+        new_node = createVarMapNode(node->entry_map, node->node_map,
+                                    node->entries_count, entries,
+                                    node->nodes_count, nodes);
+    }
+    releaseVarMapNode(child);
+    return new_node;
+}
+
+/**
+ * Find the entry of a name under a node.
+ *
+ * @param
+ *      VarMapNode* node - Node to search in.
+ *      unsigned int shift - Position of the node's hash fragment in the hash.
+ *      const char* name - Name to search for.
+ *      unsigned int hash - Hash of the name.
+ *
+ * @return
+ *      The entry, or NULL if there's no entry of the name.
+ */
+VarMapEntry* findVarMapEntry(VarMapNode* node, unsigned int shift, const char* name, unsigned int hash)
+{
+    while (shift < VARMAP_HASH_BITS)
+    {
+        uint32_t bit = (uint32_t)1 << getVarMapFragment(hash, shift);
+        if ((node->entry_map & bit) != 0) {
+            VarMapEntry* entry = node->slots[getVarMapEntryIndex(node, bit)].entry;
+            return (strcmp(entry->name, name) == 0) ? entry : NULL;
+        }
+        if ((node->node_map & bit) == 0) {
+            return NULL;
+        }
+        node = node->slots[node->entries_count + getVarMapNodeIndex(node, bit)].node;
+        shift += VARMAP_NODE_BITS;
+    }
+
+    for (unsigned int i = 0; i < node->entries_count; ++i)
+    {
+        if (strcmp(node->slots[i].entry->name, name) == 0) {
+            return node->slots[i].entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Report the differences between two nodes of the same position (see varMapDiff).
+ *
+ * @param
+ *      VarMapNode* from - Node of the first map.
+ *      VarMapNode* to - Node of the second map.
+ *      unsigned int shift - Position of the nodes' hash fragment in the hash.
+ *      VarMapDiffCallback callback - Function called for each name whose value differs.
+ *      void* context - Context passed to the callback.
+ */
+void diffVarMapNodes(VarMapNode* from, VarMapNode* to, unsigned int shift,
+                     VarMapDiffCallback callback, void* context)
+{
+    if (from == to) {
+        return;
+    }
+
+    if (shift >= VARMAP_HASH_BITS) {
+        for (unsigned int i = 0; i < to->entries_count; ++i)
+        {
+            VarMapEntry* entry = to->slots[i].entry;
+            VarMapEntry* old_entry = findVarMapEntry(from, shift, entry->name, entry->hash);
+            if (old_entry == NULL || old_entry->value != entry->value) {
+                callback(context, entry->name, true, entry->value);
+            }
+        }
+        for (unsigned int i = 0; i < from->entries_count; ++i)
+        {
+            VarMapEntry* entry = from->slots[i].entry;
+            if (findVarMapEntry(to, shift, entry->name, entry->hash) == NULL) {
+                callback(context, entry->name, false, 0);
+            }
+        }
+        return;
+    }
+
+    uint32_t slots_map = from->entry_map | from->node_map | to->entry_map | to->node_map;
+    while (slots_map != 0)
+    {
+        uint32_t bit = slots_map & -slots_map;
+        slots_map &= ~bit;
+
+        VarMapEntry* from_entry = NULL;
+        VarMapEntry* to_entry = NULL;
+        VarMapNode* from_node = NULL;
+        VarMapNode* to_node = NULL;
+        if ((from->entry_map & bit) != 0) {
+            from_entry = from->slots[getVarMapEntryIndex(from, bit)].entry;
+        } else if ((from->node_map & bit) != 0) {
+            from_node = from->slots[from->entries_count + getVarMapNodeIndex(from, bit)].node;
+        }
+        if ((to->entry_map & bit) != 0) {
+            to_entry = to->slots[getVarMapEntryIndex(to, bit)].entry;
+        } else if ((to->node_map & bit) != 0) {
+            to_node = to->slots[to->entries_count + getVarMapNodeIndex(to, bit)].node;
+        }
+
+        if (from_node != NULL && to_node != NULL) {
+            diffVarMapNodes(from_node, to_node, shift + VARMAP_NODE_BITS, callback, context);
+        } else if (from_node != NULL) {
+            diffVarMapNodeAndEntry(from_node, to_entry, shift + VARMAP_NODE_BITS, callback, context);
+        } else if (to_node != NULL) {
+            diffVarMapEntryAndNode(from_entry, to_node, shift + VARMAP_NODE_BITS, callback, context);
+        } else if (from_entry == NULL) {
+            callback(context, to_entry->name, true, to_entry->value);
+        } else if (to_entry == NULL) {
+            callback(context, from_entry->name, false, 0);
+        } else if (from_entry != to_entry) {
+            if (strcmp(from_entry->name, to_entry->name) != 0) {
+                callback(context, from_entry->name, false, 0);
+                callback(context, to_entry->name, true, to_entry->value);
+            } else if (from_entry->value != to_entry->value) {
+                callback(context, to_entry->name, true, to_entry->value);
+            }
+        }
+    }
+}
+
+/**
+ * Report the differences between an entry (or nothing) of the first map,
+ * and a sub-node of the same position in the second map.
+ *
+ * @param
+ *      VarMapEntry* from - Entry of the first map, or NULL.
+ *      VarMapNode* to - Node of the second map.
+ *      unsigned int shift - Position of the node's hash fragment in the hash.
+ *      VarMapDiffCallback callback - Function called for each name whose value differs.
+ *      void* context - Context passed to the callback.
+ */
+void diffVarMapEntryAndNode(VarMapEntry* from, VarMapNode* to, unsigned int shift,
+                            VarMapDiffCallback callback, void* context)
+{
+    VarMapEntry* to_entry = NULL;
+    if (from != NULL) {
+        to_entry = findVarMapEntry(to, shift, from->name, from->hash);
+        if (to_entry == NULL) {
+            callback(context, from->name, false, 0);
+        }
+    }
+
+    /* Report the whole node, except for an unchanged entry of the same name */
+    if (to_entry == NULL || to_entry->value != from->value) {
+        reportVarMapNode(to, true, callback, context);
+        return;
+    }
+    VarMapNode* rest = deleteFromVarMapNode(to, shift, to_entry->name, to_entry->hash);
+    reportVarMapNode(rest, true, callback, context);
+    releaseVarMapNode(rest);
+}
+
+/**
+ * Report the differences between a sub-node of the first map,
+ * and an entry (or nothing) of the same position in the second map.
+ *
+ * @param
+ *      VarMapNode* from - Node of the first map.
+ *      VarMapEntry* to - Entry of the second map, or NULL.
+ *      unsigned int shift - Position of the node's hash fragment in the hash.
+ *      VarMapDiffCallback callback - Function called for each name whose value differs.
+ *      void* context - Context passed to the callback.
+ */
+void diffVarMapNodeAndEntry(VarMapNode* from, VarMapEntry* to, unsigned int shift,
+                            VarMapDiffCallback callback, void* context)
+{
+    if (to == NULL) {
+        reportVarMapNode(from, false, callback, context);
+        return;
+    }
+
+    VarMapEntry* from_entry = findVarMapEntry(from, shift, to->name, to->hash);
+    if (from_entry == NULL) {
+        reportVarMapNode(from, false, callback, context);
+    } else {
+        VarMapNode* rest = deleteFromVarMapNode(from, shift, to->name, to->hash);
+        reportVarMapNode(rest, false, callback, context);
+        releaseVarMapNode(rest);
+    }
+    if (from_entry == NULL || from_entry->value != to->value) {
+        callback(context, to->name, true, to->value);
+    }
+}
+
+/**
+ * Report all the entries under a node as set (with their values) or as deleted.
+ * The recursion is bounded by the amount of hash bits.
+ *
+ * @param
+ *      VarMapNode* node - Node to report.
+ *      bool is_set - Whether the entries are reported as set.
+ *      VarMapDiffCallback callback - Function called for each entry.
+ *      void* context - Context passed to the callback.
+ */
+void reportVarMapNode(VarMapNode* node, bool is_set, VarMapDiffCallback callback, void* context)
+{
+    for (unsigned int i = 0; i < node->entries_count; ++i)
+    {
+        VarMapEntry* entry = node->slots[i].entry;
+        callback(context, entry->name, is_set, is_set ? entry->value : 0);
+    }
+    for (unsigned int i = 0; i < node->nodes_count; ++i)
+    {
+        reportVarMapNode(node->slots[node->entries_count + i].node, is_set, callback, context);
+    }
+}
+
+/**
+ * Get the fragment of a hash which indexes a node.
+ *
+ * @param
+ *      unsigned int hash - Hash of a name.
+ *      unsigned int shift - Position of the node's hash fragment in the hash.
+ *
+ * @return
+ *      The fragment (0 to 31).
+ */
+unsigned int getVarMapFragment(unsigned int hash, unsigned int shift)
+{
+    return (hash >> shift) & ((1u << VARMAP_NODE_BITS) - 1);
+}
+
+/**
+ * Get the slot index of the entry of a hash fragment.
+ *
+ * @param
+ *      VarMapNode* node - Node of the entry.
+ *      uint32_t bit - Bit of the hash fragment.
+ *
+ * @return
+ *      Index of the entry (where it's inserted, if the node doesn't have it).
+ */
+unsigned int getVarMapEntryIndex(VarMapNode* node, uint32_t bit)
+{
+    return (unsigned int)__builtin_popcount(node->entry_map & (bit - 1));
+}
+
+/**
+ * Get the index (among the sub-nodes) of the sub-node of a hash fragment.
+ *
+ * @param
+ *      VarMapNode* node - Node of the sub-node.
+ *      uint32_t bit - Bit of the hash fragment.
+ *
+ * @return
+ *      Index of the sub-node (where it's inserted, if the node doesn't have it).
+ */
+unsigned int getVarMapNodeIndex(VarMapNode* node, uint32_t bit)
+{
+    return (unsigned int)__builtin_popcount(node->node_map & (bit - 1));
+}
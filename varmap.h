@@ -0,0 +1,149 @@
+/*
+ * Persistent Variable Map Module
+ */
+
+#ifndef VARMAP_H_
+#define VARMAP_H_
+
+#include <stdbool.h>
+#include "common.h"
+
+/*
+ * Persistent Variable Map
+ *
+ * An immutable map from variable names to values, stored as a hash array mapped trie:
+ * each node is indexed by 5 bits of the name's hash, and holds up to 32 entries and sub-nodes.
+ * Inserting or deleting a name creates a new map, which copies only the nodes on the name's path
+ * and shares the rest with the old map. So a map is kept (e.g. as a snapshot) in O(1),
+ * and a change costs O(log32(n)), no matter how many maps share the same nodes.
+ */
+
+/*
+ * Types
+ */
+
+/* Immutable map of variable names to values (reference counted) */
+typedef struct VarMap_t* VarMap;
+
+/*
+ * Function that is called for each name whose value differs between two maps.
+ * If is_set is false, then the name isn't in the second map (and value is undefined).
+ */
+typedef void (*VarMapDiffCallback)(void* context, const char* name, bool is_set, double value);
+
+/*
+ * Functions
+ */
+
+/**
+ * Create an empty map.
+ * The map has to be released by releaseVarMap.
+ *
+ * @return
+ *      The created map.
+ */
+VarMap createVarMap();
+
+/**
+ * Take another reference to a map (O(1)).
+ *
+ * @param
+ *      VarMap map - Map to reference.
+ *
+ * @preconditions
+ *      map != NULL
+ *
+ * @return
+ *      The same map, which has to be released by releaseVarMap.
+ */
+VarMap retainVarMap(VarMap map);
+
+/**
+ * Release a reference to a map.
+ * The map (and the nodes it doesn't share with other maps) is destroyed with it's last reference.
+ * If the given map is NULL, then nothing is done.
+ *
+ * @param
+ *      VarMap map - Map to release.
+ */
+void releaseVarMap(VarMap map);
+
+/**
+ * Create a map which is identical to a given one, except for the value of a single name.
+ *
+ * @param
+ *      VarMap map - Map to change (which isn't modified).
+ *      const char* name - Name to set.
+ *      double value - Value to set.
+ *
+ * @preconditions
+ *      map != NULL, name != NULL
+ *
+ * @return
+ *      The new map, which has to be released by releaseVarMap.
+ */
+VarMap varMapInsert(VarMap map, const char* name, double value);
+
+/**
+ * Create a map which is identical to a given one, except that it doesn't have a given name.
+ *
+ * @param
+ *      VarMap map - Map to change (which isn't modified).
+ *      const char* name - Name to delete.
+ *
+ * @preconditions
+ *      map != NULL, name != NULL
+ *
+ * @return
+ *      The new map (which is the given map if it doesn't have the name),
+ *      which has to be released by releaseVarMap.
+ */
+VarMap varMapDelete(VarMap map, const char* name);
+
+/**
+ * Get the value of a name.
+ *
+ * @param
+ *      VarMap map - Map to search in.
+ *      const char* name - Name to search for.
+ *      double* value - Value of the name (output parameter).
+ *
+ * @preconditions
+ *      map != NULL, name != NULL, value != NULL
+ *
+ * @return
+ *      true iff the map has the name.
+ */
+bool varMapGet(VarMap map, const char* name, OUT double* value);
+
+/**
+ * Get the amount of names in a map.
+ *
+ * @param
+ *      VarMap map - Map to check.
+ *
+ * @preconditions
+ *      map != NULL
+ *
+ * @return
+ *      Amount of names.
+ */
+unsigned int varMapSize(VarMap map);
+
+/**
+ * Find the differences between two maps, i.e. the changes which turn the first map into the second.
+ * Nodes shared by both maps are skipped, so the cost is proportional to the changes between them
+ * (when one map was derived from the other).
+ *
+ * @param
+ *      VarMap from - First map.
+ *      VarMap to - Second map.
+ *      VarMapDiffCallback callback - Function called for each name whose value differs.
+ *      void* context - Context passed to the callback.
+ *
+ * @preconditions
+ *      from != NULL, to != NULL, callback != NULL
+ */
+void varMapDiff(VarMap from, VarMap to, VarMapDiffCallback callback, void* context);
+
+#endif /* VARMAP_H_ */